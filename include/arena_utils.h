@@ -0,0 +1,72 @@
+/**
+ * @file arena_utils.h
+ * @brief Bump-pointer (arena) memory allocator declaration.
+ */
+
+#ifndef ARENA_UTILS_H
+#define ARENA_UTILS_H
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+//! \brief Minimum size (in bytes) of each block of memory an arena asks for to the system.
+#define ARENA_BLOCK_SIZE 65536
+//! \brief Every allocation from an arena is aligned to this amount of bytes.
+#define ARENA_ALIGNMENT alignof(max_align_t)
+
+//! \brief Block of memory owned by an arena. Blocks are chained, and kept between resets.
+typedef struct arena_block
+{
+    //! \brief Next block of the chain, or NULL.
+    struct arena_block* next;
+    //! \brief Usable bytes of this block.
+    size_t size;
+    //! \brief Bytes already handed out from this block.
+    size_t used;
+    //! \brief The memory itself.
+    alignas(ARENA_ALIGNMENT) unsigned char data[];
+} arena_block;
+
+/**
+ * @brief Bump-pointer allocator: allocations are a pointer increment, and all of them are released at once with
+ * arena_reset(). Zero-initialize it before its first use (i.e.: `arena a = {0};`).
+ */
+typedef struct arena
+{
+    //! \brief First block of the chain, or NULL if nothing was ever allocated.
+    arena_block* head;
+    //! \brief Block currently handing out memory.
+    arena_block* current;
+} arena;
+
+/**
+ * @brief Allocates memory from an arena. It can't be freed on its own, only with the whole arena.
+ * @param a Arena to allocate from.
+ * @param size Bytes requested.
+ * @return Memory aligned to ARENA_ALIGNMENT, or NULL if the system ran out of memory.
+ */
+void* arena_alloc(arena* a, size_t size);
+
+/**
+ * @brief Copies a string into memory of an arena.
+ * @param a Arena to allocate from.
+ * @param s String to copy.
+ * @return The copy, or NULL if the system ran out of memory.
+ */
+char* arena_strdup(arena* a, const char* s);
+
+/**
+ * @brief Releases every allocation done from an arena, in one step. Its blocks are kept to be reused.
+ * @param a Arena to reset.
+ */
+void arena_reset(arena* a);
+
+/**
+ * @brief Gives back to the system every block of an arena, leaving it as a zero-initialized one.
+ * @param a Arena to release.
+ */
+void arena_release(arena* a);
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * @file batch_utils.h
+ * @brief Batch file reader declaration. Regular files are memory-mapped; pipes, FIFOs and the like are streamed
+ * through a read buffer that grows to hold the longest line.
+ */
+
+#ifndef BATCH_UTILS_H
+#define BATCH_UTILS_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//! \brief Bytes asked to the kernel on each read() of a non-mappable batch file; the buffer starts with this size.
+#define BATCH_READ_BUFFER_SIZE (1 << 20)
+//! \brief Bytes of a mapped batch file executed before their pages are given back to the system.
+#define BATCH_MAP_RELEASE_STEP (32 << 20)
+//! \brief Char that ends each line of a batch file.
+#define BATCH_LINE_DELIMITER '\n'
+
+/**
+ * @brief Receives each line of a batch file.
+ * @param line The line, newline excluded. It isn't NULL-terminated, and is only valid during the call.
+ * @param len Length of the line, in bytes.
+ * @param ctx Context passed to batch_for_each_line().
+ */
+typedef void (*batch_line_handler)(const char* line, size_t len, void* ctx);
+
+/**
+ * @brief Hands every line of a batch file, in order, to a handler; no line gets copied, and there's no limit to
+ * their length. The last line doesn't need a trailing newline.
+ * @param fd File descriptor of the batch file, open for reading. It isn't closed.
+ * @param handler Function called with each line.
+ * @param ctx Passed as is to the handler.
+ * @return 0 once the whole file was handled, -1 if it couldn't be read (errno is set).
+ */
+int batch_for_each_line(int fd, batch_line_handler handler, void* ctx);
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ * @file builtin_utils.h
+ * @brief Internal commands (builtins) registry declaration.
+ */
+
+#ifndef BUILTIN_UTILS_H
+#define BUILTIN_UTILS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+//! \brief Slots of the builtins perfect hash table. Must be a power of 2.
+#define BUILTIN_SLOTS 64
+//! \brief Seed (FNV-1a 32 bits offset basis replacement) that makes builtin_hash() collision free for every builtin.
+#define BUILTIN_HASH_SEED 18u
+//! \brief FNV-1a 32 bits prime.
+#define BUILTIN_HASH_PRIME 16777619u
+
+//! \brief Builtin properties, to be OR'ed.
+enum builtin_flags
+{
+    //! \brief When called solo, it's quick enough to run inside the shell process (ignoring "&"); otherwise it gets
+    //! run by a forked copy of the shell, so it can be sent to the background.
+    BUILTIN_IN_PROCESS = 1 << 0,
+    //! \brief It changes the shell state (cwd, tracked processes, etc.), so it must run inside the shell process.
+    BUILTIN_NEEDS_PARENT = 1 << 1,
+    //! \brief It can be a pipeline stage. Builtins without it do nothing when coupled with other commands.
+    BUILTIN_IN_PIPELINE = 1 << 2,
+    //! \brief As a stage of a foreground pipeline, it runs inside the shell process on a helper thread (writing to its
+    //! own stream), instead of on a forked copy of the shell. It mustn't touch what the shell thread does meanwhile
+    //! (jobs, path cache), nor read stdin.
+    BUILTIN_ON_THREAD = 1 << 3
+};
+
+//! \brief Everything an internal command gets to know about its invocation.
+typedef struct builtin_call
+{
+    //! \brief Single command tokens (quotes already resolved, redirections excluded). Last "useful" element is always
+    //! NULL.
+    char** sc_tokens;
+    //! \brief Should be executed in the background?
+    bool background_execution;
+    //! \brief Current working directory. Could get updated.
+    char* cwd;
+    //! \brief Where its output goes: stdout, or the stream of its pipeline stage when run on a helper thread.
+    FILE* out;
+    //! \brief Whether it runs on a helper thread, as a pipeline stage (see BUILTIN_ON_THREAD).
+    bool on_helper_thread;
+} builtin_call;
+
+//! \brief An internal command implementation.
+typedef void (*builtin_handler)(const builtin_call* call);
+
+//! \brief Registry entry of an internal command.
+typedef struct builtin
+{
+    //! \brief Name, as typed by the user. NULL for an unused slot.
+    const char* name;
+    //! \brief Implementation.
+    builtin_handler handler;
+    //! \brief OR'ed builtin_flags.
+    unsigned flags;
+    /**
+     * @brief Optional (NULL if not needed), for the ones with BUILTIN_ON_THREAD. Tells if an invocation runs on a
+     * forked copy of the shell anyway: one that doesn't end by itself has to be reachable by [Ctrl]+[C] and job
+     * control, as a helper thread isn't.
+     * @param sc_tokens Single command tokens.
+     * @return true if it has to run on a forked copy.
+     */
+    bool (*forks)(char** sc_tokens);
+} builtin;
+
+/**
+ * @brief Hash used to place (at compile time) and find the builtins in the registry.
+ * @param name Command name.
+ * @return Slot index, lower than BUILTIN_SLOTS.
+ */
+size_t builtin_hash(const char* name);
+
+/**
+ * @brief Finds an internal command by its name, with a single string comparison.
+ * @param name Command name (first token of a single command).
+ * @return The registry entry, or NULL if it isn't an internal command.
+ */
+const builtin* builtin_lookup(const char* name);
+
+/**
+ * @brief Gives access to the whole registry, i.e.: to list every internal command.
+ * @param n_slots Where to leave the amount of slots (some of them unused) of the registry.
+ * @return The registry slots.
+ */
+const builtin* builtin_registry(size_t* n_slots);
+
+#endif
@@ -6,68 +6,171 @@
 #ifndef CMD_UTILS_H
 #define CMD_UTILS_H
 
+#include "config_index_utils.h"
+#include "explore_utils.h"
+#include "query_utils.h"
+#include "record_utils.h"
+#include "uring_utils.h"
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <linux/limits.h>
+#include <poll.h>
+#include <stdalign.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/inotify.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 //! \brief Lowest array index.
 #define LOWEST_ARR_INDEX 0
-//! \brief Minimum char index at which '&' shell operator is permitted to appear.
-#define AMP_MIN_INDEX_APPEARANCE 2
 //! \brief Any string null terminator. Stablish the end of a string.
 #define STR_NULL_TERMINATOR '\0'
-//! \brief Buffer (in bytes) to use for read/write operations.
-#define READING_BUFFER 1024
+//! \brief Buffer (in bytes) to use for read/write operations, when the kernel can't copy on its own.
+#define READING_BUFFER 65536
+//! \brief Bytes asked to the kernel to copy at once; the most a single copy_file_range()/sendfile() moves.
+#define COPY_CHUNK 0x7FFFF000
+//! \brief Config files read at once through io_uring by default, when asked to.
+#define TRAVERSE_IO_DEPTH 64
+//! \brief Config files read at once through io_uring, at most; each one takes a READING_BUFFER while in flight.
+#define TRAVERSE_MAX_IO_DEPTH 1024
 
-/**
- * @brief Checks for "&" existence at the end of the command, "removing" it from the tokens array.
- * @param tokens Array where elements are each token of a single command. After the last useful token, must be a
- * NULL value.
- * @return true if a background execution was called, false otherwise.
- */
-bool is_background_exec(char** tokens);
+//! \brief Events on a watched dir that can add, change or remove a config file under it. A file written is told once
+//! it gets closed.
+#define AUDIT_WATCHED_EVENTS                                                                                           \
+    (IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF | IN_ONLYDIR)
+//! \brief Buffer (in bytes) used to read inotify events.
+#define AUDIT_EVENTS_BUFFER 65536
+
+//! \brief Options of "explore_filesystem", as typed.
+typedef struct explore_options
+{
+    //! \brief Path to the dir to explore, or NULL.
+    const char* dir_path;
+    //! \brief Threads listing dirs, between 1 and EXPLORE_MAX_WORKERS.
+    unsigned n_threads;
+    //! \brief Config files read at once through io_uring, up to TRAVERSE_MAX_IO_DEPTH; 0 to read them one by one.
+    unsigned io_depth;
+    //! \brief What to leave out.
+    explore_filter filter;
+    //! \brief Whether the config files get told as machine-readable records, instead of shown.
+    bool records;
+    //! \brief How the records get formatted.
+    enum record_format format;
+    //! \brief Whether each record carries the content of the config file.
+    bool with_content;
+    //! \brief Whether only the config files added, changed or removed get told.
+    bool changes;
+    //! \brief Whether the changes keep getting told as they happen.
+    bool watch;
+    //! \brief Index file of the changes, or NULL for the default one.
+    const char* index_path;
+    //! \brief Path to the value to select from each JSON config file, or NULL.
+    const char* select;
+    //! \brief Predicates the JSON config files shown have to hold.
+    char* where[QUERY_MAX_PREDICATES];
+    //! \brief Amount of predicates.
+    size_t n_where;
+} explore_options;
+
+//! \brief Ways to copy a file to another file descriptor, the cheapest first.
+enum copy_method
+{
+    //! \brief copy_file_range(): within the kernel (or the file system), to a regular file.
+    COPY_FILE_RANGE,
+    //! \brief sendfile(): within the kernel, to a pipe, socket or regular file.
+    COPY_SENDFILE,
+    //! \brief read() & write() through a buffer, to anything (i.e.: a terminal).
+    COPY_BUFFERED
+};
 
 /**
- * @brief If the arg has a newline at its end, it gets wiped. Modifies the arg.
- * @param input String to cleanse.
+ * @brief Joins tokens with a single space between them, i.e.: to rebuild a path with spaces typed unquoted.
+ * @param tokens Tokens to join. After the last useful token, must be a NULL value.
+ * @param buffer Where the joined string gets written.
+ * @param size Size of the buffer, in bytes.
+ * @return true if the joined string fit in the buffer, false otherwise.
  */
-void cleanse_newline(char* input);
+bool join_tokens(char* const* tokens, char* buffer, size_t size);
 
 /**
- * @brief This function doesn't check for valid arg, it expects a valid string with " &" at the end, aka
- * is_background_exec() returning true.
- * @param input String to cleanse.
+ * @brief Copies what's left of a file to another file descriptor, without going through user space if the kernel can.
+ * @param in_fd The file, open for reading.
+ * @param out_fd Where to copy it, open for writing (i.e.: STDOUT_FILENO).
+ * @param method The cheapest way to try first; it's left as the one that worked, so the next copies to the same
+ * out_fd don't try the ones that can't.
+ * @return 0 once the whole file was copied, -1 on failure (errno is set).
  */
-void cleanse_ampersand(char* input);
+int copy_file_to_fd(int in_fd, int out_fd, enum copy_method* method);
 
 /**
- * @brief From a list of tokenized argv strings, check if stdin redirection is found and if it does, return the file.
- * @param argv Tokenized list of strings.
- * @param _stdin Pass true if you're looking for a stdin redirection, false for a stdout redirection.
- * @return The file name, if found; otherwise returns NULL.
+ * @brief Traverses a valid dir in search for certain config files (*.config & *.json) showing its content on a stream.
+ * The dirs get listed by several threads at once; the output is the same whatever their amount. Optionally, the config
+ * files get read through io_uring: each one opened, read and closed by a chain of linked operations, and many of them
+ * submitted at once; the output is the same too. If the kernel can't, they get read one by one.
+ * @param dir_path Path to an existent directory.
+ * @param n_threads Threads listing dirs, between 1 and EXPLORE_MAX_WORKERS.
+ * @param filter What to leave out, or NULL for nothing.
+ * @param io_depth Config files read at once through io_uring, up to TRAVERSE_MAX_IO_DEPTH; 0 to read them one by one.
+ * @param out Where to show them (i.e.: stdout). Once it can't be written anymore (i.e.: nobody reads it), the traversal
+ * stops.
  */
-char* get_possible_redirection(char** argv, bool _stdin);
+void traverse_directory(const char* dir_path, unsigned n_threads, const explore_filter* filter, unsigned io_depth,
+                        FILE* out);
 
 /**
- * @brief As redirections are expected at the end of the single command, clean them from argv.
- * @param argv Tokenized list of strings. Could get modified.
+ * @brief Traverses a valid dir in search for config files (*.config & *.json), telling on a stream only the ones added,
+ * changed or removed since the last time, one per line ("added", "changed" or "removed", a tab, and the absolute path).
+ * What was found is kept on an index file; only the files whose size, mtime or inode changed get read. Optionally, the
+ * dir keeps being watched afterwards (inotify), telling each change as it happens.
+ * @param dir_path Path to an existent directory.
+ * @param n_threads Threads listing dirs, between 1 and EXPLORE_MAX_WORKERS.
+ * @param filter What to leave out, or NULL for nothing; the config files it leaves out are told as removed if they were
+ * indexed. The dirs and files that appear while watching get filtered too.
+ * @param index_path Path to the index file, or NULL for the default one of the dir (CONFIG_INDEX_DEFAULT_PATH_FORMAT).
+ * Without it, every config file found is told as added.
+ * @param watch Whether to keep watching the dir.
+ * @param stop_fd While watching, it stops once this file descriptor gets readable (i.e.: a key pressed on stdin), or
+ * out can't be written anymore. -1 to stop only on the latter.
+ * @param out Where to tell the changes (i.e.: stdout). If it can't be written anymore before the scan ends, the scan
+ * stops, the index isn't saved (so they get told again the next time), and the dir isn't watched.
+ * @return 0 on success, -1 on failure (the error gets shown).
  */
-void cleanse_redirections_on_argv(char** argv);
+int audit_directory(const char* dir_path, unsigned n_threads, const explore_filter* filter, const char* index_path,
+                    bool watch, int stop_fd, FILE* out);
 
 /**
- * @brief Cleanse redirection on single command, non-tokenized.
- * @param sc Raw single command. Could modify it.
+ * @brief Traverses a valid dir in search for config files (*.config & *.json), showing on a stream only the ones that
+ * match a query, one per line: the path, and the value selected after a tab (if the query selects one). The files are
+ * read, filtered and parsed by the threads listing dirs, as they find them; the output is the same whatever their
+ * amount. Files that aren't valid JSON never match.
+ * @param dir_path Path to an existent directory.
+ * @param n_threads Threads listing dirs, between 1 and EXPLORE_MAX_WORKERS.
+ * @param filter What to leave out, or NULL for nothing.
+ * @param query The query, compiled.
+ * @param out Where to show them (i.e.: stdout). Once it can't be written anymore, the traversal stops.
  */
-void cleanse_redirections_on_sc(char* sc);
+void query_directory(const char* dir_path, unsigned n_threads, const explore_filter* filter, const json_query* query,
+                     FILE* out);
 
 /**
- * @brief Traverses a valid dir in search for certain config files (*.config & *.json) showing its content on stdout.
+ * @brief Traverses a valid dir in search for config files (*.config & *.json), telling each one on a stream as a
+ * machine-readable record: its path, size, mtime and optionally its content. The records are kept on a large buffer,
+ * written in big blocks. Without content, the files are inspected by the threads listing dirs, as they find them; with
+ * it, each one gets streamed into its record. The output is the same whatever the amount of threads.
  * @param dir_path Path to an existent directory.
+ * @param n_threads Threads listing dirs, between 1 and EXPLORE_MAX_WORKERS.
+ * @param filter What to leave out, or NULL for nothing.
+ * @param format How the records get formatted.
+ * @param with_content Whether each record carries the content of the config file.
+ * @param out Where to tell them (i.e.: stdout); they're written straight to its file descriptor. Once it can't be
+ * written anymore, the traversal stops.
  */
-void traverse_directory(const char* dir_path);
+void export_directory(const char* dir_path, unsigned n_threads, const explore_filter* filter,
+                      enum record_format format, bool with_content, FILE* out);
 
 /**
  * @brief Check if the file name provided has the requested extension to be considered a config file.
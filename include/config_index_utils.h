@@ -0,0 +1,148 @@
+/**
+ * @file config_index_utils.h
+ * @brief Index of the config files found under a dir declaration. Each file is known by its path, and remembered with
+ * its size, mtime, inode and a hash of its content; a later scan only reads the files whose metadata changed, and
+ * tells which ones were added, changed or removed. The index is kept on a file (native byte order) between scans.
+ */
+
+#ifndef CONFIG_INDEX_UTILS_H
+#define CONFIG_INDEX_UTILS_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+//! \brief Initial amount of slots of an index. Must be a power of 2.
+#define CONFIG_INDEX_INITIAL_SLOTS 256
+//! \brief An index doubles its slots when used ones surpass this percentage.
+#define CONFIG_INDEX_MAX_LOAD_PCT 75
+//! \brief Bytes read at once while hashing the content of a file.
+#define CONFIG_INDEX_READ_BUFFER 65536
+//! \brief A file modified less than these nanoseconds before its content was hashed could be modified again without
+//! its mtime changing (timestamps are as coarse as the clock tick, or the file system); it gets hashed again next time.
+#define CONFIG_INDEX_RACY_NS 2000000000LL
+//! \brief First bytes of an index file, telling its format.
+#define CONFIG_INDEX_MAGIC "CFGIDX01"
+//! \brief Environment variable key of the user's cache dir.
+#define CONFIG_INDEX_CACHE_ENV_KEY "XDG_CACHE_HOME"
+//! \brief Environment variable key of the user's home dir; the cache dir is CONFIG_INDEX_HOME_CACHE under it, when
+//! CONFIG_INDEX_CACHE_ENV_KEY isn't set.
+#define CONFIG_INDEX_HOME_ENV_KEY "HOME"
+//! \brief Cache dir, relative to the home dir.
+#define CONFIG_INDEX_HOME_CACHE ".cache"
+//! \brief Dir of the index files when none is given, inside the cache dir.
+#define CONFIG_INDEX_CACHE_DIR "explore_filesystem"
+//! \brief Index file of a dir when none is given, inside CONFIG_INDEX_CACHE_DIR: one per dir, named after the hash of
+//! its absolute path.
+#define CONFIG_INDEX_DEFAULT_FILE_FORMAT "%016" PRIx64 ".index"
+//! \brief Permissions of the dirs created for the index files: only the user gets in.
+#define CONFIG_INDEX_DIR_MODE 0700
+
+//! \brief An index of config files. Opaque.
+typedef struct config_index config_index;
+
+//! \brief What happened to a config file since it was last indexed.
+enum config_change
+{
+    CONFIG_UNCHANGED,
+    CONFIG_ADDED,
+    CONFIG_CHANGED,
+    CONFIG_REMOVED
+};
+
+/**
+ * @brief Creates an empty index.
+ * @param root Absolute path to the dir it indexes; an index file of another dir isn't loaded.
+ * @return The index, or NULL if the system ran out of memory.
+ */
+config_index* config_index_create(const char* root);
+
+/**
+ * @brief Releases an index.
+ * @param index The index, or NULL.
+ */
+void config_index_destroy(config_index* index);
+
+/**
+ * @brief Gets the path to the index file of a dir, when none is given: inside CONFIG_INDEX_CACHE_DIR of the user's
+ * cache dir ($XDG_CACHE_HOME, or ~/.cache), which gets created if needed. Nobody else can write there, so nobody else
+ * can plant an index on it, nor a symbolic link where one gets written.
+ * @param root Absolute path to the dir.
+ * @param buffer Where the path gets written.
+ * @param size Size of the buffer, in bytes.
+ * @return true on success, false otherwise (errno is set: ENOENT if there's no cache dir to use, ENAMETOOLONG if the
+ * path didn't fit in the buffer, EPERM if CONFIG_INDEX_CACHE_DIR isn't a dir of the user that only it can write to).
+ */
+bool config_index_default_path(const char* root, char* buffer, size_t size);
+
+/**
+ * @brief Loads an index file, replacing what the index had.
+ * @param index The index.
+ * @param file Path to the index file.
+ * @return 0 on success, -1 on failure (errno is set: EINVAL if it isn't an index file of the same dir, EPERM if it
+ * isn't a regular file of the user that only it can write to). The index is left empty on failure.
+ */
+int config_index_load(config_index* index, const char* file);
+
+/**
+ * @brief Saves an index on a file, atomically: it's written aside (on a new file of a unique name, never through an
+ * existing one), and renamed over the previous one.
+ * @param index The index.
+ * @param file Path to the index file.
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+int config_index_save(const config_index* index, const char* file);
+
+/**
+ * @brief Starts a scan: the files that aren't refreshed from now on can be told apart with config_index_sweep().
+ * @param index The index.
+ */
+void config_index_begin_scan(config_index* index);
+
+/**
+ * @brief Brings the entry of a file up to date. Its content is only hashed when its size, mtime or inode differ from
+ * the indexed ones (or they were taken too close in time to tell).
+ * @param index The index.
+ * @param path Path to the file, as it's known by the index.
+ * @param change Where to leave what happened to the file: CONFIG_ADDED, CONFIG_CHANGED or CONFIG_UNCHANGED.
+ * @return 0 on success, -1 if the file couldn't be reached or read, it isn't a regular file (errno is set: EINVAL), or
+ * the system ran out of memory.
+ */
+int config_index_refresh(config_index* index, const char* path, enum config_change* change);
+
+/**
+ * @brief Forgets a file.
+ * @param index The index.
+ * @param path Path to the file, as it's known by the index.
+ * @return true if it was indexed, false otherwise.
+ */
+bool config_index_remove(config_index* index, const char* path);
+
+/**
+ * @brief Forgets the files under a dir that weren't refreshed since the scan started, i.e.: the ones removed.
+ * @param index The index.
+ * @param under Path to the dir, or NULL for every file.
+ * @param removed Called with the path of each file forgotten, or NULL.
+ * @param ctx Passed as is to removed.
+ * @return The amount of files forgotten.
+ */
+size_t config_index_sweep(config_index* index, const char* under, void (*removed)(const char* path, void* ctx),
+                          void* ctx);
+
+/**
+ * @brief Tells the amount of files indexed.
+ * @param index The index.
+ * @return The amount of files.
+ */
+size_t config_index_size(const config_index* index);
+
+#endif
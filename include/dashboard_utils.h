@@ -0,0 +1,68 @@
+/**
+ * @file dashboard_utils.h
+ * @brief Live terminal dashboard declaration: a title plus rows of "label: value", redrawn in place. Each frame only
+ * carries the values that changed since the previous one, written at their screen position (cursor addressing), so
+ * the terminal gets a few bytes per refresh instead of a whole cleared screen.
+ */
+
+#ifndef DASHBOARD_UTILS_H
+#define DASHBOARD_UTILS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+//! \brief Rows a dashboard can have, at most.
+#define DASHBOARD_MAX_ROWS 16
+//! \brief Bytes of each value (NUL included); longer ones get truncated.
+#define DASHBOARD_VALUE_SIZE 48
+//! \brief Bytes a frame can take, at most: the first one, with every label and value.
+#define DASHBOARD_FRAME_SIZE 4096
+//! \brief Screen rows taken by the title (the title itself, and its underline).
+#define DASHBOARD_TITLE_ROWS 2
+
+//! \brief State of a dashboard on the screen.
+typedef struct dashboard
+{
+    //! \brief Shown on the first row.
+    const char* title;
+    //! \brief Label of each row.
+    const char* const* labels;
+    //! \brief Amount of rows, up to DASHBOARD_MAX_ROWS.
+    size_t n_rows;
+    //! \brief Screen column (1-based) where the values start, right after the longest label.
+    int value_column;
+    //! \brief Values currently on the screen.
+    char shown[DASHBOARD_MAX_ROWS][DASHBOARD_VALUE_SIZE];
+    //! \brief Was the first (whole) frame already rendered?
+    bool drawn;
+} dashboard;
+
+/**
+ * @brief Sets up a dashboard; nothing gets rendered yet.
+ * @param d The dashboard.
+ * @param title Shown on the first row. Must outlive the dashboard.
+ * @param labels Label of each row. Must outlive the dashboard.
+ * @param n_rows Amount of rows; only the first DASHBOARD_MAX_ROWS are taken.
+ */
+void dashboard_init(dashboard* d, const char* title, const char* const* labels, size_t n_rows);
+
+/**
+ * @brief Renders the escape sequences that bring the screen up to date: the whole dashboard the first time (screen
+ * cleared, cursor hidden), and only the values that changed afterwards.
+ * @param d The dashboard.
+ * @param values Value of each row.
+ * @param frame Where to leave the frame, to be written at once. At least DASHBOARD_FRAME_SIZE bytes.
+ * @return Bytes of the frame; 0 if nothing changed.
+ */
+size_t dashboard_render(dashboard* d, const char* const* values, char* frame);
+
+/**
+ * @brief Renders the escape sequences that hand the screen back: cursor shown again, right below the dashboard.
+ * @param d The dashboard.
+ * @param frame Where to leave the frame. At least DASHBOARD_FRAME_SIZE bytes.
+ * @return Bytes of the frame.
+ */
+size_t dashboard_leave(const dashboard* d, char* frame);
+
+#endif
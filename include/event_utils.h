@@ -0,0 +1,105 @@
+/**
+ * @file event_utils.h
+ * @brief Event loop declaration. The interactive shell waits on one epoll set for whatever it has to answer to (the
+ * terminal, SIGCHLD, processes exiting), and each ready file descriptor gets its handler called.
+ */
+
+#ifndef EVENT_UTILS_H
+#define EVENT_UTILS_H
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+//! \brief File descriptors the loop has room for before growing its table.
+#define EVENT_INITIAL_SOURCES 64
+//! \brief Ready file descriptors taken from the kernel on each wait.
+#define EVENT_MAX_READY 16
+//! \brief Milliseconds in a second.
+#define EVENT_MSECS_PER_SEC 1000
+//! \brief Nanoseconds in a millisecond.
+#define EVENT_NSECS_PER_MSEC 1000000L
+
+/**
+ * @brief Answers to a file descriptor being ready.
+ * @param fd The file descriptor.
+ * @param events Ready events (EPOLLIN, EPOLLHUP, etc.).
+ * @param ctx Context passed to event_watch().
+ */
+typedef void (*event_handler)(int fd, uint32_t events, void* ctx);
+
+/**
+ * @brief Starts watching a file descriptor (level-triggered), replacing its handler if it was already watched. The
+ * loop belongs to the process that created it: a forked copy of the shell starts with an empty one of its own.
+ * @param fd File descriptor. Regular files can't be watched (they're always ready).
+ * @param events Events to watch for (EPOLLIN, EPOLLOUT, etc.).
+ * @param handler Function called each time the file descriptor is ready.
+ * @param ctx Passed as is to the handler.
+ * @return 0 on success, -1 on failure (errno is set; EPERM for a regular file).
+ */
+int event_watch(int fd, uint32_t events, event_handler handler, void* ctx);
+
+/**
+ * @brief Stops watching a file descriptor. It isn't closed. Safe to call from any handler.
+ * @param fd File descriptor. Nothing happens if it isn't watched.
+ */
+void event_unwatch(int fd);
+
+/**
+ * @brief Stops watching a file descriptor, and closes it.
+ * @param fd File descriptor.
+ */
+void event_close(int fd);
+
+/**
+ * @brief Waits until some watched file descriptor is ready, and calls its handler.
+ * @param timeout_ms Maximum milliseconds to wait; 0 to only take what's already ready, -1 to wait for as long as
+ * needed.
+ * @return Amount of handlers called (0 on timeout, on a signal interruption, or when nothing is watched), or -1 if the
+ * loop can't be waited on (errno is set).
+ */
+int event_dispatch(int timeout_ms);
+
+/**
+ * @brief Creates a periodic timer (a timerfd), without watching it (i.e.: to poll() it along with other file
+ * descriptors, outside of the loop).
+ * @param interval_ms Milliseconds between expirations, the first one included. Greater than 0.
+ * @return The timer file descriptor (non-blocking, close-on-exec), or -1 on failure (errno is set).
+ */
+int event_timerfd(unsigned interval_ms);
+
+/**
+ * @brief Creates a periodic timer (a timerfd) and starts watching it.
+ * @param interval_ms Milliseconds between expirations. Greater than 0.
+ * @param handler Function called on each expiration. It must read() the expirations count (8 bytes) out of the
+ * timer, or it keeps being ready.
+ * @param ctx Passed as is to the handler.
+ * @return The timer file descriptor (close it with event_close()), or -1 on failure (errno is set).
+ */
+int event_timer(unsigned interval_ms, event_handler handler, void* ctx);
+
+/**
+ * @brief Gets a file descriptor that refers to a child process: it becomes readable once the process exits, and
+ * (unlike its process id) it can't end up referring to another process.
+ * @param pid Process id.
+ * @return The file descriptor (close-on-exec), or -1 on failure (errno is set).
+ */
+int event_pidfd(pid_t pid);
+
+/**
+ * @brief Sends a signal to the process a pidfd refers to.
+ * @param pidfd File descriptor given by event_pidfd().
+ * @param sig Signal number.
+ * @return 0 on success, -1 on failure (errno is set; ESRCH if the process already exited).
+ */
+int event_pidfd_signal(int pidfd, int sig);
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * @file explore_utils.h
+ * @brief Parallel directory tree traversal declaration. A pool of threads lists the directories, each one with its own
+ * deque of pending directories (LIFO for itself, stolen FIFO by idle threads), opening every entry relative to the fd
+ * of its parent directory. The type of each entry is taken from readdir(); it gets inspected (statx()) only when the
+ * file system doesn't tell it, or it's a symbolic link. What's found gets reported on the calling thread, in the same
+ * order a sequential depth-first traversal would report it, whatever the amount of threads. Optionally, entries get
+ * left out by a filter (how deep, gitignore-style globs, ignore files, other file systems) before they're opened; a
+ * dir that is the same (device and inode) as one it's inside of isn't opened either, so symbolic link loops end. The
+ * visitor can stop the traversal early (i.e.: once nobody reads what it writes).
+ */
+
+#ifndef EXPLORE_UTILS_H
+#define EXPLORE_UTILS_H
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+//! \brief Maximum amount of threads listing directories.
+#define EXPLORE_MAX_WORKERS 64
+//! \brief Slots each deque of pending directories starts with; it doubles when full.
+#define EXPLORE_DEQUE_SLOTS 64
+//! \brief Entries each directory report starts with room for; it doubles when full.
+#define EXPLORE_NODE_ITEMS 16
+//! \brief Maximum amount of globs a filter leaves out.
+#define EXPLORE_MAX_EXCLUDES 16
+//! \brief Depth of a filter that doesn't limit it.
+#define EXPLORE_UNLIMITED_DEPTH UINT_MAX
+//! \brief Biggest ignore file read, in bytes; the rest of a bigger one is left out.
+#define EXPLORE_MAX_IGNORE_FILE 1048576
+
+//! \brief What to leave out of a traversal. Globs are written as on a .gitignore: one without a '/' (but a trailing
+//! one) matches the base name of an entry at any depth, otherwise the path relative to the dir it applies to; a
+//! trailing '/' matches only dirs, "**" matches across dirs, and a leading '!' takes an entry back in.
+typedef struct explore_filter
+{
+    //! \brief Dir the depth, the globs and the ignore files count from (the root, or a dir above it), or NULL for the
+    //! root of the traversal.
+    const char* base;
+    //! \brief Levels of dirs below base that get explored, at most (0: only base), or EXPLORE_UNLIMITED_DEPTH.
+    unsigned max_depth;
+    //! \brief Globs of the entries left out, relative to base.
+    const char* excludes[EXPLORE_MAX_EXCLUDES];
+    //! \brief Amount of excludes.
+    size_t n_excludes;
+    //! \brief Whether the dirs on another file system than base are left out.
+    bool one_file_system;
+    //! \brief Base name of the ignore files (i.e.: ".gitignore"), or NULL for none: the globs in the one of a dir (one
+    //! per line, '#' starts a comment) leave out entries under it; a deeper one's take precedence, and the last
+    //! matching glob of a file decides.
+    const char* ignore_file;
+} explore_filter;
+
+//! \brief What to look for, and what to do with it. The callbacks on_dir and on_file are called on the thread that
+//! called explore_tree(), one at a time and in order; wanted and inspect get called on any thread, concurrently.
+typedef struct explore_visitor
+{
+    /**
+     * @brief Tells if a regular file has to be reported.
+     * @param name Base name of the file.
+     * @param ctx Visitor context.
+     * @return true if it has to.
+     */
+    bool (*wanted)(const char* name, void* ctx);
+    /**
+     * @brief Optional (NULL if not needed). Inspects a wanted file as soon as it's found, on the thread that listed
+     * it: the work done here is spread among the threads, instead of done on_file.
+     * @param dir_fd The directory it's inside of, to open it relative to it.
+     * @param name Base name of the file.
+     * @param ctx Visitor context.
+     * @return Whatever has to be handed to on_file, or NULL.
+     */
+    void* (*inspect)(int dir_fd, const char* name, void* ctx);
+    /**
+     * @brief Reports a directory, before anything found inside of it.
+     * @param path Path of the directory.
+     * @param error 0 if it was listed, otherwise the errno value telling why it couldn't be opened.
+     * @param ctx Visitor context.
+     */
+    void (*on_dir)(const char* path, int error, void* ctx);
+    /**
+     * @brief Reports a regular file that was wanted.
+     * @param path Path of the file.
+     * @param found What inspect returned for it (the callback owns it), or NULL.
+     * @param ctx Visitor context.
+     */
+    void (*on_file)(const char* path, void* found, void* ctx);
+    /**
+     * @brief Optional (NULL if not needed). Tells, after each report, if the traversal has to stop: the dirs not listed
+     * yet aren't anymore, nor reported. What was already found still gets reported (so on_file can release what
+     * inspect returned), but dirs and files don't get looked for anymore.
+     * @param ctx Visitor context.
+     * @return true if it has to stop.
+     */
+    bool (*stopped)(void* ctx);
+    //! \brief Context passed as is to the callbacks.
+    void* ctx;
+} explore_visitor;
+
+/**
+ * @brief Traverses a directory tree, following symbolic links as stat() does, and reports what's found on it. A dir
+ * that's the same as one it's inside of gets reported with ELOOP, unopened.
+ * @param root Path to the directory the traversal starts at.
+ * @param n_workers Threads listing directories, between 1 and EXPLORE_MAX_WORKERS. If none can be created, the calling
+ * thread lists them all on its own.
+ * @param filter What to leave out (never the root itself), or NULL for nothing.
+ * @param visitor What to look for, and what to do with it.
+ * @return 0 once the whole tree was reported, -1 if it wasn't (errno is set): ECANCELED if the visitor stopped it,
+ * ENOMEM if there was no memory left to go on.
+ */
+int explore_tree(const char* root, unsigned n_workers, const explore_filter* filter, const explore_visitor* visitor);
+
+/**
+ * @brief Tells if a traversal from the base of a filter would get to an entry, i.e.: to check a single entry that
+ * appeared after the traversal. The ignore files from the base down to its dir get read.
+ * @param filter The filter, or NULL.
+ * @param path Path to the entry, starting with the base of the filter.
+ * @param is_dir Whether the entry is a dir.
+ * @return false if it's left out, true otherwise.
+ */
+bool explore_filter_admits(const explore_filter* filter, const char* path, bool is_dir);
+
+/**
+ * @brief Tells the amount of threads explore_tree() uses by default: one per online CPU, up to EXPLORE_MAX_WORKERS.
+ * @return The amount of threads.
+ */
+unsigned explore_default_workers(void);
+
+#endif
@@ -0,0 +1,195 @@
+/**
+ * @file jobs_utils.h
+ * @brief Job table declaration. A job is a command line run by the shell (one or more processes, i.e.: a pipeline);
+ * its members are reaped asynchronously, reading SIGCHLD from a signalfd instead of catching it with a handler.
+ */
+
+#ifndef JOBS_UTILS_H
+#define JOBS_UTILS_H
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+//! \brief Job ids the table has room for before growing.
+#define JOBS_INITIAL_IDS 16
+//! \brief Initial amount of slots of the process id to job map. Must be a power of 2.
+#define JOBS_PID_INITIAL_SLOTS 64
+//! \brief The process id to job map doubles its slots when used ones surpass this percentage.
+#define JOBS_PID_MAX_LOAD_PCT 75
+//! \brief Char that may prefix a job id, as typed by the user (i.e.: "fg %2").
+#define JOB_SPEC_PREFIX '%'
+//! \brief Exit code of a process killed (or stopped) by a signal, before adding the signal number.
+#define JOBS_SIGNAL_EXIT_BASE 128
+
+//! \brief State of a job, or of one of its processes.
+enum job_state
+{
+    JOB_RUNNING,
+    JOB_STOPPED,
+    JOB_DONE
+};
+
+//! \brief One process of a job.
+typedef struct job_member
+{
+    //! \brief Process id.
+    pid_t pid;
+    //! \brief State.
+    enum job_state state;
+    //! \brief Status reported by waitpid() once done, or once stopped.
+    int status;
+} job_member;
+
+//! \brief A command line run by the shell.
+typedef struct job
+{
+    //! \brief Job id, as shown to the user. Starts at 1.
+    unsigned id;
+    //! \brief Process group of its processes, or 0 if they stay on the one of the shell (no job control).
+    pid_t pgid;
+    //! \brief Processes, in the order of the pipeline.
+    job_member* members;
+    //! \brief Amount of processes.
+    size_t n_members;
+    //! \brief Processes running (not stopped nor done).
+    size_t n_running;
+    //! \brief Processes not done.
+    size_t n_alive;
+    //! \brief Command line, as typed.
+    char* command;
+    //! \brief Is it running in the background? Finished background jobs are notified.
+    bool background;
+} job;
+
+/**
+ * @brief Prepares the job table: SIGCHLD gets blocked and read from a signalfd. With job control, the shell gets its
+ * own process group and takes the terminal (SIGTTOU & SIGTTIN must be ignored beforehand).
+ * @param job_control Give each job its own process group, and the terminal to the one in the foreground?
+ * @return 0 on success, -1 if the signalfd couldn't be created (errno is set); reaping still works then.
+ */
+int jobs_init(bool job_control);
+
+/**
+ * @brief Tells if jobs get their own process group, and the terminal when in the foreground.
+ * @return true if job control is on.
+ */
+bool jobs_control_enabled(void);
+
+/**
+ * @brief Gives the signalfd that becomes readable when a child process changes its state.
+ * @return The file descriptor, or -1 if jobs_init() wasn't called (or failed).
+ */
+int jobs_signal_fd(void);
+
+/**
+ * @brief Adds a job to the table, with the lowest id greater than every other job id.
+ * @param command Command line. Doesn't need to be NULL-terminated; trailing blanks are dropped.
+ * @param command_len Length of the command line, in bytes.
+ * @param pgid Process group of the processes, or 0.
+ * @param pids Processes, in the order of the pipeline.
+ * @param n_pids Amount of processes. Greater than 0.
+ * @param background Is it running in the background?
+ * @return The job, or NULL if there's no memory left.
+ */
+job* jobs_add(const char* command, size_t command_len, pid_t pgid, const pid_t* pids, size_t n_pids, bool background);
+
+/**
+ * @brief Finds a job by its id.
+ * @param id Job id.
+ * @return The job, or NULL if there's no such job.
+ */
+job* jobs_find(unsigned id);
+
+/**
+ * @brief Finds a job as the user refers to it: "%N" or "N", or the current (latest) job.
+ * @param spec Job id (optionally prefixed by '%'), or NULL for the current job.
+ * @return The job, or NULL if there's no such job.
+ */
+job* jobs_find_spec(const char* spec);
+
+/**
+ * @brief Collects the state changes of every child process, without blocking.
+ */
+void jobs_reap(void);
+
+/**
+ * @brief Blocks (sleeping on the signalfd) until a job is done or stopped. If in the foreground with job control, the
+ * job gets the terminal meanwhile.
+ * @param j Job.
+ * @param foreground Is it being waited in the foreground?
+ */
+void jobs_wait(job* j, bool foreground);
+
+/**
+ * @brief Resumes a stopped job (SIGCONT to all its processes).
+ * @param j Job.
+ * @param background Does it go on in the background?
+ * @return 0 on success, -1 if it couldn't be signaled (errno is set).
+ */
+int jobs_continue(job* j, bool background);
+
+/**
+ * @brief Removes a job from the table, freeing it. Its processes, if any alive, are no longer tracked.
+ * @param j Job.
+ */
+void jobs_remove(job* j);
+
+/**
+ * @brief Gives the state of a job, out of the state of its processes.
+ * @param j Job.
+ * @return JOB_DONE if every process is done, JOB_STOPPED if none is running, JOB_RUNNING otherwise.
+ */
+enum job_state jobs_state(const job* j);
+
+/**
+ * @brief Gives the exit code of a job: the one of its last process, or 128 + signal number if it was killed.
+ * @param j Job. Must be done.
+ * @return Exit code.
+ */
+int jobs_exit_code(const job* j);
+
+/**
+ * @brief Gives the exit code a process status stands for: the one it exited with, or JOBS_SIGNAL_EXIT_BASE + signal
+ * number if it was killed or stopped by one.
+ * @param status Status reported by waitpid(), i.e.: the one of a job_member done or stopped.
+ * @return Exit code.
+ */
+int jobs_status_exit_code(int status);
+
+/**
+ * @brief Shows a job as a "jobs" line, i.e.: "[1]+  Running                 sleep 10 &".
+ * @param out Stream to write to.
+ * @param j Job.
+ */
+void jobs_print(FILE* out, const job* j);
+
+/**
+ * @brief Collects state changes and shows every job; done ones are then removed.
+ * @param out Stream to write to.
+ */
+void jobs_print_all(FILE* out);
+
+/**
+ * @brief Collects state changes and tells if there are background jobs done, that jobs_notify() would show.
+ * @return true if some background job is done.
+ */
+bool jobs_pending_notices(void);
+
+/**
+ * @brief Collects state changes and removes the background jobs that are done, showing them if requested.
+ * @param out Stream to write to, or NULL to remove them silently.
+ */
+void jobs_notify(FILE* out);
+
+#endif
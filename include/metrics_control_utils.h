@@ -0,0 +1,104 @@
+/**
+ * @file metrics_control_utils.h
+ * @brief "metrics" app control channel declaration. The shell creates a Unix socket pair (SOCK_SEQPACKET, so each
+ * message arrives whole) and hands one end to the "metrics" app; config changes travel as fixed-layout messages, and
+ * the app answers each one with an acknowledgment once applied, without being restarted.
+ */
+
+#ifndef METRICS_CONTROL_UTILS_H
+#define METRICS_CONTROL_UTILS_H
+
+#include "metrics_utils.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+//! \brief First bytes of each message, so the "metrics" app can tell it's one ("MCTL").
+#define METRICS_CONTROL_MAGIC 0x4C54434Du
+//! \brief Layout version of the messages; changes each time their layout does.
+#define METRICS_CONTROL_VERSION 1u
+//! \brief Environment variable that tells the "metrics" app which file descriptor is its end of the channel.
+#define METRICS_CONTROL_FD_ENV "METRICS_CONTROL_FD"
+//! \brief File descriptor the "metrics" app gets its end of the channel on.
+#define METRICS_CONTROL_CHILD_FD 4
+//! \brief Nanoseconds in a millisecond.
+#define METRICS_CONTROL_NSECS_PER_MSEC 1000000L
+//! \brief Milliseconds in a second.
+#define METRICS_CONTROL_MSECS_PER_SEC 1000L
+
+//! \brief Config change sent to the "metrics" app.
+typedef struct metrics_control_msg
+{
+    //! \brief METRICS_CONTROL_MAGIC.
+    uint32_t magic;
+    //! \brief METRICS_CONTROL_VERSION.
+    uint32_t version;
+    //! \brief Identifies the message; its acknowledgment carries the same one.
+    uint32_t sequence;
+    //! \brief Options to change, as OR'ed (1 << json_index) bits; the rest are left as they are.
+    uint32_t options;
+    //! \brief New value of each option, indexed by json_index; only the ones on options are meaningful.
+    uint8_t values[N_JSON_ENTRIES];
+} metrics_control_msg;
+
+//! \brief Answer of the "metrics" app to a config change.
+typedef struct metrics_control_ack
+{
+    //! \brief METRICS_CONTROL_MAGIC.
+    uint32_t magic;
+    //! \brief METRICS_CONTROL_VERSION.
+    uint32_t version;
+    //! \brief Sequence of the message acknowledged.
+    uint32_t sequence;
+    //! \brief 0 if the change was applied, otherwise an errno value telling why it wasn't.
+    int32_t error;
+} metrics_control_ack;
+
+/**
+ * @brief Creates the channel.
+ * @param fds Where to leave both ends (close-on-exec): [0] for the shell, [1] to be handed to the "metrics" app.
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+int metrics_control_open(int fds[2]);
+
+/**
+ * @brief Sends a config change from the shell end, and sleeps until the "metrics" app acknowledges it.
+ * Acknowledgments of previous changes (i.e.: that arrived after their timeout) are skipped.
+ * @param fd Shell end of the channel.
+ * @param msg Config change; its magic, version and sequence get set here.
+ * @param timeout_ms Milliseconds to wait for the acknowledgment.
+ * @return 0 if the change was applied, -1 otherwise (errno is set: ETIMEDOUT without acknowledgment, EPIPE if the
+ * "metrics" app closed its end, or the reason the app gave).
+ */
+int metrics_control_request(int fd, metrics_control_msg* msg, int timeout_ms);
+
+/**
+ * @brief Takes the next config change, from the "metrics" app end. Blocks unless the end is non-blocking.
+ * @param fd "metrics" app end of the channel.
+ * @param msg Where to leave the config change.
+ * @return 0 on success, -1 on failure (errno is set: EPROTO if it isn't a message with the same layout, EPIPE if the
+ * shell closed its end).
+ */
+int metrics_control_receive(int fd, metrics_control_msg* msg);
+
+/**
+ * @brief Answers a config change, from the "metrics" app end.
+ * @param fd "metrics" app end of the channel.
+ * @param sequence Sequence of the message answered.
+ * @param error 0 if the change was applied, otherwise an errno value telling why it wasn't.
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+int metrics_control_acknowledge(int fd, uint32_t sequence, int error);
+
+/**
+ * @brief Applies a config change to a whole config.
+ * @param msg Config change.
+ * @param data Config, indexed by json_index; only the options on the change get updated.
+ */
+void metrics_control_apply(const metrics_control_msg* msg, unsigned char* data);
+
+#endif
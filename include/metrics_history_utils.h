@@ -0,0 +1,118 @@
+/**
+ * @file metrics_history_utils.h
+ * @brief "metrics" app samples history declaration. Each metric is kept as a bounded time series of fixed-size
+ * quantile sketches (log-bucketed histograms, relative error bounded), one cumulative snapshot per time bucket; the
+ * summary of any window is the difference of two snapshots, so its cost doesn't depend on the window length.
+ */
+
+#ifndef METRICS_HISTORY_UTILS_H
+#define METRICS_HISTORY_UTILS_H
+
+#include "metrics_ring_utils.h"
+#include <float.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//! \brief Nanoseconds covered by each time bucket of the history.
+#define HISTORY_BUCKET_NS 10000000000ull
+//! \brief Time buckets kept, i.e.: the longest window that can be summarized (1 hour).
+#define HISTORY_BUCKETS 360
+//! \brief Bins of each quantile sketch; bin 0 holds zero (and anything below the lowest bin).
+#define HISTORY_SKETCH_BINS 256
+//! \brief Samples of a metric recorded per time bucket, at most; more are dropped. Keeps the samples of any window
+//! below 2^16, so the sketch bins can be 16 bits wide (their differences are taken modulo 2^16).
+#define HISTORY_MAX_BUCKET_SAMPLES (UINT16_MAX / HISTORY_BUCKETS)
+//! \brief Relative error of the quantiles of percentages (CPU & memory usage), between 0.01 % and ~260 %.
+#define HISTORY_PCT_ACCURACY 0.02
+//! \brief Lowest non zero percentage told apart from zero.
+#define HISTORY_PCT_MIN_VALUE 0.01
+//! \brief Relative error of the quantiles of rates & counts, between 1 and ~10^13.
+#define HISTORY_RATE_ACCURACY 0.06
+//! \brief Lowest non zero rate or count told apart from zero.
+#define HISTORY_RATE_MIN_VALUE 1.0
+
+//! \brief A history of samples (i.e.: of one "metrics" app). Opaque.
+typedef struct metrics_history metrics_history;
+
+//! \brief Metrics kept by the history.
+enum metrics_series
+{
+    SERIES_CPU,
+    SERIES_MEM,
+    SERIES_SECTORS_READ,
+    SERIES_SECTORS_WRITTEN,
+    SERIES_NET_RX,
+    SERIES_NET_TX,
+    SERIES_PROCS_RUNNING,
+    N_METRICS_SERIES
+};
+
+//! \brief Summary of a metric over a window of time.
+typedef struct metrics_summary
+{
+    //! \brief Samples in the window. The rest of the members are meaningless without any.
+    uint64_t count;
+    //! \brief Lowest value, exact.
+    double min;
+    //! \brief Highest value, exact.
+    double max;
+    //! \brief Average value, exact.
+    double avg;
+    //! \brief Median, within the relative error of the metric.
+    double p50;
+    //! \brief 95th percentile, within the relative error of the metric.
+    double p95;
+    //! \brief 99th percentile, within the relative error of the metric.
+    double p99;
+} metrics_summary;
+
+/**
+ * @brief Creates an empty history. Its time buckets (~1.4 MB) get allocated with the first sample.
+ * @return The history, or NULL if there's no memory left.
+ */
+metrics_history* metrics_history_create(void);
+
+/**
+ * @brief Destroys a history.
+ * @param history The history, or NULL.
+ */
+void metrics_history_destroy(metrics_history* history);
+
+/**
+ * @brief Gives the name of a metric kept by the history, as shown to the user.
+ * @param series The metric.
+ * @return Its name.
+ */
+const char* metrics_history_name(enum metrics_series series);
+
+/**
+ * @brief Records a sample: each metric it carries is added to its series. Samples must arrive in time order; older
+ * ones than the latest recorded are dropped.
+ * @param history The history.
+ * @param sample The sample.
+ * @return true if it was recorded, false if it's too old or there's no memory left for the history.
+ */
+bool metrics_history_add(metrics_history* history, const metrics_sample* sample);
+
+/**
+ * @brief Summarizes a metric over the last window_ns nanoseconds (rounded up to whole time buckets, and trimmed to
+ * what's kept).
+ * @param history The history.
+ * @param series The metric.
+ * @param window_ns Length of the window.
+ * @param now_ns End of the window, as CLOCK_MONOTONIC nanoseconds.
+ * @param summary Where to leave the summary.
+ */
+void metrics_history_summary(const metrics_history* history, enum metrics_series series, uint64_t window_ns,
+                             uint64_t now_ns, metrics_summary* summary);
+
+/**
+ * @brief Forgets every sample (i.e.: a new "metrics" app was started). Its memory is kept.
+ * @param history The history.
+ */
+void metrics_history_clear(metrics_history* history);
+
+#endif
@@ -0,0 +1,153 @@
+/**
+ * @file metrics_ring_utils.h
+ * @brief Shared memory ring of "metrics" app samples declaration. The shell creates the ring (a memfd) and hands it
+ * to the "metrics" app, which publishes a fixed-layout sample per update; the shell reads the latest one lock-free
+ * (seqlock), with no syscall and no signal round trip.
+ */
+
+#ifndef METRICS_RING_UTILS_H
+#define METRICS_RING_UTILS_H
+
+#include <errno.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+//! \brief Bytes of a cache line; every sample (and the ring header) starts on its own.
+#define METRICS_RING_CACHE_LINE 64
+//! \brief First bytes of a ring, so the "metrics" app can tell it's one ("MRNG").
+#define METRICS_RING_MAGIC 0x474E524Du
+//! \brief Layout version of the ring; changes each time the layout of the header or the samples does.
+#define METRICS_RING_VERSION 1u
+//! \brief Samples kept by the ring. Must be a power of 2.
+#define METRICS_RING_SLOTS 64u
+//! \brief Name of the memfd, as seen on /proc/<pid>/fd.
+#define METRICS_RING_NAME "metrics_ring"
+//! \brief Environment variable that tells the "metrics" app which file descriptor is the ring.
+#define METRICS_RING_FD_ENV "METRICS_RING_FD"
+//! \brief File descriptor the "metrics" app gets the ring on.
+#define METRICS_RING_CHILD_FD 3
+//! \brief Times a read is retried when the sample changes while being copied, before giving up.
+#define METRICS_RING_READ_RETRIES 16
+
+//! \brief Metrics a sample may carry, to be OR'ed on its fields member (i.e.: the ones disabled aren't there).
+enum metrics_field
+{
+    METRICS_FIELD_CPU = 1 << 0,
+    METRICS_FIELD_MEM = 1 << 1,
+    METRICS_FIELD_HDD = 1 << 2,
+    METRICS_FIELD_NET = 1 << 3,
+    METRICS_FIELD_PROCS = 1 << 4
+};
+
+//! \brief Data of a "metrics" app update, at full precision.
+typedef struct metrics_sample
+{
+    //! \brief When it was taken, as CLOCK_MONOTONIC nanoseconds.
+    uint64_t timestamp_ns;
+    //! \brief OR'ed metrics_field of the metrics present.
+    uint64_t fields;
+    //! \brief CPU usage, as a percentage.
+    double cpu_usage;
+    //! \brief Memory used, as a percentage.
+    double mem_usage;
+    //! \brief Disk sectors read per second.
+    uint64_t sectors_read_rate;
+    //! \brief Disk sectors written per second.
+    uint64_t sectors_written_rate;
+    //! \brief Network bytes received per second.
+    uint64_t net_rx_rate;
+    //! \brief Network bytes sent per second.
+    uint64_t net_tx_rate;
+    //! \brief Processes running.
+    uint64_t procs_running;
+    //! \brief Processes in total.
+    uint64_t procs_total;
+} metrics_sample;
+
+//! \brief Slot of the ring: a sample guarded by its seqlock.
+typedef struct metrics_ring_slot
+{
+    //! \brief Odd while the sample is being written; changes on each write.
+    alignas(METRICS_RING_CACHE_LINE) _Atomic uint64_t sequence;
+    //! \brief The sample.
+    metrics_sample sample;
+} metrics_ring_slot;
+
+//! \brief Whole shared memory region: header, then the slots.
+typedef struct metrics_ring
+{
+    //! \brief METRICS_RING_MAGIC.
+    alignas(METRICS_RING_CACHE_LINE) uint32_t magic;
+    //! \brief METRICS_RING_VERSION.
+    uint32_t version;
+    //! \brief METRICS_RING_SLOTS.
+    uint32_t n_slots;
+    //! \brief sizeof(metrics_ring_slot), so a reader can check the writer agrees on the layout.
+    uint32_t slot_size;
+    //! \brief Samples published so far; the latest one is on slot (published - 1) % n_slots.
+    _Atomic uint64_t published;
+    //! \brief Samples.
+    metrics_ring_slot slots[METRICS_RING_SLOTS];
+} metrics_ring;
+
+/**
+ * @brief Creates an empty ring on a new memfd, mapped shared.
+ * @param fd Where to leave the memfd (close-on-exec), so it can be handed to the "metrics" app.
+ * @return The ring, or NULL on failure (errno is set).
+ */
+metrics_ring* metrics_ring_create(int* fd);
+
+/**
+ * @brief Maps a ring created by someone else (i.e.: by the shell, from the "metrics" app side).
+ * @param fd The memfd of the ring.
+ * @return The ring, or NULL on failure (errno is set; EPROTO if it isn't a ring with the same layout).
+ */
+metrics_ring* metrics_ring_attach(int fd);
+
+/**
+ * @brief Unmaps a ring. Its memfd isn't closed.
+ * @param ring The ring, or NULL.
+ */
+void metrics_ring_release(metrics_ring* ring);
+
+/**
+ * @brief Publishes a sample, overwriting the oldest one. Only one process may publish on a ring.
+ * @param ring The ring.
+ * @param sample The sample.
+ */
+void metrics_ring_publish(metrics_ring* ring, const metrics_sample* sample);
+
+/**
+ * @brief Tells how many samples were published on a ring so far.
+ * @param ring The ring.
+ * @return Amount of samples; the latest one is sample number (amount - 1).
+ */
+uint64_t metrics_ring_published(const metrics_ring* ring);
+
+/**
+ * @brief Reads a sample by its number (in publishing order, starting at 0), without locks nor syscalls.
+ * @param ring The ring.
+ * @param n Sample number.
+ * @param sample Where to leave the sample.
+ * @return true if it was read, false if it wasn't published yet, or it was already overwritten (the ring keeps the
+ * last METRICS_RING_SLOTS samples).
+ */
+bool metrics_ring_read(const metrics_ring* ring, uint64_t n, metrics_sample* sample);
+
+/**
+ * @brief Reads the latest sample published, without locks nor syscalls.
+ * @param ring The ring.
+ * @param sample Where to leave the sample.
+ * @return true if there's a sample, false if none was published yet (or the writer kept rewriting it).
+ */
+bool metrics_ring_latest(const metrics_ring* ring, metrics_sample* sample);
+
+#endif
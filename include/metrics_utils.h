@@ -7,10 +7,14 @@
 #define METRICS_UTILS_H
 
 #include <cjson/cJSON.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 //! \brief Lowest array index.
 #define LOWEST_ARR_INDEX 0
@@ -35,6 +39,10 @@
 #define UPDATE_I_MINV 0
 //! \brief "update_interval" option maximum value.
 #define UPDATE_I_MAXV 255
+//! \brief Base of the int options values.
+#define OPTION_INT_BASE 10
+//! \brief Name of the in-memory JSON config file, as seen on /proc/<pid>/fd.
+#define METRICS_CONFIG_MEMFD_NAME "metrics_config.json"
 
 //! \brief JSON config file indexes for key-value pairs.
 enum json_index
@@ -47,18 +55,72 @@ enum json_index
     PROCS_I
 };
 
-//! \brief Different options prefix (leaving aside the value itself) length.
-enum option_pl
+//! \brief Kind of value a "metrics" option takes.
+enum metrics_option_kind
 {
-    CONFIG_OPL = 9,
-    UPDATE_I_OPL = 18,
-    CPU_OPL = 6,
-    MEM_OPL = 6,
-    HDD_OPL = 6,
-    NET_OPL = 6,
-    PROCS_OPL = 8
+    //! \brief Path to a JSON config file; the rest of the options are ignored.
+    OPTION_PATH,
+    //! \brief Int within a range.
+    OPTION_INT,
+    //! \brief "true" or "false".
+    OPTION_BOOL
 };
 
+//! \brief Schema of a "metrics" option: how it's typed, validated and written on the JSON config.
+typedef struct metrics_option
+{
+    //! \brief Option as typed, value excluded, i.e.: "--cpu=".
+    const char* prefix;
+    //! \brief Kind of value.
+    enum metrics_option_kind kind;
+    //! \brief Where its value goes on the config data (meaningless for OPTION_PATH).
+    enum json_index index;
+    //! \brief Lowest value (OPTION_INT only).
+    int min;
+    //! \brief Highest value (OPTION_INT only).
+    int max;
+    //! \brief Key on the JSON config; the OPTION_BOOL ones go inside the "metrics" object.
+    const char* json_key;
+} metrics_option;
+
+/**
+ * @brief Parses the "metrics" options passed by the user of the shell (i.e.: "--cpu=false"), validating each one.
+ * @param argv Typical argv passed to any program. Last element of the array must be NULL to mark its end.
+ * @param data Where to leave the config, indexed by json_index; the options not given keep the value it had.
+ * @param options Where to leave the options given, as OR'ed (1 << json_index) bits.
+ * @param config_path Where to leave the value of "--config", or NULL if it wasn't given. The options after it are
+ * ignored.
+ * @return 0 if every option given is valid, -1 otherwise (the error gets shown).
+ */
+int parse_metrics_options(char** argv, unsigned char* data, unsigned* options, char** config_path);
+
+/**
+ * @brief Gives the schema of every "metrics" option, shared by parsing, validation and the JSON config.
+ * @param n_options Where to leave the amount of options.
+ * @return The options.
+ */
+const metrics_option* metrics_options(size_t* n_options);
+
+/**
+ * @brief According to argv passed by the user of the shell, gets the "metrics" config, built in memory: a sealed
+ * (read-only) memfd holding the JSON, to be handed to the "metrics" app as an inherited file descriptor. The memfd of
+ * the last config is kept, and reused as is when the same config is asked for again.
+ * @param argv Typical argv passed to any program. Last element of the array must be NULL to mark its end.
+ * @param config_path Where to leave the path to the JSON config file passed with "--config", or
+ * DEFAULT_JSON_CONFIG_FILE_OUTPUT_PATH if memfds aren't available on the system (then the config is written there);
+ * NULL when the config is on config_fd.
+ * @param config_fd Where to leave the memfd (close-on-exec, owned by this module: don't close it), or -1.
+ * @return 0 on success, -1 on failure (the error gets shown).
+ */
+int get_metrics_config(char** argv, char** config_path, int* config_fd);
+
+/**
+ * @brief Serializes a "metrics" config as JSON, as written on the config file.
+ * @param data Config, indexed by json_index.
+ * @return The JSON text, newline ended (free() it), or NULL if the system ran out of memory.
+ */
+char* metrics_json_config(const unsigned char* data);
+
 /**
  * @brief According to argv passed by the user of the shell, parses them and get the path to the "metrics" config file.
  * @param argv Typical argv passed to any program. Last element of the array must be NULL to mark its end.
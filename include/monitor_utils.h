@@ -0,0 +1,153 @@
+/**
+ * @file monitor_utils.h
+ * @brief Registry of the "metrics" app instances started by the shell declaration. Each one is known by its name, and
+ * has its own process tracking (pidfd), shared memory ring, control channel and samples history.
+ */
+
+#ifndef MONITOR_UTILS_H
+#define MONITOR_UTILS_H
+
+#include "event_utils.h"
+#include "metrics_history_utils.h"
+#include "metrics_ring_utils.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+//! \brief Instances the registry keeps (running or stopped), at most.
+#define MONITORS_MAX 8
+//! \brief Bytes of a name (NUL included).
+#define MONITOR_NAME_SIZE 32
+//! \brief Name of the instance started without a name.
+#define MONITOR_DEFAULT_NAME "default"
+//! \brief Name that stands for every instance; no instance can take it.
+#define MONITOR_ALL_NAME "all"
+//! \brief Value of pid while the instance isn't running.
+#define MONITOR_NO_PID -1
+//! \brief Milliseconds between each move of the samples published on the shared memory ring to the history. The ring
+//! keeps more than a minute of samples, as the "metrics" app updates once per second at most.
+#define MONITOR_RECORD_MS 5000
+
+//! \brief A "metrics" app instance.
+typedef struct monitor
+{
+    //! \brief Its name; empty for an unused registry slot.
+    char name[MONITOR_NAME_SIZE];
+    //! \brief Process id, or MONITOR_NO_PID once it exits (its history is kept until the name is started again).
+    pid_t pid;
+    //! \brief pidfd of the process, or -1. Readable once it exits, so a stale pid isn't signaled.
+    int pidfd;
+    //! \brief Shared memory ring it publishes its samples on, or NULL.
+    metrics_ring* samples;
+    //! \brief memfd of samples, or -1.
+    int samples_fd;
+    //! \brief Samples of samples already recorded on the history.
+    uint64_t samples_recorded;
+    //! \brief Timer that records the samples of samples on the history while at the prompt, or -1.
+    int history_timer;
+    //! \brief Shell end of its control channel, or -1.
+    int control_fd;
+    //! \brief Its samples history, or NULL if there was no memory left for it.
+    metrics_history* history;
+} monitor;
+
+//! \brief Latest status data of an instance, as asked for by the shell.
+typedef struct monitor_status
+{
+    //! \brief Status data (meaningless if error isn't 0).
+    metrics_sample sample;
+    //! \brief Whether it came from the shared memory ring, rather than as a response to a signal.
+    bool from_ring;
+    //! \brief How old the sample is (from the ring), or how long the response took, in milliseconds.
+    double latency_ms;
+    //! \brief 0 on success, otherwise an errno value (ETIMEDOUT if no response arrived in time).
+    int error;
+} monitor_status;
+
+/**
+ * @brief Tells if a name can be given to an instance: up to MONITOR_NAME_SIZE - 1 letters, digits, "_" or "-", and
+ * not MONITOR_ALL_NAME.
+ * @param name The name.
+ * @return true if it can.
+ */
+bool monitor_name_valid(const char* name);
+
+/**
+ * @brief Finds an instance by its name.
+ * @param name The name.
+ * @return The instance (running or not), or NULL if there's none with that name.
+ */
+monitor* monitor_find(const char* name);
+
+/**
+ * @brief Gets the slot for a new instance: the one with the same name if it isn't running, a free one, or the one of
+ * an instance that isn't running anymore. Its history starts over.
+ * @param name The name. Must be valid.
+ * @return The slot, named and with no channels, or NULL if the name is running or every slot is taken by running
+ * instances (errno is set: EEXIST or ENOSPC).
+ */
+monitor* monitor_claim(const char* name);
+
+/**
+ * @brief Gives back the slot got by monitor_claim() for an instance that couldn't be started: its channels (if any
+ * were created) are closed, and its name dropped, so it isn't told as an instance with an empty history.
+ * @param m The slot, not tracked (monitor_track()) yet.
+ */
+void monitor_unclaim(monitor* m);
+
+/**
+ * @brief Gives access to the whole registry, i.e.: to go through every instance.
+ * @param n_slots Where to leave the amount of slots (some of them unused) of the registry.
+ * @return The registry slots.
+ */
+monitor* monitor_registry(size_t* n_slots);
+
+/**
+ * @brief Starts tracking the process of an instance: its exit gets noticed by the event loop, and the samples it
+ * publishes on its ring get recorded on its history periodically.
+ * @param m The instance, with its channels already created.
+ * @param pid Its process id.
+ */
+void monitor_track(monitor* m, pid_t pid);
+
+/**
+ * @brief Tells if an instance is still running, checking its pidfd (the event loop may not have had the chance to).
+ * @param m The instance.
+ * @return true if it's running.
+ */
+bool monitor_running(monitor* m);
+
+/**
+ * @brief Takes the lock over the samples of every instance: their histories, what was recorded of their rings, and
+ * the SIGUSR1 responses asked for. The shell thread and the helper threads running pipeline stages (i.e.: several
+ * "status_monitor" at once) take turns through it. It isn't recursive.
+ */
+void monitor_lock_samples(void);
+
+/**
+ * @brief Releases the lock taken by monitor_lock_samples().
+ */
+void monitor_unlock_samples(void);
+
+/**
+ * @brief Records on the history of an instance the samples published on its ring since the last call. The ones
+ * already overwritten are lost. The caller holds monitor_lock_samples().
+ * @param m The instance.
+ */
+void monitor_record_samples(monitor* m);
+
+/**
+ * @brief Stops tracking an instance (i.e.: its process exited, or was told to): its channels are closed, once the
+ * last samples on its ring are recorded. Its name and history are kept.
+ * @param m The instance.
+ */
+void monitor_forget(monitor* m);
+
+#endif
@@ -0,0 +1,64 @@
+/**
+ * @file parallel_utils.h
+ * @brief Parallel batch execution declaration. Lines of a batch file run concurrently on a bounded pool of forked
+ * workers; their stdout & stderr are captured and emitted in the order of the lines.
+ */
+
+#ifndef PARALLEL_UTILS_H
+#define PARALLEL_UTILS_H
+
+#include "batch_utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+//! \brief Maximum amount of lines run at the same time.
+#define PARALLEL_MAX_JOBS 1024
+//! \brief Bytes read at once from a worker stdout/stderr.
+#define PARALLEL_READ_CHUNK 65536
+//! \brief File every worker gets as stdin, as concurrent lines can't share the one of the shell.
+#define PARALLEL_STDIN_PATH "/dev/null"
+
+//! \brief How a line of a batch file has to be run.
+enum parallel_line_kind
+{
+    //! \brief Nothing to run (i.e.: only blanks, or malformed).
+    PARALLEL_LINE_EMPTY,
+    //! \brief Independent of the others; runs on a worker, concurrently.
+    PARALLEL_LINE_JOB,
+    //! \brief Every previous line must finish (and show its output) before it runs, on the shell process itself.
+    PARALLEL_LINE_BARRIER
+};
+
+/**
+ * @brief Decides how a line of a batch file has to be run.
+ * @param line The line, newline excluded. It isn't NULL-terminated.
+ * @param len Length of the line, in bytes.
+ * @param ctx Context passed to parallel_for_each_line().
+ * @return Kind of line.
+ */
+typedef enum parallel_line_kind (*parallel_line_classifier)(const char* line, size_t len, void* ctx);
+
+/**
+ * @brief Runs every line of a batch file, up to a certain amount of them at the same time. Each line runs on a forked
+ * worker whose stdout & stderr are captured; the output of the oldest line still running is passed through as it
+ * arrives, and the rest is held until every line before it finished, so the output is the same as a sequential run.
+ * @param fd File descriptor of the batch file, open for reading. It isn't closed.
+ * @param jobs Maximum amount of lines run at the same time, between 1 and PARALLEL_MAX_JOBS.
+ * @param classifier Decides how each line has to be run.
+ * @param runner Runs a line (on a worker, or on the shell process itself for barriers).
+ * @param ctx Passed as is to the classifier and the runner.
+ * @return 0 once the whole file was run, -1 if it couldn't be read (errno is set).
+ */
+int parallel_for_each_line(int fd, unsigned jobs, parallel_line_classifier classifier, batch_line_handler runner,
+                           void* ctx);
+
+#endif
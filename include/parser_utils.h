@@ -0,0 +1,101 @@
+/**
+ * @file parser_utils.h
+ * @brief Command line lexer/parser declaration. One pass over the input builds a compact AST (pipeline, stages,
+ * redirections, background flag) whose words point into the input by offset/length.
+ */
+
+#ifndef PARSER_UTILS_H
+#define PARSER_UTILS_H
+
+#include "arena_utils.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//! \brief This shell has a max limit of tokens per command.
+#define MAX_TOKENS_PER_COMMAND 32
+//! \brief Maximum number of single commands to execute, given the max length allowed for a command line (ARG_MAX / 4).
+#define MAX_SINGLE_COMMANDS 32768
+//! \brief Stages a pipeline AST has room for before growing.
+#define PIPELINE_INITIAL_STAGES 4
+//! \brief Char that separates single commands (stages) of a pipeline.
+#define PIPE_OPERATOR '|'
+//! \brief Char that redirects the stdin of a single command.
+#define STDIN_REDIRECTION_OPERATOR '<'
+//! \brief Char that redirects the stdout of a single command.
+#define STDOUT_REDIRECTION_OPERATOR '>'
+//! \brief Char that sends the whole command line to the background. Must be its last token.
+#define BACKGROUND_OPERATOR '&'
+//! \brief Char that escapes the next one, outside single quotes.
+#define ESCAPE_CHAR '\\'
+
+//! \brief Portion of the input (i.e.: a word, quotes included): offset & length, in bytes.
+typedef struct cmd_span
+{
+    //! \brief Offset of its first byte, from the start of the input.
+    uint32_t offset;
+    //! \brief Amount of bytes. 0 means "no span".
+    uint32_t len;
+} cmd_span;
+
+//! \brief A single command of the pipeline.
+typedef struct cmd_stage
+{
+    //! \brief Words (command name & args), in order.
+    cmd_span words[MAX_TOKENS_PER_COMMAND];
+    //! \brief Amount of words.
+    uint32_t n_words;
+    //! \brief File of the "<" redirection, if any.
+    cmd_span stdin_file;
+    //! \brief File of the ">" redirection, if any.
+    cmd_span stdout_file;
+} cmd_stage;
+
+//! \brief A whole command line: single commands coupled by pipes.
+typedef struct cmd_pipeline
+{
+    //! \brief Input the spans point into.
+    const char* input;
+    //! \brief Single commands, in order.
+    cmd_stage* stages;
+    //! \brief Amount of single commands. 0 if the input had only blanks.
+    uint32_t n_stages;
+    //! \brief Room for single commands on stages.
+    uint32_t stages_capacity;
+    //! \brief Was a "&" found at the end of the line?
+    bool background;
+    //! \brief Why the input couldn't be parsed, or NULL.
+    const char* error;
+} cmd_pipeline;
+
+/**
+ * @brief Parses a command line in a single pass. Nothing gets copied: words are spans of the input, which must stay
+ * alive (and unchanged) while the AST is used. Words can be quoted ('...' or "...") and chars escaped with '\'.
+ * @param input Command line. Doesn't need to be NULL-terminated; a trailing newline is taken as a blank.
+ * @param len Length of the command line, in bytes.
+ * @param a Arena where the AST gets allocated.
+ * @param pipeline AST to fill.
+ * @return 0 if the line was parsed, -1 if it's malformed (the reason is left on pipeline->error).
+ */
+int parse_command_line(const char* input, size_t len, arena* a, cmd_pipeline* pipeline);
+
+/**
+ * @brief Gets the string a span stands for: quotes removed and escaped chars resolved.
+ * @param pipeline AST the span belongs to.
+ * @param span Span of a word.
+ * @param a Arena where the string gets allocated.
+ * @return The NULL-terminated string, or NULL for an empty span (or if there's no memory left).
+ */
+char* cmd_span_str(const cmd_pipeline* pipeline, cmd_span span, arena* a);
+
+/**
+ * @brief Builds the argv of a single command.
+ * @param pipeline AST the single command belongs to.
+ * @param stage Single command.
+ * @param a Arena where the array and its strings get allocated.
+ * @return Array of tokens. Last "useful" element is always NULL. NULL if there's no memory left.
+ */
+char** cmd_stage_argv(const cmd_pipeline* pipeline, const cmd_stage* stage, arena* a);
+
+#endif
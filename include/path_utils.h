@@ -0,0 +1,73 @@
+/**
+ * @file path_utils.h
+ * @brief Command lookup on PATH, with a "hash" (bash-like) cache, declaration.
+ */
+
+#ifndef PATH_UTILS_H
+#define PATH_UTILS_H
+
+#include <errno.h>
+#include <linux/limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+//! \brief Environment variable key holding the directories where commands are looked for.
+#define ENV_PATH_KEY "PATH"
+//! \brief Separator of the directories listed on PATH.
+#define PATH_DIRS_SEPARATOR ':'
+//! \brief Initial amount of slots of the command lookup cache. Must be a power of 2.
+#define PATH_CACHE_INITIAL_SLOTS 64
+//! \brief The command lookup cache doubles its slots when used ones surpass this percentage.
+#define PATH_CACHE_MAX_LOAD_PCT 75
+//! \brief Events on a PATH directory that change its mtime, and so invalidate the cache.
+#define PATH_DIR_WATCHED_EVENTS                                                                                        \
+    (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF)
+//! \brief Buffer (in bytes) used to drain pending inotify events.
+#define PATH_EVENTS_BUFFER 4096
+
+//! \brief One remembered command lookup.
+typedef struct path_cache_entry
+{
+    //! \brief Command name, as typed. NULL for an unused slot.
+    char* name;
+    //! \brief Absolute path resolved for the command, or NULL if it wasn't found on PATH ("negative" entry).
+    char* path;
+    //! \brief Hash of the name.
+    uint64_t hash;
+    //! \brief Times this entry answered a lookup.
+    unsigned long hits;
+} path_cache_entry;
+
+/**
+ * @brief Resolves a command name to the executable that execvp() would run, remembering the answer (even a "not
+ * found" one) until PATH, or the contents (mtime) of any of its dirs, changes. Names with a '/' aren't looked up.
+ * @param name Command name (first token of a single command).
+ * @return Path to execute, owned by the cache (valid until the next lookup), or NULL with errno set to ENOENT.
+ */
+const char* path_cache_lookup(const char* name);
+
+/**
+ * @brief Forgets what is known about a command, i.e.: its remembered path couldn't be executed anymore.
+ * @param name Command name.
+ */
+void path_cache_forget(const char* name);
+
+/**
+ * @brief Forgets every remembered command lookup ("hash -r").
+ */
+void path_cache_flush(void);
+
+/**
+ * @brief Prints the remembered command lookups, with the times each one was used ("hash").
+ * @param out Stream to print to.
+ */
+void path_cache_print(FILE* out);
+
+#endif
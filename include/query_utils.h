@@ -0,0 +1,112 @@
+/**
+ * @file query_utils.h
+ * @brief Queries over JSON config files declaration. A query selects a value by its path (keys separated by dots, i.e.:
+ * "metrics.cpu"; a number indexes an array) from the files that hold every one of its predicates (a path, a comparison
+ * and a JSON value, i.e.: "update_interval>5"). The bytes of a file are looked over for the keys of the query before
+ * parsing it, so the files that can't match aren't parsed.
+ */
+
+#ifndef QUERY_UTILS_H
+#define QUERY_UTILS_H
+
+#include <cjson/cJSON.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//! \brief Keys a path can go through, at most.
+#define QUERY_MAX_KEYS 16
+//! \brief Predicates a query can have, at most.
+#define QUERY_MAX_PREDICATES 8
+//! \brief Separator of the keys of a path.
+#define QUERY_KEY_SEPARATOR '.'
+
+//! \brief Comparison of a predicate.
+enum query_op
+{
+    QUERY_EQ,
+    QUERY_NE,
+    QUERY_LT,
+    QUERY_LE,
+    QUERY_GT,
+    QUERY_GE
+};
+
+//! \brief Path to a value inside a JSON document.
+typedef struct query_path
+{
+    //! \brief Keys to go through, from the root.
+    char* keys[QUERY_MAX_KEYS];
+    //! \brief Amount of keys.
+    size_t n_keys;
+} query_path;
+
+//! \brief Condition a JSON document has to hold.
+typedef struct query_predicate
+{
+    //! \brief Path to the value compared.
+    query_path path;
+    //! \brief Comparison.
+    enum query_op op;
+    //! \brief Value compared with.
+    cJSON* value;
+} query_predicate;
+
+//! \brief A compiled query. Zero-initialize it before compiling it.
+typedef struct json_query
+{
+    //! \brief Whether a value gets selected, or only the documents that match are.
+    bool has_select;
+    //! \brief Path to the value selected.
+    query_path select;
+    //! \brief Predicates every matching document holds.
+    query_predicate where[QUERY_MAX_PREDICATES];
+    //! \brief Amount of predicates.
+    size_t n_where;
+    //! \brief Keys (quoted, as written on JSON) a document has to contain to have any chance of matching.
+    char* needles[QUERY_MAX_KEYS * (QUERY_MAX_PREDICATES + 1)];
+    //! \brief Amount of needles.
+    size_t n_needles;
+} json_query;
+
+/**
+ * @brief Compiles a query.
+ * @param query Where to leave it.
+ * @param select Path to the value to select, or NULL to select only the matching documents.
+ * @param where Predicates, i.e.: "update_interval>5". Comparisons: "==" (or "="), "!=", "<", "<=", ">" and ">=".
+ * A value that isn't valid JSON is taken as a string.
+ * @param n_where Amount of predicates, up to QUERY_MAX_PREDICATES.
+ * @return 0 on success, -1 if the query isn't valid (the error gets shown). Free it with json_query_free() anyway.
+ */
+int json_query_compile(json_query* query, const char* select, char* const* where, size_t n_where);
+
+/**
+ * @brief Releases what a compiled query holds.
+ * @param query The query.
+ */
+void json_query_free(json_query* query);
+
+/**
+ * @brief Tells, without parsing it, if a JSON document could match a query: it contains every key the query goes
+ * through. A document with any backslash could spell a key with escapes (i.e.: "a\/b" for "a/b"), so it always could.
+ * @param query The query.
+ * @param text The document.
+ * @param len Bytes of the document.
+ * @return false if it can't match, true if it could.
+ */
+bool json_query_may_match(const json_query* query, const char* text, size_t len);
+
+/**
+ * @brief Evaluates a query over a JSON document.
+ * @param query The query.
+ * @param text The document.
+ * @param len Bytes of the document.
+ * @param value Where to leave the value selected, as unformatted JSON (free() it); NULL if the query doesn't select
+ * any, or the system ran out of memory.
+ * @return true if the document is valid JSON, holds every predicate and has the value selected, false otherwise.
+ */
+bool json_query_match(const json_query* query, const char* text, size_t len, char** value);
+
+#endif
@@ -0,0 +1,126 @@
+/**
+ * @file record_utils.h
+ * @brief Machine-readable records writer declaration. Each record tells a file: its path, size, mtime (seconds since
+ * the epoch, with 9 decimals) and optionally its content, formatted as NDJSON, TSV or NUL-separated fields. Records
+ * are kept on a single large buffer, written to the file descriptor in big blocks when it fills up.
+ */
+
+#ifndef RECORD_UTILS_H
+#define RECORD_UTILS_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+//! \brief Bytes the records are kept on before being written at once.
+#define RECORD_BUFFER_SIZE (1 << 20)
+//! \brief Values a byte can take.
+#define RECORD_BYTE_VALUES 256
+//! \brief Bytes of a UTF-8 sequence, at most.
+#define RECORD_UTF8_MAX_BYTES 4
+//! \brief Name of the NDJSON format.
+#define RECORD_NDJSON_NAME "ndjson"
+//! \brief Name of the NUL-separated format.
+#define RECORD_NULL_NAME "null"
+//! \brief Name of the TSV format.
+#define RECORD_TSV_NAME "tsv"
+
+//! \brief How the records get formatted.
+enum record_format
+{
+    //! \brief A JSON object per line: {"path":"...","size":N,"mtime":S.NNNNNNNNN,"content":"..."}. Control chars of
+    //! the strings get escaped, and so does every byte that isn't part of a valid UTF-8 sequence (as "\u00XX", the
+    //! Latin-1 char of its value), so every line is valid JSON; any other byte is kept as is.
+    RECORD_NDJSON,
+    //! \brief Every field followed by a NUL byte (as find's -print0 does), nothing escaped: path, size, mtime and
+    //! content. The amount of fields is the same on every record.
+    RECORD_NULL,
+    //! \brief A line per record, a tab between fields: path, size, mtime and content. Backslashes, tabs, newlines and
+    //! carriage returns get escaped as "\\", "\t", "\n" and "\r".
+    RECORD_TSV
+};
+
+//! \brief Writer of records to a file descriptor.
+typedef struct record_writer
+{
+    //! \brief Where the records get written.
+    int fd;
+    //! \brief How they get formatted.
+    enum record_format format;
+    //! \brief Whether each record carries the content of the file.
+    bool with_content;
+    //! \brief Whether each byte value of a string gets escaped on the format (or, from 0x80 on, checked as UTF-8).
+    bool escaped[RECORD_BYTE_VALUES];
+    //! \brief Start of a UTF-8 sequence that a chunk of content ended in the middle of, waiting for the next one.
+    unsigned char partial[RECORD_UTF8_MAX_BYTES];
+    //! \brief Bytes of partial.
+    size_t partial_len;
+    //! \brief Records not written yet, RECORD_BUFFER_SIZE bytes.
+    char* buffer;
+    //! \brief Bytes used of the buffer.
+    size_t len;
+    //! \brief 0, or the errno value of the first write that failed; nothing gets written after it.
+    int error;
+} record_writer;
+
+/**
+ * @brief Tells the format of a name.
+ * @param name RECORD_NDJSON_NAME, RECORD_NULL_NAME or RECORD_TSV_NAME.
+ * @param format Where to leave it.
+ * @return true if the name is known, false otherwise.
+ */
+bool record_format_parse(const char* name, enum record_format* format);
+
+/**
+ * @brief Sets up a writer.
+ * @param writer Where to leave it.
+ * @param fd Where the records get written (i.e.: STDOUT_FILENO). It isn't closed.
+ * @param format How they get formatted.
+ * @param with_content Whether each record carries the content of the file (record_content()).
+ * @return 0 on success, -1 if the system ran out of memory.
+ */
+int record_writer_init(record_writer* writer, int fd, enum record_format format, bool with_content);
+
+/**
+ * @brief Starts a record. With content, it's given by record_content() before record_end().
+ * @param writer The writer.
+ * @param path Path of the file.
+ * @param size Size of the file, in bytes.
+ * @param mtime Last modification time of the file.
+ */
+void record_begin(record_writer* writer, const char* path, off_t size, struct timespec mtime);
+
+/**
+ * @brief Adds a chunk of content to the record started; it can be called as many times as needed.
+ * @param writer The writer.
+ * @param bytes The chunk.
+ * @param len Bytes of the chunk.
+ */
+void record_content(record_writer* writer, const char* bytes, size_t len);
+
+/**
+ * @brief Ends the record started.
+ * @param writer The writer.
+ */
+void record_end(record_writer* writer);
+
+/**
+ * @brief Writes every record kept on the buffer.
+ * @param writer The writer.
+ * @return 0 on success, -1 if a write failed, now or before (errno is set).
+ */
+int record_writer_flush(record_writer* writer);
+
+/**
+ * @brief Writes every record kept on the buffer, and releases it.
+ * @param writer The writer.
+ * @return 0 on success, -1 if a write failed, now or before (errno is set).
+ */
+int record_writer_destroy(record_writer* writer);
+
+#endif
@@ -6,17 +6,35 @@
 #ifndef SHELL_H
 #define SHELL_H
 
+#include "arena_utils.h"
+#include "batch_utils.h"
+#include "builtin_utils.h"
 #include "cmd_utils.h"
+#include "dashboard_utils.h"
+#include "event_utils.h"
+#include "metrics_control_utils.h"
+#include "jobs_utils.h"
+#include "metrics_history_utils.h"
+#include "metrics_ring_utils.h"
 #include "metrics_utils.h"
+#include "monitor_utils.h"
+#include "parallel_utils.h"
+#include "parser_utils.h"
+#include "path_utils.h"
+#include "spawn_utils.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <termios.h>
 #include <time.h>
 #include <unistd.h>
 #include <wait.h>
@@ -25,46 +43,114 @@
 #define HOST_NAME_MAX 64
 //! \brief Environment variable key to retrieve the computer current user.
 #define ENV_USER_KEY "USER"
-//! \brief First layer separator of smybols/tokens/words on a shell command, that creates single commands.
-#define SC_TOKEN_SEPARATOR "|"
-//! \brief Char or group of chars that define the separation of smybols/tokens/words on a single command.
-#define TOKEN_SEPARATOR " "
 //! \brief Lowest array index.
 #define LOWEST_ARR_INDEX 0
 //! \brief Environment variable key to retrieve the last ("old") current working directory.
 #define ENV_OLDPWD_KEY "OLDPWD"
 //! \brief Environment variable key to retrieve the current working directory.
 #define ENV_PWD_KEY "PWD"
+//! \brief Environment variable key where the exit code of each single command of the last foreground command line is
+//! left, separated by spaces (i.e.: "1 0" after "false | true").
+#define ENV_PIPESTATUS_KEY "PIPESTATUS"
+//! \brief Exit code of a single command that couldn't be run (i.e.: not found), as other shells give.
+#define EXIT_CODE_NOT_RUN 127
 //! \brief Average delay that some terminals (in IDEs, Shells, etc.) take to flush stdout/stderr, in microseconds.
 #define TERMINAL_FLUSH_DELAY 30000
 //! \brief ANSI escape codes that moves the cursor to the home position and clears the screen.
 #define CLR_ANSI_EC "\033[H\033[J"
-//! \brief This shell has a max limit of tokens per command.
-#define MAX_TOKENS_PER_COMMAND 32
 //! \brief Amount of signals to handle, has direct relationship with the signals array.
 #define N_SINGALS_TO_HANDLE 4
 //! \brief Signals handled or not, depending on the process currently executed.
 static const int signals[N_SINGALS_TO_HANDLE] = {SIGINT, SIGTERM, SIGTSTP, SIGQUIT};
-//! \brief GNU/Linux bytes of args + environ for exec() family of functions.
-#define ARG_MAX 131072
-//! \brief Maximum number of single commands to execute, given the max length allowed for an absolute command.
-#define MAX_SINGLE_COMMANDS (ARG_MAX / 4)
+//! \brief Amount of job control signals, has direct relationship with the job_control_signals array.
+#define N_JOB_CONTROL_SIGNALS 2
+//! \brief Signals ignored by the shell (so it can hand the terminal around), that every job gets with their default
+//! behavior.
+static const int job_control_signals[N_JOB_CONTROL_SIGNALS] = {SIGTTIN, SIGTTOU};
+//! \brief Bytes asked to the kernel on each read() of the interactive input; its buffer grows by this much at least.
+#define PROMPT_READ_CHUNK 4096
 //! \brief Path to the metrics (lab #1) app.
 #define METRICS_APP_PATH "/opt/metrics"
+//! \brief File descriptor the "metrics" app gets its in-memory JSON config file on.
+#define METRICS_CONFIG_CHILD_FD 5
+//! \brief Path the "metrics" app gets as its JSON config file when it's in memory (METRICS_CONFIG_CHILD_FD).
+#define METRICS_CONFIG_CHILD_PATH "/dev/fd/5"
 //! \brief A code, that the "metrics" app understands as "get status".
 #define METRICS_GET_STATUS_CODE 7
-//! \brief Seconds awaited to receive response from metrics app after a "get status" req, when executed in foreground.
-#define WAIT_T_FOR_METRICS_RESPONSE 3.0
-//! \brief Number of metrics returned by a "get status" by the metrics app.
-#define G_STATUS_N_METRICS_TRACKED 4
-//! \brief For a process non-existent or undetected, by set its pid as "unassigned".
-#define PID_UNASSIGNED -1
+//! \brief Milliseconds awaited to receive response from metrics app after a "get status" req, by default.
+#define METRICS_RESPONSE_TIMEOUT_MS 500
+//! \brief Maximum milliseconds that can be awaited for a response from metrics app after a "get status" req.
+#define METRICS_RESPONSE_TIMEOUT_MAX_MS 60000
+//! \brief "status_monitor" option that sets the milliseconds awaited for a response, i.e.: "--timeout=250".
+#define METRICS_TIMEOUT_OPTION "--timeout="
+//! \brief Base of the "--timeout" value.
+#define METRICS_TIMEOUT_OPTION_BASE 10
+//! \brief "status_monitor" option that summarizes the samples of a window of time, i.e.: "--history 5m".
+#define METRICS_HISTORY_OPTION "--history"
+//! \brief Milliseconds between each "get status" req to the "metrics" apps that didn't respond yet: responses that
+//! arrive together merge into one (SIGUSR1 isn't a realtime signal).
+#define METRICS_RESEND_MS 10
+//! \brief "explore_filesystem" option that sets the threads listing dirs, i.e.: "--threads=8".
+#define EXPLORE_THREADS_OPTION "--threads="
+//! \brief "explore_filesystem" option that sets how the config files get read: "--io=sync" (one by one, the default) or
+//! "--io=uring" (many at once through io_uring, if the kernel can).
+#define EXPLORE_IO_OPTION "--io="
+//! \brief Value of "--io" that reads the config files one by one.
+#define EXPLORE_IO_SYNC "sync"
+//! \brief Value of "--io" that reads the config files through io_uring.
+#define EXPLORE_IO_URING "uring"
+//! \brief "explore_filesystem" option that sets the config files read at once with "--io=uring", i.e.:
+//! "--io-depth=128".
+#define EXPLORE_IO_DEPTH_OPTION "--io-depth="
+//! \brief "explore_filesystem" option that sets the levels of dirs explored below the one given, i.e.: "--max-depth=2".
+#define EXPLORE_MAX_DEPTH_OPTION "--max-depth="
+//! \brief "explore_filesystem" option that leaves out the entries matching a glob (as on a .gitignore), i.e.:
+//! "--exclude node_modules/".
+#define EXPLORE_EXCLUDE_OPTION "--exclude"
+//! \brief "explore_filesystem" option that leaves out the dirs on another file system than the one given.
+#define EXPLORE_ONE_FILE_SYSTEM_OPTION "--one-file-system"
+//! \brief "explore_filesystem" option that leaves out the entries matching the globs of the ignore files of that name
+//! (gitignore-style), i.e.: "--ignore-file=.gitignore".
+#define EXPLORE_IGNORE_FILE_OPTION "--ignore-file="
+//! \brief "explore_filesystem" option that tells each config file as a machine-readable record (path, size and mtime)
+//! instead of showing it: "--format=ndjson", "--format=tsv" or "--format=null" (NUL-separated fields).
+#define EXPLORE_FORMAT_OPTION "--format="
+//! \brief "explore_filesystem" option that adds the content of each config file to its record (needs --format).
+#define EXPLORE_CONTENT_OPTION "--content"
+//! \brief "explore_filesystem" option that tells only the config files added, changed or removed since the last time.
+#define EXPLORE_CHANGES_OPTION "--changes"
+//! \brief "explore_filesystem" option that keeps telling the config files changes as they happen (implies --changes).
+#define EXPLORE_WATCH_OPTION "--watch"
+//! \brief "explore_filesystem" option that sets the index file of --changes, i.e.: "--index=/var/cache/etc.index".
+#define EXPLORE_INDEX_OPTION "--index="
+//! \brief "explore_filesystem" option that selects a value of each matching JSON config file, i.e.:
+//! "--query metrics.cpu".
+#define EXPLORE_QUERY_OPTION "--query"
+//! \brief "explore_filesystem" option that only shows the JSON config files holding a predicate, i.e.:
+//! "--where 'update_interval>5'".
+#define EXPLORE_WHERE_OPTION "--where"
+//! \brief "start_monitor" option that names the "metrics" app, i.e.: "--name=fast".
+#define MONITOR_NAME_OPTION "--name="
+//! \brief Metrics shown by "status_monitor" and "watch_monitor", one per row.
+#define METRICS_STATUS_ROWS 7
+//! \brief Milliseconds between "watch_monitor" refreshes, by default.
+#define WATCH_INTERVAL_MS 1000
+//! \brief Lowest milliseconds between "watch_monitor" refreshes (10 Hz).
+#define WATCH_INTERVAL_MIN_MS 100
+//! \brief Highest milliseconds between "watch_monitor" refreshes.
+#define WATCH_INTERVAL_MAX_MS 60000
+//! \brief Seconds in a minute.
+#define SECS_PER_MIN 60
+//! \brief Seconds in an hour.
+#define SECS_PER_HOUR 3600
+//! \brief Nanoseconds in a millisecond.
+#define NSECS_PER_MSEC 1000000L
+//! \brief Nanoseconds in a second.
+#define NSECS_PER_SEC 1000000000L
+//! \brief Milliseconds in a second.
+#define MSECS_PER_SEC 1000L
 //! \brief "metrics" app maximum argc value.
 #define METRICS_MAX_ARGC 2
-//! \brief Change Directory ("cd") command index at which its argument start.
-#define CD_ARG_START_I 3
-//! \brief Echo ("echo") command index at which its argument start.
-#define ECHO_ARG_START_I 5
 //! \brief Binary mask, so to make useful only the LS Byte.
 #define LSBYTE_MASK 0xFF
 
@@ -75,13 +161,12 @@ enum sc_args_i
     SC_SECOND_ARG_I,
 };
 
-//! \brief Decoded status of "metrics" app indexes, each one linking to a specific status data.
-enum d_status_i
+//! \brief Index on spawn_io shared_fds of each file descriptor handed to the "metrics" app.
+enum monitor_shared_fd_i
 {
-    D_STATUS_CPU_I,
-    D_STATUS_RAM_I,
-    D_STATUS_HDDR_I,
-    D_STATUS_HDDW_I
+    RING_SHARED_FD_I,
+    CONTROL_SHARED_FD_I,
+    CONFIG_SHARED_FD_I
 };
 
 //! \brief Starting LS bit of encoded "monitor" status data.
@@ -94,29 +179,38 @@ enum ls_bit_encoded_msd
 };
 
 /**
- * @brief Starts the custom shell main loop.
+ * @brief Starts the custom shell main loop: an event loop that reads the command lines as they arrive, and shows the
+ * background jobs that finish right away. Ends the shell at the end of the input.
  */
 void start_shell_ml(void);
 
 /**
- * @brief Passed a single command, tokenize it, and return an array with each token.
- * @param sc Single command.
- * @return Array of tokens. Last "useful" element is always NULL. Must be manually freed after being used.
+ * @brief Executes certain command line, could be an internal command, external one, or unexistent. A malformed line
+ * gets reported and skipped.
+ * @param input Command line. It isn't modified, and doesn't need to be NULL-terminated.
+ * @param len Length of the command line, in bytes.
+ * @param cwd Current working directory. This variable could be updated inside.
  */
-char** tokenize_single_command(char* sc);
+void execute_command(const char* input, size_t len, char* cwd);
 
 /**
- * @brief Executes certain command, could be an internal one, external one, or unexistent.
- * @param input Command input.
- * @param cwd Current working directory. This variable could be updated inside.
+ * @brief Tries to execute a certain (no comments, one line per command) batch file. Lines can be of any length.
+ * @param path Path to the batch file.
+ * @param jobs Maximum amount of lines run at the same time. With more than 1, independent lines run concurrently on
+ * forked workers (their output is shown in the order of the lines), while lines that change the shell state (i.e.:
+ * "cd") and "wait" lines first wait for every previous line to finish.
  */
-void execute_command(char* input, char* cwd);
+void execute_batch_file(const char* path, unsigned jobs);
 
 /**
- * @brief Tries to execute a certain (no comments, one line per command) batch file.
- * @param path Path to the batch file.
+ * @brief Sets the capacity of the pipes created from now on to connect the single commands of a command line; bigger
+ * ones let a fast producer run ahead of its consumer with fewer context switches.
+ * @param bytes Capacity of each pipe, in bytes (rounded up to a power of 2 pages by the kernel), or 0 for the system
+ * default.
+ * @return 0 on success, -1 if the system doesn't allow pipes that big (errno is set; i.e.: EPERM over
+ * /proc/sys/fs/pipe-max-size).
  */
-void execute_batch_file(const char* path);
+int set_pipe_size(int bytes);
 
 /**
  * @brief Redirects the stdin to a specific existent (hopefully) file.
@@ -142,54 +236,176 @@ void restore_stdio(int original_stdio, int target_fd);
 
 /**
  * @brief "Change directory" internal command.
- * @param input Single command input.
- * @param sc_tokens Single command tokens.
- * @param background_execution Should be executed in the background?
- * @param cwd Current working directory. Used too as a buffer, where the new cd (if) will be saved.
+ * @param call Invocation; its cwd is used too as a buffer, where the new cd (if) will be saved.
+ */
+void execute_cd(const builtin_call* call);
+
+/**
+ * @brief "Clear" internal command, which cleans the terminal.
+ * @param call Invocation. Not used inside the function.
  */
-void execute_cd(char* input, char** sc_tokens, bool background_execution, char* cwd);
+void execute_clr(const builtin_call* call);
 
 /**
  * @brief "Echo" internal command.
- * @param input Single command input.
- * @param sc_tokens Single command tokens.
- * @param background_execution Should be executed in the background?
+ * @param call Invocation.
+ */
+void execute_echo(const builtin_call* call);
+
+/**
+ * @brief "Quit" internal command, which exits the shell cleanly.
+ * @param call Invocation. Not used inside the function.
  */
-void execute_echo(char* input, char** sc_tokens, bool background_execution);
+void execute_quit(const builtin_call* call);
 
 /**
- * @brief Executes the "stop_monitor" command, which stops the "metrics" app, if it was init by this Shell.
- * @param metrics_pid The "metrics" app process id.
+ * @brief Executes the "start_monitor" command, which starts the "metrics" app with the configuration requested.
+ * Several ones can run at once, each known by its "--name=NAME" ("default" if not given), with its own IPC channels.
+ * @param call Invocation.
  */
-void execute_stop_monitor(int* metrics_pid);
+void execute_start_monitor(const builtin_call* call);
 
 /**
- * @brief Executes the "status_monitor" command, that shows the "metrics" app, if it was init by this Shell.
- * @param metrics_pid The "metrics" app process id.
+ * @brief Executes the "stop_monitor [name|all]" command, which stops the "metrics" app with that name (or every one),
+ * if it was init by this Shell.
+ * @param call Invocation.
  */
-void execute_status_monitor(const int* metrics_pid);
+void execute_stop_monitor(const builtin_call* call);
+
+/**
+ * @brief Executes the "config_monitor [name]" command, that changes the config of the "metrics" app, if it was init by
+ * this Shell, while it keeps running (i.e.: "config_monitor fast --cpu=false --update_interval=2"). The options are the
+ * ones of "start_monitor", validated the same way; the change goes through its control channel, and the app
+ * acknowledges it once applied.
+ * @param call Command invocation.
+ */
+void execute_config_monitor(const builtin_call* call);
+
+/**
+ * @brief Executes the "status_monitor" command, that shows the "metrics" app, if it was init by this Shell. The latest
+ * sample published on the shared memory ring is read straight away; otherwise the shell asks for it with a signal, and
+ * sleeps until the response arrives (or "--timeout=MS" milliseconds pass). How long it took (or how old the sample
+ * is) gets shown too. "--history W" (i.e.: "30s", "5m", "1h") summarizes every metric over the last W instead. It's
+ * about the "metrics" app named by the first arg, if any; "all" shows every one on a table, asking them all at once.
+ * @param call Invocation.
+ */
+void execute_status_monitor(const builtin_call* call);
+
+/**
+ * @brief Executes the "watch_monitor [name] [interval]" command, that keeps showing the "metrics" app data, if it was
+ * init by this Shell, refreshed in place every interval seconds (1 by default, 0.1 at least) until a key is pressed or
+ * the app exits. Only the values that changed get redrawn, with a single write per refresh.
+ * @param call Command invocation.
+ */
+void execute_watch_monitor(const builtin_call* call);
 
 /**
  * @brief Executes the "explore_filesystem" internal command, which needs a single arg: a path to a dir. It explores
  * recursively the dir, looking for *.config and *.json files. Reading each one content and showing it in the shell.
+ * The dirs get listed by "--threads=N" threads (one per CPU by default); the output doesn't depend on it. With
+ * "--io=uring", the config files get read "--io-depth=N" at a time through io_uring (or one by one, if the kernel
+ * can't); the output doesn't depend on it either. Dirs get left out, before they're opened, by "--max-depth=N",
+ * "--exclude GLOB", "--one-file-system" and "--ignore-file=NAME"; a dir that's the same as one it's inside of (a
+ * symbolic link loop) isn't explored again. With "--changes", only the config files added, changed or removed
+ * since the last time get told (an index of them is kept on "--index=FILE"); with "--watch", they keep getting told as
+ * they happen, until a key is pressed. With "--query PATH" and/or "--where PREDICATE", only the JSON config files that
+ * match are shown (the path, and the value selected), parsed by the threads as they're found.
+ * @param call Invocation.
+ */
+void execute_explore_filesystem(const builtin_call* call);
+
+/**
+ * @brief Tells if an "explore_filesystem" pipeline stage runs on a forked copy of the shell, instead of on a helper
+ * thread: with "--watch" it doesn't end by itself. Meant to be the forks callback of its registry entry.
  * @param sc_tokens Single command tokens.
+ * @return true if "--watch" is among them.
  */
-void execute_explore_filesystem(char** sc_tokens);
+bool explore_filesystem_forks(char** sc_tokens);
 
 /**
- * @brief Potential external command execution.
+ * @brief Executes the "hash" internal command. Without args shows the remembered command lookups, "-r" forgets them
+ * all, and command names as args get looked up (and remembered) right away.
+ * @param call Invocation.
+ */
+void execute_hash(const builtin_call* call);
+
+/**
+ * @brief "Jobs" internal command, which shows every job of the shell and its state.
+ * @param call Invocation. Not used inside the function.
+ */
+void execute_jobs(const builtin_call* call);
+
+/**
+ * @brief "Foreground" internal command: resumes a job (the current one, or "%N") in the foreground.
+ * @param call Invocation.
+ */
+void execute_fg(const builtin_call* call);
+
+/**
+ * @brief "Background" internal command: resumes a stopped job (the current one, or "%N") in the background.
+ * @param call Invocation.
+ */
+void execute_bg(const builtin_call* call);
+
+/**
+ * @brief "Wait" internal command: waits for a job ("%N") to finish, or for every job if no arg is given.
+ * @param call Invocation.
+ */
+void execute_wait(const builtin_call* call);
+
+/**
+ * @brief Runs an internal command on a forked copy of the shell, i.e.: when it's a pipeline stage.
+ * @param internal_cmd Registry entry of the internal command.
+ * @param call Invocation.
+ * @param io Standard streams wiring applied on the copy before running the command.
+ * @return The child process id, or -1 if the shell couldn't be forked. The child never returns.
+ */
+pid_t execute_internal_cmd_forked(const builtin* internal_cmd, const builtin_call* call, const spawn_io* io);
+
+/**
+ * @brief Registers the processes of a command line as a job, and waits for it to finish (or stop) if it runs in the
+ * foreground; otherwise shows its job id and the process id of its last process.
+ * @param command Command line. Doesn't need to be NULL-terminated.
+ * @param command_len Length of the command line, in bytes.
+ * @param pgid Process group of the processes, or 0 if they're on the one of the shell.
+ * @param pids Processes, in the order of the pipeline.
+ * @param n_pids Amount of processes. Greater than 0.
+ * @param background_execution Is it being executed in the background?
+ * @param exit_codes Where to leave the exit code of each process, once done (or stopped) in the foreground, or NULL.
+ * n_pids elements.
+ * @return true if it was stopped while in the foreground (i.e.: [Ctrl]+[Z]), so it's still around; false otherwise.
+ */
+bool await_job(const char* command, size_t command_len, pid_t pgid, const pid_t* pids, size_t n_pids,
+               bool background_execution, int* exit_codes);
+
+/**
+ * @brief Potential external command execution. The process gets spawned (no fork() of the shell is done) with the
+ * wiring requested, reverting the handled signals to their default behavior if run in the foreground.
  * @param sc_tokens Single command tokens.
  * @param background_execution Should be executed in the background?
+ * @param io Standard streams wiring of the new process.
+ * @return The child process id, or -1 if it couldn't be executed (the error gets shown).
  */
-void execute_external_cmd(char** sc_tokens, bool background_execution);
+pid_t execute_external_cmd(char** sc_tokens, bool background_execution, spawn_io* io);
 
 /**
- * @brief You don't call this function directly, this is a handler.
- * @param sig Not used inside the function.
- * @param info Metadata of the signal.
- * @param context Not used inside the function.
+ * @brief Decodes the status data sent by the "metrics" app as response to a "get status" req (4 metrics of 1 byte
+ * each), for the "metrics" apps that don't publish on the shared memory ring.
+ * @param e_status "metrics" app status encoded, as sent on the signal value.
+ * @param sample Where to leave the status data.
  */
-void handle_sigusr1(int sig, siginfo_t* info, void* context);
+void decode_metrics_status(int e_status, metrics_sample* sample);
+
+/**
+ * @brief Shows the status data of a "metrics" app; the metrics it doesn't have are shown as "n/a".
+ * @param out Where to show it (i.e.: stdout).
+ * @param name Name of the "metrics" app.
+ * @param sample Status data.
+ * @param latency_label What latency_ms measures, i.e.: "Response time".
+ * @param latency_ms Milliseconds it took to get the status data.
+ */
+void print_metrics_status(FILE* out, const char* name, const metrics_sample* sample, const char* latency_label,
+                          double latency_ms);
 
 /**
  * @brief Monkeypatch of perror and fprintf(stderr, ...). Needed due to "bad" management of some IDE/Shell terminals.
@@ -199,12 +415,4 @@ void handle_sigusr1(int sig, siginfo_t* info, void* context);
  */
 void wstderr(const char* s, bool use_perror);
 
-/**
- * @brief Auxiliary function to free dinamycally allocated memory recursively.
- * @param arr Array of array. Could be for example an array of strings (char array).
- * @param limit The limit at which stop to free elements of the upmost array. Pass -1 as the limit to free until
- * a NULL value is found.
- */
-void free_recursively(void** arr, int limit);
-
 #endif
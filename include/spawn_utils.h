@@ -0,0 +1,101 @@
+/**
+ * @file spawn_utils.h
+ * @brief Process spawning utilities declaration. The pipes connecting the processes are created close-on-exec, so no
+ * end reaches a program it wasn't handed to.
+ */
+
+#ifndef SPAWN_UTILS_H
+#define SPAWN_UTILS_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+//! \brief Value of a spawn_io file descriptor member that means "inherit the one from the shell".
+#define SPAWN_FD_INHERIT -1
+//! \brief Value of spawn_io pgid that means "stay on the process group of the shell".
+#define SPAWN_PGID_INHERIT -1
+//! \brief File descriptors that can be handed to a spawned process on a number of choice, at most.
+#define SPAWN_MAX_SHARED_FDS 4
+//! \brief Permissions used when a stdout redirection creates its target file.
+#define SPAWN_REDIRECTION_FILE_MODE 0666
+
+/**
+ * @brief Standard streams wiring, applied to a spawned process before its program image is loaded. Replaces the
+ * dup2()/close()/open() calls that a fork()ed child used to perform by itself.
+ */
+typedef struct spawn_io
+{
+    //! \brief File descriptor to be used as stdin (i.e.: a pipe read end), or SPAWN_FD_INHERIT.
+    int stdin_fd;
+    //! \brief File descriptor to be used as stdout (i.e.: a pipe write end), or SPAWN_FD_INHERIT.
+    int stdout_fd;
+    //! \brief File to open as stdin ("<" redirection), or NULL. Takes precedence over stdin_fd.
+    const char* stdin_file;
+    //! \brief File to create/truncate as stdout (">" redirection), or NULL. Takes precedence over stdout_fd.
+    const char* stdout_file;
+    //! \brief File descriptors that must not leak into the spawned process and aren't close-on-exec (the pipes of
+    //! spawn_pipes() already are).
+    const int* fds_to_close;
+    //! \brief Amount of elements in fds_to_close.
+    size_t n_fds_to_close;
+    //! \brief Signals whose disposition must be reverted to SIG_DFL in the spawned process, or NULL to inherit them.
+    const sigset_t* sig_default;
+    //! \brief Process group to join (0 creates a new one, led by the spawned process), or SPAWN_PGID_INHERIT.
+    pid_t pgid;
+    //! \brief File descriptors handed to the spawned process (i.e.: a shared memory region, a control socket) on the
+    //! number at the same index of shared_fd_targets, even if they are close-on-exec; SPAWN_FD_INHERIT when unused.
+    int shared_fds[SPAWN_MAX_SHARED_FDS];
+    //! \brief File descriptor number the spawned process gets each one of shared_fds on.
+    int shared_fd_targets[SPAWN_MAX_SHARED_FDS];
+} spawn_io;
+
+/**
+ * @brief Initializes a spawn_io so the spawned process inherits everything from the shell.
+ * @param io Wiring to initialize.
+ */
+void spawn_io_init(spawn_io* io);
+
+/**
+ * @brief Launches a program with posix_spawn(), which on GNU/Linux is implemented with clone(CLONE_VM|CLONE_VFORK):
+ * no page tables get copied, so the cost doesn't grow with the shell memory footprint.
+ * @param path Path to the program executable (no PATH lookup is done).
+ * @param argv Program name and its args. Last element must be NULL.
+ * @param io Standard streams wiring, signals to reset and process group. Pass NULL to inherit everything.
+ * @return The child pid, or -1 (errno set) if the process couldn't be spawned or the program couldn't be executed.
+ */
+pid_t spawn_process(const char* path, char* const* argv, const spawn_io* io);
+
+/**
+ * @brief Creates pipes to connect processes with, close-on-exec: a process only gets the ends it's handed (dup2()
+ * clears the flag on the copy), whatever the amount of pipes.
+ * @param fds Where to leave the ends, read end first: 2 * n_pipes elements.
+ * @param n_pipes Amount of pipes.
+ * @param size Capacity of each pipe, in bytes (F_SETPIPE_SZ), or 0 for the system default. It's best effort: a pipe
+ * that can't be grown (i.e.: over /proc/sys/fs/pipe-max-size) keeps the default.
+ * @return 0 on success, -1 if a pipe couldn't be created (errno is set; none is left open).
+ */
+int spawn_pipes(int* fds, size_t n_pipes, int size);
+
+/**
+ * @brief Checks if pipes can get a capacity, by growing one.
+ * @param size Capacity, in bytes.
+ * @return 0 if they can, -1 otherwise (errno is set; i.e.: EPERM over /proc/sys/fs/pipe-max-size).
+ */
+int spawn_check_pipe_size(int size);
+
+/**
+ * @brief Closes file descriptors (i.e.: every end of the pipes of a pipeline). A contiguous range of them gets closed
+ * with a single close_range() syscall.
+ * @param fds File descriptors.
+ * @param n_fds Amount of file descriptors.
+ */
+void spawn_close_fds(const int* fds, size_t n_fds);
+
+#endif
@@ -0,0 +1,134 @@
+/**
+ * @file uring_utils.h
+ * @brief Minimal io_uring (the kernel asynchronous I/O interface) declaration, straight on its syscalls: a ring is set
+ * up, operations are queued on its submission queue, submitted at once with a single syscall, and their results reaped
+ * from its completion queue.
+ */
+
+#ifndef URING_UTILS_H
+#define URING_UTILS_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+//! \brief Operations a probe asks the kernel about, at most (IORING_OP_* codes fit in a byte).
+#define URING_PROBE_OPS 256
+
+//! \brief An io_uring instance, with its rings mapped.
+typedef struct uring
+{
+    //! \brief The instance, or -1.
+    int fd;
+    //! \brief Submission queue ring, as mapped.
+    void* sq_ring;
+    //! \brief Bytes of sq_ring mapped.
+    size_t sq_ring_size;
+    //! \brief Completion queue ring, as mapped (the same as sq_ring if the kernel maps them together).
+    void* cq_ring;
+    //! \brief Bytes of cq_ring mapped.
+    size_t cq_ring_size;
+    //! \brief Submission queue entries.
+    struct io_uring_sqe* sqes;
+    //! \brief Bytes of sqes mapped.
+    size_t sqes_size;
+    //! \brief Head of the submission queue, moved by the kernel.
+    unsigned* sq_head;
+    //! \brief Tail of the submission queue.
+    unsigned* sq_tail;
+    //! \brief Mask of the submission queue indexes.
+    unsigned sq_mask;
+    //! \brief Indirection array of the submission queue (to sqes).
+    unsigned* sq_array;
+    //! \brief Tail of the entries queued but not submitted yet.
+    unsigned sq_pending_tail;
+    //! \brief Head of the completion queue.
+    unsigned* cq_head;
+    //! \brief Tail of the completion queue, moved by the kernel.
+    unsigned* cq_tail;
+    //! \brief Mask of the completion queue indexes.
+    unsigned cq_mask;
+    //! \brief Completion queue entries.
+    struct io_uring_cqe* cqes;
+} uring;
+
+/**
+ * @brief Sets up a ring.
+ * @param ring Where to leave it.
+ * @param entries Submission queue entries (rounded up to a power of 2 by the kernel).
+ * @return 0 on success, -1 on failure (errno is set; i.e.: ENOSYS if the kernel lacks io_uring, or EPERM if it's
+ * disabled).
+ */
+int uring_init(uring* ring, unsigned entries);
+
+/**
+ * @brief Tears down a ring; whatever is still in flight gets canceled, and its registered files closed.
+ * @param ring The ring.
+ */
+void uring_exit(uring* ring);
+
+/**
+ * @brief Tells if the kernel supports some operations on a ring.
+ * @param ring The ring.
+ * @param ops The IORING_OP_* operations.
+ * @param n_ops Amount of operations.
+ * @return true if every one is supported.
+ */
+bool uring_supports(const uring* ring, const uint8_t* ops, size_t n_ops);
+
+/**
+ * @brief Registers an empty table of files on a ring, to open files straight into (direct descriptors, not on the
+ * process file table).
+ * @param ring The ring.
+ * @param n_files Slots of the table.
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+int uring_register_files(const uring* ring, unsigned n_files);
+
+/**
+ * @brief Tells if files really get opened into, and closed from, the registered table of a ring: kernels before 5.15
+ * know IORING_OP_OPENAT and IORING_OP_CLOSE, but ignore the slot they're given (opening on the process file table, and
+ * closing its descriptor 0 instead). It opens the root directory into the first slot, and closes it from there.
+ * @param ring The ring, with its files registered and nothing queued nor waiting to be reaped.
+ * @return true if they do.
+ */
+bool uring_opens_direct(uring* ring);
+
+/**
+ * @brief Gets a submission queue entry to fill in, zeroed. It gets submitted with the next uring_submit().
+ * @param ring The ring.
+ * @return The entry, or NULL if the submission queue is full.
+ */
+struct io_uring_sqe* uring_get_sqe(uring* ring);
+
+/**
+ * @brief Submits every entry queued, and optionally waits for completions. It's retried while interrupted, or the
+ * kernel is short of resources for the moment.
+ * @param ring The ring.
+ * @param wait_nr Completions to wait for (0 to not wait).
+ * @return The amount of entries submitted, or -1 on failure (errno is set).
+ */
+int uring_submit(uring* ring, unsigned wait_nr);
+
+/**
+ * @brief Gets the oldest completion not seen yet, without waiting.
+ * @param ring The ring.
+ * @return The completion (call uring_cqe_seen() once done with it), or NULL if there's none.
+ */
+struct io_uring_cqe* uring_peek_cqe(uring* ring);
+
+/**
+ * @brief Marks the oldest completion as seen, so its slot can be reused by the kernel.
+ * @param ring The ring.
+ */
+void uring_cqe_seen(uring* ring);
+
+#endif
@@ -0,0 +1,80 @@
+/**
+ * @file arena_utils.c
+ * @brief Bump-pointer (arena) memory allocator definition.
+ */
+
+#include "arena_utils.h"
+
+void* arena_alloc(arena* a, size_t size)
+{
+    // Keep the next allocation aligned too
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+    // Move along the chain (blocks kept from previous resets) until one has room enough
+    while (a->current != NULL && a->current->size - a->current->used < size)
+    {
+        if (a->current->next == NULL)
+        {
+            break;
+        }
+        a->current = a->current->next;
+        a->current->used = 0;
+    }
+    if (a->current == NULL || a->current->size - a->current->used < size)
+    {
+        const size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        arena_block* block = malloc(sizeof(arena_block) + block_size);
+        if (block == NULL)
+        {
+            return NULL;
+        }
+        block->next = NULL;
+        block->size = block_size;
+        block->used = 0;
+        if (a->current == NULL)
+        {
+            a->head = block;
+        }
+        else
+        {
+            // A block too small for this request is left behind (still chained), as the current one is the last
+            a->current->next = block;
+        }
+        a->current = block;
+    }
+    void* memory = a->current->data + a->current->used;
+    a->current->used += size;
+    return memory;
+}
+
+char* arena_strdup(arena* a, const char* s)
+{
+    const size_t len = strlen(s) + 1;
+    char* copy = arena_alloc(a, len);
+    if (copy != NULL)
+    {
+        memcpy(copy, s, len);
+    }
+    return copy;
+}
+
+void arena_reset(arena* a)
+{
+    a->current = a->head;
+    if (a->current != NULL)
+    {
+        a->current->used = 0;
+    }
+}
+
+void arena_release(arena* a)
+{
+    arena_block* block = a->head;
+    while (block != NULL)
+    {
+        arena_block* next = block->next;
+        free(block);
+        block = next;
+    }
+    a->head = NULL;
+    a->current = NULL;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file batch_utils.c
+ * @brief Batch file reader definition.
+ */
+
+#include "batch_utils.h"
+
+/**
+ * @brief Hands every complete line of a chunk of memory to a handler.
+ * @param data Chunk of the batch file.
+ * @param len Length of the chunk, in bytes.
+ * @param handler Function called with each line.
+ * @param ctx Passed as is to the handler.
+ * @return Bytes consumed, i.e.: up to (and including) the last newline found.
+ */
+static size_t handle_lines(const char* data, size_t len, batch_line_handler handler, void* ctx)
+{
+    size_t consumed = 0;
+    const char* newline;
+    while ((newline = memchr(data + consumed, BATCH_LINE_DELIMITER, len - consumed)) != NULL)
+    {
+        const size_t line_len = (size_t)(newline - (data + consumed));
+        handler(data + consumed, line_len, ctx);
+        consumed += line_len + 1;
+    }
+    return consumed;
+}
+
+/**
+ * @brief Reads a batch file that can't be mapped (pipe, FIFO, terminal, etc.) through a buffer, which doubles its
+ * size whenever a single line doesn't fit in it.
+ * @param fd File descriptor of the batch file.
+ * @param handler Function called with each line.
+ * @param ctx Passed as is to the handler.
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+static int stream_lines(int fd, batch_line_handler handler, void* ctx)
+{
+    size_t capacity = BATCH_READ_BUFFER_SIZE;
+    char* buffer = malloc(capacity);
+    if (buffer == NULL)
+    {
+        return -1;
+    }
+    // Bytes of an incomplete line, kept at the start of the buffer
+    size_t pending = 0;
+    while (true)
+    {
+        if (pending == capacity)
+        {
+            char* bigger = realloc(buffer, capacity * 2);
+            if (bigger == NULL)
+            {
+                free(buffer);
+                return -1;
+            }
+            buffer = bigger;
+            capacity *= 2;
+        }
+        const ssize_t n_read = read(fd, buffer + pending, capacity - pending);
+        if (n_read == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            const int read_errno = errno;
+            free(buffer);
+            errno = read_errno;
+            return -1;
+        }
+        if (n_read == 0)
+        {
+            break;
+        }
+        // Only the bytes just read can hold a newline; the pending ones were already scanned
+        const size_t scanned = pending;
+        pending += (size_t)n_read;
+        const char* newline = memchr(buffer + scanned, BATCH_LINE_DELIMITER, pending - scanned);
+        if (newline == NULL)
+        {
+            continue;
+        }
+        const size_t consumed = handle_lines(buffer, pending, handler, ctx);
+        pending -= consumed;
+        memmove(buffer, buffer + consumed, pending);
+    }
+    // The last line may lack its newline
+    if (pending > 0)
+    {
+        handler(buffer, pending, ctx);
+    }
+    free(buffer);
+    return 0;
+}
+
+int batch_for_each_line(int fd, batch_line_handler handler, void* ctx)
+{
+    struct stat stat_buffer;
+    if (fstat(fd, &stat_buffer) == -1)
+    {
+        return -1;
+    }
+    if (!S_ISREG(stat_buffer.st_mode))
+    {
+        return stream_lines(fd, handler, ctx);
+    }
+    const size_t len = (size_t)stat_buffer.st_size;
+    if (len == 0)
+    {
+        // Nothing to map (mmap() refuses a 0 length), nor to execute
+        return 0;
+    }
+    const char* data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        // Some file systems can't be mapped; read them as any other stream
+        return stream_lines(fd, handler, ctx);
+    }
+    // The file gets read from start to end once; let the kernel read ahead aggressively
+    madvise((void*)data, len, MADV_SEQUENTIAL);
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = 0;
+    size_t released = 0;
+    while (start < len)
+    {
+        // The last line may lack its newline
+        const char* newline = memchr(data + start, BATCH_LINE_DELIMITER, len - start);
+        const size_t end = newline == NULL ? len : (size_t)(newline - data);
+        handler(data + start, end - start, ctx);
+        start = end + 1;
+        // Lines already executed won't be read again; give their pages back instead of keeping the whole file resident
+        if (start - released >= BATCH_MAP_RELEASE_STEP && start < len)
+        {
+            const size_t release_end = start & ~(page_size - 1);
+            madvise((void*)(data + released), release_end - released, MADV_DONTNEED);
+            released = release_end;
+        }
+    }
+    munmap((void*)data, len);
+    return 0;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file builtin_utils.c
+ * @brief Internal commands (builtins) registry definition.
+ */
+
+#include "builtin_utils.h"
+#include "shell.h"
+
+/**
+ * \brief Every internal command, placed on the slot builtin_hash() gives for its name, so a lookup is a hash plus one
+ * strcmp(). When adding one, place it on its slot; if it collides, pick another BUILTIN_HASH_SEED and re-place them
+ * all.
+ */
+static const builtin builtins[BUILTIN_SLOTS] = {
+    [5] = {"cd", execute_cd, BUILTIN_IN_PROCESS | BUILTIN_NEEDS_PARENT | BUILTIN_IN_PIPELINE},
+    [6] = {"hash", execute_hash, BUILTIN_IN_PROCESS | BUILTIN_IN_PIPELINE},
+    [13] = {"status_monitor", execute_status_monitor, BUILTIN_IN_PROCESS | BUILTIN_IN_PIPELINE | BUILTIN_ON_THREAD},
+    [17] = {"explore_filesystem", execute_explore_filesystem,
+            BUILTIN_IN_PROCESS | BUILTIN_IN_PIPELINE | BUILTIN_ON_THREAD, explore_filesystem_forks},
+    [21] = {"bg", execute_bg, BUILTIN_IN_PROCESS | BUILTIN_NEEDS_PARENT},
+    [25] = {"quit", execute_quit, BUILTIN_IN_PROCESS | BUILTIN_NEEDS_PARENT},
+    [31] = {"start_monitor", execute_start_monitor, BUILTIN_IN_PROCESS | BUILTIN_NEEDS_PARENT},
+    [33] = {"fg", execute_fg, BUILTIN_IN_PROCESS | BUILTIN_NEEDS_PARENT},
+    [34] = {"jobs", execute_jobs, BUILTIN_IN_PROCESS | BUILTIN_IN_PIPELINE},
+    [35] = {"echo", execute_echo, BUILTIN_IN_PROCESS | BUILTIN_IN_PIPELINE | BUILTIN_ON_THREAD},
+    [39] = {"wait", execute_wait, BUILTIN_IN_PROCESS | BUILTIN_NEEDS_PARENT},
+    [45] = {"config_monitor", execute_config_monitor, BUILTIN_IN_PROCESS | BUILTIN_NEEDS_PARENT},
+    [52] = {"watch_monitor", execute_watch_monitor, BUILTIN_IN_PROCESS | BUILTIN_NEEDS_PARENT},
+    [61] = {"clr", execute_clr, BUILTIN_IN_PROCESS | BUILTIN_IN_PIPELINE | BUILTIN_ON_THREAD},
+    [63] = {"stop_monitor", execute_stop_monitor, BUILTIN_IN_PROCESS | BUILTIN_NEEDS_PARENT},
+};
+
+size_t builtin_hash(const char* name)
+{
+    uint32_t hash = BUILTIN_HASH_SEED;
+    for (const unsigned char* c = (const unsigned char*)name; *c != '\0'; c++)
+    {
+        hash = (hash ^ *c) * BUILTIN_HASH_PRIME;
+    }
+    return hash & (BUILTIN_SLOTS - 1);
+}
+
+const builtin* builtin_lookup(const char* name)
+{
+    const builtin* entry = &builtins[builtin_hash(name)];
+    return (entry->name != NULL && strcmp(entry->name, name) == 0) ? entry : NULL;
+}
+
+const builtin* builtin_registry(size_t* n_slots)
+{
+    *n_slots = BUILTIN_SLOTS;
+    return builtins;
+}
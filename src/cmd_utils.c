@@ -3,158 +3,1235 @@
  * @brief Commands utilities definition.
  */
 
+// copy_file_range()
+#define _GNU_SOURCE
 #include "cmd_utils.h"
 
-bool is_background_exec(char** tokens)
+bool join_tokens(char* const* tokens, char* buffer, size_t size)
 {
-    // Ignore " &" if appears, as this is an internal command
-    if (tokens != NULL)
+    size_t used = 0;
+    for (int i = LOWEST_ARR_INDEX; tokens[i] != NULL; i++)
     {
-        // Seek for the NULL token
-        int i;
-        for (i = LOWEST_ARR_INDEX; tokens[i] != NULL; i++)
+        const size_t token_len = strlen(tokens[i]);
+        // Room for the separator (if not the first one), the token, and the null terminator
+        if (used + (i > LOWEST_ARR_INDEX) + token_len + 1 > size)
         {
+            return false;
         }
-        if (strcmp(tokens[i - 1], "&") == 0)
+        if (i > LOWEST_ARR_INDEX)
         {
-            tokens[i - 1] = NULL;
-            return true;
+            buffer[used++] = ' ';
         }
+        memcpy(&buffer[used], tokens[i], token_len);
+        used += token_len;
     }
-    return false;
+    if (size == 0)
+    {
+        return false;
+    }
+    buffer[used] = STR_NULL_TERMINATOR;
+    return true;
 }
 
-void cleanse_newline(char* input)
+int copy_file_to_fd(int in_fd, int out_fd, enum copy_method* method)
 {
-    const size_t input_len = strlen(input);
-    if (input[input_len - 1] == '\n')
+    bool copied = false;
+    char buffer[READING_BUFFER];
+    while (true)
     {
-        input[input_len - 1] = STR_NULL_TERMINATOR;
+        ssize_t n;
+        if (*method == COPY_FILE_RANGE)
+        {
+            n = copy_file_range(in_fd, NULL, out_fd, NULL, COPY_CHUNK, 0);
+        }
+        else if (*method == COPY_SENDFILE)
+        {
+            n = sendfile(out_fd, in_fd, NULL, COPY_CHUNK);
+        }
+        else
+        {
+            n = read(in_fd, buffer, sizeof(buffer));
+            for (ssize_t done = 0; n > 0 && done < n;)
+            {
+                const ssize_t written = write(out_fd, buffer + done, (size_t)(n - done));
+                if (written == -1 && errno != EINTR)
+                {
+                    return -1;
+                }
+                done += written > 0 ? written : 0;
+            }
+        }
+        if (n == 0)
+        {
+            return 0;
+        }
+        if (n > 0)
+        {
+            copied = true;
+            continue;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        // This way isn't supported between these kinds of files; the next one is, as long as nothing got copied yet
+        if (*method != COPY_BUFFERED && !copied &&
+            (errno == EINVAL || errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP || errno == EBADF))
+        {
+            (*method)++;
+            continue;
+        }
+        return -1;
     }
 }
 
-void cleanse_ampersand(char* input)
+/**
+ * @brief Tells if a file found by traverse_directory() is a config file. Meant to be the wanted callback of an
+ * explore_visitor.
+ * @param name File base name.
+ * @param ctx Not used inside the function.
+ * @return true if the file is considered a config file, false otherwise.
+ */
+static bool wanted_config_file(const char* name, void* ctx)
 {
-    const size_t input_len = strlen(input);
-    input[input_len - 2] = STR_NULL_TERMINATOR;
+    // Args ignored
+    (void)ctx;
+    return is_config_file(name);
 }
 
-char* get_possible_redirection(char** argv, bool _stdin)
+//! \brief Where traverse_directory() shows what it finds.
+typedef struct traverse_output
 {
-    for (int i = LOWEST_ARR_INDEX; argv[i] != NULL; i++)
+    //! \brief The stream (i.e.: stdout).
+    FILE* out;
+    //! \brief The copy_method to use on its file descriptor.
+    enum copy_method method;
+    //! \brief Whether it can't be written anymore (i.e.: nobody reads it); nothing else gets shown.
+    bool broken;
+} traverse_output;
+
+/**
+ * @brief Tells if what traverse_directory() finds can't be shown anymore, so the traversal stops. Meant to be the
+ * stopped callback of an explore_visitor.
+ * @param ctx The traverse_output.
+ * @return true if it can't.
+ */
+static bool output_broken(void* ctx)
+{
+    traverse_output* output = ctx;
+    output->broken = output->broken || ferror(output->out);
+    return output->broken;
+}
+
+/**
+ * @brief Shows a dir found by traverse_directory(), before its content. Meant to be the on_dir callback of an
+ * explore_visitor.
+ * @param path Path to the dir.
+ * @param error 0 if it could be opened, otherwise the errno value telling why not.
+ * @param ctx The traverse_output.
+ */
+static void show_dir(const char* path, int error, void* ctx)
+{
+    traverse_output* output = ctx;
+    if (error != 0)
     {
-        if (strcmp(argv[i], _stdin ? "<" : ">") == 0)
+        fprintf(stderr, "ERROR: Couldn't open the dir provided: %s\n", strerror(error));
+        return;
+    }
+    fprintf(output->out, "Explorando el dir: \"%s\" en busca de archivos *.{config|json} ...\n", path);
+}
+
+/**
+ * @brief Shows a config file found by traverse_directory(), and its content. Meant to be the on_file callback of an
+ * explore_visitor.
+ * @param path Path to the config file.
+ * @param found Not used inside the function.
+ * @param ctx The traverse_output.
+ */
+static void show_config_file(const char* path, void* found, void* ctx)
+{
+    // Args ignored
+    (void)found;
+    traverse_output* output = ctx;
+    if (output_broken(output))
+    {
+        return;
+    }
+    fprintf(output->out, "Archivo de configuración encontrado: \"%s\".\n", path);
+    // Open the file
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd != -1)
+    {
+        // Print the file content straight to the file descriptor of the stream; what stdio holds goes first
+        fprintf(output->out, "Contenido de \"%s\":\n", path);
+        if (fflush(output->out) == EOF || copy_file_to_fd(fd, fileno(output->out), &output->method) == -1)
         {
-            // This could even be NULL
-            return argv[i + 1];
+            // Nobody reading it anymore isn't an error, but the end of the traversal
+            output->broken = errno == EPIPE;
+            if (!output->broken)
+            {
+                perror("ERROR: On config file reading");
+            }
         }
+        close(fd);
+        fprintf(output->out, "\n");
+    }
+    else
+    {
+        perror("ERROR: On config file opening for reading purpose.");
+        // Doesn't exist, just continues with the next entry ...
+    }
+}
+
+//! \brief Operations of the chain each config file gets read by through io_uring, in order.
+enum dump_op
+{
+    DUMP_OPEN,
+    DUMP_READ,
+    DUMP_CLOSE,
+    DUMP_OPS
+};
+
+//! \brief Something found by traverse_directory() waiting its turn to be shown.
+typedef struct dump_entry
+{
+    //! \brief Path to it.
+    char* path;
+    //! \brief Whether it's a config file, or a dir.
+    bool is_file;
+    //! \brief Dir: 0 if it could be opened, otherwise the errno value telling why not. Config file: result of its
+    //! opening (negative errno value on failure).
+    int error;
+    //! \brief Config file: result of its reading (bytes read, or a negative errno value).
+    int read_result;
+    //! \brief Config file: operations of its chain not completed yet.
+    unsigned pending;
+} dump_entry;
+
+//! \brief Config files being read through io_uring, and what was found along them, in order. Each config file takes
+//! the slot of its entry on the registered files of the ring, and on the buffers, until it gets shown.
+typedef struct uring_dump
+{
+    //! \brief The ring.
+    uring ring;
+    //! \brief FIFO of what's waiting to be shown, depth slots.
+    dump_entry* entries;
+    //! \brief Buffers the config files are read to, READING_BUFFER bytes each slot.
+    char* buffers;
+    //! \brief Slots.
+    unsigned depth;
+    //! \brief Slot of the oldest entry.
+    unsigned head;
+    //! \brief Entries waiting.
+    unsigned count;
+    //! \brief Where everything gets shown; the content that doesn't fit in a buffer is copied as show_config_file()
+    //! does.
+    traverse_output output;
+} uring_dump;
+
+/**
+ * @brief Sets up the reading of config files through io_uring.
+ * @param dump Where to leave it.
+ * @param depth Config files read at once.
+ * @param out Where everything gets shown.
+ * @return 0 on success, -1 if the kernel lacks what's needed (opening files straight into the registered ones
+ * included), or the system ran out of memory.
+ */
+static int uring_dump_init(uring_dump* dump, unsigned depth, FILE* out)
+{
+    static const uint8_t ops[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE};
+    *dump = (uring_dump){.depth = depth, .output = {out, COPY_FILE_RANGE, false}};
+    if (uring_init(&dump->ring, depth * DUMP_OPS) == -1)
+    {
+        return -1;
+    }
+    dump->entries = calloc(depth, sizeof(dump_entry));
+    dump->buffers = malloc((size_t)depth * READING_BUFFER);
+    if (dump->entries == NULL || dump->buffers == NULL || !uring_supports(&dump->ring, ops, sizeof(ops)) ||
+        uring_register_files(&dump->ring, depth) == -1 || !uring_opens_direct(&dump->ring))
+    {
+        free(dump->entries);
+        free(dump->buffers);
+        uring_exit(&dump->ring);
+        return -1;
     }
-    return NULL;
+    return 0;
 }
 
-void cleanse_redirections_on_argv(char** argv)
+/**
+ * @brief Takes in the completions of the ring, as they are.
+ * @param dump The dump.
+ */
+static void reap_dump_completions(uring_dump* dump)
 {
-    for (int i = LOWEST_ARR_INDEX; argv[i] != NULL; i++)
+    const struct io_uring_cqe* cqe;
+    while ((cqe = uring_peek_cqe(&dump->ring)) != NULL)
     {
-        if (strcmp(argv[i], ">") == 0 || strcmp(argv[i], "<") == 0)
+        dump_entry* entry = &dump->entries[cqe->user_data / DUMP_OPS];
+        if (cqe->user_data % DUMP_OPS == DUMP_OPEN)
         {
-            argv[i] = NULL;
-            return;
+            entry->error = cqe->res;
         }
+        else if (cqe->user_data % DUMP_OPS == DUMP_READ)
+        {
+            entry->read_result = cqe->res;
+        }
+        entry->pending--;
+        uring_cqe_seen(&dump->ring);
     }
 }
 
-void cleanse_redirections_on_sc(char* sc)
+/**
+ * @brief Shows a config file read through io_uring, as show_config_file() does.
+ * @param dump The dump.
+ * @param entry Its entry, with its chain completed.
+ */
+static void show_dumped_config_file(uring_dump* dump, const dump_entry* entry)
 {
-    const size_t sc_len = strlen(sc);
-    int first_char_redirecting = -1;
-    // No cmd is permitted redirection at the leftmost, on a char index less than AMP_MIN_INDEX_APPEARANCE
-    for (int i = sc_len - 1; i >= AMP_MIN_INDEX_APPEARANCE; i--)
+    FILE* out = dump->output.out;
+    fprintf(out, "Archivo de configuración encontrado: \"%s\".\n", entry->path);
+    if (entry->error < 0)
+    {
+        errno = -entry->error;
+        perror("ERROR: On config file opening for reading purpose.");
+        return;
+    }
+    fprintf(out, "Contenido de \"%s\":\n", entry->path);
+    const char* buffer = &dump->buffers[(size_t)(entry - dump->entries) * READING_BUFFER];
+    if (entry->read_result < 0)
     {
-        if (sc[i] == '<' || sc[i] == '>')
+        fflush(out);
+        errno = -entry->read_result;
+        perror("ERROR: On config file reading");
+    }
+    else if (fwrite(buffer, 1, (size_t)entry->read_result, out) == (size_t)entry->read_result &&
+             entry->read_result == READING_BUFFER)
+    {
+        // It didn't fit in the buffer: the rest gets copied as show_config_file() does
+        const int fd = open(entry->path, O_RDONLY | O_CLOEXEC);
+        if (fflush(out) == EOF || fd == -1 || lseek(fd, READING_BUFFER, SEEK_SET) == -1 ||
+            copy_file_to_fd(fd, fileno(out), &dump->output.method) == -1)
         {
-            first_char_redirecting = i;
+            dump->output.broken = errno == EPIPE;
+            if (!dump->output.broken)
+            {
+                perror("ERROR: On config file reading");
+            }
+        }
+        if (fd != -1)
+        {
+            close(fd);
         }
     }
-    if (first_char_redirecting != -1)
+    fprintf(out, "\n");
+}
+
+/**
+ * @brief Shows the oldest entry of the dump, once its chain is completed, and frees its slot. Once the output can't be
+ * written anymore, it's only freed.
+ * @param dump The dump.
+ */
+static void show_oldest_dumped(uring_dump* dump)
+{
+    dump_entry* entry = &dump->entries[dump->head];
+    while (entry->pending > 0)
     {
-        // cleanse prefix space if exist
-        if (sc[first_char_redirecting - 1] == ' ')
+        // Everything queued gets submitted at once
+        if (uring_submit(&dump->ring, 1) == -1)
         {
-            sc[first_char_redirecting - 1] = STR_NULL_TERMINATOR;
+            perror("ERROR: On config files reading");
+            exit(EXIT_FAILURE);
         }
-        else
+        reap_dump_completions(dump);
+    }
+    if (output_broken(&dump->output))
+    {
+        // Nobody reads it anymore
+    }
+    else if (entry->is_file)
+    {
+        show_dumped_config_file(dump, entry);
+    }
+    else
+    {
+        show_dir(entry->path, entry->error, &dump->output);
+    }
+    free(entry->path);
+    dump->head = (dump->head + 1) % dump->depth;
+    dump->count--;
+}
+
+/**
+ * @brief Shows every entry of the dump, in order.
+ * @param dump The dump.
+ */
+static void drain_dump(uring_dump* dump)
+{
+    while (dump->count > 0)
+    {
+        show_oldest_dumped(dump);
+    }
+}
+
+/**
+ * @brief Takes a slot for a new entry of the dump, showing the oldest one if there's none free.
+ * @param dump The dump.
+ * @param path Path to what's found.
+ * @return The entry, or NULL if the system ran out of memory (every older entry gets shown).
+ */
+static dump_entry* push_dumped(uring_dump* dump, const char* path)
+{
+    char* copy = strdup(path);
+    if (copy == NULL)
+    {
+        drain_dump(dump);
+        return NULL;
+    }
+    if (dump->count == dump->depth)
+    {
+        show_oldest_dumped(dump);
+    }
+    dump_entry* entry = &dump->entries[(dump->head + dump->count++) % dump->depth];
+    *entry = (dump_entry){.path = copy};
+    return entry;
+}
+
+/**
+ * @brief Queues a dir found by traverse_directory() to be shown in its turn. Meant to be the on_dir callback of an
+ * explore_visitor.
+ * @param path Path to the dir.
+ * @param error 0 if it could be opened, otherwise the errno value telling why not.
+ * @param ctx The uring_dump.
+ */
+static void queue_dir(const char* path, int error, void* ctx)
+{
+    dump_entry* entry = push_dumped(ctx, path);
+    if (entry == NULL)
+    {
+        show_dir(path, error, &((uring_dump*)ctx)->output);
+        return;
+    }
+    entry->error = error;
+}
+
+/**
+ * @brief Gets a submission queue entry of the dump, submitting what's queued if there's none free.
+ * @param dump The dump.
+ * @return The entry.
+ */
+static struct io_uring_sqe* get_dump_sqe(uring_dump* dump)
+{
+    struct io_uring_sqe* sqe;
+    while ((sqe = uring_get_sqe(&dump->ring)) == NULL)
+    {
+        if (uring_submit(&dump->ring, 0) == -1)
         {
-            sc[first_char_redirecting] = STR_NULL_TERMINATOR;
+            perror("ERROR: On config files reading");
+            exit(EXIT_FAILURE);
         }
     }
-    else if (sc[sc_len - 1] == ' ')
+    return sqe;
+}
+
+/**
+ * @brief Queues a config file found by traverse_directory() to be read through io_uring (opened into the registered
+ * file of its slot, read to its buffer, and closed), and shown in its turn. Meant to be the on_file callback of an
+ * explore_visitor.
+ * @param path Path to the config file.
+ * @param found Not used inside the function.
+ * @param ctx The uring_dump.
+ */
+static void queue_config_file(const char* path, void* found, void* ctx)
+{
+    uring_dump* dump = ctx;
+    dump_entry* entry = push_dumped(dump, path);
+    if (entry == NULL)
     {
-        // cleanse trailing space
-        sc[sc_len - 1] = STR_NULL_TERMINATOR;
+        show_config_file(path, found, &dump->output);
+        return;
     }
+    const unsigned slot = (unsigned)(entry - dump->entries);
+    entry->is_file = true;
+    entry->pending = DUMP_OPS;
+    // Reading needs it opened, but closing it doesn't need it read
+    struct io_uring_sqe* sqe = get_dump_sqe(dump);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uintptr_t)entry->path;
+    sqe->open_flags = O_RDONLY;
+    sqe->file_index = slot + 1;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = (uint64_t)slot * DUMP_OPS + DUMP_OPEN;
+    sqe = get_dump_sqe(dump);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = (int)slot;
+    sqe->addr = (uintptr_t)&dump->buffers[(size_t)slot * READING_BUFFER];
+    sqe->len = READING_BUFFER;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+    sqe->user_data = (uint64_t)slot * DUMP_OPS + DUMP_READ;
+    sqe = get_dump_sqe(dump);
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = slot + 1;
+    sqe->user_data = (uint64_t)slot * DUMP_OPS + DUMP_CLOSE;
 }
 
-void traverse_directory(const char* dir_path)
+/**
+ * @brief Tells if what's dumped can't be shown anymore, as output_broken() does. Meant to be the stopped callback of an
+ * explore_visitor.
+ * @param ctx The uring_dump.
+ * @return true if it can't.
+ */
+static bool dump_broken(void* ctx)
 {
-    // Open the directory file, to interpret its metadata
-    DIR* dir = opendir(dir_path);
-    struct dirent* entry;
-    char path[PATH_MAX];
-    // Sanity check
-    if (!dir)
+    return output_broken(&((uring_dump*)ctx)->output);
+}
+
+void traverse_directory(const char* dir_path, unsigned n_threads, const explore_filter* filter, unsigned io_depth,
+                        FILE* out)
+{
+    uring_dump dump;
+    if (io_depth > 0 && uring_dump_init(&dump, io_depth, out) == 0)
     {
-        perror("ERROR: Couldn't open the dir provided");
+        const explore_visitor visitor = {wanted_config_file, NULL, queue_dir, queue_config_file, dump_broken, &dump};
+        const int explored = explore_tree(dir_path, n_threads, filter, &visitor);
+        const int error = errno;
+        drain_dump(&dump);
+        if (explored == -1 && error != ECANCELED)
+        {
+            errno = error;
+            perror("ERROR: Some entries were left out");
+        }
+        free(dump.entries);
+        free(dump.buffers);
+        uring_exit(&dump.ring);
+        fflush(out);
         return;
     }
-    printf("Explorando el dir: \"%s\" en busca de archivos *.{config|json} ...\n", dir_path);
-    // Actually traverse all its content
-    while ((entry = readdir(dir)) != NULL)
+    traverse_output output = {out, COPY_FILE_RANGE, false};
+    const explore_visitor visitor = {wanted_config_file, NULL, show_dir, show_config_file, output_broken, &output};
+    // Being stopped because nobody reads the output anymore isn't an error
+    if (explore_tree(dir_path, n_threads, filter, &visitor) == -1 && errno != ECANCELED)
     {
-        // Skip "." and ".."
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        perror("ERROR: Some entries were left out");
+    }
+    fflush(out);
+}
+
+//! \brief Word telling each kind of change, as of config_change.
+static const char* const change_names[] = {
+    [CONFIG_UNCHANGED] = "unchanged",
+    [CONFIG_ADDED] = "added",
+    [CONFIG_CHANGED] = "changed",
+    [CONFIG_REMOVED] = "removed",
+};
+
+//! \brief State of audit_directory(), shared by its callbacks.
+typedef struct audit_state
+{
+    //! \brief Index of the config files found.
+    config_index* index;
+    //! \brief Threads listing dirs.
+    unsigned n_threads;
+    //! \brief What to leave out, based on the dir audited.
+    explore_filter filter;
+    //! \brief inotify instance watching the dirs found, or -1 if they aren't watched.
+    int inotify_fd;
+    //! \brief Path of each dir watched, by its watch descriptor (NULL for the ones not in use).
+    char** watched;
+    //! \brief Amount of slots of watched.
+    size_t n_watched;
+    //! \brief Watch descriptor of the dir audited, or -1.
+    int root_wd;
+    //! \brief Where the changes get told (i.e.: stdout).
+    FILE* out;
+} audit_state;
+
+/**
+ * @brief Tells a change on a config file.
+ * @param out Where to tell it.
+ * @param change What happened to it.
+ * @param path Path to the file.
+ */
+static void print_change(FILE* out, enum config_change change, const char* path)
+{
+    fprintf(out, "%s\t%s\n", change_names[change], path);
+}
+
+/**
+ * @brief Tells a config file as removed. Meant to be the removed callback of config_index_sweep().
+ * @param path Path to the file.
+ * @param ctx The audit_state.
+ */
+static void print_removed(const char* path, void* ctx)
+{
+    print_change(((const audit_state*)ctx)->out, CONFIG_REMOVED, path);
+}
+
+/**
+ * @brief Tells if the changes can't be told anymore (i.e.: nobody reads them), so the scan stops. Meant to be the
+ * stopped callback of an explore_visitor.
+ * @param ctx The audit_state.
+ * @return true if they can't.
+ */
+static bool audit_broken(void* ctx)
+{
+    return ferror(((const audit_state*)ctx)->out);
+}
+
+/**
+ * @brief Starts watching a dir, if the audit watches them.
+ * @param state Audit state.
+ * @param path Path to the dir.
+ * @return Its watch descriptor, or -1 if it isn't watched.
+ */
+static int watch_dir(audit_state* state, const char* path)
+{
+    if (state->inotify_fd == -1)
+    {
+        return -1;
+    }
+    const int wd = inotify_add_watch(state->inotify_fd, path, AUDIT_WATCHED_EVENTS);
+    if (wd == -1)
+    {
+        fprintf(stderr, "ERROR: Couldn't watch the dir \"%s\": %s\n", path, strerror(errno));
+        return -1;
+    }
+    if ((size_t)wd >= state->n_watched)
+    {
+        const size_t n_watched = (size_t)wd * 2 + 1;
+        char** watched = realloc(state->watched, n_watched * sizeof(char*));
+        if (watched == NULL)
         {
-            continue;
+            inotify_rm_watch(state->inotify_fd, wd);
+            return -1;
         }
-        // Build the full path
-        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
-        // Check if it's a directory
-        struct stat stat_buffer;
-        if (stat(path, &stat_buffer) == 0 && S_ISDIR(stat_buffer.st_mode))
+        memset(&watched[state->n_watched], 0, (n_watched - state->n_watched) * sizeof(char*));
+        state->watched = watched;
+        state->n_watched = n_watched;
+    }
+    // The same dir reached again (i.e.: through a symbolic link) keeps its watch descriptor; the last path is kept
+    free(state->watched[wd]);
+    state->watched[wd] = strdup(path);
+    return wd;
+}
+
+/**
+ * @brief Checks a dir found by audit_directory(), watching it. Meant to be the on_dir callback of an explore_visitor.
+ * @param path Path to the dir.
+ * @param error 0 if it could be opened, otherwise the errno value telling why not.
+ * @param ctx The audit_state.
+ */
+static void audit_dir(const char* path, int error, void* ctx)
+{
+    if (error != 0)
+    {
+        fprintf(stderr, "ERROR: Couldn't open the dir \"%s\": %s\n", path, strerror(error));
+        return;
+    }
+    watch_dir(ctx, path);
+}
+
+/**
+ * @brief Brings the index entry of a config file up to date, telling if it was added or changed. Meant to be the
+ * on_file callback of an explore_visitor.
+ * @param path Path to the config file.
+ * @param found Not used inside the function.
+ * @param ctx The audit_state.
+ */
+static void audit_file(const char* path, void* found, void* ctx)
+{
+    // Args ignored
+    (void)found;
+    const audit_state* state = ctx;
+    enum config_change change;
+    if (config_index_refresh(state->index, path, &change) == -1)
+    {
+        // Gone, or not a file anymore: it's a removal if it was known
+        if (errno == ENOENT || errno == ENOTDIR || errno == EINVAL || errno == ELOOP)
         {
-            // If it's a directory, recurse into it
-            traverse_directory(path);
+            if (config_index_remove(state->index, path))
+            {
+                print_change(state->out, CONFIG_REMOVED, path);
+            }
+            return;
         }
-        // Check if it's a regular file and has a valid extension
-        else if (S_ISREG(stat_buffer.st_mode) && is_config_file(entry->d_name))
+        fprintf(stderr, "ERROR: Couldn't read the config file \"%s\": %s\n", path, strerror(errno));
+        return;
+    }
+    if (change != CONFIG_UNCHANGED)
+    {
+        print_change(state->out, change, path);
+    }
+}
+
+/**
+ * @brief Scans a dir (and everything under it), telling what changed since it was last scanned.
+ * @param state Audit state.
+ * @param path Path to the dir.
+ * @return 0 once the whole dir was scanned, -1 if it wasn't (errno is set): ECANCELED if the changes can't be told
+ * anymore, ENOMEM if there was no memory left to go on.
+ */
+static int scan_dir(audit_state* state, const char* path)
+{
+    const explore_visitor visitor = {wanted_config_file, NULL, audit_dir, audit_file, audit_broken, state};
+    config_index_begin_scan(state->index);
+    if (explore_tree(path, state->n_threads, &state->filter, &visitor) == -1)
+    {
+        // What wasn't reached can't be told as removed
+        const int error = errno;
+        if (error != ECANCELED)
         {
-            printf("Archivo de configuración encontrado: \"%s\".\n", path);
-            // Open the file
-            FILE* file = fopen(path, "r");
-            if (file)
+            perror("ERROR: Some entries were left out");
+        }
+        errno = error;
+        return -1;
+    }
+    config_index_sweep(state->index, path, print_removed, state);
+    return 0;
+}
+
+/**
+ * @brief Forgets a dir that's gone (removed, or moved away): the config files under it are told as removed, and it's
+ * not watched anymore, nor anything under it.
+ * @param state Audit state.
+ * @param path Path to the dir.
+ */
+static void forget_dir(audit_state* state, const char* path)
+{
+    config_index_begin_scan(state->index);
+    config_index_sweep(state->index, path, print_removed, state);
+    const size_t path_len = strlen(path);
+    for (size_t wd = 0; wd < state->n_watched; wd++)
+    {
+        const char* watched = state->watched[wd];
+        if (watched != NULL && strncmp(watched, path, path_len) == 0 &&
+            (watched[path_len] == '/' || watched[path_len] == STR_NULL_TERMINATOR))
+        {
+            inotify_rm_watch(state->inotify_fd, (int)wd);
+            free(state->watched[wd]);
+            state->watched[wd] = NULL;
+        }
+    }
+}
+
+/**
+ * @brief Tells if a path is the one of a dir being watched.
+ * @param state Audit state.
+ * @param path The path.
+ * @return true if it is.
+ */
+static bool is_watched(const audit_state* state, const char* path)
+{
+    for (size_t wd = 0; wd < state->n_watched; wd++)
+    {
+        if (state->watched[wd] != NULL && strcmp(state->watched[wd], path) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Handles an event on a watched dir, telling the changes it brings.
+ * @param state Audit state.
+ * @param root Path to the dir audited.
+ * @param event The event.
+ * @return true if the dir audited can still be watched, false if it's gone.
+ */
+static bool handle_watch_event(audit_state* state, const char* root, const struct inotify_event* event)
+{
+    if ((event->mask & IN_Q_OVERFLOW) != 0)
+    {
+        // Some events were lost; scanning everything again tells what they would have
+        scan_dir(state, root);
+        return true;
+    }
+    if (event->wd < 0 || (size_t)event->wd >= state->n_watched || state->watched[event->wd] == NULL)
+    {
+        return true;
+    }
+    if ((event->mask & (IN_IGNORED | IN_MOVE_SELF)) != 0)
+    {
+        if (event->wd == state->root_wd)
+        {
+            return false;
+        }
+        // Any other dir is forgotten through the event on its parent; its watch descriptor is freed once it's gone
+        if ((event->mask & IN_IGNORED) != 0)
+        {
+            free(state->watched[event->wd]);
+            state->watched[event->wd] = NULL;
+        }
+        return true;
+    }
+    char path[PATH_MAX];
+    if (event->len == 0 ||
+        snprintf(path, sizeof(path), "%s/%s", state->watched[event->wd], event->name) >= (int)sizeof(path))
+    {
+        return true;
+    }
+    const bool is_dir = (event->mask & IN_ISDIR) != 0;
+    if ((event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0)
+    {
+        if (is_dir || is_watched(state, path))
+        {
+            forget_dir(state, path);
+        }
+        else if (is_config_file(event->name) && config_index_remove(state->index, path))
+        {
+            print_change(state->out, CONFIG_REMOVED, path);
+        }
+        return true;
+    }
+    struct stat st;
+    if ((event->mask & (IN_CREATE | IN_MOVED_TO)) != 0 && (is_dir || (stat(path, &st) == 0 && S_ISDIR(st.st_mode))))
+    {
+        // A new dir, or a symbolic link to one
+        if (explore_filter_admits(&state->filter, path, true))
+        {
+            scan_dir(state, path);
+        }
+        return true;
+    }
+    // A regular file just created gets told once it's written and closed; a symbolic link or hard link, right away
+    if (!is_config_file(event->name) || !explore_filter_admits(&state->filter, path, false) ||
+        ((event->mask & IN_CREATE) != 0 && lstat(path, &st) == 0 && S_ISREG(st.st_mode) && st.st_nlink == 1))
+    {
+        return true;
+    }
+    audit_file(path, NULL, state);
+    return true;
+}
+
+/**
+ * @brief Keeps telling the changes under a dir as they happen, until told to stop, nobody reads them anymore or the dir
+ * is gone.
+ * @param state Audit state, with the dir already scanned and watched.
+ * @param root Path to the dir audited.
+ * @param stop_fd It stops once this file descriptor gets readable, or -1.
+ */
+static void watch_changes(audit_state* state, const char* root, int stop_fd)
+{
+    alignas(struct inotify_event) char events[AUDIT_EVENTS_BUFFER];
+    // A -1 file descriptor is ignored by poll(); the output only tells POLLERR (or POLLHUP) once its reader is gone, so
+    // a watch with no changes to tell doesn't outlive it
+    struct pollfd sources[] = {{stop_fd, POLLIN, 0}, {fileno(state->out), 0, 0}, {state->inotify_fd, POLLIN, 0}};
+    bool watching = fflush(state->out) == 0;
+    while (watching)
+    {
+        if (poll(sources, sizeof(sources) / sizeof(sources[0]), -1) == -1)
+        {
+            if (errno == EINTR)
             {
-                // Print the file content to stdout
-                char buffer[READING_BUFFER];
-                size_t bytes_read;
-                printf("Contenido de \"%s\":\n", path);
-                while ((bytes_read = fread((void*)buffer, sizeof(char), sizeof(buffer), file)) > 0)
-                {
-                    fwrite((void*)buffer, sizeof(char), bytes_read, stdout);
-                }
-                fclose(file);
-                printf("\n");
-                // Force the stdout flush
-                fflush(stderr);
+                continue;
+            }
+            break;
+        }
+        if (sources[0].revents != 0 || (sources[1].revents & (POLLERR | POLLHUP)) != 0)
+        {
+            break;
+        }
+        ssize_t n;
+        while (watching && (n = read(state->inotify_fd, events, sizeof(events))) > 0)
+        {
+            for (char* at = events; watching && at < events + n;)
+            {
+                const struct inotify_event* event = (const struct inotify_event*)at;
+                watching = handle_watch_event(state, root, event);
+                at += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        if (!watching)
+        {
+            fprintf(stderr, "ERROR: The dir \"%s\" was moved or removed.\n", root);
+        }
+        // The changes get told as soon as they happen; nobody reading them anymore ends the watch too
+        watching = watching && fflush(state->out) == 0;
+    }
+}
+
+int audit_directory(const char* dir_path, unsigned n_threads, const explore_filter* filter, const char* index_path,
+                    bool watch, int stop_fd, FILE* out)
+{
+    // The index knows every file by its absolute path, no matter the cwd, or how the dir was typed
+    char root[PATH_MAX];
+    char default_path[PATH_MAX];
+    if (realpath(dir_path, root) == NULL)
+    {
+        perror("ERROR: Couldn't resolve the dir provided");
+        return -1;
+    }
+    if (index_path == NULL)
+    {
+        if (!config_index_default_path(root, default_path, sizeof(default_path)))
+        {
+            perror("ERROR: Couldn't get to the index of the dir provided (give one with `--index=FILE`)");
+            return -1;
+        }
+        index_path = default_path;
+    }
+    audit_state state = {config_index_create(root), n_threads, {.max_depth = EXPLORE_UNLIMITED_DEPTH}, -1, NULL, 0, -1,
+                         out};
+    if (filter != NULL)
+    {
+        state.filter = *filter;
+    }
+    // The dirs that appear while watching get filtered as if the scan started at the root
+    state.filter.base = root;
+    if (state.index == NULL)
+    {
+        perror("ERROR: Couldn't create the index");
+        return -1;
+    }
+    if (config_index_load(state.index, index_path) == -1 && errno != ENOENT)
+    {
+        fprintf(stderr, "ERROR: Couldn't load the index \"%s\" (%s); it starts over.\n", index_path, strerror(errno));
+    }
+    if (watch)
+    {
+        // Each dir starts being watched as the scan reports it
+        state.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (state.inotify_fd == -1)
+        {
+            perror("ERROR: Couldn't watch the dir provided");
+        }
+    }
+    int result = scan_dir(&state, root);
+    // The changes nobody got to read get told again the next time
+    const bool canceled = result == -1 && errno == ECANCELED;
+    if (!canceled && config_index_save(state.index, index_path) == -1)
+    {
+        fprintf(stderr, "ERROR: Couldn't save the index \"%s\": %s\n", index_path, strerror(errno));
+        result = -1;
+    }
+    if (state.inotify_fd != -1)
+    {
+        // Already watched by the scan; watching it again gives its watch descriptor
+        state.root_wd = canceled ? -1 : watch_dir(&state, root);
+        if (state.root_wd != -1)
+        {
+            watch_changes(&state, root, stop_fd);
+            if (config_index_save(state.index, index_path) == -1)
+            {
+                fprintf(stderr, "ERROR: Couldn't save the index \"%s\": %s\n", index_path, strerror(errno));
+                result = -1;
             }
-            else
+        }
+        close(state.inotify_fd);
+    }
+    for (size_t wd = 0; wd < state.n_watched; wd++)
+    {
+        free(state.watched[wd]);
+    }
+    free(state.watched);
+    config_index_destroy(state.index);
+    fflush(out);
+    return result;
+}
+
+//! \brief State of query_directory(), shared by its callbacks.
+typedef struct query_state
+{
+    //! \brief The query, compiled.
+    const json_query* query;
+    //! \brief Where the matches get shown (i.e.: stdout).
+    FILE* out;
+} query_state;
+
+//! \brief Outcome of a query over a config file that matched it, or that couldn't be read.
+typedef struct query_match
+{
+    //! \brief 0, or the errno value telling why the file couldn't be read.
+    int error;
+    //! \brief Value selected, as unformatted JSON, or NULL.
+    char* value;
+} query_match;
+
+/**
+ * @brief Reads a whole file.
+ * @param dir_fd Dir the file is inside of.
+ * @param name Base name of the file.
+ * @param len Where to leave the bytes read.
+ * @return The content (free() it), or NULL on failure (errno is set).
+ */
+static char* read_file_at(int dir_fd, const char* name, size_t* len)
+{
+    const int fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1)
+    {
+        const int error = errno;
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        errno = error;
+        return NULL;
+    }
+    // Room for what it holds now, and a byte more to notice if it grew meanwhile
+    size_t capacity = (size_t)st.st_size + 1;
+    char* text = malloc(capacity);
+    *len = 0;
+    while (text != NULL)
+    {
+        const ssize_t n = read(fd, text + *len, capacity - *len);
+        if (n == 0)
+        {
+            break;
+        }
+        if (n == -1 && errno != EINTR)
+        {
+            free(text);
+            text = NULL;
+            break;
+        }
+        *len += n > 0 ? (size_t)n : 0;
+        if (*len == capacity)
+        {
+            char* grown = realloc(text, capacity * 2);
+            if (grown == NULL)
             {
-                perror("ERROR: On config file opening for reading purpose.");
-                // Doesn't exist, just continues with the next entry ...
+                free(text);
             }
+            text = grown;
+            capacity *= 2;
         }
     }
-    // Close the dir file opened
-    closedir(dir);
+    const int error = errno;
+    close(fd);
+    errno = error;
+    return text;
+}
+
+/**
+ * @brief Evaluates the query over a config file, as soon as it's found. Meant to be the inspect callback of an
+ * explore_visitor.
+ * @param dir_fd Dir the file is inside of.
+ * @param name Base name of the file.
+ * @param ctx The query_state.
+ * @return A query_match if the file matched or couldn't be read, otherwise NULL.
+ */
+static void* match_config_file(int dir_fd, const char* name, void* ctx)
+{
+    const json_query* query = ((const query_state*)ctx)->query;
+    size_t len = 0;
+    char* text = read_file_at(dir_fd, name, &len);
+    query_match match = {text == NULL ? errno : 0, NULL};
+    const bool matched = match.error == 0 && json_query_may_match(query, text, len) &&
+                         json_query_match(query, text, len, &match.value);
+    free(text);
+    if (!matched && match.error == 0)
+    {
+        return NULL;
+    }
+    query_match* found = malloc(sizeof(query_match));
+    if (found == NULL)
+    {
+        free(match.value);
+        return NULL;
+    }
+    *found = match;
+    return found;
+}
+
+/**
+ * @brief Shows a dir that couldn't be opened by query_directory(). Meant to be the on_dir callback of an
+ * explore_visitor.
+ * @param path Path to the dir.
+ * @param error 0 if it could be opened, otherwise the errno value telling why not.
+ * @param ctx Not used inside the function.
+ */
+static void show_dir_error(const char* path, int error, void* ctx)
+{
+    // Args ignored
+    (void)ctx;
+    if (error != 0)
+    {
+        fprintf(stderr, "ERROR: Couldn't open the dir \"%s\": %s\n", path, strerror(error));
+    }
+}
+
+/**
+ * @brief Shows a config file that matched the query of query_directory(), and the value selected. Meant to be the
+ * on_file callback of an explore_visitor.
+ * @param path Path to the config file.
+ * @param found Its query_match, or NULL if it didn't match.
+ * @param ctx The query_state.
+ */
+static void show_query_match(const char* path, void* found, void* ctx)
+{
+    FILE* out = ((const query_state*)ctx)->out;
+    query_match* match = found;
+    if (match == NULL)
+    {
+        return;
+    }
+    if (match->error != 0)
+    {
+        fprintf(stderr, "ERROR: Couldn't read the config file \"%s\": %s\n", path, strerror(match->error));
+    }
+    else if (match->value != NULL)
+    {
+        fprintf(out, "%s\t%s\n", path, match->value);
+    }
+    else
+    {
+        fprintf(out, "%s\n", path);
+    }
+    free(match->value);
+    free(match);
+}
+
+/**
+ * @brief Tells if the matches can't be shown anymore (i.e.: nobody reads them), so the traversal stops. Meant to be the
+ * stopped callback of an explore_visitor.
+ * @param ctx The query_state.
+ * @return true if they can't.
+ */
+static bool query_broken(void* ctx)
+{
+    return ferror(((const query_state*)ctx)->out);
+}
+
+void query_directory(const char* dir_path, unsigned n_threads, const explore_filter* filter, const json_query* query,
+                     FILE* out)
+{
+    query_state state = {query, out};
+    const explore_visitor visitor = {wanted_config_file, match_config_file, show_dir_error, show_query_match,
+                                     query_broken, &state};
+    if (explore_tree(dir_path, n_threads, filter, &visitor) == -1 && errno != ECANCELED)
+    {
+        perror("ERROR: Some entries were left out");
+    }
+    fflush(out);
+}
+
+//! \brief Size and mtime of a config file found by export_directory(), or why they couldn't be told.
+typedef struct export_stat
+{
+    //! \brief 0, or the errno value telling why the file couldn't be inspected.
+    int error;
+    //! \brief Size, in bytes.
+    off_t size;
+    //! \brief Last modification time.
+    struct timespec mtime;
+} export_stat;
+
+/**
+ * @brief Tells the size and mtime of a config file, as soon as it's found. Meant to be the inspect callback of an
+ * explore_visitor.
+ * @param dir_fd Dir the file is inside of.
+ * @param name Base name of the file.
+ * @param ctx Not used inside the function.
+ * @return Its export_stat, or NULL if the system ran out of memory.
+ */
+static void* stat_config_file(int dir_fd, const char* name, void* ctx)
+{
+    // Args ignored
+    (void)ctx;
+    export_stat* found = malloc(sizeof(export_stat));
+    struct stat st;
+    if (found != NULL)
+    {
+        *found = fstatat(dir_fd, name, &st, 0) == -1 ? (export_stat){.error = errno}
+                                                      : (export_stat){0, st.st_size, st.st_mtim};
+    }
+    return found;
+}
+
+/**
+ * @brief Writes the record of a config file found by export_directory(). Meant to be the on_file callback of an
+ * explore_visitor.
+ * @param path Path to the config file.
+ * @param found Its export_stat, or NULL to open it and tell them (and its content, if the records carry it) here.
+ * @param ctx The record_writer.
+ */
+static void export_config_file(const char* path, void* found, void* ctx)
+{
+    record_writer* writer = ctx;
+    export_stat* inspected = found;
+    if (inspected != NULL || !writer->with_content)
+    {
+        if (inspected == NULL || inspected->error != 0)
+        {
+            fprintf(stderr, "ERROR: Couldn't inspect the config file \"%s\": %s\n", path,
+                    strerror(inspected == NULL ? ENOMEM : inspected->error));
+        }
+        else
+        {
+            record_begin(writer, path, inspected->size, inspected->mtime);
+            record_end(writer);
+        }
+        free(inspected);
+        return;
+    }
+    // The content gets streamed into the record, so a big file doesn't have to fit in memory
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1)
+    {
+        fprintf(stderr, "ERROR: Couldn't read the config file \"%s\": %s\n", path, strerror(errno));
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        return;
+    }
+    record_begin(writer, path, st.st_size, st.st_mtim);
+    char buffer[READING_BUFFER];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) != 0)
+    {
+        if (n > 0)
+        {
+            record_content(writer, buffer, (size_t)n);
+        }
+        else if (errno != EINTR)
+        {
+            // The record ends with what could be read
+            fprintf(stderr, "ERROR: Couldn't read the config file \"%s\": %s\n", path, strerror(errno));
+            break;
+        }
+    }
+    record_end(writer);
+    close(fd);
+}
+
+/**
+ * @brief Tells if the records can't be written anymore (i.e.: nobody reads them), so the traversal stops. Meant to be
+ * the stopped callback of an explore_visitor.
+ * @param ctx The record_writer.
+ * @return true if they can't.
+ */
+static bool export_broken(void* ctx)
+{
+    return ((const record_writer*)ctx)->error != 0;
+}
+
+void export_directory(const char* dir_path, unsigned n_threads, const explore_filter* filter,
+                      enum record_format format, bool with_content, FILE* out)
+{
+    record_writer writer;
+    if (record_writer_init(&writer, fileno(out), format, with_content) == -1)
+    {
+        perror("ERROR: Couldn't set up the records");
+        return;
+    }
+    // What stdio holds goes first
+    fflush(out);
+    // Without content, the files get inspected by the threads listing dirs
+    const explore_visitor visitor = {wanted_config_file, with_content ? NULL : stat_config_file, show_dir_error,
+                                     export_config_file, export_broken, &writer};
+    if (explore_tree(dir_path, n_threads, filter, &visitor) == -1 && errno != ECANCELED)
+    {
+        perror("ERROR: Some entries were left out");
+    }
+    // A reader that went away (i.e.: `| head`) isn't an error
+    if (record_writer_destroy(&writer) == -1 && errno != EPIPE)
+    {
+        perror("ERROR: Couldn't write the records");
+    }
 }
 
 bool is_config_file(const char* filename)
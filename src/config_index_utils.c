@@ -0,0 +1,547 @@
+/**
+ * @file config_index_utils.c
+ * @brief Index of the config files found under a dir definition.
+ */
+
+// mkostemp()
+#define _GNU_SOURCE
+#include "config_index_utils.h"
+
+//! \brief FNV-1a 64 bits offset basis.
+#define FNV1A_OFFSET_BASIS 0xcbf29ce484222325ULL
+//! \brief FNV-1a 64 bits prime.
+#define FNV1A_PRIME 0x100000001b3ULL
+//! \brief mtime left on an entry hashed too close to its last modification. No file has it, so it's hashed again.
+#define RACY_MTIME_NS INT64_MIN
+//! \brief Longest path an index file can hold, in bytes.
+#define INDEX_PATH_MAX 4096
+
+//! \brief What's known about a config file.
+typedef struct config_entry
+{
+    //! \brief Path to the file. NULL for an unused slot.
+    char* path;
+    //! \brief Hash of the path.
+    uint64_t path_hash;
+    //! \brief Size, in bytes.
+    uint64_t size;
+    //! \brief Last modification time, in nanoseconds since the epoch, or RACY_MTIME_NS.
+    int64_t mtime_ns;
+    //! \brief Inode number; a file replaced by another one (i.e.: renamed over it) is told apart by it.
+    uint64_t ino;
+    //! \brief Hash of the content.
+    uint64_t content_hash;
+    //! \brief Scan the entry was last refreshed on.
+    uint64_t scan;
+} config_entry;
+
+//! \brief How each entry is laid out on an index file, followed by its path (path_len bytes, no NUL).
+typedef struct index_record
+{
+    //! \brief Size, in bytes.
+    uint64_t size;
+    //! \brief Last modification time, in nanoseconds since the epoch, or RACY_MTIME_NS.
+    int64_t mtime_ns;
+    //! \brief Inode number.
+    uint64_t ino;
+    //! \brief Hash of the content.
+    uint64_t content_hash;
+    //! \brief Bytes of the path.
+    uint64_t path_len;
+} index_record;
+
+struct config_index
+{
+    //! \brief Open addressing (linear probing) table of entries.
+    config_entry* slots;
+    //! \brief Amount of slots, always a power of 2.
+    size_t n_slots;
+    //! \brief Amount of slots in use.
+    size_t n_used;
+    //! \brief Current scan; increases with each config_index_begin_scan().
+    uint64_t scan;
+    //! \brief Absolute path to the dir indexed.
+    char* root;
+};
+
+/**
+ * @brief Continues a FNV-1a hash with some more bytes.
+ * @param hash Hash of the bytes before, or FNV1A_OFFSET_BASIS for the first ones.
+ * @param bytes The bytes.
+ * @param n Amount of bytes.
+ * @return The hash of every byte so far.
+ */
+static uint64_t fnv1a(uint64_t hash, const unsigned char* bytes, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        hash = (hash ^ bytes[i]) * FNV1A_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief FNV-1a hash of a path.
+ * @param path The path.
+ * @return Its hash.
+ */
+static uint64_t hash_path(const char* path)
+{
+    return fnv1a(FNV1A_OFFSET_BASIS, (const unsigned char*)path, strlen(path));
+}
+
+/**
+ * @brief Finds the slot of a path: the one holding it, or the unused one where it would be placed.
+ * @param slots Table of entries.
+ * @param n_slots Amount of slots of the table, a power of 2.
+ * @param path The path.
+ * @param hash Hash of the path.
+ * @return The slot found. The table always has unused slots, so there's always one.
+ */
+static config_entry* find_slot(config_entry* slots, size_t n_slots, const char* path, uint64_t hash)
+{
+    size_t i = hash & (n_slots - 1);
+    while (slots[i].path != NULL && (slots[i].path_hash != hash || strcmp(slots[i].path, path) != 0))
+    {
+        i = (i + 1) & (n_slots - 1);
+    }
+    return &slots[i];
+}
+
+/**
+ * @brief Doubles the amount of slots of an index, re-placing every entry.
+ * @param index The index.
+ * @return true if it could be done, false otherwise.
+ */
+static bool grow_slots(config_index* index)
+{
+    const size_t n_slots = index->n_slots * 2;
+    config_entry* slots = calloc(n_slots, sizeof(config_entry));
+    if (slots == NULL)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < index->n_slots; i++)
+    {
+        if (index->slots[i].path != NULL)
+        {
+            *find_slot(slots, n_slots, index->slots[i].path, index->slots[i].path_hash) = index->slots[i];
+        }
+    }
+    free(index->slots);
+    index->slots = slots;
+    index->n_slots = n_slots;
+    return true;
+}
+
+/**
+ * @brief Finds the entry of a path, or adds an empty one for it.
+ * @param index The index.
+ * @param path The path.
+ * @param hash Hash of the path.
+ * @param added Where to leave whether the entry was added.
+ * @return The entry, or NULL if the system ran out of memory (errno is set).
+ */
+static config_entry* find_or_add(config_index* index, const char* path, uint64_t hash, bool* added)
+{
+    config_entry* entry = find_slot(index->slots, index->n_slots, path, hash);
+    *added = entry->path == NULL;
+    if (!*added)
+    {
+        return entry;
+    }
+    if ((index->n_used + 1) * 100 > index->n_slots * CONFIG_INDEX_MAX_LOAD_PCT)
+    {
+        if (!grow_slots(index))
+        {
+            return NULL;
+        }
+        entry = find_slot(index->slots, index->n_slots, path, hash);
+    }
+    entry->path = strdup(path);
+    if (entry->path == NULL)
+    {
+        return NULL;
+    }
+    entry->path_hash = hash;
+    entry->mtime_ns = RACY_MTIME_NS;
+    index->n_used++;
+    return entry;
+}
+
+/**
+ * @brief Frees an entry, re-placing the rest of its cluster so no lookup stops at the hole left (linear probing).
+ * @param index The index.
+ * @param entry The entry.
+ */
+static void remove_entry(config_index* index, config_entry* entry)
+{
+    free(entry->path);
+    entry->path = NULL;
+    index->n_used--;
+    size_t i = (size_t)(entry - index->slots);
+    for (i = (i + 1) & (index->n_slots - 1); index->slots[i].path != NULL; i = (i + 1) & (index->n_slots - 1))
+    {
+        config_entry moved = index->slots[i];
+        index->slots[i].path = NULL;
+        *find_slot(index->slots, index->n_slots, moved.path, moved.path_hash) = moved;
+    }
+}
+
+/**
+ * @brief Frees every entry of an index.
+ * @param index The index.
+ */
+static void clear_entries(config_index* index)
+{
+    for (size_t i = 0; i < index->n_slots; i++)
+    {
+        free(index->slots[i].path);
+    }
+    memset(index->slots, 0, index->n_slots * sizeof(config_entry));
+    index->n_used = 0;
+}
+
+/**
+ * @brief Gets the last modification time of a file, in nanoseconds since the epoch.
+ * @param st Its status.
+ * @return The time.
+ */
+static int64_t mtime_ns(const struct stat* st)
+{
+    return (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+/**
+ * @brief Hashes what's left of a file.
+ * @param fd The file, open for reading.
+ * @param hash Where to leave the hash.
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+static int hash_content(int fd, uint64_t* hash)
+{
+    unsigned char buffer[CONFIG_INDEX_READ_BUFFER];
+    *hash = FNV1A_OFFSET_BASIS;
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) != 0)
+    {
+        if (n == -1 && errno != EINTR)
+        {
+            return -1;
+        }
+        *hash = n > 0 ? fnv1a(*hash, buffer, (size_t)n) : *hash;
+    }
+    return 0;
+}
+
+config_index* config_index_create(const char* root)
+{
+    config_index* index = calloc(1, sizeof(config_index));
+    if (index == NULL)
+    {
+        return NULL;
+    }
+    index->slots = calloc(CONFIG_INDEX_INITIAL_SLOTS, sizeof(config_entry));
+    index->n_slots = CONFIG_INDEX_INITIAL_SLOTS;
+    index->root = strdup(root);
+    if (index->slots == NULL || index->root == NULL)
+    {
+        free(index->slots);
+        free(index->root);
+        free(index);
+        return NULL;
+    }
+    return index;
+}
+
+void config_index_destroy(config_index* index)
+{
+    if (index == NULL)
+    {
+        return;
+    }
+    clear_entries(index);
+    free(index->slots);
+    free(index->root);
+    free(index);
+}
+
+/**
+ * @brief Tells if a file can be trusted to hold what the user left on it: it's the user's, and only the user can write
+ * to it.
+ * @param st Status of the file.
+ * @return true if it can.
+ */
+static bool owned_by_user(const struct stat* st)
+{
+    return st->st_uid == geteuid() && (st->st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+/**
+ * @brief Tells if what snprintf() wrote fit in its buffer.
+ * @param len What snprintf() returned.
+ * @param size Size of the buffer, in bytes.
+ * @return true if it fit, false otherwise (errno is ENAMETOOLONG).
+ */
+static bool path_fits(int len, size_t size)
+{
+    if (len < 0 || (size_t)len >= size)
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    return true;
+}
+
+bool config_index_default_path(const char* root, char* buffer, size_t size)
+{
+    // Relative cache dirs are left out, as the XDG spec tells
+    const char* cache = getenv(CONFIG_INDEX_CACHE_ENV_KEY);
+    const char* home = getenv(CONFIG_INDEX_HOME_ENV_KEY);
+    const bool from_cache = cache != NULL && cache[0] == '/';
+    if (!from_cache && (home == NULL || home[0] != '/'))
+    {
+        errno = ENOENT;
+        return false;
+    }
+    const char* base = from_cache ? cache : home;
+    const char* below = from_cache ? "" : "/" CONFIG_INDEX_HOME_CACHE;
+    // The cache dir may be new too
+    if (!path_fits(snprintf(buffer, size, "%s%s", base, below), size) ||
+        (mkdir(buffer, CONFIG_INDEX_DIR_MODE) == -1 && errno != EEXIST))
+    {
+        return false;
+    }
+    struct stat st;
+    if (!path_fits(snprintf(buffer, size, "%s%s/" CONFIG_INDEX_CACHE_DIR, base, below), size) ||
+        (mkdir(buffer, CONFIG_INDEX_DIR_MODE) == -1 && errno != EEXIST) || lstat(buffer, &st) == -1)
+    {
+        return false;
+    }
+    if (!S_ISDIR(st.st_mode) || !owned_by_user(&st))
+    {
+        errno = EPERM;
+        return false;
+    }
+    return path_fits(snprintf(buffer, size, "%s%s/" CONFIG_INDEX_CACHE_DIR "/" CONFIG_INDEX_DEFAULT_FILE_FORMAT, base,
+                              below, hash_path(root)),
+                     size);
+}
+
+int config_index_load(config_index* index, const char* file)
+{
+    clear_entries(index);
+    FILE* in = fopen(file, "re");
+    if (in == NULL)
+    {
+        return -1;
+    }
+    // Whatever someone else could have written (or replaced) isn't trusted to tell what the user saw
+    struct stat st;
+    if (fstat(fileno(in), &st) == -1 || !S_ISREG(st.st_mode) || !owned_by_user(&st))
+    {
+        fclose(in);
+        errno = EPERM;
+        return -1;
+    }
+    char magic[sizeof(CONFIG_INDEX_MAGIC) - 1];
+    uint64_t root_len;
+    uint64_t n_entries;
+    char path[INDEX_PATH_MAX + 1];
+    bool valid = fread(magic, sizeof(magic), 1, in) == 1 && memcmp(magic, CONFIG_INDEX_MAGIC, sizeof(magic)) == 0 &&
+                 fread(&root_len, sizeof(root_len), 1, in) == 1 && root_len <= INDEX_PATH_MAX &&
+                 fread(path, 1, root_len, in) == root_len && root_len == strlen(index->root) &&
+                 memcmp(path, index->root, root_len) == 0 && fread(&n_entries, sizeof(n_entries), 1, in) == 1;
+    int error = EINVAL;
+    for (uint64_t i = 0; valid && i < n_entries; i++)
+    {
+        index_record record;
+        valid = fread(&record, sizeof(record), 1, in) == 1 && record.path_len <= INDEX_PATH_MAX &&
+                fread(path, 1, record.path_len, in) == record.path_len;
+        if (!valid)
+        {
+            break;
+        }
+        path[record.path_len] = '\0';
+        bool added;
+        config_entry* entry = find_or_add(index, path, hash_path(path), &added);
+        if (entry == NULL)
+        {
+            error = ENOMEM;
+            valid = false;
+            break;
+        }
+        entry->size = record.size;
+        entry->mtime_ns = record.mtime_ns;
+        entry->ino = record.ino;
+        entry->content_hash = record.content_hash;
+        entry->scan = index->scan;
+    }
+    fclose(in);
+    if (!valid)
+    {
+        clear_entries(index);
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+int config_index_save(const config_index* index, const char* file)
+{
+    char aside[INDEX_PATH_MAX];
+    if (snprintf(aside, sizeof(aside), "%s.XXXXXX", file) >= (int)sizeof(aside))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    // Created anew (O_EXCL), readable & writable only by the user; a file or link already there isn't followed
+    const int fd = mkostemp(aside, O_CLOEXEC);
+    FILE* out = fd != -1 ? fdopen(fd, "w") : NULL;
+    if (out == NULL)
+    {
+        if (fd != -1)
+        {
+            close(fd);
+            unlink(aside);
+        }
+        return -1;
+    }
+    const uint64_t root_len = strlen(index->root);
+    const uint64_t n_entries = index->n_used;
+    fwrite(CONFIG_INDEX_MAGIC, sizeof(CONFIG_INDEX_MAGIC) - 1, 1, out);
+    fwrite(&root_len, sizeof(root_len), 1, out);
+    fwrite(index->root, 1, root_len, out);
+    fwrite(&n_entries, sizeof(n_entries), 1, out);
+    for (size_t i = 0; i < index->n_slots; i++)
+    {
+        const config_entry* entry = &index->slots[i];
+        if (entry->path != NULL)
+        {
+            const index_record record = {entry->size, entry->mtime_ns, entry->ino, entry->content_hash,
+                                         strlen(entry->path)};
+            fwrite(&record, sizeof(record), 1, out);
+            fwrite(entry->path, 1, record.path_len, out);
+        }
+    }
+    // Whatever failed while writing shows up on the flush, or the stream error flag
+    bool saved = fflush(out) == 0 && !ferror(out);
+    int error = errno;
+    if (fclose(out) != 0 && saved)
+    {
+        saved = false;
+        error = errno;
+    }
+    if (saved && rename(aside, file) == -1)
+    {
+        saved = false;
+        error = errno;
+    }
+    if (!saved)
+    {
+        unlink(aside);
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+void config_index_begin_scan(config_index* index)
+{
+    index->scan++;
+}
+
+int config_index_refresh(config_index* index, const char* path, enum config_change* change)
+{
+    struct stat st;
+    if (stat(path, &st) == -1)
+    {
+        return -1;
+    }
+    if (!S_ISREG(st.st_mode))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    const uint64_t hash = hash_path(path);
+    config_entry* entry = find_slot(index->slots, index->n_slots, path, hash);
+    if (entry->path != NULL && entry->size == (uint64_t)st.st_size && entry->mtime_ns == mtime_ns(&st) &&
+        entry->ino == st.st_ino)
+    {
+        entry->scan = index->scan;
+        *change = CONFIG_UNCHANGED;
+        return 0;
+    }
+    // The metadata hashed along with the content is the one taken after opening the file
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    uint64_t content_hash;
+    struct timespec hashed_at;
+    const bool hashed = fstat(fd, &st) == 0 && hash_content(fd, &content_hash) == 0;
+    const int error = errno;
+    clock_gettime(CLOCK_REALTIME, &hashed_at);
+    close(fd);
+    if (!hashed)
+    {
+        errno = error;
+        return -1;
+    }
+    bool added;
+    entry = find_or_add(index, path, hash, &added);
+    if (entry == NULL)
+    {
+        return -1;
+    }
+    *change = added ? CONFIG_ADDED : entry->content_hash != content_hash ? CONFIG_CHANGED : CONFIG_UNCHANGED;
+    const int64_t hashed_ns = (int64_t)hashed_at.tv_sec * 1000000000LL + hashed_at.tv_nsec;
+    entry->size = (uint64_t)st.st_size;
+    entry->mtime_ns = hashed_ns - mtime_ns(&st) < CONFIG_INDEX_RACY_NS ? RACY_MTIME_NS : mtime_ns(&st);
+    entry->ino = st.st_ino;
+    entry->content_hash = content_hash;
+    entry->scan = index->scan;
+    return 0;
+}
+
+bool config_index_remove(config_index* index, const char* path)
+{
+    config_entry* entry = find_slot(index->slots, index->n_slots, path, hash_path(path));
+    if (entry->path == NULL)
+    {
+        return false;
+    }
+    remove_entry(index, entry);
+    return true;
+}
+
+size_t config_index_sweep(config_index* index, const char* under, void (*removed)(const char* path, void* ctx),
+                          void* ctx)
+{
+    const size_t under_len = under != NULL ? strlen(under) : 0;
+    size_t n_removed = 0;
+    for (size_t i = 0; i < index->n_slots; i++)
+    {
+        // Removing re-places the rest of the cluster, maybe onto this same slot: it gets checked again
+        config_entry* entry = &index->slots[i];
+        while (entry->path != NULL && entry->scan != index->scan &&
+               (under == NULL || (strncmp(entry->path, under, under_len) == 0 &&
+                                  (entry->path[under_len] == '/' || entry->path[under_len] == '\0' ||
+                                   (under_len > 0 && under[under_len - 1] == '/')))))
+        {
+            if (removed != NULL)
+            {
+                removed(entry->path, ctx);
+            }
+            remove_entry(index, entry);
+            n_removed++;
+        }
+    }
+    return n_removed;
+}
+
+size_t config_index_size(const config_index* index)
+{
+    return index->n_used;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file dashboard_utils.c
+ * @brief Live terminal dashboard definition.
+ */
+
+#include "dashboard_utils.h"
+#include <stdarg.h>
+
+/**
+ * @brief Appends formatted text to a frame; what doesn't fit on DASHBOARD_FRAME_SIZE bytes gets dropped.
+ * @param frame The frame.
+ * @param len Bytes already on the frame; updated.
+ * @param format printf() format.
+ */
+static void append(char* frame, size_t* len, const char* format, ...)
+{
+    if (*len >= DASHBOARD_FRAME_SIZE - 1)
+    {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    const int written = vsnprintf(frame + *len, DASHBOARD_FRAME_SIZE - *len, format, args);
+    va_end(args);
+    if (written > 0)
+    {
+        *len += (size_t)written < DASHBOARD_FRAME_SIZE - *len ? (size_t)written : DASHBOARD_FRAME_SIZE - 1 - *len;
+    }
+}
+
+void dashboard_init(dashboard* d, const char* title, const char* const* labels, size_t n_rows)
+{
+    d->title = title;
+    d->labels = labels;
+    d->n_rows = n_rows < DASHBOARD_MAX_ROWS ? n_rows : DASHBOARD_MAX_ROWS;
+    size_t longest = 0;
+    for (size_t i = 0; i < d->n_rows; i++)
+    {
+        const size_t label_len = strlen(labels[i]);
+        longest = label_len > longest ? label_len : longest;
+    }
+    // "label: value"
+    d->value_column = (int)longest + 3;
+    d->drawn = false;
+}
+
+size_t dashboard_render(dashboard* d, const char* const* values, char* frame)
+{
+    size_t len = 0;
+    if (!d->drawn)
+    {
+        // Cursor hidden, screen cleared, then the parts that never change
+        append(frame, &len, "\033[?25l\033[H\033[J%s\n", d->title);
+        for (size_t i = 0; d->title[i] != '\0'; i++)
+        {
+            append(frame, &len, "-");
+        }
+        for (size_t i = 0; i < d->n_rows; i++)
+        {
+            append(frame, &len, "\n%s:", d->labels[i]);
+            d->shown[i][0] = '\0';
+        }
+    }
+    for (size_t i = 0; i < d->n_rows; i++)
+    {
+        if (d->drawn && strncmp(d->shown[i], values[i], DASHBOARD_VALUE_SIZE - 1) == 0)
+        {
+            continue;
+        }
+        snprintf(d->shown[i], DASHBOARD_VALUE_SIZE, "%s", values[i]);
+        // Straight to where the value goes, and whatever the previous (maybe longer) value left gets erased
+        append(frame, &len, "\033[%zu;%dH%s\033[K", DASHBOARD_TITLE_ROWS + i + 1, d->value_column, d->shown[i]);
+    }
+    d->drawn = true;
+    return len;
+}
+
+size_t dashboard_leave(const dashboard* d, char* frame)
+{
+    size_t len = 0;
+    append(frame, &len, "\033[%zu;1H\033[?25h", DASHBOARD_TITLE_ROWS + d->n_rows + 1);
+    return len;
+}
@@ -0,0 +1,199 @@
+/**
+ * @file event_utils.c
+ * @brief Event loop definition.
+ */
+
+#include "event_utils.h"
+
+//! \brief What to do when a watched file descriptor is ready.
+typedef struct event_source
+{
+    //! \brief Handler, or NULL if the file descriptor isn't watched.
+    event_handler handler;
+    //! \brief Passed as is to the handler.
+    void* ctx;
+    //! \brief Changes each time the file descriptor starts being watched, so a report about a file descriptor that
+    //! got closed (and reused) meanwhile can be told apart.
+    uint32_t generation;
+} event_source;
+
+//! \brief The event loop itself.
+static struct
+{
+    //! \brief epoll instance, or -1 if it wasn't created yet.
+    int epoll_fd;
+    //! \brief Process that created the epoll instance; a forked copy shares it, so it must not use it.
+    pid_t owner;
+    //! \brief Watched file descriptors, indexed by the file descriptor itself.
+    event_source* sources;
+    //! \brief Room on sources.
+    size_t capacity;
+    //! \brief Amount of watched file descriptors.
+    size_t n_watched;
+    //! \brief Last generation handed out.
+    uint32_t generation;
+} loop = {.epoll_fd = -1};
+
+/**
+ * @brief Creates the epoll instance, or a new one if the current one was inherited from the parent process.
+ * @return true if the loop is ready to be used, false otherwise (errno is set).
+ */
+static bool ensure_loop(void)
+{
+    if (loop.epoll_fd != -1 && loop.owner == getpid())
+    {
+        return true;
+    }
+    if (loop.epoll_fd != -1)
+    {
+        // Inherited: whatever the parent watches isn't this process business
+        close(loop.epoll_fd);
+        memset(loop.sources, 0, loop.capacity * sizeof(event_source));
+        loop.n_watched = 0;
+    }
+    loop.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop.owner = getpid();
+    return loop.epoll_fd != -1;
+}
+
+int event_watch(int fd, uint32_t events, event_handler handler, void* ctx)
+{
+    if (fd < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    if (!ensure_loop())
+    {
+        return -1;
+    }
+    if ((size_t)fd >= loop.capacity)
+    {
+        size_t capacity = loop.capacity == 0 ? EVENT_INITIAL_SOURCES : loop.capacity;
+        while (capacity <= (size_t)fd)
+        {
+            capacity *= 2;
+        }
+        event_source* sources = realloc(loop.sources, capacity * sizeof(event_source));
+        if (sources == NULL)
+        {
+            return -1;
+        }
+        memset(sources + loop.capacity, 0, (capacity - loop.capacity) * sizeof(event_source));
+        loop.sources = sources;
+        loop.capacity = capacity;
+    }
+    event_source* source = &loop.sources[fd];
+    const bool watched = source->handler != NULL;
+    const uint32_t generation = watched ? source->generation : ++loop.generation;
+    struct epoll_event event = {.events = events, .data.u64 = ((uint64_t)generation << 32) | (uint32_t)fd};
+    if (epoll_ctl(loop.epoll_fd, watched ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) == -1)
+    {
+        return -1;
+    }
+    *source = (event_source){handler, ctx, generation};
+    if (!watched)
+    {
+        loop.n_watched++;
+    }
+    return 0;
+}
+
+void event_unwatch(int fd)
+{
+    if (fd < 0 || (size_t)fd >= loop.capacity || loop.sources[fd].handler == NULL || !ensure_loop())
+    {
+        return;
+    }
+    epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    loop.sources[fd].handler = NULL;
+    loop.n_watched--;
+}
+
+void event_close(int fd)
+{
+    event_unwatch(fd);
+    close(fd);
+}
+
+int event_dispatch(int timeout_ms)
+{
+    if (!ensure_loop())
+    {
+        return -1;
+    }
+    if (loop.n_watched == 0)
+    {
+        return 0;
+    }
+    struct epoll_event ready[EVENT_MAX_READY];
+    const int n_ready = epoll_wait(loop.epoll_fd, ready, EVENT_MAX_READY, timeout_ms);
+    if (n_ready == -1)
+    {
+        return errno == EINTR ? 0 : -1;
+    }
+    int n_handled = 0;
+    for (int i = 0; i < n_ready; i++)
+    {
+        const int fd = (int)(uint32_t)ready[i].data.u64;
+        const uint32_t generation = (uint32_t)(ready[i].data.u64 >> 32);
+        // A previous handler may have stopped watching it (or closed it, and watched a new one on the same number)
+        if ((size_t)fd >= loop.capacity || loop.sources[fd].handler == NULL ||
+            loop.sources[fd].generation != generation)
+        {
+            continue;
+        }
+        const event_source source = loop.sources[fd];
+        source.handler(fd, ready[i].events, source.ctx);
+        n_handled++;
+    }
+    return n_handled;
+}
+
+int event_timerfd(unsigned interval_ms)
+{
+    const int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    const struct timespec interval = {interval_ms / EVENT_MSECS_PER_SEC,
+                                      (long)(interval_ms % EVENT_MSECS_PER_SEC) * EVENT_NSECS_PER_MSEC};
+    const struct itimerspec schedule = {interval, interval};
+    if (timerfd_settime(fd, 0, &schedule, NULL) == -1)
+    {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+int event_timer(unsigned interval_ms, event_handler handler, void* ctx)
+{
+    const int fd = event_timerfd(interval_ms);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    if (event_watch(fd, EPOLLIN, handler, ctx) == -1)
+    {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+int event_pidfd(pid_t pid)
+{
+    // pidfd_open() has no libc wrapper on every supported system; the file descriptor is always close-on-exec
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+}
+
+int event_pidfd_signal(int pidfd, int sig)
+{
+    return (int)syscall(SYS_pidfd_send_signal, pidfd, sig, NULL, 0);
+}
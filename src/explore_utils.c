@@ -0,0 +1,1126 @@
+/**
+ * @file explore_utils.c
+ * @brief Parallel directory tree traversal definition.
+ */
+
+// statx()
+#define _GNU_SOURCE
+#include "explore_utils.h"
+
+typedef struct explore_node explore_node;
+
+//! \brief A glob of an ignore file, or of the excludes.
+typedef struct explore_rule
+{
+    //! \brief The glob, without the leading '!', nor the leading and trailing '/'.
+    const char* glob;
+    //! \brief Whether it takes back in what it matches, instead of leaving it out.
+    bool negated;
+    //! \brief Whether it matches only dirs.
+    bool dir_only;
+    //! \brief Whether it matches the path relative to its dir, instead of the base name.
+    bool anchored;
+    //! \brief Whether it has "**", that matches across dirs.
+    bool deep;
+} explore_rule;
+
+//! \brief The globs of an ignore file (or the excludes), on top of the ones of the dirs above it.
+typedef struct explore_rules explore_rules;
+struct explore_rules
+{
+    //! \brief Globs of the closest dir above with an ignore file, or NULL.
+    explore_rules* parent;
+    //! \brief Length of the path of the dir they apply to.
+    size_t dir_len;
+    //! \brief Text the globs point into.
+    char* text;
+    //! \brief The globs, in the order written.
+    explore_rule* rules;
+    //! \brief Amount of globs.
+    size_t n_rules;
+};
+
+//! \brief Kind of entry found inside a directory.
+enum explore_item_kind
+{
+    //! \brief A directory, listed on its own.
+    ITEM_DIR,
+    //! \brief A regular file that was wanted.
+    ITEM_FILE
+};
+
+//! \brief An entry found inside a directory, in the order it was listed.
+typedef struct explore_item
+{
+    //! \brief Kind of entry.
+    enum explore_item_kind kind;
+    //! \brief Path of the file (ITEM_FILE only).
+    char* path;
+    //! \brief What the visitor found inspecting the file (ITEM_FILE only), or NULL.
+    void* found;
+    //! \brief The directory (ITEM_DIR only).
+    explore_node* child;
+} explore_item;
+
+//! \brief A directory of the tree: from the moment it's found, until it's reported.
+struct explore_node
+{
+    //! \brief Directory it's inside of, or NULL for the root.
+    explore_node* parent;
+    //! \brief Its path.
+    char* path;
+    //! \brief Where its base name starts on path; it gets opened by it, relative to its parent.
+    size_t name_offset;
+    //! \brief The directory open, while it's being listed or any directory inside of it still has to be opened.
+    DIR* dir;
+    //! \brief Holders of dir: the thread listing it, plus each directory inside of it not opened yet.
+    atomic_uint refs;
+    //! \brief 0, or the errno value telling why it couldn't be opened.
+    int error;
+    //! \brief Entries found inside of it.
+    explore_item* items;
+    //! \brief Amount of items.
+    size_t n_items;
+    //! \brief Room for items.
+    size_t capacity;
+    //! \brief Whether it was listed already, so it can be reported.
+    atomic_bool done;
+    //! \brief Whether it was left unlisted, as the traversal was stopped before; it isn't reported.
+    bool canceled;
+    //! \brief Levels below the base of the filter.
+    unsigned depth;
+    //! \brief Globs that apply to its entries: the ones of its ignore file, or of the closest dir above with one.
+    explore_rules* rules;
+    //! \brief Whether rules are the ones of its ignore file, freed along with it.
+    bool own_rules;
+    //! \brief Device it's on, once it's opened.
+    dev_t dev;
+    //! \brief Its inode, once it's opened; 0 if it's unknown.
+    ino_t ino;
+};
+
+//! \brief Directories pending to be listed by a thread. The thread itself takes the newest one (depth-first, so the
+//! fds open stay few), the ones with nothing to do steal the oldest one (the biggest subtrees, likely).
+typedef struct explore_deque
+{
+    //! \brief Guards the deque; contended only when stealing.
+    pthread_mutex_t lock;
+    //! \brief The directories, as a ring indexed modulo capacity.
+    explore_node** slots;
+    //! \brief Room for directories; a power of 2.
+    size_t capacity;
+    //! \brief Index of the oldest one, the next to be stolen.
+    size_t top;
+    //! \brief Index after the newest one.
+    size_t bottom;
+} explore_deque;
+
+//! \brief State shared by every thread of a traversal.
+typedef struct explore_pool
+{
+    //! \brief What to look for, and what to do with it.
+    const explore_visitor* visitor;
+    //! \brief What to leave out, or NULL.
+    const explore_filter* filter;
+    //! \brief Levels of dirs below the base that get explored, at most.
+    unsigned max_depth;
+    //! \brief Globs of the excludes of the filter, or NULL.
+    explore_rules* excludes;
+    //! \brief Device the base of the filter is on.
+    dev_t base_dev;
+    //! \brief Pending directories of each thread.
+    explore_deque deques[EXPLORE_MAX_WORKERS];
+    //! \brief Amount of threads (and deques in use).
+    unsigned n_workers;
+    //! \brief Directories found and not listed yet; the traversal is over once it's 0.
+    atomic_size_t pending;
+    //! \brief Directories on the deques.
+    atomic_size_t queued;
+    //! \brief Threads sleeping until there's a directory to take.
+    atomic_uint sleeping;
+    //! \brief Whether the calling thread is sleeping until a directory is listed.
+    atomic_bool reporter_waiting;
+    //! \brief Whether some entry was left out, as there was no memory left for it.
+    atomic_bool failed;
+    //! \brief Whether the visitor told to stop; the dirs not listed yet aren't anymore.
+    atomic_bool stopped;
+    //! \brief Guards the sleeps.
+    pthread_mutex_t lock;
+    //! \brief Signaled when there's a directory to take, or the traversal is over.
+    pthread_cond_t wake;
+    //! \brief Signaled when a directory is listed.
+    pthread_cond_t progress;
+} explore_pool;
+
+//! \brief What a thread of the pool needs to know.
+typedef struct explore_worker
+{
+    //! \brief The pool.
+    explore_pool* pool;
+    //! \brief Its index, and the one of its deque.
+    unsigned index;
+} explore_worker;
+
+/**
+ * @brief Releases the globs of an ignore file (or of the excludes), not the ones above them.
+ * @param rules The globs, or NULL.
+ */
+static void free_rules(explore_rules* rules)
+{
+    if (rules != NULL)
+    {
+        free(rules->text);
+        free(rules->rules);
+        free(rules);
+    }
+}
+
+/**
+ * @brief Parses globs, one per line, as written on a .gitignore: blank lines and the ones starting with '#' are left
+ * out, as trailing blanks are; a leading '\\' escapes a '#' or '!'.
+ * @param text The lines; it's taken over, and the globs point into it.
+ * @param dir_len Length of the path of the dir they apply to.
+ * @param parent Globs of the closest dir above, or NULL.
+ * @return The globs, or NULL if there's none (errno is 0) or no memory left (errno is ENOMEM).
+ */
+static explore_rules* compile_rules(char* text, size_t dir_len, explore_rules* parent)
+{
+    size_t n_lines = 1;
+    for (const char* c = text; *c != '\0'; c++)
+    {
+        n_lines += *c == '\n';
+    }
+    explore_rules* rules = malloc(sizeof(*rules));
+    explore_rule* parsed = malloc(n_lines * sizeof(*parsed));
+    if (rules == NULL || parsed == NULL)
+    {
+        free(rules);
+        free(parsed);
+        free(text);
+        errno = ENOMEM;
+        return NULL;
+    }
+    *rules = (explore_rules){parent, dir_len, text, parsed, 0};
+    for (char* line = text; line != NULL;)
+    {
+        char* next = strchr(line, '\n');
+        if (next != NULL)
+        {
+            *next++ = '\0';
+        }
+        size_t len = strlen(line);
+        // Trailing blanks (and the '\r' of CRLF line ends) don't count
+        while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t' || line[len - 1] == '\r'))
+        {
+            line[--len] = '\0';
+        }
+        explore_rule rule = {0};
+        if (len > 0 && line[0] == '!')
+        {
+            rule.negated = true;
+            line++;
+            len--;
+        }
+        else if (len > 0 && line[0] == '\\')
+        {
+            line++;
+            len--;
+        }
+        else if (len > 0 && line[0] == '#')
+        {
+            len = 0;
+        }
+        if (len > 1 && line[len - 1] == '/')
+        {
+            rule.dir_only = true;
+            line[--len] = '\0';
+        }
+        rule.anchored = strchr(line, '/') != NULL;
+        if (line[0] == '/')
+        {
+            line++;
+            len--;
+        }
+        rule.deep = strstr(line, "**") != NULL;
+        rule.glob = line;
+        if (len > 0)
+        {
+            parsed[rules->n_rules++] = rule;
+        }
+        line = next;
+    }
+    if (rules->n_rules == 0)
+    {
+        free_rules(rules);
+        errno = 0;
+        return NULL;
+    }
+    return rules;
+}
+
+/**
+ * @brief Reads the ignore file of a dir.
+ * @param dir_fd The dir, or AT_FDCWD.
+ * @param file Path to the ignore file, relative to dir_fd.
+ * @param dir_len Length of the path of the dir.
+ * @param parent Globs of the closest dir above, or NULL.
+ * @return Its globs, or NULL if there's none, or it couldn't be read (errno is 0) or no memory left (errno is ENOMEM).
+ */
+static explore_rules* read_rules(int dir_fd, const char* file, size_t dir_len, explore_rules* parent)
+{
+    const int fd = openat(dir_fd, file, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+    {
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        errno = 0;
+        return NULL;
+    }
+    const size_t size = st.st_size < EXPLORE_MAX_IGNORE_FILE ? (size_t)st.st_size : EXPLORE_MAX_IGNORE_FILE;
+    char* text = malloc(size + 1);
+    size_t len = 0;
+    while (text != NULL && len < size)
+    {
+        const ssize_t n = read(fd, text + len, size - len);
+        if (n <= 0 && !(n == -1 && errno == EINTR))
+        {
+            break;
+        }
+        len += n > 0 ? (size_t)n : 0;
+    }
+    close(fd);
+    if (text == NULL)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    text[len] = '\0';
+    return compile_rules(text, dir_len, parent);
+}
+
+/**
+ * @brief Reads the ignore files of the dirs along a path, from the base down to one of them, each on top of the former.
+ * @param filter The filter, with an ignore file.
+ * @param path The path, starting with the base.
+ * @param base_len Length of the base on path.
+ * @param dir_len Length of the deepest dir on path whose ignore file gets read.
+ * @return The globs of the deepest dir with an ignore file (free them with free_rules_chain()), or NULL if there's none
+ * (errno is 0) or no memory left (errno is ENOMEM).
+ */
+static explore_rules* read_rules_along(const explore_filter* filter, const char* path, size_t base_len, size_t dir_len)
+{
+    const size_t file_len = strlen(filter->ignore_file);
+    char* file = malloc(dir_len + 1 + file_len + 1);
+    if (file == NULL)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    explore_rules* rules = NULL;
+    errno = 0;
+    for (size_t len = base_len; len <= dir_len && errno == 0; len++)
+    {
+        // Each dir, at the end of the base and at every '/' after it (repeated ones count once)
+        if (len != base_len && (path[len] != '/' || path[len - 1] == '/'))
+        {
+            continue;
+        }
+        memcpy(file, path, len);
+        file[len] = '/';
+        memcpy(file + len + 1, filter->ignore_file, file_len + 1);
+        explore_rules* dir_rules = read_rules(AT_FDCWD, file, len, rules);
+        rules = dir_rules != NULL ? dir_rules : rules;
+    }
+    const int error = errno;
+    free(file);
+    errno = error;
+    return rules;
+}
+
+/**
+ * @brief Releases the globs of an ignore file, and the ones above them.
+ * @param rules The globs, or NULL.
+ */
+static void free_rules_chain(explore_rules* rules)
+{
+    while (rules != NULL)
+    {
+        explore_rules* parent = rules->parent;
+        free_rules(rules);
+        rules = parent;
+    }
+}
+
+/**
+ * @brief Parses the excludes of a filter.
+ * @param filter The filter.
+ * @param base_len Length of its base.
+ * @return Their globs, or NULL if there's none (errno is 0) or no memory left (errno is ENOMEM).
+ */
+static explore_rules* compile_excludes(const explore_filter* filter, size_t base_len)
+{
+    size_t len = 0;
+    for (size_t i = 0; i < filter->n_excludes; i++)
+    {
+        len += strlen(filter->excludes[i]) + 1;
+    }
+    char* text = malloc(len + 1);
+    if (text == NULL)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    // One per line, as on an ignore file
+    text[0] = '\0';
+    for (size_t i = 0, at = 0; i < filter->n_excludes; i++)
+    {
+        const size_t exclude_len = strlen(filter->excludes[i]);
+        memcpy(text + at, filter->excludes[i], exclude_len);
+        at += exclude_len;
+        text[at++] = '\n';
+        text[at] = '\0';
+    }
+    return compile_rules(text, base_len, NULL);
+}
+
+/**
+ * @brief Tells if some globs leave an entry out. The last glob of the deepest dir that matches it decides.
+ * @param rules The globs, or NULL.
+ * @param path Path to the entry.
+ * @param name Its base name.
+ * @param is_dir Whether it's a dir.
+ * @return true if it's left out.
+ */
+static bool rules_leave_out(const explore_rules* rules, const char* path, const char* name, bool is_dir)
+{
+    for (; rules != NULL; rules = rules->parent)
+    {
+        const char* relative = path + rules->dir_len;
+        while (*relative == '/')
+        {
+            relative++;
+        }
+        for (size_t i = rules->n_rules; i > 0; i--)
+        {
+            const explore_rule* rule = &rules->rules[i - 1];
+            bool matches;
+            if (rule->dir_only && !is_dir)
+            {
+                matches = false;
+            }
+            else if (!rule->anchored)
+            {
+                matches = fnmatch(rule->glob, name, 0) == 0;
+            }
+            else if (!rule->deep)
+            {
+                matches = fnmatch(rule->glob, relative, FNM_PATHNAME) == 0;
+            }
+            else
+            {
+                // '*' gets to match '/' too; a leading "**/" matches no dir as well
+                matches = fnmatch(rule->glob, relative, 0) == 0 ||
+                          (strncmp(rule->glob, "**/", 3) == 0 && fnmatch(rule->glob + 3, relative, 0) == 0);
+            }
+            if (matches)
+            {
+                return !rule->negated;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Tells the length of the base of a filter on the paths, without trailing '/'.
+ * @param base The base.
+ * @return Its length.
+ */
+static size_t base_length(const char* base)
+{
+    size_t len = strlen(base);
+    while (len > 1 && base[len - 1] == '/')
+    {
+        len--;
+    }
+    return len;
+}
+
+/**
+ * @brief Tells the length of the dir a path is inside of, on it.
+ * @param path The path.
+ * @param len Its length.
+ * @return The length of its dir.
+ */
+static size_t dir_length(const char* path, size_t len)
+{
+    while (len > 1 && path[len - 1] == '/')
+    {
+        len--;
+    }
+    while (len > 0 && path[len - 1] != '/')
+    {
+        len--;
+    }
+    while (len > 1 && path[len - 1] == '/')
+    {
+        len--;
+    }
+    return len;
+}
+
+/**
+ * @brief Tells how many levels below the base of a filter a path is.
+ * @param path The path, starting with the base.
+ * @param base_len Length of the base on path.
+ * @return The levels.
+ */
+static unsigned depth_below(const char* path, size_t base_len)
+{
+    unsigned depth = 0;
+    for (const char* c = path + base_len; *c != '\0'; c++)
+    {
+        depth += c[0] == '/' && c[1] != '/' && c[1] != '\0';
+    }
+    return depth;
+}
+
+/**
+ * @brief Creates a directory of the tree.
+ * @param parent Directory it's inside of, or NULL for the root.
+ * @param name Its base name, or its path for the root.
+ * @return The directory, or NULL if there's no memory left.
+ */
+static explore_node* create_node(explore_node* parent, const char* name)
+{
+    explore_node* node = calloc(1, sizeof(*node));
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    const size_t parent_len = parent != NULL ? strlen(parent->path) + 1 : 0;
+    const size_t name_len = strlen(name);
+    node->path = malloc(parent_len + name_len + 1);
+    if (node->path == NULL)
+    {
+        free(node);
+        return NULL;
+    }
+    if (parent != NULL)
+    {
+        memcpy(node->path, parent->path, parent_len - 1);
+        node->path[parent_len - 1] = '/';
+    }
+    memcpy(node->path + parent_len, name, name_len + 1);
+    node->parent = parent;
+    node->name_offset = parent_len;
+    if (parent != NULL)
+    {
+        node->depth = parent->depth + 1;
+        node->rules = parent->rules;
+    }
+    atomic_init(&node->refs, 1);
+    atomic_init(&node->done, false);
+    return node;
+}
+
+/**
+ * @brief Adds an entry to the ones found inside a directory.
+ * @param node The directory.
+ * @param item The entry.
+ * @return true on success, false if there's no memory left.
+ */
+static bool add_item(explore_node* node, const explore_item* item)
+{
+    if (node->n_items == node->capacity)
+    {
+        const size_t capacity = node->capacity == 0 ? EXPLORE_NODE_ITEMS : node->capacity * 2;
+        explore_item* items = realloc(node->items, capacity * sizeof(*items));
+        if (items == NULL)
+        {
+            return false;
+        }
+        node->items = items;
+        node->capacity = capacity;
+    }
+    node->items[node->n_items++] = *item;
+    return true;
+}
+
+/**
+ * @brief Lets go of the open directory; the last holder closes it.
+ * @param node The directory.
+ */
+static void release_dir(explore_node* node)
+{
+    if (atomic_fetch_sub(&node->refs, 1) == 1)
+    {
+        closedir(node->dir);
+        node->dir = NULL;
+    }
+}
+
+/**
+ * @brief Adds a directory to a deque, as the newest one.
+ * @param deque The deque.
+ * @param node The directory.
+ * @return true on success, false if there's no memory left to grow the deque.
+ */
+static bool deque_push(explore_deque* deque, explore_node* node)
+{
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom - deque->top == deque->capacity)
+    {
+        const size_t capacity = deque->capacity == 0 ? EXPLORE_DEQUE_SLOTS : deque->capacity * 2;
+        explore_node** slots = malloc(capacity * sizeof(*slots));
+        if (slots == NULL)
+        {
+            pthread_mutex_unlock(&deque->lock);
+            return false;
+        }
+        for (size_t i = deque->top; i != deque->bottom; i++)
+        {
+            slots[i & (capacity - 1)] = deque->slots[i & (deque->capacity - 1)];
+        }
+        free(deque->slots);
+        deque->slots = slots;
+        deque->capacity = capacity;
+    }
+    deque->slots[deque->bottom++ & (deque->capacity - 1)] = node;
+    pthread_mutex_unlock(&deque->lock);
+    return true;
+}
+
+/**
+ * @brief Takes a directory from a deque.
+ * @param deque The deque.
+ * @param newest Whether to take the newest one (its own thread), or the oldest one (stealing).
+ * @return The directory, or NULL if the deque is empty.
+ */
+static explore_node* deque_take(explore_deque* deque, bool newest)
+{
+    explore_node* node = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom != deque->top)
+    {
+        node = newest ? deque->slots[--deque->bottom & (deque->capacity - 1)]
+                      : deque->slots[deque->top++ & (deque->capacity - 1)];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return node;
+}
+
+/**
+ * @brief Takes the next directory to list: the newest one of the thread's own deque, otherwise the oldest one of any
+ * other deque.
+ * @param pool The pool.
+ * @param self Index of the thread.
+ * @return The directory, or NULL if every deque is empty.
+ */
+static explore_node* take_dir(explore_pool* pool, unsigned self)
+{
+    explore_node* node = deque_take(&pool->deques[self], true);
+    for (unsigned i = 1; node == NULL && i < pool->n_workers; i++)
+    {
+        node = deque_take(&pool->deques[(self + i) % pool->n_workers], false);
+    }
+    if (node != NULL)
+    {
+        atomic_fetch_sub(&pool->queued, 1);
+    }
+    return node;
+}
+
+/**
+ * @brief Marks a directory as listed, waking up whoever waits for it.
+ * @param pool The pool.
+ * @param node The directory.
+ */
+static void finish_dir(explore_pool* pool, explore_node* node)
+{
+    atomic_store(&node->done, true);
+    const bool over = atomic_fetch_sub(&pool->pending, 1) == 1;
+    if (over || atomic_load(&pool->reporter_waiting))
+    {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->progress);
+        if (over)
+        {
+            pthread_cond_broadcast(&pool->wake);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/**
+ * @brief Tells the type of an entry of a directory, as stat() would (symbolic links followed). The one readdir()
+ * gives is trusted; only when the file system doesn't give it, or it's a symbolic link, the entry gets inspected.
+ * @param dir_fd The directory.
+ * @param entry The entry.
+ * @param identify Whether a directory has to be inspected anyway, to tell its device.
+ * @param dev Where to leave the device it's on, if it was inspected.
+ * @param ino Where to leave its inode if it was inspected, 0 otherwise.
+ * @return Its type, as the S_IFMT bits of a mode; 0 if it couldn't be inspected.
+ */
+static mode_t entry_type(int dir_fd, const struct dirent* entry, bool identify, dev_t* dev, ino_t* ino)
+{
+    *ino = 0;
+    switch (entry->d_type)
+    {
+    case DT_DIR:
+        if (!identify)
+        {
+            return S_IFDIR;
+        }
+        // fall through
+    case DT_UNKNOWN:
+    case DT_LNK:
+    {
+        struct statx statx_buffer;
+        if (statx(dir_fd, entry->d_name, AT_STATX_SYNC_AS_STAT, STATX_TYPE | STATX_INO, &statx_buffer) == -1 ||
+            !(statx_buffer.stx_mask & STATX_TYPE))
+        {
+            return 0;
+        }
+        if (statx_buffer.stx_mask & STATX_INO)
+        {
+            *dev = makedev(statx_buffer.stx_dev_major, statx_buffer.stx_dev_minor);
+            *ino = statx_buffer.stx_ino;
+        }
+        return statx_buffer.stx_mode & S_IFMT;
+    }
+    case DT_REG:
+        return S_IFREG;
+    default:
+        // Devices, pipes and sockets aren't looked for
+        return 0;
+    }
+}
+
+/**
+ * @brief Tells if a directory is the same as another one it's inside of, or that one itself.
+ * @param node The directory it's inside of.
+ * @param dev Device it's on.
+ * @param ino Its inode.
+ * @return true if it is.
+ */
+static bool is_ancestor(const explore_node* node, dev_t dev, ino_t ino)
+{
+    for (; node != NULL; node = node->parent)
+    {
+        if (node->ino == ino && node->dev == dev)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Tells if the filter of the pool leaves out an entry of a directory.
+ * @param pool The pool.
+ * @param node The directory.
+ * @param path Path to the entry.
+ * @param name Its base name.
+ * @param is_dir Whether it's a directory.
+ * @return true if it's left out.
+ */
+static bool left_out(const explore_pool* pool, const explore_node* node, const char* path, const char* name,
+                     bool is_dir)
+{
+    return rules_leave_out(pool->excludes, path, name, is_dir) || rules_leave_out(node->rules, path, name, is_dir);
+}
+
+/**
+ * @brief Lists a directory: opens it relative to its parent, and goes through its entries, inspecting each one
+ * relative to it only when their type isn't known already. The directories found are handed to the pool, unless the
+ * filter leaves them out, or they're the same as one they're inside of (reported as ELOOP, unopened).
+ * @param pool The pool.
+ * @param self Index of the thread.
+ * @param node The directory.
+ */
+static void list_dir(explore_pool* pool, unsigned self, explore_node* node)
+{
+    if (atomic_load(&pool->stopped))
+    {
+        // Nobody wants what's inside of it anymore
+        node->canceled = true;
+        if (node->parent != NULL)
+        {
+            release_dir(node->parent);
+        }
+        finish_dir(pool, node);
+        return;
+    }
+    const int parent_fd = node->parent != NULL ? dirfd(node->parent->dir) : AT_FDCWD;
+    const int fd = openat(parent_fd, node->path + node->name_offset, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    node->error = fd == -1 ? errno : 0;
+    if (node->parent != NULL)
+    {
+        release_dir(node->parent);
+    }
+    node->dir = fd != -1 ? fdopendir(fd) : NULL;
+    if (fd != -1 && node->dir == NULL)
+    {
+        node->error = errno;
+        close(fd);
+    }
+    if (node->dir == NULL)
+    {
+        finish_dir(pool, node);
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0)
+    {
+        node->dev = st.st_dev;
+        node->ino = st.st_ino;
+    }
+    const explore_filter* filter = pool->filter;
+    if (filter != NULL && filter->ignore_file != NULL)
+    {
+        explore_rules* rules = read_rules(fd, filter->ignore_file, strlen(node->path), node->rules);
+        if (rules != NULL)
+        {
+            node->rules = rules;
+            node->own_rules = true;
+        }
+        else if (errno == ENOMEM)
+        {
+            atomic_store(&pool->failed, true);
+        }
+    }
+    const bool identify = filter != NULL && filter->one_file_system;
+    const explore_visitor* visitor = pool->visitor;
+    for (struct dirent* entry; !atomic_load(&pool->stopped) && (entry = readdir(node->dir)) != NULL;)
+    {
+        // Skip "." and ".."
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+        dev_t dev = 0;
+        ino_t ino;
+        const mode_t type = entry_type(fd, entry, identify, &dev, &ino);
+        explore_item item = {0};
+        if (S_ISDIR(type))
+        {
+            // Left out before it's opened
+            if (node->depth >= pool->max_depth || (identify && ino != 0 && dev != pool->base_dev))
+            {
+                continue;
+            }
+            item.kind = ITEM_DIR;
+            item.child = create_node(node, entry->d_name);
+            if (item.child != NULL && left_out(pool, node, item.child->path, entry->d_name, true))
+            {
+                free(item.child->path);
+                free(item.child);
+                continue;
+            }
+            if (item.child == NULL || !add_item(node, &item))
+            {
+                free(item.child != NULL ? item.child->path : NULL);
+                free(item.child);
+                atomic_store(&pool->failed, true);
+                continue;
+            }
+            if (ino != 0 && is_ancestor(node, dev, ino))
+            {
+                // A loop (i.e.: a symbolic link to a dir it's inside of); it would never end
+                item.child->error = ELOOP;
+                atomic_store(&item.child->done, true);
+                continue;
+            }
+            atomic_fetch_add(&node->refs, 1);
+            atomic_fetch_add(&pool->pending, 1);
+            if (!deque_push(&pool->deques[self], item.child))
+            {
+                // No room to hand it over; this thread lists it right away
+                list_dir(pool, self, item.child);
+                continue;
+            }
+            atomic_fetch_add(&pool->queued, 1);
+            if (atomic_load(&pool->sleeping) > 0)
+            {
+                pthread_mutex_lock(&pool->lock);
+                pthread_cond_signal(&pool->wake);
+                pthread_mutex_unlock(&pool->lock);
+            }
+        }
+        else if (S_ISREG(type) && visitor->wanted(entry->d_name, visitor->ctx))
+        {
+            const size_t path_len = strlen(node->path);
+            const size_t name_len = strlen(entry->d_name);
+            item.kind = ITEM_FILE;
+            item.path = malloc(path_len + 1 + name_len + 1);
+            if (item.path == NULL)
+            {
+                atomic_store(&pool->failed, true);
+                continue;
+            }
+            memcpy(item.path, node->path, path_len);
+            item.path[path_len] = '/';
+            memcpy(item.path + path_len + 1, entry->d_name, name_len + 1);
+            if (left_out(pool, node, item.path, entry->d_name, false))
+            {
+                free(item.path);
+                continue;
+            }
+            if (!add_item(node, &item))
+            {
+                free(item.path);
+                atomic_store(&pool->failed, true);
+                continue;
+            }
+            if (visitor->inspect != NULL)
+            {
+                node->items[node->n_items - 1].found = visitor->inspect(fd, entry->d_name, visitor->ctx);
+            }
+        }
+    }
+    release_dir(node);
+    finish_dir(pool, node);
+}
+
+/**
+ * @brief Lists directories until every one of the tree is. Meant to be the routine of a thread of the pool.
+ * @param arg The explore_worker of the thread.
+ * @return NULL.
+ */
+static void* work(void* arg)
+{
+    const explore_worker* worker = arg;
+    explore_pool* pool = worker->pool;
+    while (atomic_load(&pool->pending) > 0)
+    {
+        explore_node* node = take_dir(pool, worker->index);
+        if (node != NULL)
+        {
+            list_dir(pool, worker->index, node);
+            continue;
+        }
+        // Nothing to take: sleep until there is, or the traversal is over
+        pthread_mutex_lock(&pool->lock);
+        atomic_fetch_add(&pool->sleeping, 1);
+        while (atomic_load(&pool->queued) == 0 && atomic_load(&pool->pending) > 0)
+        {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        atomic_fetch_sub(&pool->sleeping, 1);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Asks the visitor, after a report, if the traversal has to stop; once it does, it's remembered.
+ * @param pool The pool.
+ */
+static void check_stopped(explore_pool* pool)
+{
+    const explore_visitor* visitor = pool->visitor;
+    if (visitor->stopped != NULL && !atomic_load(&pool->stopped) && visitor->stopped(visitor->ctx))
+    {
+        atomic_store(&pool->stopped, true);
+    }
+}
+
+/**
+ * @brief Reports a directory and everything inside of it, in order, as soon as each directory is listed; then frees
+ * them.
+ * @param pool The pool.
+ * @param node The directory.
+ */
+static void report_dir(explore_pool* pool, explore_node* node)
+{
+    if (!atomic_load(&node->done))
+    {
+        atomic_store(&pool->reporter_waiting, true);
+        pthread_mutex_lock(&pool->lock);
+        while (!atomic_load(&node->done))
+        {
+            pthread_cond_wait(&pool->progress, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+        atomic_store(&pool->reporter_waiting, false);
+    }
+    const explore_visitor* visitor = pool->visitor;
+    if (!node->canceled)
+    {
+        visitor->on_dir(node->path, node->error, visitor->ctx);
+        check_stopped(pool);
+    }
+    for (size_t i = 0; i < node->n_items; i++)
+    {
+        if (node->items[i].kind == ITEM_DIR)
+        {
+            report_dir(pool, node->items[i].child);
+        }
+        else
+        {
+            visitor->on_file(node->items[i].path, node->items[i].found, visitor->ctx);
+            free(node->items[i].path);
+            check_stopped(pool);
+        }
+    }
+    if (node->own_rules)
+    {
+        free_rules(node->rules);
+    }
+    free(node->items);
+    free(node->path);
+    free(node);
+}
+
+int explore_tree(const char* root, unsigned n_workers, const explore_filter* filter, const explore_visitor* visitor)
+{
+    explore_node* root_node = create_node(NULL, root);
+    if (root_node == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    explore_pool pool = {.visitor = visitor, .filter = filter, .max_depth = EXPLORE_UNLIMITED_DEPTH,
+                         .n_workers = n_workers};
+    atomic_init(&pool.failed, false);
+    atomic_init(&pool.stopped, false);
+    explore_rules* root_rules = NULL;
+    if (filter != NULL)
+    {
+        // The base is the root, unless the root is under it
+        const char* base = filter->base != NULL ? filter->base : root;
+        size_t base_len = base_length(base);
+        if (strncmp(root, base, base_len) != 0 || (root[base_len] != '/' && root[base_len] != '\0'))
+        {
+            base = root;
+            base_len = base_length(root);
+        }
+        struct stat st;
+        pool.base_dev = stat(base, &st) == 0 ? st.st_dev : 0;
+        pool.max_depth = filter->max_depth;
+        root_node->depth = depth_below(root, base_len);
+        pool.excludes = compile_excludes(filter, base_len);
+        atomic_store(&pool.failed, pool.excludes == NULL && errno == ENOMEM);
+        if (filter->ignore_file != NULL && root_node->depth > 0)
+        {
+            // The ignore files of the dirs from the base down to the one the root is inside of apply too
+            root_rules = read_rules_along(filter, root, base_len, dir_length(root, strlen(root)));
+            root_node->rules = root_rules;
+            atomic_store(&pool.failed, atomic_load(&pool.failed) || (root_rules == NULL && errno == ENOMEM));
+        }
+    }
+    atomic_init(&pool.pending, 1);
+    atomic_init(&pool.queued, 0);
+    atomic_init(&pool.sleeping, 0);
+    atomic_init(&pool.reporter_waiting, false);
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.wake, NULL);
+    pthread_cond_init(&pool.progress, NULL);
+    for (unsigned i = 0; i < n_workers; i++)
+    {
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+    }
+    const bool root_queued = deque_push(&pool.deques[0], root_node);
+    if (root_queued)
+    {
+        atomic_fetch_add(&pool.queued, 1);
+    }
+    explore_worker workers[EXPLORE_MAX_WORKERS];
+    pthread_t threads[EXPLORE_MAX_WORKERS];
+    unsigned n_threads = 0;
+    for (unsigned i = 0; i < n_workers; i++)
+    {
+        workers[i] = (explore_worker){&pool, i};
+        n_threads += pthread_create(&threads[n_threads], NULL, work, &workers[i]) == 0;
+    }
+    if (!root_queued)
+    {
+        // The root couldn't even be queued; list it here
+        list_dir(&pool, 0, root_node);
+    }
+    if (n_threads == 0)
+    {
+        // No threads at all; this one lists the whole tree, and then reports it
+        work(&workers[0]);
+    }
+    report_dir(&pool, root_node);
+    for (unsigned i = 0; i < n_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    for (unsigned i = 0; i < n_workers; i++)
+    {
+        pthread_mutex_destroy(&pool.deques[i].lock);
+        free(pool.deques[i].slots);
+    }
+    pthread_cond_destroy(&pool.progress);
+    pthread_cond_destroy(&pool.wake);
+    pthread_mutex_destroy(&pool.lock);
+    free_rules(pool.excludes);
+    free_rules_chain(root_rules);
+    if (atomic_load(&pool.stopped))
+    {
+        errno = ECANCELED;
+        return -1;
+    }
+    if (atomic_load(&pool.failed))
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+bool explore_filter_admits(const explore_filter* filter, const char* path, bool is_dir)
+{
+    if (filter == NULL)
+    {
+        return true;
+    }
+    const char* base = filter->base != NULL ? filter->base : path;
+    const size_t base_len = base_length(base);
+    if (strncmp(path, base, base_len) != 0 || (path[base_len] != '/' && path[base_len] != '\0'))
+    {
+        return true;
+    }
+    // The base itself always is; any other entry, if the dir it's inside of is explored (and itself, if it's a dir)
+    const unsigned depth = depth_below(path, base_len);
+    if (depth == 0)
+    {
+        return true;
+    }
+    if (depth - !is_dir > filter->max_depth)
+    {
+        return false;
+    }
+    struct stat st;
+    struct stat base_st;
+    if (is_dir && filter->one_file_system && stat(path, &st) == 0 && stat(base, &base_st) == 0 &&
+        st.st_dev != base_st.st_dev)
+    {
+        return false;
+    }
+    const size_t path_len = strlen(path);
+    const size_t dir_len = dir_length(path, path_len);
+    const char* name = path + dir_len;
+    while (*name == '/')
+    {
+        name++;
+    }
+    explore_rules* excludes = compile_excludes(filter, base_len);
+    explore_rules* rules = filter->ignore_file != NULL ? read_rules_along(filter, path, base_len, dir_len) : NULL;
+    const bool admitted = !rules_leave_out(excludes, path, name, is_dir) && !rules_leave_out(rules, path, name, is_dir);
+    free_rules(excludes);
+    free_rules_chain(rules);
+    return admitted;
+}
+
+unsigned explore_default_workers(void)
+{
+    const long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return n_cpus < 1 ? 1 : n_cpus > EXPLORE_MAX_WORKERS ? EXPLORE_MAX_WORKERS : (unsigned)n_cpus;
+}
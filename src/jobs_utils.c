@@ -0,0 +1,518 @@
+/**
+ * @file jobs_utils.c
+ * @brief Job table definition.
+ */
+
+// strsignal()
+#define _GNU_SOURCE
+#include "jobs_utils.h"
+
+//! \brief Where a process of the table can be found.
+typedef struct pid_slot
+{
+    //! \brief Process id. 0 for an unused slot.
+    pid_t pid;
+    //! \brief Id of its job.
+    unsigned job_id;
+    //! \brief Index of the process among the members of its job.
+    size_t member;
+} pid_slot;
+
+//! \brief The job table itself.
+static struct
+{
+    //! \brief Jobs indexed by their id (index 0 is never used), so a lookup by id is an array access.
+    job** by_id;
+    //! \brief Room on by_id.
+    unsigned capacity;
+    //! \brief Greatest job id in use; the current job. 0 if the table is empty.
+    unsigned highest;
+    //! \brief Open addressing (linear probing) map from process id to its job, for reaping in O(1).
+    pid_slot* pids;
+    //! \brief Slots of pids. Power of 2.
+    size_t n_pid_slots;
+    //! \brief Slots of pids in use.
+    size_t n_pids;
+    //! \brief Readable when SIGCHLD is pending, or -1.
+    int signal_fd;
+    //! \brief Do jobs get their own process group?
+    bool job_control;
+    //! \brief Process group of the shell itself.
+    pid_t shell_pgid;
+} table = {.signal_fd = -1};
+
+/**
+ * @brief Spreads process ids over the map slots (Fibonacci hashing).
+ * @param pid Process id.
+ * @return Hash.
+ */
+static size_t hash_pid(pid_t pid)
+{
+    return (size_t)((uint32_t)pid * 2654435769u);
+}
+
+/**
+ * @brief Finds the slot of a process, or the one where it should be placed.
+ * @param slots Slots of the map.
+ * @param n_slots Amount of slots. Power of 2.
+ * @param pid Process id.
+ * @return The slot holding the process, or the unused slot that ends its probe sequence.
+ */
+static pid_slot* find_pid_slot(pid_slot* slots, size_t n_slots, pid_t pid)
+{
+    size_t i = hash_pid(pid) & (n_slots - 1);
+    while (slots[i].pid != 0 && slots[i].pid != pid)
+    {
+        i = (i + 1) & (n_slots - 1);
+    }
+    return &slots[i];
+}
+
+/**
+ * @brief Doubles the slots of the process id map (or creates it), re-placing every entry.
+ * @return true on success, false if there's no memory left.
+ */
+static bool grow_pid_slots(void)
+{
+    const size_t n_slots = table.n_pid_slots == 0 ? JOBS_PID_INITIAL_SLOTS : table.n_pid_slots * 2;
+    pid_slot* slots = calloc(n_slots, sizeof(pid_slot));
+    if (slots == NULL)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < table.n_pid_slots; i++)
+    {
+        if (table.pids[i].pid != 0)
+        {
+            *find_pid_slot(slots, n_slots, table.pids[i].pid) = table.pids[i];
+        }
+    }
+    free(table.pids);
+    table.pids = slots;
+    table.n_pid_slots = n_slots;
+    return true;
+}
+
+/**
+ * @brief Stops tracking a process.
+ * @param pid Process id.
+ */
+static void forget_pid(pid_t pid)
+{
+    if (table.n_pid_slots == 0)
+    {
+        return;
+    }
+    pid_slot* entry = find_pid_slot(table.pids, table.n_pid_slots, pid);
+    if (entry->pid == 0)
+    {
+        return;
+    }
+    entry->pid = 0;
+    table.n_pids--;
+    // Linear probing: the rest of the cluster gets re-placed, so no lookup stops at the hole just made
+    const size_t mask = table.n_pid_slots - 1;
+    for (size_t i = ((size_t)(entry - table.pids) + 1) & mask; table.pids[i].pid != 0; i = (i + 1) & mask)
+    {
+        pid_slot moved = table.pids[i];
+        table.pids[i].pid = 0;
+        *find_pid_slot(table.pids, table.n_pid_slots, moved.pid) = moved;
+    }
+}
+
+/**
+ * @brief Records a state change of a process, reported by waitpid().
+ * @param pid Process id.
+ * @param status Status reported.
+ */
+static void update_member(pid_t pid, int status)
+{
+    if (table.n_pid_slots == 0)
+    {
+        return;
+    }
+    const pid_slot* entry = find_pid_slot(table.pids, table.n_pid_slots, pid);
+    if (entry->pid == 0)
+    {
+        // Not a job process (i.e.: a worker of a parallel batch run)
+        return;
+    }
+    job* j = table.by_id[entry->job_id];
+    job_member* member = &j->members[entry->member];
+    if (WIFSTOPPED(status))
+    {
+        if (member->state == JOB_RUNNING)
+        {
+            member->state = JOB_STOPPED;
+            member->status = status;
+            j->n_running--;
+        }
+    }
+    else if (WIFCONTINUED(status))
+    {
+        if (member->state == JOB_STOPPED)
+        {
+            member->state = JOB_RUNNING;
+            j->n_running++;
+        }
+    }
+    else
+    {
+        if (member->state == JOB_RUNNING)
+        {
+            j->n_running--;
+        }
+        member->state = JOB_DONE;
+        member->status = status;
+        j->n_alive--;
+        forget_pid(pid);
+    }
+}
+
+int jobs_init(bool job_control)
+{
+    // SIGCHLD is never delivered to a handler; it's read from the signalfd, whenever the shell is ready to
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    if (table.signal_fd == -1)
+    {
+        table.signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    }
+    table.shell_pgid = getpgrp();
+    if (job_control)
+    {
+        // The shell leads its own process group (it may already, i.e.: as a session leader), and owns the terminal
+        if (table.shell_pgid != getpid() && setpgid(0, 0) == 0)
+        {
+            table.shell_pgid = getpid();
+        }
+        job_control = tcsetpgrp(STDIN_FILENO, table.shell_pgid) == 0;
+    }
+    table.job_control = job_control;
+    return table.signal_fd == -1 ? -1 : 0;
+}
+
+bool jobs_control_enabled(void)
+{
+    return table.job_control;
+}
+
+int jobs_signal_fd(void)
+{
+    return table.signal_fd;
+}
+
+job* jobs_add(const char* command, size_t command_len, pid_t pgid, const pid_t* pids, size_t n_pids, bool background)
+{
+    const unsigned id = table.highest + 1;
+    if (id >= table.capacity)
+    {
+        const unsigned capacity = table.capacity == 0 ? JOBS_INITIAL_IDS : table.capacity * 2;
+        job** by_id = realloc(table.by_id, capacity * sizeof(job*));
+        if (by_id == NULL)
+        {
+            return NULL;
+        }
+        memset(by_id + table.capacity, 0, (capacity - table.capacity) * sizeof(job*));
+        table.by_id = by_id;
+        table.capacity = capacity;
+    }
+    while ((table.n_pids + n_pids) * 100 >= table.n_pid_slots * JOBS_PID_MAX_LOAD_PCT)
+    {
+        if (!grow_pid_slots())
+        {
+            return NULL;
+        }
+    }
+    // Trailing blanks (i.e.: the newline) aren't part of the command shown
+    while (command_len > 0 && strchr(" \t\r\n", command[command_len - 1]) != NULL)
+    {
+        command_len--;
+    }
+    job* j = malloc(sizeof(job));
+    job_member* members = malloc(n_pids * sizeof(job_member));
+    char* copy = malloc(command_len + 1);
+    if (j == NULL || members == NULL || copy == NULL)
+    {
+        free(j);
+        free(members);
+        free(copy);
+        return NULL;
+    }
+    memcpy(copy, command, command_len);
+    copy[command_len] = '\0';
+    *j = (job){id, pgid, members, n_pids, n_pids, n_pids, copy, background};
+    for (size_t i = 0; i < n_pids; i++)
+    {
+        members[i] = (job_member){pids[i], JOB_RUNNING, 0};
+        *find_pid_slot(table.pids, table.n_pid_slots, pids[i]) = (pid_slot){pids[i], id, i};
+    }
+    table.n_pids += n_pids;
+    table.by_id[id] = j;
+    table.highest = id;
+    return j;
+}
+
+job* jobs_find(unsigned id)
+{
+    return (id > 0 && id <= table.highest) ? table.by_id[id] : NULL;
+}
+
+job* jobs_find_spec(const char* spec)
+{
+    if (spec == NULL)
+    {
+        return jobs_find(table.highest);
+    }
+    if (*spec == JOB_SPEC_PREFIX)
+    {
+        spec++;
+    }
+    char* end;
+    const unsigned long id = strtoul(spec, &end, 10);
+    if (end == spec || *end != '\0' || id > UINT32_MAX)
+    {
+        return NULL;
+    }
+    return jobs_find((unsigned)id);
+}
+
+void jobs_reap(void)
+{
+    // Drain the pending SIGCHLD (several exits may have been merged into one); waitpid() tells what happened
+    if (table.signal_fd != -1)
+    {
+        struct signalfd_siginfo info[8];
+        while (read(table.signal_fd, info, sizeof(info)) > 0)
+        {
+        }
+    }
+    if (table.n_pids == 0)
+    {
+        return;
+    }
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0)
+    {
+        update_member(pid, status);
+    }
+}
+
+void jobs_wait(job* j, bool foreground)
+{
+    const bool hand_terminal = foreground && table.job_control && j->pgid > 0;
+    if (hand_terminal)
+    {
+        tcsetpgrp(STDIN_FILENO, j->pgid);
+    }
+    while (j->n_running > 0)
+    {
+        if (table.signal_fd != -1)
+        {
+            // Sleep until some child changes its state, then collect every change (other jobs' ones included)
+            jobs_reap();
+            if (j->n_running == 0)
+            {
+                break;
+            }
+            struct pollfd ready = {table.signal_fd, POLLIN, 0};
+            if (poll(&ready, 1, -1) == -1 && errno != EINTR)
+            {
+                break;
+            }
+            continue;
+        }
+        int status;
+        const pid_t pid = waitpid(-1, &status, WUNTRACED);
+        if (pid == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            // Nothing left to wait for (someone else reaped them); don't hang
+            break;
+        }
+        update_member(pid, status);
+    }
+    if (hand_terminal)
+    {
+        tcsetpgrp(STDIN_FILENO, table.shell_pgid);
+    }
+}
+
+int jobs_continue(job* j, bool background)
+{
+    j->background = background;
+    if (j->pgid > 0)
+    {
+        if (kill(-j->pgid, SIGCONT) == -1)
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < j->n_members; i++)
+        {
+            if (j->members[i].state != JOB_DONE && kill(j->members[i].pid, SIGCONT) == -1)
+            {
+                return -1;
+            }
+        }
+    }
+    // Resumed right now; the WCONTINUED reports that'll follow find nothing to change
+    for (size_t i = 0; i < j->n_members; i++)
+    {
+        if (j->members[i].state == JOB_STOPPED)
+        {
+            j->members[i].state = JOB_RUNNING;
+            j->n_running++;
+        }
+    }
+    return 0;
+}
+
+void jobs_remove(job* j)
+{
+    for (size_t i = 0; i < j->n_members; i++)
+    {
+        if (j->members[i].state != JOB_DONE)
+        {
+            forget_pid(j->members[i].pid);
+        }
+    }
+    table.by_id[j->id] = NULL;
+    while (table.highest > 0 && table.by_id[table.highest] == NULL)
+    {
+        table.highest--;
+    }
+    free(j->members);
+    free(j->command);
+    free(j);
+}
+
+enum job_state jobs_state(const job* j)
+{
+    if (j->n_alive == 0)
+    {
+        return JOB_DONE;
+    }
+    return j->n_running == 0 ? JOB_STOPPED : JOB_RUNNING;
+}
+
+int jobs_exit_code(const job* j)
+{
+    return jobs_status_exit_code(j->members[j->n_members - 1].status);
+}
+
+int jobs_status_exit_code(int status)
+{
+    if (WIFSTOPPED(status))
+    {
+        return JOBS_SIGNAL_EXIT_BASE + WSTOPSIG(status);
+    }
+    return WIFSIGNALED(status) ? JOBS_SIGNAL_EXIT_BASE + WTERMSIG(status) : WEXITSTATUS(status);
+}
+
+void jobs_print(FILE* out, const job* j)
+{
+    char state[32];
+    switch (jobs_state(j))
+    {
+    case JOB_RUNNING:
+        snprintf(state, sizeof(state), "Running");
+        break;
+    case JOB_STOPPED:
+        snprintf(state, sizeof(state), "Stopped");
+        break;
+    case JOB_DONE:
+    {
+        const int status = j->members[j->n_members - 1].status;
+        if (WIFSIGNALED(status))
+        {
+            snprintf(state, sizeof(state), "%s", strsignal(WTERMSIG(status)));
+        }
+        else if (WEXITSTATUS(status) != 0)
+        {
+            snprintf(state, sizeof(state), "Exit %d", WEXITSTATUS(status));
+        }
+        else
+        {
+            snprintf(state, sizeof(state), "Done");
+        }
+        break;
+    }
+    }
+    fprintf(out, "[%u]%c  %-24s%s\n", j->id, j->id == table.highest ? '+' : ' ', state, j->command);
+}
+
+void jobs_print_all(FILE* out)
+{
+    jobs_reap();
+    for (unsigned id = 1; id <= table.highest; id++)
+    {
+        job* j = table.by_id[id];
+        if (j != NULL)
+        {
+            jobs_print(out, j);
+        }
+    }
+    fflush(out);
+    // Done jobs are shown once
+    for (unsigned id = table.highest; id >= 1; id--)
+    {
+        job* j = table.by_id[id];
+        if (j != NULL && jobs_state(j) == JOB_DONE)
+        {
+            jobs_remove(j);
+        }
+    }
+}
+
+bool jobs_pending_notices(void)
+{
+    // Always drained, even with no job to update, so the signalfd doesn't stay readable
+    jobs_reap();
+    for (unsigned id = 1; id <= table.highest; id++)
+    {
+        const job* j = table.by_id[id];
+        if (j != NULL && j->background && jobs_state(j) == JOB_DONE)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void jobs_notify(FILE* out)
+{
+    if (table.highest == 0)
+    {
+        return;
+    }
+    jobs_reap();
+    if (out != NULL)
+    {
+        for (unsigned id = 1; id <= table.highest; id++)
+        {
+            const job* j = table.by_id[id];
+            if (j != NULL && j->background && jobs_state(j) == JOB_DONE)
+            {
+                jobs_print(out, j);
+            }
+        }
+        fflush(out);
+    }
+    for (unsigned id = table.highest; id >= 1; id--)
+    {
+        job* j = table.by_id[id];
+        if (j != NULL && j->background && jobs_state(j) == JOB_DONE)
+        {
+            jobs_remove(j);
+        }
+    }
+}
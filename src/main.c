@@ -9,24 +9,140 @@
 // source headers
 #include "shell.h"
 
-//! \brief This app maximum argc value.
-#define APP_MAX_ARGC 2
 //! \brief This app first argument index, among argv.
 #define ARGV_FIRST_APP_ARG_I 1
+//! \brief Option that sets how many lines of the batch file can run at the same time, i.e.: "--jobs=8" or "--jobs 8".
+#define JOBS_OPTION "--jobs"
+//! \brief Base of the "--jobs" value.
+#define JOBS_OPTION_BASE 10
+//! \brief Option that sets the capacity of the pipes between single commands, in bytes, i.e.: "--pipe-size=1M" or
+//! "--pipe-size 262144".
+#define PIPE_SIZE_OPTION "--pipe-size"
+//! \brief Base of the "--pipe-size" value.
+#define PIPE_SIZE_OPTION_BASE 10
+//! \brief Smallest "--pipe-size" value: a page.
+#define PIPE_SIZE_MIN 4096
+//! \brief Biggest "--pipe-size" value, 1 GiB.
+#define PIPE_SIZE_MAX 1073741824
+//! \brief Bytes in a KiB, as the "K" suffix of the "--pipe-size" value stands for.
+#define KIB 1024
+
+/**
+ * @brief Parses the value of the "--jobs" option.
+ * @param value Option value, as typed.
+ * @param jobs Where to leave the value parsed.
+ * @return true if it's an int between 1 and PARALLEL_MAX_JOBS, false otherwise.
+ */
+static bool parse_jobs(const char* value, unsigned* jobs)
+{
+    if (value == NULL)
+    {
+        return false;
+    }
+    char* end;
+    errno = 0;
+    const long n = strtol(value, &end, JOBS_OPTION_BASE);
+    if (errno != 0 || end == value || *end != STR_NULL_TERMINATOR || n < 1 || n > PARALLEL_MAX_JOBS)
+    {
+        return false;
+    }
+    *jobs = (unsigned)n;
+    return true;
+}
+
+/**
+ * @brief Parses the value of the "--pipe-size" option.
+ * @param value Option value, as typed: bytes, optionally followed by a 'K' or 'M' suffix (i.e.: "1M").
+ * @param bytes Where to leave the value parsed, in bytes.
+ * @return true if it's between PIPE_SIZE_MIN and PIPE_SIZE_MAX, false otherwise.
+ */
+static bool parse_pipe_size(const char* value, int* bytes)
+{
+    if (value == NULL)
+    {
+        return false;
+    }
+    char* end;
+    errno = 0;
+    long n = strtol(value, &end, PIPE_SIZE_OPTION_BASE);
+    if (errno != 0 || end == value || n < 1 || n > PIPE_SIZE_MAX)
+    {
+        return false;
+    }
+    if (*end == 'K' || *end == 'M')
+    {
+        n *= *end == 'K' ? KIB : KIB * KIB;
+        end++;
+    }
+    if (*end != STR_NULL_TERMINATOR || n < PIPE_SIZE_MIN || n > PIPE_SIZE_MAX)
+    {
+        return false;
+    }
+    *bytes = (int)n;
+    return true;
+}
 
 //! \brief Main function of the program.
 int main(int argc, char* argv[])
 {
+    const char* batch_file_path = NULL;
+    unsigned jobs = 1;
+    int pipe_size = 0;
+    const size_t jobs_option_len = strlen(JOBS_OPTION);
+    const size_t pipe_size_option_len = strlen(PIPE_SIZE_OPTION);
+    for (int i = ARGV_FIRST_APP_ARG_I; i < argc; i++)
+    {
+        if (strncmp(argv[i], JOBS_OPTION, jobs_option_len) == 0 &&
+            (argv[i][jobs_option_len] == '=' || argv[i][jobs_option_len] == STR_NULL_TERMINATOR))
+        {
+            // The value comes right after "=", or as the next arg
+            const char* value = argv[i][jobs_option_len] == '=' ? &argv[i][jobs_option_len + 1] : argv[++i];
+            if (!parse_jobs(value, &jobs))
+            {
+                wstderr("ERROR: `--jobs` value must be a recognizable int between 1 and 1024.\n", false);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strncmp(argv[i], PIPE_SIZE_OPTION, pipe_size_option_len) == 0 &&
+                 (argv[i][pipe_size_option_len] == '=' || argv[i][pipe_size_option_len] == STR_NULL_TERMINATOR))
+        {
+            const char* value = argv[i][pipe_size_option_len] == '=' ? &argv[i][pipe_size_option_len + 1] : argv[++i];
+            if (!parse_pipe_size(value, &pipe_size))
+            {
+                wstderr("ERROR: `--pipe-size` value must be a recognizable int between 4096 and 1073741824 (bytes; K "
+                        "or M suffixes allowed, i.e.: 1M).\n",
+                        false);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (batch_file_path == NULL)
+        {
+            batch_file_path = argv[i];
+        }
+        else
+        {
+            // Make the user know that this shell accept 0 or 1 argument
+            wstderr("ERROR: This shell only takes 1 arg (path to a batch file, optionally with `--jobs=N`), or 0 "
+                    "(start shell); both optionally with `--pipe-size=BYTES`.\n",
+                    false);
+            return EXIT_SUCCESS;
+        }
+    }
 
-    if (argc > APP_MAX_ARGC)
+    if (set_pipe_size(pipe_size) == -1)
+    {
+        wstderr("ERROR: `--pipe-size` is over what the system allows (see /proc/sys/fs/pipe-max-size)", true);
+        return EXIT_FAILURE;
+    }
+    if (batch_file_path != NULL)
     {
-        // Make the user know that this shell accept 0 or 1 argument
-        wstderr("ERROR: This shell only takes 1 arg (path to a batch file), or 0 (start shell).\n", false);
+        // A batch file was passed
+        execute_batch_file(batch_file_path, jobs);
     }
-    else if (argc == APP_MAX_ARGC)
+    else if (jobs > 1)
     {
-        // An argument was passed
-        execute_batch_file(argv[ARGV_FIRST_APP_ARG_I]);
+        wstderr("ERROR: `--jobs` is only meant for batch files.\n", false);
+        return EXIT_FAILURE;
     }
     else
     {
@@ -0,0 +1,130 @@
+/**
+ * @file metrics_control_utils.c
+ * @brief "metrics" app control channel definition.
+ */
+
+#include "metrics_control_utils.h"
+
+//! \brief Sequence of the last config change sent.
+static uint32_t last_sequence = 0;
+
+int metrics_control_open(int fds[2])
+{
+    return socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds);
+}
+
+/**
+ * @brief Milliseconds left until a deadline.
+ * @param deadline The deadline, as CLOCK_MONOTONIC time.
+ * @return Milliseconds left (rounded up), or 0 if it already passed.
+ */
+static int msecs_left(const struct timespec* deadline)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const long long left_ns = (long long)(deadline->tv_sec - now.tv_sec) * METRICS_CONTROL_MSECS_PER_SEC *
+                                  METRICS_CONTROL_NSECS_PER_MSEC +
+                              (deadline->tv_nsec - now.tv_nsec);
+    return left_ns <= 0 ? 0 : (int)((left_ns + METRICS_CONTROL_NSECS_PER_MSEC - 1) / METRICS_CONTROL_NSECS_PER_MSEC);
+}
+
+int metrics_control_request(int fd, metrics_control_msg* msg, int timeout_ms)
+{
+    msg->magic = METRICS_CONTROL_MAGIC;
+    msg->version = METRICS_CONTROL_VERSION;
+    msg->sequence = ++last_sequence;
+    // No SIGPIPE if the "metrics" app already closed its end; EPIPE is enough (ECONNRESET if it left messages unread)
+    if (send(fd, msg, sizeof(*msg), MSG_NOSIGNAL) == -1)
+    {
+        errno = errno == ECONNRESET ? EPIPE : errno;
+        return -1;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / METRICS_CONTROL_MSECS_PER_SEC;
+    deadline.tv_nsec += (timeout_ms % METRICS_CONTROL_MSECS_PER_SEC) * METRICS_CONTROL_NSECS_PER_MSEC;
+    if (deadline.tv_nsec >= METRICS_CONTROL_MSECS_PER_SEC * METRICS_CONTROL_NSECS_PER_MSEC)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= METRICS_CONTROL_MSECS_PER_SEC * METRICS_CONTROL_NSECS_PER_MSEC;
+    }
+    while (true)
+    {
+        struct pollfd answer = {fd, POLLIN, 0};
+        const int ready = poll(&answer, 1, msecs_left(&deadline));
+        if (ready == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ready == -1)
+        {
+            return -1;
+        }
+        if (ready == 0)
+        {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        metrics_control_ack ack;
+        const ssize_t received = recv(fd, &ack, sizeof(ack), MSG_DONTWAIT);
+        if (received == 0)
+        {
+            errno = EPIPE;
+            return -1;
+        }
+        // Anything else than the acknowledgment of this change is stale (or garbage); keep waiting
+        if (received == (ssize_t)sizeof(ack) && ack.magic == METRICS_CONTROL_MAGIC &&
+            ack.version == METRICS_CONTROL_VERSION && ack.sequence == msg->sequence)
+        {
+            if (ack.error != 0)
+            {
+                errno = ack.error;
+                return -1;
+            }
+            return 0;
+        }
+        if (received == -1 && errno != EAGAIN && errno != EINTR)
+        {
+            errno = errno == ECONNRESET ? EPIPE : errno;
+            return -1;
+        }
+    }
+}
+
+int metrics_control_receive(int fd, metrics_control_msg* msg)
+{
+    const ssize_t received = recv(fd, msg, sizeof(*msg), 0);
+    if (received == -1)
+    {
+        return -1;
+    }
+    if (received == 0)
+    {
+        errno = EPIPE;
+        return -1;
+    }
+    if (received != (ssize_t)sizeof(*msg) || msg->magic != METRICS_CONTROL_MAGIC ||
+        msg->version != METRICS_CONTROL_VERSION)
+    {
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+}
+
+int metrics_control_acknowledge(int fd, uint32_t sequence, int error)
+{
+    const metrics_control_ack ack = {METRICS_CONTROL_MAGIC, METRICS_CONTROL_VERSION, sequence, error};
+    return send(fd, &ack, sizeof(ack), MSG_NOSIGNAL) == -1 ? -1 : 0;
+}
+
+void metrics_control_apply(const metrics_control_msg* msg, unsigned char* data)
+{
+    for (int i = 0; i < N_JSON_ENTRIES; i++)
+    {
+        if (msg->options & (1u << i))
+        {
+            data[i] = msg->values[i];
+        }
+    }
+}
@@ -0,0 +1,382 @@
+/**
+ * @file metrics_history_utils.c
+ * @brief "metrics" app samples history definition.
+ */
+
+#include "metrics_history_utils.h"
+
+//! \brief How the values of a metric are spread over the sketch bins.
+enum sketch_mapping
+{
+    MAPPING_PCT,
+    MAPPING_RATE,
+    N_SKETCH_MAPPINGS
+};
+
+//! \brief State of a metric when a time bucket started, plus the extremes of the bucket itself.
+typedef struct series_bucket
+{
+    //! \brief Cumulative sketch bins (modulo 2^16) when the bucket started.
+    uint16_t bins[HISTORY_SKETCH_BINS];
+    //! \brief Cumulative amount of samples when the bucket started.
+    uint64_t count;
+    //! \brief Cumulative sum of the samples when the bucket started.
+    double sum;
+    //! \brief Lowest value recorded within the bucket.
+    double min;
+    //! \brief Highest value recorded within the bucket.
+    double max;
+} series_bucket;
+
+//! \brief Name shown for each metric, as of metrics_series.
+static const char* const series_names[N_METRICS_SERIES] = {
+    [SERIES_CPU] = "CPU usage (%)",
+    [SERIES_MEM] = "RAM usage (%)",
+    [SERIES_SECTORS_READ] = "HDD sectors read/s",
+    [SERIES_SECTORS_WRITTEN] = "HDD sectors written/s",
+    [SERIES_NET_RX] = "Network bytes received/s",
+    [SERIES_NET_TX] = "Network bytes sent/s",
+    [SERIES_PROCS_RUNNING] = "Processes running",
+};
+
+//! \brief Sample field each metric comes from, as of metrics_series.
+static const uint64_t series_fields[N_METRICS_SERIES] = {
+    [SERIES_CPU] = METRICS_FIELD_CPU,
+    [SERIES_MEM] = METRICS_FIELD_MEM,
+    [SERIES_SECTORS_READ] = METRICS_FIELD_HDD,
+    [SERIES_SECTORS_WRITTEN] = METRICS_FIELD_HDD,
+    [SERIES_NET_RX] = METRICS_FIELD_NET,
+    [SERIES_NET_TX] = METRICS_FIELD_NET,
+    [SERIES_PROCS_RUNNING] = METRICS_FIELD_PROCS,
+};
+
+//! \brief Sketch mapping of each metric, as of metrics_series.
+static const enum sketch_mapping series_mappings[N_METRICS_SERIES] = {
+    [SERIES_CPU] = MAPPING_PCT,
+    [SERIES_MEM] = MAPPING_PCT,
+    [SERIES_SECTORS_READ] = MAPPING_RATE,
+    [SERIES_SECTORS_WRITTEN] = MAPPING_RATE,
+    [SERIES_NET_RX] = MAPPING_RATE,
+    [SERIES_NET_TX] = MAPPING_RATE,
+    [SERIES_PROCS_RUNNING] = MAPPING_RATE,
+};
+
+//! \brief A history of samples.
+struct metrics_history
+{
+    //! \brief Time buckets kept (a ring indexed by bucket id), HISTORY_BUCKETS * N_METRICS_SERIES; NULL until the
+    //! first sample arrives.
+    series_bucket* buckets;
+    //! \brief Cumulative sketch bins of each metric, up to the latest sample (modulo 2^16).
+    uint16_t bins[N_METRICS_SERIES][HISTORY_SKETCH_BINS];
+    //! \brief Cumulative amount of samples of each metric.
+    uint64_t count[N_METRICS_SERIES];
+    //! \brief Cumulative sum of the samples of each metric.
+    double sum[N_METRICS_SERIES];
+    //! \brief Id (time / HISTORY_BUCKET_NS) of the oldest bucket kept.
+    uint64_t first_bucket;
+    //! \brief Id of the bucket of the latest sample.
+    uint64_t current_bucket;
+    //! \brief Time of the latest sample, as CLOCK_MONOTONIC nanoseconds.
+    uint64_t latest_ns;
+    //! \brief No sample recorded yet?
+    bool empty;
+};
+
+//! \brief Bins of the sketches, the same for every history.
+static struct
+{
+    //! \brief Upper bound (excluded) of each bin, per mapping. Bin i covers [bounds[i - 1], bounds[i]).
+    double bounds[N_SKETCH_MAPPINGS][HISTORY_SKETCH_BINS];
+    //! \brief Ratio between the bounds of consecutive bins, per mapping.
+    double gamma[N_SKETCH_MAPPINGS];
+    //! \brief Were bounds and gamma computed already?
+    bool ready;
+} sketch = {.ready = false};
+
+/**
+ * @brief Gives the bucket of a metric on the ring.
+ * @param history The history.
+ * @param bucket_id Bucket id. Must be kept.
+ * @param series The metric.
+ * @return The bucket.
+ */
+static series_bucket* bucket_of(const metrics_history* history, uint64_t bucket_id, enum metrics_series series)
+{
+    return &history->buckets[(bucket_id % HISTORY_BUCKETS) * N_METRICS_SERIES + series];
+}
+
+/**
+ * @brief Allocates the time buckets of a history, and computes the bins bounds once (geometric, so each bin has the
+ * same relative width).
+ * @param history The history.
+ * @return true on success, false if there's no memory left.
+ */
+static bool ensure_history(metrics_history* history)
+{
+    if (history->buckets != NULL)
+    {
+        return true;
+    }
+    history->buckets = calloc(HISTORY_BUCKETS * N_METRICS_SERIES, sizeof(series_bucket));
+    if (history->buckets == NULL)
+    {
+        return false;
+    }
+    if (sketch.ready)
+    {
+        return true;
+    }
+    sketch.ready = true;
+    const double accuracies[N_SKETCH_MAPPINGS] = {HISTORY_PCT_ACCURACY, HISTORY_RATE_ACCURACY};
+    const double min_values[N_SKETCH_MAPPINGS] = {HISTORY_PCT_MIN_VALUE, HISTORY_RATE_MIN_VALUE};
+    for (int m = 0; m < N_SKETCH_MAPPINGS; m++)
+    {
+        // A value shown as 2 * upper / (gamma + 1) is within the accuracy of anything in [upper / gamma, upper)
+        sketch.gamma[m] = (1 + accuracies[m]) / (1 - accuracies[m]);
+        double bound = min_values[m];
+        for (size_t i = 0; i < HISTORY_SKETCH_BINS; i++)
+        {
+            sketch.bounds[m][i] = bound;
+            bound *= sketch.gamma[m];
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Finds the bin of a value.
+ * @param mapping Mapping of the metric.
+ * @param value The value.
+ * @return Bin index; the last bin also holds anything above its upper bound.
+ */
+static size_t bin_of(enum sketch_mapping mapping, double value)
+{
+    const double* bounds = sketch.bounds[mapping];
+    size_t low = 0;
+    size_t high = HISTORY_SKETCH_BINS - 1;
+    while (low < high)
+    {
+        const size_t middle = (low + high) / 2;
+        if (value < bounds[middle])
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief Gives the value that stands for every value of a bin.
+ * @param mapping Mapping of the metric.
+ * @param bin Bin index.
+ * @return The value.
+ */
+static double bin_value(enum sketch_mapping mapping, size_t bin)
+{
+    return bin == 0 ? 0.0 : 2 * sketch.bounds[mapping][bin] / (sketch.gamma[mapping] + 1);
+}
+
+/**
+ * @brief Starts a time bucket for every metric: it remembers the current cumulative state.
+ * @param history The history.
+ * @param bucket_id Bucket id.
+ */
+static void start_bucket(metrics_history* history, uint64_t bucket_id)
+{
+    for (int s = 0; s < N_METRICS_SERIES; s++)
+    {
+        series_bucket* bucket = bucket_of(history, bucket_id, s);
+        memcpy(bucket->bins, history->bins[s], sizeof(bucket->bins));
+        bucket->count = history->count[s];
+        bucket->sum = history->sum[s];
+        bucket->min = DBL_MAX;
+        bucket->max = -DBL_MAX;
+    }
+}
+
+/**
+ * @brief Moves the history forward to a time bucket, starting it and every bucket in between (the oldest ones kept
+ * get dropped).
+ * @param history The history.
+ * @param bucket_id Bucket id. Not older than the current one.
+ */
+static void advance_to(metrics_history* history, uint64_t bucket_id)
+{
+    if (history->empty)
+    {
+        history->first_bucket = bucket_id;
+    }
+    else if (bucket_id == history->current_bucket)
+    {
+        return;
+    }
+    // Buckets without samples still start, with the same cumulative state; only the last HISTORY_BUCKETS matter
+    uint64_t id = history->empty ? bucket_id : history->current_bucket + 1;
+    if (bucket_id - id >= HISTORY_BUCKETS)
+    {
+        id = bucket_id - HISTORY_BUCKETS + 1;
+    }
+    for (; id <= bucket_id; id++)
+    {
+        start_bucket(history, id);
+    }
+    history->current_bucket = bucket_id;
+    if (history->current_bucket - history->first_bucket >= HISTORY_BUCKETS)
+    {
+        history->first_bucket = history->current_bucket - HISTORY_BUCKETS + 1;
+    }
+    history->empty = false;
+}
+
+/**
+ * @brief Gives the value of a metric out of a sample.
+ * @param sample The sample.
+ * @param series The metric.
+ * @return The value.
+ */
+static double series_value(const metrics_sample* sample, enum metrics_series series)
+{
+    switch (series)
+    {
+    case SERIES_CPU:
+        return sample->cpu_usage;
+    case SERIES_MEM:
+        return sample->mem_usage;
+    case SERIES_SECTORS_READ:
+        return (double)sample->sectors_read_rate;
+    case SERIES_SECTORS_WRITTEN:
+        return (double)sample->sectors_written_rate;
+    case SERIES_NET_RX:
+        return (double)sample->net_rx_rate;
+    case SERIES_NET_TX:
+        return (double)sample->net_tx_rate;
+    case SERIES_PROCS_RUNNING:
+    default:
+        return (double)sample->procs_running;
+    }
+}
+
+metrics_history* metrics_history_create(void)
+{
+    metrics_history* history = calloc(1, sizeof(metrics_history));
+    if (history != NULL)
+    {
+        history->empty = true;
+    }
+    return history;
+}
+
+void metrics_history_destroy(metrics_history* history)
+{
+    if (history != NULL)
+    {
+        free(history->buckets);
+        free(history);
+    }
+}
+
+const char* metrics_history_name(enum metrics_series series)
+{
+    return series_names[series];
+}
+
+bool metrics_history_add(metrics_history* history, const metrics_sample* sample)
+{
+    if ((!history->empty && sample->timestamp_ns < history->latest_ns) || !ensure_history(history))
+    {
+        return false;
+    }
+    advance_to(history, sample->timestamp_ns / HISTORY_BUCKET_NS);
+    history->latest_ns = sample->timestamp_ns;
+    for (int s = 0; s < N_METRICS_SERIES; s++)
+    {
+        series_bucket* bucket = bucket_of(history, history->current_bucket, s);
+        if (!(sample->fields & series_fields[s]) || history->count[s] - bucket->count >= HISTORY_MAX_BUCKET_SAMPLES)
+        {
+            continue;
+        }
+        const double value = series_value(sample, s);
+        history->bins[s][bin_of(series_mappings[s], value)]++;
+        history->count[s]++;
+        history->sum[s] += value;
+        if (value < bucket->min)
+        {
+            bucket->min = value;
+        }
+        if (value > bucket->max)
+        {
+            bucket->max = value;
+        }
+    }
+    return true;
+}
+
+void metrics_history_summary(const metrics_history* history, enum metrics_series series, uint64_t window_ns,
+                             uint64_t now_ns, metrics_summary* summary)
+{
+    memset(summary, 0, sizeof(metrics_summary));
+    const uint64_t now_bucket = now_ns / HISTORY_BUCKET_NS;
+    uint64_t n_buckets = (window_ns + HISTORY_BUCKET_NS - 1) / HISTORY_BUCKET_NS;
+    if (n_buckets == 0)
+    {
+        n_buckets = 1;
+    }
+    if (history->empty || now_bucket < history->current_bucket || now_bucket - history->current_bucket >= n_buckets)
+    {
+        // Nothing recorded within the window
+        return;
+    }
+    uint64_t start = now_bucket - n_buckets + 1;
+    if (n_buckets > now_bucket || start < history->first_bucket)
+    {
+        start = history->first_bucket;
+    }
+    // The window is whatever got recorded since its first bucket started
+    const series_bucket* first = bucket_of(history, start, series);
+    summary->count = history->count[series] - first->count;
+    if (summary->count == 0)
+    {
+        return;
+    }
+    summary->avg = (history->sum[series] - first->sum) / (double)summary->count;
+    summary->min = DBL_MAX;
+    summary->max = -DBL_MAX;
+    for (uint64_t id = start; id <= history->current_bucket; id++)
+    {
+        const series_bucket* bucket = bucket_of(history, id, series);
+        summary->min = bucket->min < summary->min ? bucket->min : summary->min;
+        summary->max = bucket->max > summary->max ? bucket->max : summary->max;
+    }
+    // Walk the bins of the window once, stopping at the rank of each quantile
+    const double quantiles[] = {0.50, 0.95, 0.99};
+    double* results[] = {&summary->p50, &summary->p95, &summary->p99};
+    const size_t n_quantiles = sizeof(quantiles) / sizeof(quantiles[0]);
+    const enum sketch_mapping mapping = series_mappings[series];
+    uint64_t seen = 0;
+    size_t q = 0;
+    for (size_t bin = 0; bin < HISTORY_SKETCH_BINS && q < n_quantiles; bin++)
+    {
+        seen += (uint16_t)(history->bins[series][bin] - first->bins[bin]);
+        while (q < n_quantiles && (double)seen > quantiles[q] * (double)(summary->count - 1))
+        {
+            // The sketch value never goes out of what was actually seen
+            double value = bin_value(mapping, bin);
+            value = value < summary->min ? summary->min : value;
+            *results[q++] = value > summary->max ? summary->max : value;
+        }
+    }
+}
+
+void metrics_history_clear(metrics_history* history)
+{
+    memset(history->bins, 0, sizeof(history->bins));
+    memset(history->count, 0, sizeof(history->count));
+    memset(history->sum, 0, sizeof(history->sum));
+    history->latest_ns = 0;
+    history->empty = true;
+}
@@ -0,0 +1,139 @@
+/**
+ * @file metrics_ring_utils.c
+ * @brief Shared memory ring of "metrics" app samples definition.
+ */
+
+// memfd_create()
+#define _GNU_SOURCE
+#include "metrics_ring_utils.h"
+
+/**
+ * @brief Maps a memfd holding a ring.
+ * @param fd The memfd.
+ * @return The ring, or NULL on failure (errno is set).
+ */
+static metrics_ring* map_ring(int fd)
+{
+    metrics_ring* ring = mmap(NULL, sizeof(metrics_ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return ring == MAP_FAILED ? NULL : ring;
+}
+
+metrics_ring* metrics_ring_create(int* fd)
+{
+    *fd = memfd_create(METRICS_RING_NAME, MFD_CLOEXEC);
+    if (*fd == -1)
+    {
+        return NULL;
+    }
+    metrics_ring* ring = NULL;
+    // A new memfd is zero-filled: no sample published, every slot unlocked
+    if (ftruncate(*fd, sizeof(metrics_ring)) == 0)
+    {
+        ring = map_ring(*fd);
+    }
+    if (ring == NULL)
+    {
+        const int error = errno;
+        close(*fd);
+        *fd = -1;
+        errno = error;
+        return NULL;
+    }
+    ring->version = METRICS_RING_VERSION;
+    ring->n_slots = METRICS_RING_SLOTS;
+    ring->slot_size = sizeof(metrics_ring_slot);
+    // The magic goes last, so a ring with the magic is always complete
+    atomic_thread_fence(memory_order_release);
+    ring->magic = METRICS_RING_MAGIC;
+    return ring;
+}
+
+metrics_ring* metrics_ring_attach(int fd)
+{
+    metrics_ring* ring = map_ring(fd);
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+    if (ring->magic != METRICS_RING_MAGIC || ring->version != METRICS_RING_VERSION ||
+        ring->n_slots != METRICS_RING_SLOTS || ring->slot_size != sizeof(metrics_ring_slot))
+    {
+        metrics_ring_release(ring);
+        errno = EPROTO;
+        return NULL;
+    }
+    return ring;
+}
+
+void metrics_ring_release(metrics_ring* ring)
+{
+    if (ring != NULL)
+    {
+        munmap(ring, sizeof(metrics_ring));
+    }
+}
+
+void metrics_ring_publish(metrics_ring* ring, const metrics_sample* sample)
+{
+    const uint64_t published = atomic_load_explicit(&ring->published, memory_order_relaxed);
+    metrics_ring_slot* slot = &ring->slots[published & (METRICS_RING_SLOTS - 1)];
+    // Odd sequence: readers that catch the slot meanwhile retry
+    const uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->sample = *sample;
+    atomic_store_explicit(&slot->sequence, sequence + 2, memory_order_release);
+    atomic_store_explicit(&ring->published, published + 1, memory_order_release);
+}
+
+uint64_t metrics_ring_published(const metrics_ring* ring)
+{
+    return atomic_load_explicit(&ring->published, memory_order_acquire);
+}
+
+bool metrics_ring_read(const metrics_ring* ring, uint64_t n, metrics_sample* sample)
+{
+    const metrics_ring_slot* slot = &ring->slots[n & (METRICS_RING_SLOTS - 1)];
+    for (int attempt = 0; attempt < METRICS_RING_READ_RETRIES; attempt++)
+    {
+        // Sample n is on its slot from the moment it's published, until sample n + METRICS_RING_SLOTS starts
+        const uint64_t published = metrics_ring_published(ring);
+        if (n >= published || published - n > METRICS_RING_SLOTS)
+        {
+            return false;
+        }
+        const uint64_t before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (before & 1)
+        {
+            continue;
+        }
+        *sample = slot->sample;
+        // The copy must be complete before the sequence gets checked again
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) != before)
+        {
+            continue;
+        }
+        // Each write of a slot adds 2 to its sequence, so it tells which sample the slot holds
+        return before == 2 * (n / METRICS_RING_SLOTS + 1);
+    }
+    return false;
+}
+
+bool metrics_ring_latest(const metrics_ring* ring, metrics_sample* sample)
+{
+    for (int attempt = 0; attempt < METRICS_RING_READ_RETRIES; attempt++)
+    {
+        const uint64_t published = metrics_ring_published(ring);
+        if (published == 0)
+        {
+            return false;
+        }
+        // The latest sample may get overwritten meanwhile (the writer lapped the ring); try the new latest one
+        if (metrics_ring_read(ring, published - 1, sample))
+        {
+            return true;
+        }
+    }
+    return false;
+}
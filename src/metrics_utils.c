@@ -3,123 +3,194 @@
  * @brief "metrics" app utilities definition.
  */
 
+// memfd_create(), F_ADD_SEALS
+#define _GNU_SOURCE
 #include "metrics_utils.h"
 
-char* get_metrics_json_config_file_path(char** argv)
+//! \brief Every option "start_monitor" (and "config_monitor") takes. When adding one, give it a json_index too.
+static const metrics_option options_schema[] = {
+    {"--config=", OPTION_PATH, UPDATE_I_I, 0, 0, NULL},
+    {"--update_interval=", OPTION_INT, UPDATE_I_I, UPDATE_I_MINV + 1, UPDATE_I_MAXV, "update_interval"},
+    {"--cpu=", OPTION_BOOL, CPU_I, false, true, "cpu"},
+    {"--mem=", OPTION_BOOL, MEM_I, false, true, "mem"},
+    {"--hdd=", OPTION_BOOL, HDD_I, false, true, "hdd"},
+    {"--net=", OPTION_BOOL, NET_I, false, true, "net"},
+    {"--procs=", OPTION_BOOL, PROCS_I, false, true, "procs"},
+};
+
+//! \brief Config built last, kept so an identical one isn't built again.
+static struct
 {
-    unsigned char data[N_JSON_ENTRIES] = JSON_ENTRIES_DEF_VAL;
+    //! \brief Its sealed memfd, or -1.
+    int fd;
+    //! \brief The config itself, indexed by json_index.
+    unsigned char data[N_JSON_ENTRIES];
+} config_cache = {.fd = -1};
+
+const metrics_option* metrics_options(size_t* n_options)
+{
+    *n_options = sizeof(options_schema) / sizeof(options_schema[0]);
+    return options_schema;
+}
+
+/**
+ * @brief Parses the value of an option, as its schema says.
+ * @param option Schema of the option.
+ * @param value Value, as typed.
+ * @param parsed Where to leave the value (OPTION_INT and OPTION_BOOL only).
+ * @return true if it's valid, false otherwise (the error gets shown).
+ */
+static bool parse_option_value(const metrics_option* option, const char* value, unsigned char* parsed)
+{
+    // The name, as shown on errors, is the prefix without its "="
+    const int name_len = (int)strlen(option->prefix) - 1;
+    if (option->kind == OPTION_BOOL)
+    {
+        if (strcmp(value, "true") == 0 || strcmp(value, "false") == 0)
+        {
+            *parsed = strcmp(value, "true") == 0;
+            return true;
+        }
+        fprintf(stderr, "ERROR: `%.*s` value must be either \"true\" or \"false\".", name_len, option->prefix);
+        return false;
+    }
+    char* end;
+    errno = 0;
+    const long number = strtol(value, &end, OPTION_INT_BASE);
+    if (errno == 0 && end != value && *end == '\0' && number >= option->min && number <= option->max)
+    {
+        *parsed = (unsigned char)number;
+        return true;
+    }
+    fprintf(stderr, "ERROR: `%.*s` value must be a recognizable int between %d and %d.", name_len, option->prefix,
+            option->min, option->max);
+    return false;
+}
+
+int parse_metrics_options(char** argv, unsigned char* data, unsigned* options, char** config_path)
+{
+    *options = 0;
+    *config_path = NULL;
     // First arg is "start_monitor", known
     for (int i = LOWEST_ARR_INDEX + 1; argv[i] != NULL; i++)
     {
-        // Inquire for each possible parameter; if `--config` was passed, ignore all the others
+        // Inquire for each possible parameter (unknown ones are ignored); if `--config` was passed, ignore all the
+        // others
         const char* arg = argv[i];
-        if ((strlen(arg) > CONFIG_OPL) && (strncmp(arg, "--config=", CONFIG_OPL) == 0))
+        for (size_t o = 0; o < sizeof(options_schema) / sizeof(options_schema[0]); o++)
         {
-            // Return the path to the config file
-            return argv[i] + CONFIG_OPL;
-        }
-        // `--update_interval` check
-        else if ((strlen(arg) > UPDATE_I_OPL) && (strncmp(arg, "--update_interval=", UPDATE_I_OPL) == 0))
-        {
-            int seconds = atoi(arg + UPDATE_I_OPL);
-            if (seconds <= UPDATE_I_MINV || seconds > UPDATE_I_MAXV)
+            const metrics_option* option = &options_schema[o];
+            const size_t prefix_len = strlen(option->prefix);
+            if (strlen(arg) <= prefix_len || strncmp(arg, option->prefix, prefix_len) != 0)
             {
-                char* error_s = "ERROR: `--update_interval` value must be a recognizable int between 1 and 255.";
-                fwrite(error_s, sizeof(char), strlen(error_s), stderr);
-                return NULL;
+                continue;
             }
-            data[UPDATE_I_I] = seconds;
-        }
-        // `--cpu` check
-        else if ((strlen(arg) > CPU_OPL) && (strncmp(arg, "--cpu=", CPU_OPL) == 0))
-        {
-            if (strcmp(arg + CPU_OPL, "true") == 0)
+            if (option->kind == OPTION_PATH)
             {
-                data[CPU_I] = true;
+                // Leave the path to the config file
+                *config_path = argv[i] + prefix_len;
+                return 0;
             }
-            else if (strcmp(arg + CPU_OPL, "false") == 0)
+            if (!parse_option_value(option, arg + prefix_len, &data[option->index]))
             {
-                data[CPU_I] = false;
-            }
-            else
-            {
-                char* error_s = "ERROR: `--cpu` value must be either \"true\" or \"false\".";
-                fwrite(error_s, sizeof(char), strlen(error_s), stderr);
-                return NULL;
+                return -1;
             }
+            *options |= 1u << option->index;
+            break;
         }
-        // `--mem` check
-        else if ((strlen(arg) > MEM_OPL) && (strncmp(arg, "--mem=", MEM_OPL) == 0))
-        {
-            if (strcmp(arg + MEM_OPL, "true") == 0)
-            {
-                data[MEM_I] = true;
-            }
-            else if (strcmp(arg + MEM_OPL, "false") == 0)
-            {
-                data[MEM_I] = false;
-            }
-            else
-            {
-                char* error_s = "ERROR: `--mem` value must be either \"true\" or \"false\".";
-                fwrite(error_s, sizeof(char), strlen(error_s), stderr);
-                return NULL;
-            }
-        }
-        // `--hdd` check
-        else if ((strlen(arg) > HDD_OPL) && (strncmp(arg, "--hdd=", HDD_OPL) == 0))
+    }
+    return 0;
+}
+
+/**
+ * @brief Puts a "metrics" config, as JSON, on a new memfd, sealed so nobody can change it afterwards.
+ * @param data Config, indexed by json_index.
+ * @return The memfd (close-on-exec), or -1 on failure (errno is set).
+ */
+static int create_metrics_config_memfd(const unsigned char* data)
+{
+    char* json_string = metrics_json_config(data);
+    if (json_string == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    const int fd = memfd_create(METRICS_CONFIG_MEMFD_NAME, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    bool written = fd != -1;
+    const size_t len = strlen(json_string);
+    for (size_t done = 0; written && done < len;)
+    {
+        const ssize_t n = write(fd, json_string + done, len - done);
+        written = n > 0;
+        done += written ? (size_t)n : 0;
+    }
+    free(json_string);
+    if (!written || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1)
+    {
+        if (fd != -1)
         {
-            if (strcmp(arg + HDD_OPL, "true") == 0)
-            {
-                data[HDD_I] = true;
-            }
-            else if (strcmp(arg + HDD_OPL, "false") == 0)
-            {
-                data[HDD_I] = false;
-            }
-            else
-            {
-                char* error_s = "ERROR: `--hdd` value must be either \"true\" or \"false\".";
-                fwrite(error_s, sizeof(char), strlen(error_s), stderr);
-                return NULL;
-            }
+            const int error = errno;
+            close(fd);
+            errno = error;
         }
-        // `--net` check
-        else if ((strlen(arg) > NET_OPL) && (strncmp(arg, "--net=", NET_OPL) == 0))
-        {
-            if (strcmp(arg + NET_OPL, "true") == 0)
-            {
-                data[NET_I] = true;
-            }
-            else if (strcmp(arg + NET_OPL, "false") == 0)
-            {
-                data[NET_I] = false;
-            }
-            else
-            {
-                char* error_s = "ERROR: `--net` value must be either \"true\" or \"false\".";
-                fwrite(error_s, sizeof(char), strlen(error_s), stderr);
-                return NULL;
-            }
-        }
-        // `--procs` check
-        else if ((strlen(arg) > PROCS_OPL) && (strncmp(arg, "--procs=", PROCS_OPL) == 0))
+        return -1;
+    }
+    return fd;
+}
+
+int get_metrics_config(char** argv, char** config_path, int* config_fd)
+{
+    unsigned char data[N_JSON_ENTRIES] = JSON_ENTRIES_DEF_VAL;
+    unsigned options;
+    *config_fd = -1;
+    if (parse_metrics_options(argv, data, &options, config_path) == -1)
+    {
+        return -1;
+    }
+    if (*config_path != NULL)
+    {
+        return 0;
+    }
+    // Same config as last time: nothing to build
+    if (config_cache.fd != -1 && memcmp(config_cache.data, data, sizeof(data)) == 0)
+    {
+        *config_fd = config_cache.fd;
+        return 0;
+    }
+    const int fd = create_metrics_config_memfd(data);
+    if (fd == -1)
+    {
+        // No memfds on this system: the JSON config file, as it used to be
+        if (create_metrics_json_config_file(data) == -1)
         {
-            if (strcmp(arg + PROCS_OPL, "true") == 0)
-            {
-                data[PROCS_I] = true;
-            }
-            else if (strcmp(arg + PROCS_OPL, "false") == 0)
-            {
-                data[PROCS_I] = false;
-            }
-            else
-            {
-                char* error_s = "ERROR: `--procs` value must be either \"true\" or \"false\".";
-                fwrite(error_s, sizeof(char), strlen(error_s), stderr);
-                return NULL;
-            }
+            return -1;
         }
+        *config_path = DEFAULT_JSON_CONFIG_FILE_OUTPUT_PATH;
+        return 0;
+    }
+    if (config_cache.fd != -1)
+    {
+        close(config_cache.fd);
+    }
+    config_cache.fd = fd;
+    memcpy(config_cache.data, data, sizeof(data));
+    *config_fd = fd;
+    return 0;
+}
+
+char* get_metrics_json_config_file_path(char** argv)
+{
+    unsigned char data[N_JSON_ENTRIES] = JSON_ENTRIES_DEF_VAL;
+    unsigned options;
+    char* config_path;
+    if (parse_metrics_options(argv, data, &options, &config_path) == -1)
+    {
+        return NULL;
+    }
+    if (config_path != NULL)
+    {
+        // Return the path to the config file
+        return config_path;
     }
     // JSON config file must be created
     if (create_metrics_json_config_file(data) == 0)
@@ -133,33 +204,62 @@ char* get_metrics_json_config_file_path(char** argv)
     }
 }
 
-int create_metrics_json_config_file(const unsigned char* data)
+char* metrics_json_config(const unsigned char* data)
 {
-    // Create JSON as a net of structs
+    // Create JSON as a net of structs, as the schema says
     cJSON* root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "update_interval", data[UPDATE_I_I]);
-    cJSON* metrics = cJSON_AddObjectToObject(root, "metrics");
-    cJSON_AddBoolToObject(metrics, "cpu", data[CPU_I]);
-    cJSON_AddBoolToObject(metrics, "mem", data[MEM_I]);
-    cJSON_AddBoolToObject(metrics, "hdd", data[HDD_I]);
-    cJSON_AddBoolToObject(metrics, "net", data[NET_I]);
-    cJSON_AddBoolToObject(metrics, "procs", data[PROCS_I]);
-    // Transform it to a string
+    cJSON* metrics = NULL;
+    for (size_t o = 0; o < sizeof(options_schema) / sizeof(options_schema[0]); o++)
+    {
+        const metrics_option* option = &options_schema[o];
+        if (option->kind == OPTION_INT)
+        {
+            cJSON_AddNumberToObject(root, option->json_key, data[option->index]);
+        }
+        else if (option->kind == OPTION_BOOL)
+        {
+            metrics = metrics != NULL ? metrics : cJSON_AddObjectToObject(root, "metrics");
+            cJSON_AddBoolToObject(metrics, option->json_key, data[option->index]);
+        }
+    }
+    // Transform it to a string, ending with a newline as the config file always did
     char* json_string = cJSON_Print(root);
+    cJSON_Delete(root);
+    if (json_string == NULL)
+    {
+        return NULL;
+    }
+    const size_t len = strlen(json_string);
+    char* text = realloc(json_string, len + 2);
+    if (text == NULL)
+    {
+        free(json_string);
+        return NULL;
+    }
+    text[len] = '\n';
+    text[len + 1] = '\0';
+    return text;
+}
+
+int create_metrics_json_config_file(const unsigned char* data)
+{
+    char* json_string = metrics_json_config(data);
+    if (json_string == NULL)
+    {
+        return -1;
+    }
     // Write that to a file
     FILE* file = fopen(DEFAULT_JSON_CONFIG_FILE_OUTPUT_PATH, "w");
     if (file == NULL)
     {
         perror("ERROR: Failed to open file for writing");
-        cJSON_Delete(root);
         free(json_string);
         return -1;
     }
-    fprintf(file, "%s\n", json_string);
+    fputs(json_string, file);
     // Close the file
     fclose(file);
     // Clean up
-    cJSON_Delete(root);
     free(json_string);
     return 0;
 }
@@ -0,0 +1,226 @@
+/**
+ * @file monitor_utils.c
+ * @brief Registry of the "metrics" app instances definition.
+ */
+
+#include "monitor_utils.h"
+
+//! \brief Every instance; a fixed array, so a pointer to one stays valid (i.e.: as the ctx of its event handlers).
+static monitor registry[MONITORS_MAX];
+//! \brief Lock over the samples of every instance (see monitor_lock_samples()).
+static pthread_mutex_t samples_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Resets a slot to an instance without process nor channels. Its name and history are left as they are.
+ * @param m The slot.
+ */
+static void reset_channels(monitor* m)
+{
+    m->pid = MONITOR_NO_PID;
+    m->pidfd = -1;
+    m->samples = NULL;
+    m->samples_fd = -1;
+    m->samples_recorded = 0;
+    m->history_timer = -1;
+    m->control_fd = -1;
+}
+
+bool monitor_name_valid(const char* name)
+{
+    const size_t len = strlen(name);
+    if (len == 0 || len >= MONITOR_NAME_SIZE || strcmp(name, MONITOR_ALL_NAME) == 0)
+    {
+        return false;
+    }
+    return strspn(name, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-") == len;
+}
+
+monitor* monitor_find(const char* name)
+{
+    for (size_t i = 0; i < MONITORS_MAX; i++)
+    {
+        if (registry[i].name[0] != '\0' && strcmp(registry[i].name, name) == 0)
+        {
+            return &registry[i];
+        }
+    }
+    return NULL;
+}
+
+monitor* monitor_claim(const char* name)
+{
+    monitor* m = monitor_find(name);
+    if (m != NULL && monitor_running(m))
+    {
+        errno = EEXIST;
+        return NULL;
+    }
+    // A free slot first, so the history of a stopped instance lasts as long as possible
+    for (size_t i = 0; m == NULL && i < MONITORS_MAX; i++)
+    {
+        m = registry[i].name[0] == '\0' ? &registry[i] : NULL;
+    }
+    for (size_t i = 0; m == NULL && i < MONITORS_MAX; i++)
+    {
+        m = !monitor_running(&registry[i]) ? &registry[i] : NULL;
+    }
+    if (m == NULL)
+    {
+        errno = ENOSPC;
+        return NULL;
+    }
+    if (m->name[0] == '\0')
+    {
+        reset_channels(m);
+    }
+    snprintf(m->name, sizeof(m->name), "%s", name);
+    // The history starts over with each "metrics" app
+    monitor_lock_samples();
+    if (m->history == NULL)
+    {
+        m->history = metrics_history_create();
+    }
+    else
+    {
+        metrics_history_clear(m->history);
+    }
+    monitor_unlock_samples();
+    return m;
+}
+
+monitor* monitor_registry(size_t* n_slots)
+{
+    *n_slots = MONITORS_MAX;
+    return registry;
+}
+
+void monitor_lock_samples(void)
+{
+    pthread_mutex_lock(&samples_lock);
+}
+
+void monitor_unlock_samples(void)
+{
+    pthread_mutex_unlock(&samples_lock);
+}
+
+void monitor_record_samples(monitor* m)
+{
+    if (m->samples == NULL)
+    {
+        return;
+    }
+    const uint64_t published = metrics_ring_published(m->samples);
+    uint64_t n = m->samples_recorded;
+    if (published - n > METRICS_RING_SLOTS)
+    {
+        n = published - METRICS_RING_SLOTS;
+    }
+    for (metrics_sample sample; n < published; n++)
+    {
+        if (metrics_ring_read(m->samples, n, &sample) && m->history != NULL)
+        {
+            metrics_history_add(m->history, &sample);
+        }
+    }
+    m->samples_recorded = published;
+}
+
+/**
+ * @brief Records the samples of an instance on its history, periodically. Meant to be an event_handler for a timer.
+ * @param fd Timer file descriptor.
+ * @param events Not used inside the function.
+ * @param ctx The instance.
+ */
+static void on_record_timer(int fd, uint32_t events, void* ctx)
+{
+    // Args ignored
+    (void)events;
+    uint64_t expirations;
+    if (read(fd, &expirations, sizeof(expirations)) > 0)
+    {
+        monitor_lock_samples();
+        monitor_record_samples(ctx);
+        monitor_unlock_samples();
+    }
+}
+
+/**
+ * @brief Forgets an instance, once its process exited. Meant to be an event_handler for its pidfd.
+ * @param fd Not used inside the function.
+ * @param events Not used inside the function.
+ * @param ctx The instance.
+ */
+static void on_monitor_exit(int fd, uint32_t events, void* ctx)
+{
+    // Args ignored
+    (void)fd;
+    (void)events;
+    monitor_forget(ctx);
+}
+
+void monitor_track(monitor* m, pid_t pid)
+{
+    m->pid = pid;
+    m->pidfd = event_pidfd(pid);
+    if (m->pidfd != -1)
+    {
+        event_watch(m->pidfd, EPOLLIN, on_monitor_exit, m);
+    }
+    if (m->samples != NULL)
+    {
+        m->history_timer = event_timer(MONITOR_RECORD_MS, on_record_timer, m);
+    }
+}
+
+bool monitor_running(monitor* m)
+{
+    struct pollfd exited = {m->pidfd, POLLIN, 0};
+    if (m->pidfd != -1 && poll(&exited, 1, 0) == 1)
+    {
+        monitor_forget(m);
+    }
+    return m->pid != MONITOR_NO_PID;
+}
+
+/**
+ * @brief Closes the channels of an instance (and unwatches its process), and resets them. Its name and history are
+ * left as they are.
+ * @param m The instance.
+ */
+static void close_channels(monitor* m)
+{
+    if (m->pidfd != -1)
+    {
+        event_close(m->pidfd);
+    }
+    if (m->history_timer != -1)
+    {
+        event_close(m->history_timer);
+    }
+    metrics_ring_release(m->samples);
+    if (m->samples_fd != -1)
+    {
+        close(m->samples_fd);
+    }
+    if (m->control_fd != -1)
+    {
+        close(m->control_fd);
+    }
+    reset_channels(m);
+}
+
+void monitor_forget(monitor* m)
+{
+    monitor_lock_samples();
+    monitor_record_samples(m);
+    monitor_unlock_samples();
+    close_channels(m);
+}
+
+void monitor_unclaim(monitor* m)
+{
+    close_channels(m);
+    // Its history (just cleared by monitor_claim()) stays allocated for the next instance of the slot
+    m->name[0] = '\0';
+}
@@ -0,0 +1,355 @@
+/**
+ * @file parallel_utils.c
+ * @brief Parallel batch execution definition.
+ */
+
+// pipe2()
+#define _GNU_SOURCE
+#include "parallel_utils.h"
+
+//! \brief Standard streams of a worker that get captured, in the order they're emitted.
+static const int captured_fds[] = {STDOUT_FILENO, STDERR_FILENO};
+//! \brief Amount of standard streams captured per worker.
+#define N_CAPTURED_FDS (sizeof(captured_fds) / sizeof(captured_fds[0]))
+
+//! \brief Output captured from one of the standard streams of a worker.
+typedef struct parallel_output
+{
+    //! \brief Read end of the pipe the worker writes to, or -1 once it was closed by the worker.
+    int fd;
+    //! \brief Output held until the line gets its turn to show it.
+    char* data;
+    //! \brief Bytes held.
+    size_t len;
+    //! \brief Room on data, in bytes.
+    size_t capacity;
+    //! \brief Couldn't data grow? Then the rest is left on the pipe, unwatched, until the line gets its turn.
+    bool stalled;
+} parallel_output;
+
+//! \brief A line running on a worker, or already finished but waiting for its turn to show its output.
+typedef struct parallel_job
+{
+    //! \brief Worker process id, or -1 once it was reaped.
+    pid_t pid;
+    //! \brief Captured standard streams, as of captured_fds.
+    parallel_output outputs[N_CAPTURED_FDS];
+} parallel_job;
+
+//! \brief State of a parallel run of a batch file.
+typedef struct parallel_run
+{
+    //! \brief Ring of jobs, in the order of their lines.
+    parallel_job* slots;
+    //! \brief Slots of the ring, i.e.: maximum amount of lines run at the same time.
+    unsigned jobs;
+    //! \brief Slot of the oldest line whose output wasn't completely shown yet.
+    unsigned head;
+    //! \brief Slots in use, starting at head.
+    unsigned n_pending;
+    //! \brief Poll set, rebuilt on each wait: room for every stream of every slot.
+    struct pollfd* poll_fds;
+    //! \brief Slot index of each entry of poll_fds, as slot * N_CAPTURED_FDS + stream.
+    unsigned* poll_owners;
+    //! \brief Decides how each line has to be run.
+    parallel_line_classifier classifier;
+    //! \brief Runs a line.
+    batch_line_handler runner;
+    //! \brief Passed as is to the classifier and the runner.
+    void* ctx;
+} parallel_run;
+
+/**
+ * @brief Writes a whole chunk of memory to a file descriptor, retrying partial writes.
+ * @param fd File descriptor to write to.
+ * @param data Chunk of memory.
+ * @param len Bytes to write.
+ */
+static void write_all(int fd, const char* data, size_t len)
+{
+    while (len > 0)
+    {
+        const ssize_t written = write(fd, data, len);
+        if (written == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            // Nobody to show it to (i.e.: closed pipe); the output is dropped, as it would be on a sequential run
+            return;
+        }
+        data += written;
+        len -= (size_t)written;
+    }
+}
+
+/**
+ * @brief Shows (and forgets) the output a job held while it wasn't its turn.
+ * @param job Job that just became the oldest one.
+ */
+static void emit_held_output(parallel_job* job)
+{
+    for (size_t i = 0; i < N_CAPTURED_FDS; i++)
+    {
+        write_all(captured_fds[i], job->outputs[i].data, job->outputs[i].len);
+        job->outputs[i].len = 0;
+    }
+}
+
+/**
+ * @brief Frees the slots of the oldest jobs that finished, showing the held output of the ones after them.
+ * @param run Parallel run.
+ */
+static void retire_finished_jobs(parallel_run* run)
+{
+    while (run->n_pending > 0 && run->slots[run->head].pid == -1)
+    {
+        parallel_job* job = &run->slots[run->head];
+        for (size_t i = 0; i < N_CAPTURED_FDS; i++)
+        {
+            free(job->outputs[i].data);
+            job->outputs[i] = (parallel_output){-1, NULL, 0, 0, false};
+        }
+        run->head = (run->head + 1) % run->jobs;
+        run->n_pending--;
+        if (run->n_pending > 0)
+        {
+            emit_held_output(&run->slots[run->head]);
+        }
+    }
+}
+
+/**
+ * @brief Consumes what a worker wrote to one of its captured streams: passed through if it's the oldest job,
+ * held otherwise. Once both streams are closed, the worker gets reaped.
+ * @param run Parallel run.
+ * @param slot Slot of the job.
+ * @param stream Index of the stream, as of captured_fds.
+ */
+static void consume_output(parallel_run* run, unsigned slot, size_t stream)
+{
+    parallel_job* job = &run->slots[slot];
+    parallel_output* output = &job->outputs[stream];
+    const bool is_oldest = slot == run->head;
+    char chunk[PARALLEL_READ_CHUNK];
+    char* destination = chunk;
+    if (!is_oldest)
+    {
+        if (output->capacity - output->len < PARALLEL_READ_CHUNK)
+        {
+            const size_t capacity = output->capacity == 0 ? PARALLEL_READ_CHUNK : output->capacity * 2;
+            char* data = realloc(output->data, capacity);
+            if (data == NULL)
+            {
+                // Leave it on the pipe (the worker blocks once it's full) until the job gets its turn
+                output->stalled = true;
+                return;
+            }
+            output->data = data;
+            output->capacity = capacity;
+        }
+        destination = output->data + output->len;
+    }
+    const ssize_t n_read = read(output->fd, destination, PARALLEL_READ_CHUNK);
+    if (n_read == -1 && errno == EINTR)
+    {
+        return;
+    }
+    if (n_read > 0)
+    {
+        if (is_oldest)
+        {
+            write_all(captured_fds[stream], chunk, (size_t)n_read);
+        }
+        else
+        {
+            output->len += (size_t)n_read;
+        }
+        return;
+    }
+    // End of the stream (or a broken one)
+    close(output->fd);
+    output->fd = -1;
+    for (size_t i = 0; i < N_CAPTURED_FDS; i++)
+    {
+        if (job->outputs[i].fd != -1)
+        {
+            return;
+        }
+    }
+    // The worker closed everything, so it's finishing
+    while (waitpid(job->pid, NULL, 0) == -1 && errno == EINTR)
+    {
+    }
+    job->pid = -1;
+}
+
+/**
+ * @brief Waits until some worker writes or finishes, and handles it.
+ * @param run Parallel run.
+ */
+static void await_workers(parallel_run* run)
+{
+    nfds_t n_fds = 0;
+    for (unsigned i = 0; i < run->n_pending; i++)
+    {
+        const unsigned slot = (run->head + i) % run->jobs;
+        for (size_t j = 0; j < N_CAPTURED_FDS; j++)
+        {
+            // A stalled stream would be ready again right away, but only the oldest job can read it
+            if (run->slots[slot].outputs[j].fd != -1 && (!run->slots[slot].outputs[j].stalled || i == 0))
+            {
+                run->poll_fds[n_fds] = (struct pollfd){run->slots[slot].outputs[j].fd, POLLIN, 0};
+                run->poll_owners[n_fds++] = slot * N_CAPTURED_FDS + j;
+            }
+        }
+    }
+    if (n_fds > 0 && poll(run->poll_fds, n_fds, -1) > 0)
+    {
+        for (nfds_t i = 0; i < n_fds; i++)
+        {
+            if (run->poll_fds[i].revents != 0)
+            {
+                consume_output(run, run->poll_owners[i] / N_CAPTURED_FDS, run->poll_owners[i] % N_CAPTURED_FDS);
+            }
+        }
+    }
+    retire_finished_jobs(run);
+}
+
+/**
+ * @brief Waits for every line run so far to finish and show its output.
+ * @param run Parallel run.
+ */
+static void await_all_workers(parallel_run* run)
+{
+    while (run->n_pending > 0)
+    {
+        await_workers(run);
+    }
+}
+
+/**
+ * @brief Runs a line on a new worker, using the next free slot.
+ * @param run Parallel run. Must have a free slot.
+ * @param line The line.
+ * @param len Length of the line, in bytes.
+ * @return true if the worker was started, false if it couldn't be (the line wasn't run).
+ */
+static bool start_worker(parallel_run* run, const char* line, size_t len)
+{
+    const unsigned slot = (run->head + run->n_pending) % run->jobs;
+    parallel_job* job = &run->slots[slot];
+    int pipesfd[N_CAPTURED_FDS][2];
+    for (size_t i = 0; i < N_CAPTURED_FDS; i++)
+    {
+        if (pipe2(pipesfd[i], O_CLOEXEC) == -1)
+        {
+            for (size_t j = 0; j < i; j++)
+            {
+                close(pipesfd[j][0]);
+                close(pipesfd[j][1]);
+            }
+            return false;
+        }
+    }
+    // Don't let the worker inherit pending stdio data
+    fflush(stdout);
+    fflush(stderr);
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        // Worker: concurrent lines can't share the shell stdin, and their output goes to their own pipes
+        const int stdin_fd = open(PARALLEL_STDIN_PATH, O_RDONLY);
+        if (stdin_fd != -1)
+        {
+            dup2(stdin_fd, STDIN_FILENO);
+            close(stdin_fd);
+        }
+        for (size_t i = 0; i < N_CAPTURED_FDS; i++)
+        {
+            dup2(pipesfd[i][1], captured_fds[i]);
+        }
+        run->runner(line, len, run->ctx);
+        fflush(stdout);
+        fflush(stderr);
+        _exit(EXIT_SUCCESS);
+    }
+    for (size_t i = 0; i < N_CAPTURED_FDS; i++)
+    {
+        close(pipesfd[i][1]);
+        if (pid == -1)
+        {
+            close(pipesfd[i][0]);
+        }
+    }
+    if (pid == -1)
+    {
+        return false;
+    }
+    job->pid = pid;
+    for (size_t i = 0; i < N_CAPTURED_FDS; i++)
+    {
+        job->outputs[i] = (parallel_output){pipesfd[i][0], NULL, 0, 0, false};
+    }
+    run->n_pending++;
+    return true;
+}
+
+/**
+ * @brief Runs a line of the batch file the way its kind requires. Meant to be a batch_line_handler.
+ * @param line The line.
+ * @param len Length of the line, in bytes.
+ * @param ctx Parallel run.
+ */
+static void dispatch_line(const char* line, size_t len, void* ctx)
+{
+    parallel_run* run = ctx;
+    switch (run->classifier(line, len, run->ctx))
+    {
+    case PARALLEL_LINE_EMPTY:
+        return;
+    case PARALLEL_LINE_JOB:
+        while (run->n_pending == run->jobs)
+        {
+            await_workers(run);
+        }
+        if (start_worker(run, line, len))
+        {
+            return;
+        }
+        // No resources for a worker; run it the sequential way
+        await_all_workers(run);
+        run->runner(line, len, run->ctx);
+        break;
+    case PARALLEL_LINE_BARRIER:
+        await_all_workers(run);
+        run->runner(line, len, run->ctx);
+        break;
+    }
+    // Whatever the shell itself printed must appear before the output of the next lines
+    fflush(stdout);
+    fflush(stderr);
+}
+
+int parallel_for_each_line(int fd, unsigned jobs, parallel_line_classifier classifier, batch_line_handler runner,
+                           void* ctx)
+{
+    parallel_run run = {.jobs = jobs, .classifier = classifier, .runner = runner, .ctx = ctx};
+    run.slots = calloc(jobs, sizeof(parallel_job));
+    run.poll_fds = calloc(jobs * N_CAPTURED_FDS, sizeof(struct pollfd));
+    run.poll_owners = calloc(jobs * N_CAPTURED_FDS, sizeof(unsigned));
+    int result = -1;
+    if (run.slots != NULL && run.poll_fds != NULL && run.poll_owners != NULL)
+    {
+        result = batch_for_each_line(fd, dispatch_line, &run);
+        const int read_errno = errno;
+        await_all_workers(&run);
+        errno = read_errno;
+    }
+    free(run.slots);
+    free(run.poll_fds);
+    free(run.poll_owners);
+    return result;
+}
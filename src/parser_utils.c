@@ -0,0 +1,282 @@
+/**
+ * @file parser_utils.c
+ * @brief Command line lexer/parser definition.
+ */
+
+#include "parser_utils.h"
+
+//! \brief Lexical class of each input char; anything not listed is part of a word.
+enum char_kind
+{
+    CK_WORD = 0,
+    CK_BLANK,
+    CK_OPERATOR,
+    CK_QUOTE,
+    CK_ESCAPE
+};
+
+//! \brief Lexical class of every possible byte, so the lexer takes one decision per byte.
+static const unsigned char char_kinds[256] = {
+    [' '] = CK_BLANK,
+    ['\t'] = CK_BLANK,
+    ['\n'] = CK_BLANK,
+    ['\r'] = CK_BLANK,
+    [PIPE_OPERATOR] = CK_OPERATOR,
+    [STDIN_REDIRECTION_OPERATOR] = CK_OPERATOR,
+    [STDOUT_REDIRECTION_OPERATOR] = CK_OPERATOR,
+    [BACKGROUND_OPERATOR] = CK_OPERATOR,
+    ['\''] = CK_QUOTE,
+    ['"'] = CK_QUOTE,
+    [ESCAPE_CHAR] = CK_ESCAPE,
+};
+
+/**
+ * @brief Leaves the reason of a malformed command line on the AST.
+ * @param pipeline AST being filled.
+ * @param error Reason, ready to be shown to the user.
+ * @return Always -1, so it can be returned right away.
+ */
+static int parse_error(cmd_pipeline* pipeline, const char* error)
+{
+    pipeline->error = error;
+    return -1;
+}
+
+/**
+ * @brief Appends an empty single command to the pipeline, growing its room if needed.
+ * @param pipeline AST being filled.
+ * @param a Arena where the AST gets allocated.
+ * @return The new single command, or NULL if there's no room left (the reason is left on the AST).
+ */
+static cmd_stage* add_stage(cmd_pipeline* pipeline, arena* a)
+{
+    if (pipeline->n_stages == pipeline->stages_capacity)
+    {
+        const uint32_t capacity =
+            pipeline->stages_capacity == 0 ? PIPELINE_INITIAL_STAGES : pipeline->stages_capacity * 2;
+        if (capacity > MAX_SINGLE_COMMANDS)
+        {
+            parse_error(pipeline, "ERROR: You surpassed the single commands limit for a command line.\n");
+            return NULL;
+        }
+        cmd_stage* stages = arena_alloc(a, capacity * sizeof(cmd_stage));
+        if (stages == NULL)
+        {
+            parse_error(pipeline, "ERROR: Failed to allocate memory\n");
+            return NULL;
+        }
+        if (pipeline->n_stages != 0)
+        {
+            memcpy(stages, pipeline->stages, pipeline->n_stages * sizeof(cmd_stage));
+        }
+        pipeline->stages = stages;
+        pipeline->stages_capacity = capacity;
+    }
+    cmd_stage* stage = &pipeline->stages[pipeline->n_stages++];
+    stage->n_words = 0;
+    stage->stdin_file = (cmd_span){0, 0};
+    stage->stdout_file = (cmd_span){0, 0};
+    return stage;
+}
+
+int parse_command_line(const char* input, size_t len, arena* a, cmd_pipeline* pipeline)
+{
+    pipeline->input = input;
+    pipeline->stages = NULL;
+    pipeline->n_stages = 0;
+    pipeline->stages_capacity = 0;
+    pipeline->background = false;
+    pipeline->error = NULL;
+    if (len > UINT32_MAX)
+    {
+        return parse_error(pipeline, "ERROR: The command line is too long.\n");
+    }
+    // Single command being filled (NULL right after a "|"), and where the next word goes if it's a redirection file
+    cmd_stage* stage = NULL;
+    cmd_span* redirection = NULL;
+    size_t i = 0;
+    while (i < len)
+    {
+        const unsigned char kind = char_kinds[(unsigned char)input[i]];
+        if (kind == CK_BLANK)
+        {
+            i++;
+            continue;
+        }
+        if (pipeline->background)
+        {
+            return parse_error(pipeline, "ERROR: \"&\" must be the last token of the command line.\n");
+        }
+        if (kind == CK_OPERATOR)
+        {
+            if (redirection != NULL)
+            {
+                return parse_error(pipeline, "ERROR: A redirection is missing its file.\n");
+            }
+            if (input[i] == PIPE_OPERATOR)
+            {
+                if (stage == NULL || stage->n_words == 0)
+                {
+                    return parse_error(pipeline, "ERROR: A command is missing around \"|\".\n");
+                }
+                stage = NULL;
+            }
+            else if (input[i] == BACKGROUND_OPERATOR)
+            {
+                pipeline->background = true;
+            }
+            else
+            {
+                if (stage == NULL && (stage = add_stage(pipeline, a)) == NULL)
+                {
+                    return -1;
+                }
+                redirection = input[i] == STDIN_REDIRECTION_OPERATOR ? &stage->stdin_file : &stage->stdout_file;
+            }
+            i++;
+            continue;
+        }
+        // A word starts here; it ends on the first blank or operator outside quotes
+        const size_t start = i;
+        while (i < len)
+        {
+            const unsigned char word_kind = char_kinds[(unsigned char)input[i]];
+            if (word_kind == CK_BLANK || word_kind == CK_OPERATOR)
+            {
+                break;
+            }
+            else if (word_kind == CK_ESCAPE)
+            {
+                i += (i + 1 < len) ? 2 : 1;
+            }
+            else if (word_kind == CK_QUOTE)
+            {
+                // Inside double quotes '\' still escapes; inside single quotes nothing does
+                const char quote = input[i++];
+                while (i < len && input[i] != quote)
+                {
+                    i += (quote == '"' && input[i] == ESCAPE_CHAR && i + 1 < len) ? 2 : 1;
+                }
+                if (i >= len)
+                {
+                    return parse_error(pipeline, "ERROR: A quoted string is missing its closing quote.\n");
+                }
+                i++;
+            }
+            else
+            {
+                i++;
+            }
+        }
+        const cmd_span word = {(uint32_t)start, (uint32_t)(i - start)};
+        if (redirection != NULL)
+        {
+            *redirection = word;
+            redirection = NULL;
+            continue;
+        }
+        if (stage == NULL && (stage = add_stage(pipeline, a)) == NULL)
+        {
+            return -1;
+        }
+        if (stage->n_words == MAX_TOKENS_PER_COMMAND)
+        {
+            return parse_error(pipeline, "ERROR: You surpassed the arguments limit for a command.\n");
+        }
+        stage->words[stage->n_words++] = word;
+    }
+    if (redirection != NULL)
+    {
+        return parse_error(pipeline, "ERROR: A redirection is missing its file.\n");
+    }
+    if ((stage == NULL && pipeline->n_stages > 0) || (stage != NULL && stage->n_words == 0))
+    {
+        return parse_error(pipeline, "ERROR: A command is missing around \"|\".\n");
+    }
+    if (pipeline->n_stages == 0 && pipeline->background)
+    {
+        return parse_error(pipeline, "ERROR: \"&\" needs a command to send to the background.\n");
+    }
+    return 0;
+}
+
+char* cmd_span_str(const cmd_pipeline* pipeline, cmd_span span, arena* a)
+{
+    if (span.len == 0)
+    {
+        return NULL;
+    }
+    const char* src = pipeline->input + span.offset;
+    // Quotes and escapes only make the string shorter
+    char* str = arena_alloc(a, span.len + 1);
+    if (str == NULL)
+    {
+        return NULL;
+    }
+    size_t n = 0;
+    char quote = '\0';
+    for (size_t i = 0; i < span.len; i++)
+    {
+        const char c = src[i];
+        if (quote == '\'')
+        {
+            if (c == '\'')
+            {
+                quote = '\0';
+            }
+            else
+            {
+                str[n++] = c;
+            }
+        }
+        else if (quote == '"')
+        {
+            if (c == '"')
+            {
+                quote = '\0';
+            }
+            else if (c == ESCAPE_CHAR && i + 1 < span.len && (src[i + 1] == '"' || src[i + 1] == ESCAPE_CHAR))
+            {
+                str[n++] = src[++i];
+            }
+            else
+            {
+                str[n++] = c;
+            }
+        }
+        else if (c == '\'' || c == '"')
+        {
+            quote = c;
+        }
+        else if (c == ESCAPE_CHAR && i + 1 < span.len)
+        {
+            str[n++] = src[++i];
+        }
+        else
+        {
+            str[n++] = c;
+        }
+    }
+    str[n] = '\0';
+    return str;
+}
+
+char** cmd_stage_argv(const cmd_pipeline* pipeline, const cmd_stage* stage, arena* a)
+{
+    char** argv = arena_alloc(a, (stage->n_words + 1) * sizeof(char*));
+    if (argv == NULL)
+    {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < stage->n_words; i++)
+    {
+        argv[i] = cmd_span_str(pipeline, stage->words[i], a);
+        if (argv[i] == NULL)
+        {
+            return NULL;
+        }
+    }
+    // "close" the argv list
+    argv[stage->n_words] = NULL;
+    return argv;
+}
@@ -0,0 +1,362 @@
+/**
+ * @file path_utils.c
+ * @brief Command lookup on PATH, with a "hash" (bash-like) cache, definition.
+ */
+
+#include "path_utils.h"
+
+//! \brief Directories searched when PATH isn't set, same as execvp() does.
+#define PATH_DEFAULT_DIRS "/bin:/usr/bin"
+//! \brief FNV-1a 64 bits offset basis.
+#define FNV1A_OFFSET_BASIS 0xcbf29ce484222325ULL
+//! \brief FNV-1a 64 bits prime.
+#define FNV1A_PRIME 0x100000001b3ULL
+
+//! \brief The whole cache state; entries are only valid for the PATH value (and dirs content) they were resolved on.
+static struct
+{
+    //! \brief Open addressing (linear probing) table of entries.
+    path_cache_entry* slots;
+    //! \brief Amount of slots, always a power of 2.
+    size_t n_slots;
+    //! \brief Amount of slots in use.
+    size_t n_used;
+    //! \brief PATH value the entries were resolved with.
+    char* path_env;
+    //! \brief Each one of the PATH dirs.
+    char** dirs;
+    //! \brief mtime of each PATH dir, when the inotify watch isn't available.
+    struct timespec* dirs_mtime;
+    //! \brief Amount of PATH dirs.
+    size_t n_dirs;
+    //! \brief true if some PATH dir is relative to the cwd; lookups resolved with them aren't remembered.
+    bool relative_dirs;
+    //! \brief inotify instance watching the PATH dirs, or -1 to compare their mtime instead.
+    int inotify_fd;
+} cache = {.inotify_fd = -1};
+
+/**
+ * @brief FNV-1a hash of a command name.
+ * @param name Command name.
+ * @return Its hash.
+ */
+static uint64_t hash_name(const char* name)
+{
+    uint64_t hash = FNV1A_OFFSET_BASIS;
+    for (const unsigned char* c = (const unsigned char*)name; *c != '\0'; c++)
+    {
+        hash = (hash ^ *c) * FNV1A_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Finds the slot of a name: the one holding it, or the unused one where it would be placed.
+ * @param slots Table of entries.
+ * @param n_slots Amount of slots of the table, a power of 2.
+ * @param name Command name.
+ * @param hash Hash of the name.
+ * @return The slot found. The table always has unused slots, so there's always one.
+ */
+static path_cache_entry* find_slot(path_cache_entry* slots, size_t n_slots, const char* name, uint64_t hash)
+{
+    size_t i = hash & (n_slots - 1);
+    while (slots[i].name != NULL && (slots[i].hash != hash || strcmp(slots[i].name, name) != 0))
+    {
+        i = (i + 1) & (n_slots - 1);
+    }
+    return &slots[i];
+}
+
+/**
+ * @brief Doubles the amount of slots of the cache (or allocates the initial ones), re-placing every entry.
+ * @return true if it could be done, false otherwise.
+ */
+static bool grow_slots(void)
+{
+    const size_t n_slots = cache.n_slots == 0 ? PATH_CACHE_INITIAL_SLOTS : cache.n_slots * 2;
+    path_cache_entry* slots = calloc(n_slots, sizeof(path_cache_entry));
+    if (slots == NULL)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < cache.n_slots; i++)
+    {
+        if (cache.slots[i].name != NULL)
+        {
+            *find_slot(slots, n_slots, cache.slots[i].name, cache.slots[i].hash) = cache.slots[i];
+        }
+    }
+    free(cache.slots);
+    cache.slots = slots;
+    cache.n_slots = n_slots;
+    return true;
+}
+
+/**
+ * @brief Gets the last modification time of a dir.
+ * @param dir Path to the dir.
+ * @param mtime Where to leave the time. Zeroed if the dir can't be reached.
+ * @return true if the dir could be reached, false otherwise.
+ */
+static bool dir_mtime(const char* dir, struct timespec* mtime)
+{
+    struct stat stat_buffer;
+    if (stat(dir, &stat_buffer) == -1)
+    {
+        mtime->tv_sec = 0;
+        mtime->tv_nsec = 0;
+        return false;
+    }
+    *mtime = stat_buffer.st_mtim;
+    return true;
+}
+
+/**
+ * @brief Splits a PATH value into its dirs, taking a snapshot of their mtime and watching them for changes.
+ * @param path_env PATH value.
+ */
+static void load_dirs(const char* path_env)
+{
+    free(cache.path_env);
+    for (size_t i = 0; i < cache.n_dirs; i++)
+    {
+        free(cache.dirs[i]);
+    }
+    free(cache.dirs);
+    free(cache.dirs_mtime);
+    cache.dirs = NULL;
+    cache.dirs_mtime = NULL;
+    cache.n_dirs = 0;
+    cache.relative_dirs = false;
+    // A new inotify instance drops every watch of the previous PATH at once
+    if (cache.inotify_fd != -1)
+    {
+        close(cache.inotify_fd);
+    }
+    cache.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    cache.path_env = strdup(path_env);
+    if (cache.path_env == NULL)
+    {
+        return;
+    }
+    // One more dir than separators found
+    size_t n_dirs = 1;
+    for (const char* c = path_env; *c != '\0'; c++)
+    {
+        n_dirs += *c == PATH_DIRS_SEPARATOR;
+    }
+    cache.dirs = calloc(n_dirs, sizeof(char*));
+    cache.dirs_mtime = calloc(n_dirs, sizeof(struct timespec));
+    if (cache.dirs == NULL || cache.dirs_mtime == NULL)
+    {
+        return;
+    }
+    const char* start = path_env;
+    while (cache.n_dirs < n_dirs)
+    {
+        const char* end = strchr(start, PATH_DIRS_SEPARATOR);
+        const size_t len = end == NULL ? strlen(start) : (size_t)(end - start);
+        // An empty entry means the cwd
+        char* dir = len == 0 ? strdup(".") : strndup(start, len);
+        if (dir == NULL)
+        {
+            break;
+        }
+        cache.relative_dirs |= dir[0] != '/';
+        dir_mtime(dir, &cache.dirs_mtime[cache.n_dirs]);
+        if (cache.inotify_fd != -1)
+        {
+            inotify_add_watch(cache.inotify_fd, dir, PATH_DIR_WATCHED_EVENTS);
+        }
+        cache.dirs[cache.n_dirs++] = dir;
+        start = end == NULL ? start + len : end + 1;
+    }
+}
+
+/**
+ * @brief Checks if any PATH dir got an entry added, removed, renamed or changed since the last check.
+ * @return true if so, false otherwise.
+ */
+static bool dirs_changed(void)
+{
+    if (cache.inotify_fd != -1)
+    {
+        // Any pending event means some PATH dir got its mtime changed; drain them all
+        char events[PATH_EVENTS_BUFFER];
+        bool changed = false;
+        while (read(cache.inotify_fd, events, sizeof(events)) > 0)
+        {
+            changed = true;
+        }
+        return changed;
+    }
+    for (size_t i = 0; i < cache.n_dirs; i++)
+    {
+        struct timespec mtime;
+        dir_mtime(cache.dirs[i], &mtime);
+        if (mtime.tv_sec != cache.dirs_mtime[i].tv_sec || mtime.tv_nsec != cache.dirs_mtime[i].tv_nsec)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Forgets every remembered lookup if PATH, or the contents of any of its dirs, changed.
+ */
+static void validate_cache(void)
+{
+    const char* path_env = getenv(ENV_PATH_KEY);
+    if (path_env == NULL)
+    {
+        path_env = PATH_DEFAULT_DIRS;
+    }
+    if (cache.path_env == NULL || strcmp(cache.path_env, path_env) != 0)
+    {
+        path_cache_flush();
+        load_dirs(path_env);
+    }
+    else if (dirs_changed())
+    {
+        path_cache_flush();
+        // Watches (or mtimes) get renewed, as a removed & recreated dir is a different inode
+        load_dirs(path_env);
+    }
+}
+
+/**
+ * @brief Walks the PATH dirs looking for an executable named after a command.
+ * @param name Command name.
+ * @param from_relative_dir Set to true if the answer depends on the cwd, and so can't be remembered.
+ * @return Allocated path to the executable, or NULL if not found.
+ */
+static char* resolve(const char* name, bool* from_relative_dir)
+{
+    char candidate[PATH_MAX];
+    for (size_t i = 0; i < cache.n_dirs; i++)
+    {
+        if (snprintf(candidate, sizeof(candidate), "%s/%s", cache.dirs[i], name) >= (int)sizeof(candidate))
+        {
+            continue;
+        }
+        // Same outcome execvp() would get: first regular file that can be executed
+        struct stat stat_buffer;
+        if (stat(candidate, &stat_buffer) == 0 && S_ISREG(stat_buffer.st_mode) && access(candidate, X_OK) == 0)
+        {
+            *from_relative_dir = cache.dirs[i][0] != '/';
+            return strdup(candidate);
+        }
+    }
+    *from_relative_dir = cache.relative_dirs;
+    return NULL;
+}
+
+const char* path_cache_lookup(const char* name)
+{
+    // Paths (absolute or relative) are executed as they are
+    if (strchr(name, '/') != NULL)
+    {
+        return name;
+    }
+    validate_cache();
+    const uint64_t hash = hash_name(name);
+    if (cache.n_slots != 0)
+    {
+        path_cache_entry* entry = find_slot(cache.slots, cache.n_slots, name, hash);
+        if (entry->name != NULL)
+        {
+            entry->hits++;
+            if (entry->path == NULL)
+            {
+                errno = ENOENT;
+            }
+            return entry->path;
+        }
+    }
+    // Not remembered; walk PATH once
+    bool from_relative_dir;
+    char* path = resolve(name, &from_relative_dir);
+    if (!from_relative_dir && ((cache.n_used + 1) * 100 <= cache.n_slots * PATH_CACHE_MAX_LOAD_PCT || grow_slots()))
+    {
+        path_cache_entry* entry = find_slot(cache.slots, cache.n_slots, name, hash);
+        entry->name = strdup(name);
+        if (entry->name != NULL)
+        {
+            entry->path = path;
+            entry->hash = hash;
+            entry->hits = 1;
+            cache.n_used++;
+        }
+    }
+    else
+    {
+        // Can't be remembered; keep the answer alive until the next lookup
+        static char* uncached_path = NULL;
+        free(uncached_path);
+        uncached_path = path;
+    }
+    if (path == NULL)
+    {
+        errno = ENOENT;
+    }
+    return path;
+}
+
+void path_cache_forget(const char* name)
+{
+    if (cache.n_slots == 0)
+    {
+        return;
+    }
+    path_cache_entry* entry = find_slot(cache.slots, cache.n_slots, name, hash_name(name));
+    if (entry->name == NULL)
+    {
+        return;
+    }
+    free(entry->name);
+    free(entry->path);
+    entry->name = NULL;
+    cache.n_used--;
+    // Linear probing: the rest of the cluster gets re-placed, so no lookup stops at the hole just made
+    size_t i = (size_t)(entry - cache.slots);
+    for (i = (i + 1) & (cache.n_slots - 1); cache.slots[i].name != NULL; i = (i + 1) & (cache.n_slots - 1))
+    {
+        path_cache_entry moved = cache.slots[i];
+        cache.slots[i].name = NULL;
+        *find_slot(cache.slots, cache.n_slots, moved.name, moved.hash) = moved;
+    }
+}
+
+void path_cache_flush(void)
+{
+    for (size_t i = 0; i < cache.n_slots; i++)
+    {
+        free(cache.slots[i].name);
+        free(cache.slots[i].path);
+        cache.slots[i].name = NULL;
+        cache.slots[i].path = NULL;
+    }
+    cache.n_used = 0;
+}
+
+void path_cache_print(FILE* out)
+{
+    validate_cache();
+    if (cache.n_used == 0)
+    {
+        fputs("hash: hash table empty\n", out);
+        return;
+    }
+    fputs("hits\tcommand\n", out);
+    for (size_t i = 0; i < cache.n_slots; i++)
+    {
+        const path_cache_entry* entry = &cache.slots[i];
+        if (entry->name != NULL)
+        {
+            fprintf(out, "%4lu\t%s%s\n", entry->hits, entry->path == NULL ? entry->name : entry->path,
+                    entry->path == NULL ? " (not found)" : "");
+        }
+    }
+}
@@ -0,0 +1,276 @@
+/**
+ * @file query_utils.c
+ * @brief Queries over JSON config files definition.
+ */
+
+// memmem()
+#define _GNU_SOURCE
+#include "query_utils.h"
+
+//! \brief Spelling of each comparison, as of query_op; the two-character ones go first, so they're looked for first.
+static const struct
+{
+    //! \brief How it's written.
+    const char* text;
+    //! \brief The comparison.
+    enum query_op op;
+} query_ops[] = {{"==", QUERY_EQ}, {"!=", QUERY_NE}, {"<=", QUERY_LE}, {">=", QUERY_GE},
+                 {"=", QUERY_EQ},  {"<", QUERY_LT},  {">", QUERY_GT}};
+
+/**
+ * @brief Tells if a key is a non-negative integer, so it can index an array.
+ * @param key The key.
+ * @return true if it is.
+ */
+static bool is_index_key(const char* key)
+{
+    return key[0] != '\0' && strspn(key, "0123456789") == strlen(key);
+}
+
+/**
+ * @brief Compiles a path, adding its keys to the needles of the query.
+ * @param query The query.
+ * @param text The path, as typed.
+ * @param len Bytes of the path.
+ * @param path Where to leave it.
+ * @return true if it's valid, false otherwise (the error gets shown).
+ */
+static bool compile_path(json_query* query, const char* text, size_t len, query_path* path)
+{
+    for (size_t start = 0; start <= len;)
+    {
+        const char* separator = memchr(text + start, QUERY_KEY_SEPARATOR, len - start);
+        const size_t key_len = separator != NULL ? (size_t)(separator - (text + start)) : len - start;
+        if (key_len == 0 || path->n_keys == QUERY_MAX_KEYS)
+        {
+            fprintf(stderr, "ERROR: `%.*s` isn't a valid path (up to %d non-empty keys, separated by \"%c\").\n",
+                    (int)len, text, QUERY_MAX_KEYS, QUERY_KEY_SEPARATOR);
+            return false;
+        }
+        char* key = strndup(text + start, key_len);
+        if (key == NULL)
+        {
+            perror("ERROR: On query compiling");
+            return false;
+        }
+        path->keys[path->n_keys++] = key;
+        // An array index isn't written on the document, nor a key that would be escaped on it
+        if (!is_index_key(key) && strpbrk(key, "\"\\") == NULL)
+        {
+            char* needle = malloc(key_len + 3);
+            if (needle != NULL)
+            {
+                snprintf(needle, key_len + 3, "\"%s\"", key);
+                query->needles[query->n_needles++] = needle;
+            }
+        }
+        start += key_len + 1;
+    }
+    return true;
+}
+
+/**
+ * @brief Compiles a predicate.
+ * @param query The query.
+ * @param text The predicate, as typed.
+ * @param predicate Where to leave it.
+ * @return true if it's valid, false otherwise (the error gets shown).
+ */
+static bool compile_predicate(json_query* query, const char* text, query_predicate* predicate)
+{
+    const size_t path_len = strcspn(text, "=!<>");
+    for (size_t i = 0; i < sizeof(query_ops) / sizeof(query_ops[0]); i++)
+    {
+        const size_t op_len = strlen(query_ops[i].text);
+        if (strncmp(text + path_len, query_ops[i].text, op_len) != 0)
+        {
+            continue;
+        }
+        if (!compile_path(query, text, path_len, &predicate->path))
+        {
+            return false;
+        }
+        predicate->op = query_ops[i].op;
+        const char* value = text + path_len + op_len;
+        predicate->value = cJSON_ParseWithOpts(value, NULL, true);
+        if (predicate->value == NULL)
+        {
+            // Not JSON: a bare word, taken as a string
+            predicate->value = cJSON_CreateString(value);
+        }
+        return predicate->value != NULL;
+    }
+    fprintf(stderr, "ERROR: `%s` isn't a valid predicate (i.e.: \"update_interval>5\").\n", text);
+    return false;
+}
+
+int json_query_compile(json_query* query, const char* select, char* const* where, size_t n_where)
+{
+    if (n_where > QUERY_MAX_PREDICATES)
+    {
+        fprintf(stderr, "ERROR: A query can have up to %d predicates.\n", QUERY_MAX_PREDICATES);
+        return -1;
+    }
+    query->has_select = select != NULL;
+    if (select != NULL && !compile_path(query, select, strlen(select), &query->select))
+    {
+        return -1;
+    }
+    for (; query->n_where < n_where; query->n_where++)
+    {
+        if (!compile_predicate(query, where[query->n_where], &query->where[query->n_where]))
+        {
+            // Counted anyway, so whatever it holds gets freed
+            query->n_where++;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Releases the keys of a path.
+ * @param path The path.
+ */
+static void free_path(query_path* path)
+{
+    for (size_t i = 0; i < path->n_keys; i++)
+    {
+        free(path->keys[i]);
+    }
+    path->n_keys = 0;
+}
+
+void json_query_free(json_query* query)
+{
+    free_path(&query->select);
+    for (size_t i = 0; i < query->n_where; i++)
+    {
+        free_path(&query->where[i].path);
+        cJSON_Delete(query->where[i].value);
+    }
+    for (size_t i = 0; i < query->n_needles; i++)
+    {
+        free(query->needles[i]);
+    }
+    memset(query, 0, sizeof(*query));
+}
+
+bool json_query_may_match(const json_query* query, const char* text, size_t len)
+{
+    // Any escape could be part of a key (i.e.: "\/" for '/', or "\u" for any char), so it takes a parse to tell
+    if (memchr(text, '\\', len) != NULL)
+    {
+        return true;
+    }
+    for (size_t i = 0; i < query->n_needles; i++)
+    {
+        if (memmem(text, len, query->needles[i], strlen(query->needles[i])) == NULL)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Goes through a path from a JSON value.
+ * @param node The value.
+ * @param path The path.
+ * @return The value at the end of the path, or NULL if there's none.
+ */
+static const cJSON* lookup(const cJSON* node, const query_path* path)
+{
+    for (size_t i = 0; node != NULL && i < path->n_keys; i++)
+    {
+        if (cJSON_IsObject(node))
+        {
+            node = cJSON_GetObjectItemCaseSensitive(node, path->keys[i]);
+        }
+        else if (cJSON_IsArray(node) && is_index_key(path->keys[i]))
+        {
+            node = cJSON_GetArrayItem(node, atoi(path->keys[i]));
+        }
+        else
+        {
+            node = NULL;
+        }
+    }
+    return node;
+}
+
+/**
+ * @brief Tells if a value holds a predicate. Numbers and strings can be ordered; booleans and null can only be equal.
+ * Values of different kinds are only unequal.
+ * @param found The value, or NULL if the document doesn't have it.
+ * @param predicate The predicate.
+ * @return true if it holds it.
+ */
+static bool holds(const cJSON* found, const query_predicate* predicate)
+{
+    if (found == NULL)
+    {
+        return false;
+    }
+    const cJSON* value = predicate->value;
+    bool comparable = true;
+    bool ordered = false;
+    int order = 0;
+    if (cJSON_IsNumber(found) && cJSON_IsNumber(value))
+    {
+        ordered = true;
+        order = (found->valuedouble > value->valuedouble) - (found->valuedouble < value->valuedouble);
+    }
+    else if (cJSON_IsString(found) && cJSON_IsString(value))
+    {
+        ordered = true;
+        order = strcmp(found->valuestring, value->valuestring);
+    }
+    else if (cJSON_IsBool(found) && cJSON_IsBool(value))
+    {
+        order = cJSON_IsTrue(found) != cJSON_IsTrue(value);
+    }
+    else
+    {
+        comparable = cJSON_IsNull(found) && cJSON_IsNull(value);
+    }
+    switch (predicate->op)
+    {
+    case QUERY_EQ:
+        return comparable && order == 0;
+    case QUERY_NE:
+        return !comparable || order != 0;
+    case QUERY_LT:
+        return ordered && order < 0;
+    case QUERY_LE:
+        return ordered && order <= 0;
+    case QUERY_GT:
+        return ordered && order > 0;
+    case QUERY_GE:
+        return ordered && order >= 0;
+    }
+    return false;
+}
+
+bool json_query_match(const json_query* query, const char* text, size_t len, char** value)
+{
+    *value = NULL;
+    cJSON* document = cJSON_ParseWithLength(text, len);
+    if (document == NULL)
+    {
+        return false;
+    }
+    bool matched = true;
+    for (size_t i = 0; matched && i < query->n_where; i++)
+    {
+        matched = holds(lookup(document, &query->where[i].path), &query->where[i]);
+    }
+    if (matched && query->has_select)
+    {
+        const cJSON* selected = lookup(document, &query->select);
+        matched = selected != NULL;
+        *value = matched ? cJSON_PrintUnformatted(selected) : NULL;
+    }
+    cJSON_Delete(document);
+    return matched;
+}
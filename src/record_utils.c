@@ -0,0 +1,397 @@
+/**
+ * @file record_utils.c
+ * @brief Machine-readable records writer definition.
+ */
+
+#include "record_utils.h"
+
+//! \brief Nanoseconds on a second.
+#define NANOS_PER_SECOND 1000000000L
+//! \brief Decimals of the mtime.
+#define MTIME_DECIMALS 9
+
+bool record_format_parse(const char* name, enum record_format* format)
+{
+    static const char* const names[] = {
+        [RECORD_NDJSON] = RECORD_NDJSON_NAME,
+        [RECORD_NULL] = RECORD_NULL_NAME,
+        [RECORD_TSV] = RECORD_TSV_NAME,
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (strcmp(name, names[i]) == 0)
+        {
+            *format = (enum record_format)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+int record_writer_init(record_writer* writer, int fd, enum record_format format, bool with_content)
+{
+    *writer = (record_writer){.fd = fd, .format = format, .with_content = with_content};
+    for (unsigned c = 0; c < RECORD_BYTE_VALUES && format != RECORD_NULL; c++)
+    {
+        writer->escaped[c] = c == '\\' || (format == RECORD_NDJSON ? c < 0x20 || c == '"' || c >= 0x80
+                                                                     : c == '\t' || c == '\n' || c == '\r');
+    }
+    writer->buffer = malloc(RECORD_BUFFER_SIZE);
+    return writer->buffer == NULL ? -1 : 0;
+}
+
+int record_writer_flush(record_writer* writer)
+{
+    for (size_t done = 0; writer->error == 0 && done < writer->len;)
+    {
+        const ssize_t written = write(writer->fd, writer->buffer + done, writer->len - done);
+        if (written == -1 && errno != EINTR)
+        {
+            writer->error = errno;
+        }
+        done += written > 0 ? (size_t)written : 0;
+    }
+    writer->len = 0;
+    if (writer->error != 0)
+    {
+        errno = writer->error;
+        return -1;
+    }
+    return 0;
+}
+
+int record_writer_destroy(record_writer* writer)
+{
+    const int flushed = record_writer_flush(writer);
+    const int error = errno;
+    free(writer->buffer);
+    writer->buffer = NULL;
+    errno = error;
+    return flushed;
+}
+
+/**
+ * @brief Keeps bytes on the buffer, writing it whenever it fills up.
+ * @param writer The writer.
+ * @param bytes The bytes.
+ * @param len Amount of bytes.
+ */
+static void put_bytes(record_writer* writer, const char* bytes, size_t len)
+{
+    while (len > 0 && writer->error == 0)
+    {
+        if (writer->len == RECORD_BUFFER_SIZE)
+        {
+            record_writer_flush(writer);
+            continue;
+        }
+        const size_t room = RECORD_BUFFER_SIZE - writer->len;
+        const size_t n = len < room ? len : room;
+        memcpy(writer->buffer + writer->len, bytes, n);
+        writer->len += n;
+        bytes += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief Tells how a byte of a string gets escaped on a format.
+ * @param format The format.
+ * @param c The byte.
+ * @param escaped Where to leave its escape sequence (room for 6 bytes).
+ * @return Bytes of the escape sequence, or 0 if the byte is kept as is. On NDJSON, a byte from 0x80 on always gets one:
+ * it's meant for the ones that aren't part of a valid UTF-8 sequence.
+ */
+static size_t escape_byte(enum record_format format, unsigned char c, char* escaped)
+{
+    static const char hex[] = "0123456789abcdef";
+    char letter = 0;
+    switch (c)
+    {
+    case '\\':
+        letter = '\\';
+        break;
+    case '\t':
+        letter = 't';
+        break;
+    case '\n':
+        letter = 'n';
+        break;
+    case '\r':
+        letter = 'r';
+        break;
+    case '"':
+        letter = format == RECORD_NDJSON ? '"' : 0;
+        break;
+    case '\b':
+        letter = format == RECORD_NDJSON ? 'b' : 0;
+        break;
+    case '\f':
+        letter = format == RECORD_NDJSON ? 'f' : 0;
+        break;
+    default:
+        break;
+    }
+    if (letter != 0)
+    {
+        escaped[0] = '\\';
+        escaped[1] = letter;
+        return 2;
+    }
+    if (format == RECORD_NDJSON && (c < 0x20 || c >= 0x80))
+    {
+        memcpy(escaped, "\\u00", 4);
+        escaped[4] = hex[c >> 4];
+        escaped[5] = hex[c & 0xF];
+        return 6;
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks the UTF-8 sequence a byte from 0x80 on starts, as RFC 3629 defines it: no overlong forms, no
+ * surrogates, and nothing above U+10FFFF.
+ * @param bytes The sequence.
+ * @param len Bytes available, at least 1.
+ * @return Bytes of the sequence if it's valid, 0 if it isn't, or -1 if it's valid so far but the bytes ran out.
+ */
+static int utf8_sequence(const unsigned char* bytes, size_t len)
+{
+    // Range of the second byte, narrower after some leads; the rest of them are always 0x80-0xBF
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    size_t n;
+    if (bytes[0] >= 0xC2 && bytes[0] <= 0xDF)
+    {
+        n = 2;
+    }
+    else if (bytes[0] >= 0xE0 && bytes[0] <= 0xEF)
+    {
+        n = 3;
+        low = bytes[0] == 0xE0 ? 0xA0 : low;
+        high = bytes[0] == 0xED ? 0x9F : high;
+    }
+    else if (bytes[0] >= 0xF0 && bytes[0] <= 0xF4)
+    {
+        n = 4;
+        low = bytes[0] == 0xF0 ? 0x90 : low;
+        high = bytes[0] == 0xF4 ? 0x8F : high;
+    }
+    else
+    {
+        return 0;
+    }
+    for (size_t i = 1; i < n; i++)
+    {
+        if (i == len)
+        {
+            return -1;
+        }
+        if (bytes[i] < (i == 1 ? low : 0x80) || bytes[i] > (i == 1 ? high : 0xBF))
+        {
+            return 0;
+        }
+    }
+    return (int)n;
+}
+
+/**
+ * @brief Keeps the start of a UTF-8 sequence left by the previous chunk on the buffer escaped, as it isn't valid.
+ * @param writer The writer.
+ */
+static void put_partial_escaped(record_writer* writer)
+{
+    char escaped[6];
+    for (size_t i = 0; i < writer->partial_len; i++)
+    {
+        put_bytes(writer, escaped, escape_byte(writer->format, writer->partial[i], escaped));
+    }
+    writer->partial_len = 0;
+}
+
+/**
+ * @brief Completes the UTF-8 sequence left by the previous chunk with the first bytes of a new one, and keeps it on the
+ * buffer: as is if it's valid, escaped otherwise.
+ * @param writer The writer.
+ * @param bytes The new chunk.
+ * @param len Bytes of the chunk.
+ * @return Bytes of the chunk used.
+ */
+static size_t complete_partial(record_writer* writer, const unsigned char* bytes, size_t len)
+{
+    unsigned char sequence[RECORD_UTF8_MAX_BYTES];
+    size_t n = writer->partial_len;
+    memcpy(sequence, writer->partial, n);
+    size_t used = 0;
+    while (n < RECORD_UTF8_MAX_BYTES && used < len)
+    {
+        sequence[n++] = bytes[used++];
+    }
+    const int valid = utf8_sequence(sequence, n);
+    if (valid == -1)
+    {
+        // Still cut short, so the whole chunk was used
+        memcpy(writer->partial, sequence, n);
+        writer->partial_len = n;
+        return len;
+    }
+    if (valid == 0)
+    {
+        // None of its bytes can start a sequence (only its first one is a lead); the chunk is checked from its start
+        put_partial_escaped(writer);
+        return 0;
+    }
+    put_bytes(writer, (const char*)sequence, (size_t)valid);
+    used = (size_t)valid - writer->partial_len;
+    writer->partial_len = 0;
+    return used;
+}
+
+/**
+ * @brief Keeps a string on the buffer, escaped as its format needs; the bytes between escapes are copied at once. On
+ * NDJSON, the bytes from 0x80 on are kept only as part of a valid UTF-8 sequence; one cut short by the end of the
+ * string waits for the next string (a chunk of content), or put_partial_escaped().
+ * @param writer The writer.
+ * @param text The string (it may hold NUL bytes).
+ * @param len Bytes of the string.
+ */
+static void put_escaped(record_writer* writer, const char* text, size_t len)
+{
+    if (writer->format == RECORD_NULL)
+    {
+        put_bytes(writer, text, len);
+        return;
+    }
+    const unsigned char* bytes = (const unsigned char*)text;
+    size_t i = writer->partial_len > 0 ? complete_partial(writer, bytes, len) : 0;
+    size_t kept = i;
+    char escaped[6];
+    for (; i < len; i++)
+    {
+        if (!writer->escaped[bytes[i]])
+        {
+            continue;
+        }
+        const int valid = bytes[i] < 0x80 ? 0 : utf8_sequence(bytes + i, len - i);
+        if (valid > 0)
+        {
+            i += (size_t)valid - 1;
+            continue;
+        }
+        put_bytes(writer, text + kept, i - kept);
+        if (valid == -1)
+        {
+            memcpy(writer->partial, bytes + i, len - i);
+            writer->partial_len = len - i;
+            return;
+        }
+        put_bytes(writer, escaped, escape_byte(writer->format, bytes[i], escaped));
+        kept = i + 1;
+    }
+    put_bytes(writer, text + kept, len - kept);
+}
+
+/**
+ * @brief Keeps a non-negative number on the buffer, in decimal.
+ * @param writer The writer.
+ * @param value The number.
+ * @param min_digits Digits written at least, padded with leading zeros.
+ */
+static void put_decimal(record_writer* writer, unsigned long long value, int min_digits)
+{
+    char digits[24];
+    size_t start = sizeof(digits);
+    do
+    {
+        digits[--start] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0 || (int)(sizeof(digits) - start) < min_digits);
+    put_bytes(writer, digits + start, sizeof(digits) - start);
+}
+
+/**
+ * @brief Keeps the separator between two fields on the buffer, as of the format.
+ * @param writer The writer.
+ * @param json The one of NDJSON: what closes the field before, and opens the next one.
+ */
+static void put_separator(record_writer* writer, const char* json)
+{
+    switch (writer->format)
+    {
+    case RECORD_NDJSON:
+        put_bytes(writer, json, strlen(json));
+        break;
+    case RECORD_NULL:
+        put_bytes(writer, "", 1);
+        break;
+    case RECORD_TSV:
+        put_bytes(writer, "\t", 1);
+        break;
+    }
+}
+
+/**
+ * @brief Keeps a time on the buffer, as seconds since the epoch with MTIME_DECIMALS decimals.
+ * @param writer The writer.
+ * @param time The time.
+ */
+static void put_time(record_writer* writer, struct timespec time)
+{
+    long long seconds = time.tv_sec;
+    long nanos = time.tv_nsec;
+    // Before the epoch, the fraction counts towards the negative side too
+    const bool negative = seconds < 0;
+    if (negative && nanos > 0)
+    {
+        seconds++;
+        nanos = NANOS_PER_SECOND - nanos;
+    }
+    if (negative)
+    {
+        put_bytes(writer, "-", 1);
+    }
+    put_decimal(writer, (unsigned long long)(negative ? -seconds : seconds), 1);
+    put_bytes(writer, ".", 1);
+    put_decimal(writer, (unsigned long long)nanos, MTIME_DECIMALS);
+}
+
+void record_begin(record_writer* writer, const char* path, off_t size, struct timespec mtime)
+{
+    if (writer->format == RECORD_NDJSON)
+    {
+        put_bytes(writer, "{\"path\":\"", strlen("{\"path\":\""));
+    }
+    put_escaped(writer, path, strlen(path));
+    put_partial_escaped(writer);
+    put_separator(writer, "\",\"size\":");
+    put_decimal(writer, (unsigned long long)(size > 0 ? size : 0), 1);
+    put_separator(writer, ",\"mtime\":");
+    put_time(writer, mtime);
+    if (writer->with_content)
+    {
+        put_separator(writer, ",\"content\":\"");
+    }
+}
+
+void record_content(record_writer* writer, const char* bytes, size_t len)
+{
+    put_escaped(writer, bytes, len);
+}
+
+void record_end(record_writer* writer)
+{
+    put_partial_escaped(writer);
+    switch (writer->format)
+    {
+    case RECORD_NDJSON:
+        put_bytes(writer, writer->with_content ? "\"}\n" : "}\n", writer->with_content ? 3 : 2);
+        break;
+    case RECORD_NULL:
+        // The last field is followed by a NUL byte too
+        put_bytes(writer, "", 1);
+        break;
+    case RECORD_TSV:
+        put_bytes(writer, "\n", 1);
+        break;
+    }
+}
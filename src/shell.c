@@ -6,696 +6,2276 @@
 #include "shell.h"
 
 // Global variables
-//! \brief Status from "metrics" handled. Gets set to true when the "metrics" app signals with its status data.
-static bool sfmh = false;
+//! \brief Label of each metric shown by "status_monitor" and "watch_monitor".
+static const char* const metrics_status_labels[METRICS_STATUS_ROWS] = {"CPU usage",
+                                                                       "RAM usage",
+                                                                       "HDD Sectors (512 KB each) read/s",
+                                                                       "HDD Sectors (512 KB each) written/s",
+                                                                       "Network bytes received/s",
+                                                                       "Network bytes sent/s",
+                                                                       "Processes running/total"};
+//! \brief Memory of the command line being executed (tokens, argv arrays). Released at once when it finishes.
+static arena cmd_arena = {0};
+//! \brief Capacity of the pipes between the single commands of a command line, in bytes, or 0 for the system default.
+static int pipe_size = 0;
+//! \brief Interactive command line prompt, and the input that doesn't make a whole line yet.
+static struct
+{
+    //! \brief Current user name.
+    const char* user;
+    //! \brief Computer (host) name.
+    char host[HOST_NAME_MAX + 1];
+    //! \brief Input read so far.
+    char* input;
+    //! \brief Bytes of input read so far.
+    size_t len;
+    //! \brief Room on input, in bytes.
+    size_t capacity;
+} prompt = {0};
+
+/**
+ * @brief Materializes what's needed to run a single command of the AST, from the command line arena.
+ * @param pipeline AST of the command line.
+ * @param stage Single command.
+ * @param stdin_file Where to leave the file of its "<" redirection, or NULL.
+ * @param stdout_file Where to leave the file of its ">" redirection, or NULL.
+ * @return Array of tokens. Last "useful" element is always NULL.
+ */
+static char** prepare_single_command(const cmd_pipeline* pipeline, const cmd_stage* stage, const char** stdin_file,
+                                     const char** stdout_file)
+{
+    char** sc_tokens = cmd_stage_argv(pipeline, stage, &cmd_arena);
+    *stdin_file = cmd_span_str(pipeline, stage->stdin_file, &cmd_arena);
+    *stdout_file = cmd_span_str(pipeline, stage->stdout_file, &cmd_arena);
+    if (sc_tokens == NULL || (stage->stdin_file.len != 0 && *stdin_file == NULL) ||
+        (stage->stdout_file.len != 0 && *stdout_file == NULL))
+    {
+        wstderr("ERROR: Failed to allocate memory", true);
+        exit(EXIT_FAILURE);
+    }
+    return sc_tokens;
+}
+
+//! \brief Internal command of a foreground pipeline run inside the shell process: on a helper thread, or on the shell
+//! thread if it changes the shell state. It owns everything it uses, so it can outlive the command line.
+typedef struct builtin_stage
+{
+    //! \brief The internal command.
+    const builtin* internal_cmd;
+    //! \brief Its invocation: copies of its tokens (and of the cwd, on a helper thread) in a single block starting at
+    //! sc_tokens, and the stream of the stage as out.
+    builtin_call call;
+} builtin_stage;
+
+/**
+ * @brief Sets up an internal command of a foreground pipeline to run inside the shell process, as its stage: its output
+ * goes to a stream of its own, over the pipe (or the redirection) of the stage.
+ * @param internal_cmd The internal command.
+ * @param sc_tokens Its tokens.
+ * @param stdin_file File of its "<" redirection, or NULL; it's only checked, as internal commands don't read stdin.
+ * @param stdout_file File of its ">" redirection, or NULL.
+ * @param stdout_fd Write end of the pipe of the stage, or SPAWN_FD_INHERIT for the shell stdout.
+ * @param cwd Current working directory; it gets updated only by the ones that run on the shell thread.
+ * @return The stage (run_builtin_stage() releases it), or NULL if it can't run (the error gets shown).
+ */
+static builtin_stage* prepare_builtin_stage(const builtin* internal_cmd, char** sc_tokens, const char* stdin_file,
+                                            const char* stdout_file, int stdout_fd, char* cwd)
+{
+    const bool on_helper_thread = !(internal_cmd->flags & BUILTIN_NEEDS_PARENT);
+    if (stdin_file != NULL)
+    {
+        const int input_fd = open(stdin_file, O_RDONLY | O_CLOEXEC);
+        if (input_fd == -1)
+        {
+            wstderr("ERROR: Failed to open input file", true);
+            return NULL;
+        }
+        close(input_fd);
+    }
+    // Its own file descriptor, so the stream can be closed once it's done; nothing spawned meanwhile inherits it
+    const int output_fd = stdout_file != NULL
+                              ? open(stdout_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666)
+                              : fcntl(stdout_fd == SPAWN_FD_INHERIT ? STDOUT_FILENO : stdout_fd, F_DUPFD_CLOEXEC, 0);
+    if (output_fd == -1)
+    {
+        wstderr(stdout_file != NULL ? "ERROR: Failed to open output file" : "ERROR: Failed to redirect stdout", true);
+        return NULL;
+    }
+    // Pointers to the tokens first, then the strings
+    size_t n_tokens = 0;
+    size_t strings_size = on_helper_thread ? strlen(cwd) + 1 : 0;
+    for (; sc_tokens[n_tokens] != NULL; n_tokens++)
+    {
+        strings_size += strlen(sc_tokens[n_tokens]) + 1;
+    }
+    builtin_stage* stage = malloc(sizeof(builtin_stage));
+    char** tokens = malloc((n_tokens + 1) * sizeof(char*) + strings_size);
+    FILE* out = stage != NULL && tokens != NULL ? fdopen(output_fd, "w") : NULL;
+    if (out == NULL)
+    {
+        wstderr("ERROR: Failed to allocate memory", true);
+        free(stage);
+        free(tokens);
+        close(output_fd);
+        return NULL;
+    }
+    char* string = (char*)&tokens[n_tokens + 1];
+    for (size_t i = LOWEST_ARR_INDEX; i < n_tokens; i++)
+    {
+        const size_t token_size = strlen(sc_tokens[i]) + 1;
+        tokens[i] = memcpy(string, sc_tokens[i], token_size);
+        string += token_size;
+    }
+    tokens[n_tokens] = NULL;
+    *stage = (builtin_stage){internal_cmd, {tokens, false, on_helper_thread ? strcpy(string, cwd) : cwd, out,
+                                            on_helper_thread}};
+    return stage;
+}
+
+/**
+ * @brief Runs an internal command of a foreground pipeline on the calling thread, closes its stream, and releases the
+ * stage. A reader that went away shows up as EPIPE on its writes, instead of killing the whole shell with SIGPIPE.
+ * @param stage The stage.
+ * @return Its exit code: JOBS_SIGNAL_EXIT_BASE + SIGPIPE if nobody read what it wrote (as for a process killed by it),
+ * EXIT_SUCCESS otherwise.
+ */
+static int run_builtin_stage(builtin_stage* stage)
+{
+    sigset_t pipe_set;
+    sigset_t original_set;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_set, &original_set);
+    stage->internal_cmd->handler(&stage->call);
+    fclose(stage->call.out);
+    // The SIGPIPE raised meanwhile (if any) is taken, so it isn't delivered once unblocked
+    const struct timespec no_wait = {0, 0};
+    bool broken = false;
+    while (sigtimedwait(&pipe_set, NULL, &no_wait) == SIGPIPE)
+    {
+        broken = true;
+    }
+    pthread_sigmask(SIG_SETMASK, &original_set, NULL);
+    free(stage->call.sc_tokens);
+    free(stage);
+    return broken ? JOBS_SIGNAL_EXIT_BASE + SIGPIPE : EXIT_SUCCESS;
+}
+
+/**
+ * @brief Runs an internal command of a foreground pipeline on a helper thread. Meant to be a pthread start routine.
+ * @param arg The builtin_stage.
+ * @return Its exit code, as an intptr_t.
+ */
+static void* run_builtin_stage_thread(void* arg)
+{
+    return (void*)(intptr_t)run_builtin_stage(arg);
+}
+
+/**
+ * @brief Leaves the exit code of each single command of a foreground command line on ENV_PIPESTATUS_KEY.
+ * @param exit_codes Exit codes, in the order of the pipeline.
+ * @param n Amount of exit codes. Greater than 0.
+ */
+static void set_pipe_status(const int* exit_codes, size_t n)
+{
+    // Up to 3 digits and a separator each
+    const size_t size = n * 4;
+    char* status = arena_alloc(&cmd_arena, size);
+    if (status == NULL)
+    {
+        wstderr("ERROR: Failed to allocate memory", true);
+        exit(EXIT_FAILURE);
+    }
+    size_t len = 0;
+    for (size_t i = LOWEST_ARR_INDEX; i < n && len < size; i++)
+    {
+        len += (size_t)snprintf(status + len, size - len, i == LOWEST_ARR_INDEX ? "%d" : " %d", exit_codes[i]);
+    }
+    setenv(ENV_PIPESTATUS_KEY, status, 1);
+}
+
+/**
+ * @brief Executes a command line of several single commands, connected by pipes. Every process of the pipeline is part
+ * of the same job (and process group, led by the first one); the internal commands of a foreground one run inside the
+ * shell process instead. A foreground one leaves the exit code of each single command on ENV_PIPESTATUS_KEY.
+ * @param pipeline AST of the command line, with more than one stage. Its memory (as the one of everything else here)
+ * is on the command line arena.
+ * @param input Command line.
+ * @param len Length of the command line, in bytes.
+ * @param cwd Current working directory. This variable could be updated inside.
+ */
+static void execute_pipeline(const cmd_pipeline* pipeline, const char* input, size_t len, char* cwd)
+{
+    const size_t n_stages = pipeline->n_stages;
+    const bool background_execution = pipeline->background;
+    // A pipe between each single command and the next one: the read end of the i-th at 2 * i, its write end right after
+    const size_t n_pipe_fds = 2 * (n_stages - 1);
+    int* pipesfd = arena_alloc(&cmd_arena, n_pipe_fds * sizeof(int));
+    // Per single command: its process (0 if none), its internal command to run inside the shell process (NULL if
+    // none) and its helper thread, if it got one
+    pid_t* stage_pids = arena_alloc(&cmd_arena, n_stages * sizeof(pid_t));
+    builtin_stage** stages = arena_alloc(&cmd_arena, n_stages * sizeof(builtin_stage*));
+    pthread_t* threads = arena_alloc(&cmd_arena, n_stages * sizeof(pthread_t));
+    bool* threaded = arena_alloc(&cmd_arena, n_stages * sizeof(bool));
+    int* exit_codes = arena_alloc(&cmd_arena, n_stages * sizeof(int));
+    // The processes alone, in the order of the pipeline, and what they exit with
+    pid_t* pids = arena_alloc(&cmd_arena, n_stages * sizeof(pid_t));
+    int* pid_exit_codes = arena_alloc(&cmd_arena, n_stages * sizeof(int));
+    if (pipesfd == NULL || stage_pids == NULL || stages == NULL || threads == NULL || threaded == NULL ||
+        exit_codes == NULL || pids == NULL || pid_exit_codes == NULL)
+    {
+        wstderr("ERROR: Failed to allocate memory", true);
+        exit(EXIT_FAILURE);
+    }
+    // Close-on-exec: a spawned command only gets the ends it's handed, no matter how long the pipeline is
+    if (spawn_pipes(pipesfd, n_stages - 1, pipe_size) == -1)
+    {
+        wstderr("ERROR: On pipe creation", true);
+        return;
+    }
+    for (size_t i = LOWEST_ARR_INDEX; i < n_stages; i++)
+    {
+        stage_pids[i] = 0;
+        stages[i] = NULL;
+        threaded[i] = false;
+        exit_codes[i] = EXIT_SUCCESS;
+    }
+    size_t n_pids = 0;
+    pid_t pgid = jobs_control_enabled() ? 0 : SPAWN_PGID_INHERIT;
+    // The shell output goes before theirs
+    fflush(stdout);
+    // The internal commands that change the shell state (i.e.: cd) run first, on the shell thread, so the whole
+    // pipeline starts from where they leave it; what they write waits on their pipe for its reader
+    for (size_t i = LOWEST_ARR_INDEX; i < n_stages && !background_execution; i++)
+    {
+        const char* stdin_file;
+        const char* stdout_file;
+        char** sc_tokens = prepare_single_command(pipeline, &pipeline->stages[i], &stdin_file, &stdout_file);
+        const builtin* internal_cmd = builtin_lookup(sc_tokens[LOWEST_ARR_INDEX]);
+        if (internal_cmd != NULL && (internal_cmd->flags & BUILTIN_IN_PIPELINE) &&
+            (internal_cmd->flags & BUILTIN_NEEDS_PARENT))
+        {
+            builtin_stage* stage = prepare_builtin_stage(internal_cmd, sc_tokens, stdin_file, stdout_file,
+                                                         i < (n_stages - 1) ? pipesfd[i * 2 + 1] : SPAWN_FD_INHERIT,
+                                                         cwd);
+            exit_codes[i] = stage != NULL ? run_builtin_stage(stage) : EXIT_FAILURE;
+        }
+    }
+    // Launch a process per single command
+    for (size_t i = LOWEST_ARR_INDEX; i < n_stages; i++)
+    {
+        const char* stdin_file;
+        const char* stdout_file;
+        char** sc_tokens = prepare_single_command(pipeline, &pipeline->stages[i], &stdin_file, &stdout_file);
+        // Pipe ends wiring: first one doesn't need read end set, last one doesn't need its stdout set
+        spawn_io io;
+        spawn_io_init(&io);
+        if (i > 0)
+        {
+            io.stdin_fd = pipesfd[(i - 1) * 2];
+        }
+        if (i < (n_stages - 1))
+        {
+            io.stdout_fd = pipesfd[i * 2 + 1];
+        }
+        // Redirections get applied after the pipe ends, so (as in other shells) they take precedence over them
+        io.stdin_file = stdin_file;
+        io.stdout_file = stdout_file;
+        io.pgid = pgid;
+        pid_t pid_child;
+        const builtin* internal_cmd = builtin_lookup(sc_tokens[LOWEST_ARR_INDEX]);
+        if (internal_cmd == NULL)
+        {
+            // External commands are spawned straight from the shell, the spawn wires the pipe ends; the rest of them
+            // are close-on-exec
+            pid_child = execute_external_cmd(sc_tokens, background_execution, &io);
+            exit_codes[i] = pid_child == -1 ? EXIT_CODE_NOT_RUN : EXIT_SUCCESS;
+        }
+        else if ((internal_cmd->flags & BUILTIN_IN_PIPELINE) && !background_execution &&
+                 (internal_cmd->flags & BUILTIN_NEEDS_PARENT))
+        {
+            // Already run on the shell thread, above
+            continue;
+        }
+        else if ((internal_cmd->flags & BUILTIN_IN_PIPELINE) && !background_execution &&
+                 (internal_cmd->flags & BUILTIN_ON_THREAD) &&
+                 (internal_cmd->forks == NULL || !internal_cmd->forks(sc_tokens)))
+        {
+            // No copy of the shell needed: it runs on a helper thread
+            stages[i] = prepare_builtin_stage(internal_cmd, sc_tokens, stdin_file, stdout_file, io.stdout_fd, cwd);
+            exit_codes[i] = stages[i] != NULL ? EXIT_SUCCESS : EXIT_FAILURE;
+            continue;
+        }
+        else if (internal_cmd->flags & BUILTIN_IN_PIPELINE)
+        {
+            // The rest of internal commands need a copy of the shell to run on (as they all do in the background),
+            // which doesn't exec: it closes the pipe ends by itself
+            io.fds_to_close = pipesfd;
+            io.n_fds_to_close = n_pipe_fds;
+            const builtin_call call = {sc_tokens, background_execution, cwd, stdout, false};
+            pid_child = execute_internal_cmd_forked(internal_cmd, &call, &io);
+            exit_codes[i] = pid_child == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+        else
+        {
+            // As a coupled command, does nothing
+            continue;
+        }
+        if (pid_child == -1)
+        {
+            continue;
+        }
+        // Parent process; keep track of the just created child, the first one leads the process group
+        if (pgid == 0)
+        {
+            pgid = pid_child;
+        }
+        stage_pids[i] = pid_child;
+        pids[n_pids++] = pid_child;
+    }
+    // Parent process closes all pipe file descriptors as it makes no use of them; the internal commands have their
+    // own, and a stage reading from one of them gets EPIPE (as nobody reads it)
+    spawn_close_fds(pipesfd, n_pipe_fds);
+    bool response_blocked = false;
+    for (size_t i = LOWEST_ARR_INDEX; i < n_stages; i++)
+    {
+        if (stages[i] == NULL)
+        {
+            continue;
+        }
+        if (!response_blocked)
+        {
+            // The responses to "status_monitor" (SIGUSR1) are taken by the helper thread asking for them; the shell
+            // thread never gets them delivered either
+            sigset_t response_set;
+            sigemptyset(&response_set);
+            sigaddset(&response_set, SIGUSR1);
+            pthread_sigmask(SIG_BLOCK, &response_set, NULL);
+            response_blocked = true;
+        }
+        threaded[i] = pthread_create(&threads[i], NULL, run_builtin_stage_thread, stages[i]) == 0;
+        if (!threaded[i])
+        {
+            // Without a thread for it, it runs on the shell thread; every process is already spawned
+            exit_codes[i] = run_builtin_stage(stages[i]);
+        }
+    }
+    // Hold for the job to finish, if it runs in the foreground
+    bool stopped = false;
+    if (n_pids > 0)
+    {
+        stopped = await_job(input, len, pgid == SPAWN_PGID_INHERIT ? 0 : pgid, pids, n_pids, background_execution,
+                            background_execution ? NULL : pid_exit_codes);
+    }
+    // The internal commands end once they're done, or nobody reads what they write; a stopped job leaves them
+    // behind, as they don't need anything from the command line
+    for (size_t i = LOWEST_ARR_INDEX; i < n_stages; i++)
+    {
+        void* exit_code;
+        if (!threaded[i])
+        {
+            continue;
+        }
+        if (stopped)
+        {
+            pthread_detach(threads[i]);
+        }
+        else if (pthread_join(threads[i], &exit_code) == 0)
+        {
+            exit_codes[i] = (int)(intptr_t)exit_code;
+        }
+    }
+    if (background_execution)
+    {
+        return;
+    }
+    for (size_t i = LOWEST_ARR_INDEX, pid_i = LOWEST_ARR_INDEX; i < n_stages; i++)
+    {
+        if (stage_pids[i] != 0)
+        {
+            exit_codes[i] = pid_exit_codes[pid_i++];
+        }
+    }
+    set_pipe_status(exit_codes, n_stages);
+}
+
+/**
+ * @brief Executes a line of a batch file. Meant to be a batch_line_handler.
+ * @param line Command line.
+ * @param len Length of the command line, in bytes.
+ * @param ctx Current working directory.
+ */
+static void execute_batch_line(const char* line, size_t len, void* ctx)
+{
+    // Background jobs that finished are forgotten silently; nobody is in front of a prompt
+    jobs_notify(NULL);
+    execute_command(line, len, ctx);
+}
+
+/**
+ * @brief Decides how a line of a batch file has to be run on a parallel run. Meant to be a parallel_line_classifier.
+ * @param line Command line.
+ * @param len Length of the command line, in bytes.
+ * @param ctx Not used inside the function.
+ * @return Kind of line: internal commands that change the shell state (or wait for jobs), and lines sent to the
+ * background, are barriers.
+ */
+static enum parallel_line_kind classify_batch_line(const char* line, size_t len, void* ctx)
+{
+    // Args ignored
+    (void)ctx;
+    cmd_pipeline pipeline;
+    // Malformed lines are jobs too, so their error is shown in order
+    enum parallel_line_kind kind = PARALLEL_LINE_JOB;
+    if (parse_command_line(line, len, &cmd_arena, &pipeline) == 0)
+    {
+        if (pipeline.n_stages == 0)
+        {
+            kind = PARALLEL_LINE_EMPTY;
+        }
+        else if (pipeline.background)
+        {
+            // Its job belongs to the shell (for "jobs" & "wait"), and it outlives any worker capturing its output
+            kind = PARALLEL_LINE_BARRIER;
+        }
+        else if (pipeline.n_stages == 1)
+        {
+            const cmd_stage* stage = &pipeline.stages[LOWEST_ARR_INDEX];
+            const char* name = cmd_span_str(&pipeline, stage->words[LOWEST_ARR_INDEX], &cmd_arena);
+            const builtin* internal_cmd = name == NULL ? NULL : builtin_lookup(name);
+            if (internal_cmd != NULL && (internal_cmd->flags & BUILTIN_NEEDS_PARENT))
+            {
+                kind = PARALLEL_LINE_BARRIER;
+            }
+        }
+    }
+    arena_reset(&cmd_arena);
+    return kind;
+}
+
+/**
+ * @brief Shows the background jobs that finished since the last prompt (once), and the command line prompt.
+ * @param cwd Current working directory.
+ */
+static void show_prompt(const char* cwd)
+{
+    jobs_notify(stdout);
+    printf("%s@%s:%s$ ", prompt.user, prompt.host, cwd);
+    // Nothing reads stdin through stdio anymore, so nothing else flushes it
+    fflush(stdout);
+}
+
+/**
+ * @brief Reads what's available of the interactive input, and executes every whole line in it. At the end of the input
+ * the shell quits. Meant to be an event_handler.
+ * @param fd File descriptor of the input.
+ * @param events Not used inside the function.
+ * @param ctx Current working directory.
+ */
+static void read_prompt_input(int fd, uint32_t events, void* ctx)
+{
+    // Args ignored
+    (void)events;
+    char* cwd = ctx;
+    // Lines can be of any length; the buffer grows to hold the longest one
+    if (prompt.capacity - prompt.len < PROMPT_READ_CHUNK)
+    {
+        const size_t capacity = prompt.capacity == 0 ? PROMPT_READ_CHUNK : prompt.capacity * 2;
+        char* input = realloc(prompt.input, capacity);
+        if (input == NULL)
+        {
+            wstderr("ERROR: Failed to allocate memory", true);
+            exit(EXIT_FAILURE);
+        }
+        prompt.input = input;
+        prompt.capacity = capacity;
+    }
+    const ssize_t n_read = read(fd, prompt.input + prompt.len, prompt.capacity - prompt.len);
+    if (n_read == -1 && (errno == EINTR || errno == EAGAIN))
+    {
+        return;
+    }
+    if (n_read <= 0)
+    {
+        // End of the input (i.e.: [Ctrl]+[D]); an unterminated last line still gets executed
+        if (prompt.len > 0)
+        {
+            execute_command(prompt.input, prompt.len, cwd);
+        }
+        putchar('\n');
+        execute_quit(NULL);
+    }
+    prompt.len += (size_t)n_read;
+    // Every whole line gets executed, in order; a partial one waits for the rest of it
+    size_t start = 0;
+    const char* newline;
+    while ((newline = memchr(prompt.input + start, '\n', prompt.len - start)) != NULL)
+    {
+        const size_t end = (size_t)(newline - prompt.input) + 1;
+        execute_command(prompt.input + start, end - start, cwd);
+        start = end;
+        show_prompt(cwd);
+    }
+    memmove(prompt.input, prompt.input + start, prompt.len - start);
+    prompt.len -= start;
+}
+
+/**
+ * @brief Shows the background jobs that finished while the shell waits at the prompt, right away, then the prompt
+ * again. Meant to be an event_handler for the SIGCHLD signalfd.
+ * @param fd Not used inside the function.
+ * @param events Not used inside the function.
+ * @param ctx Current working directory.
+ */
+static void notify_finished_jobs(int fd, uint32_t events, void* ctx)
+{
+    // Args ignored
+    (void)fd;
+    (void)events;
+    if (jobs_pending_notices())
+    {
+        putchar('\n');
+        show_prompt(ctx);
+    }
+}
+
+/**
+ * @brief Takes the name of the "metrics" app a command is about: its first arg, unless it's an option ("--...").
+ * @param sc_tokens Single command tokens.
+ * @param next_i Where to leave the index of the first arg after the name.
+ * @return The name, or MONITOR_DEFAULT_NAME if it isn't given.
+ */
+static const char* monitor_name_arg(char** sc_tokens, int* next_i)
+{
+    const char* name = sc_tokens[SC_FIRST_ARG_I];
+    if (name == NULL || strncmp(name, "--", 2) == 0)
+    {
+        *next_i = SC_FIRST_ARG_I;
+        return MONITOR_DEFAULT_NAME;
+    }
+    *next_i = SC_SECOND_ARG_I;
+    return name;
+}
+
+/**
+ * @brief Finds a running "metrics" app by its name; if there's none, tells so.
+ * @param out Where to tell it (i.e.: stdout).
+ * @param name The name.
+ * @return The instance, or NULL if it isn't running (or wasn't started by this Shell).
+ */
+static monitor* running_monitor(FILE* out, const char* name)
+{
+    monitor* m = monitor_find(name);
+    if (m != NULL && monitor_running(m))
+    {
+        return m;
+    }
+    if (strcmp(name, MONITOR_DEFAULT_NAME) == 0)
+    {
+        fputs("WARNING: metrics app not initialized, or not tracked by this Shell.\n", out);
+    }
+    else
+    {
+        fprintf(out, "WARNING: metrics app \"%s\" not initialized, or not tracked by this Shell.\n", name);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Parses a length of time, as typed by the user: an int followed by "s" (seconds, also if omitted), "m"
+ * (minutes) or "h" (hours).
+ * @param text Length of time, as typed.
+ * @param ns Where to leave the length of time, in nanoseconds.
+ * @return true if it's between 1 second and what the history keeps, false otherwise.
+ */
+static bool parse_duration(const char* text, uint64_t* ns)
+{
+    char* end;
+    errno = 0;
+    const long value = strtol(text, &end, METRICS_TIMEOUT_OPTION_BASE);
+    long seconds_per_unit = 1;
+    if (*end == 'm')
+    {
+        seconds_per_unit = SECS_PER_MIN;
+        end++;
+    }
+    else if (*end == 'h')
+    {
+        seconds_per_unit = SECS_PER_HOUR;
+        end++;
+    }
+    else if (*end == 's')
+    {
+        end++;
+    }
+    if (errno != 0 || end == text || *end != STR_NULL_TERMINATOR || value < 1 ||
+        value > (long)(HISTORY_BUCKETS * (HISTORY_BUCKET_NS / NSECS_PER_SEC)) / seconds_per_unit)
+    {
+        return false;
+    }
+    *ns = (uint64_t)(value * seconds_per_unit) * NSECS_PER_SEC;
+    return true;
+}
+
+/**
+ * @brief Parses the options of "status_monitor": "--timeout=MS" and "--history W" (or "--history=W").
+ * @param sc_tokens Single command tokens.
+ * @param first_i Index of the first option.
+ * @param timeout_ms Where to leave the milliseconds to wait; METRICS_RESPONSE_TIMEOUT_MS if the option isn't given.
+ * @param history_ns Where to leave the window to summarize, in nanoseconds; 0 if the option isn't given.
+ * @param history_text Where to leave the window to summarize, as typed; NULL if the option isn't given.
+ * @return true if every option is known and valid (or there's none), false otherwise.
+ */
+static bool parse_status_options(char** sc_tokens, int first_i, long* timeout_ms, uint64_t* history_ns,
+                                 const char** history_text)
+{
+    *timeout_ms = METRICS_RESPONSE_TIMEOUT_MS;
+    *history_ns = 0;
+    *history_text = NULL;
+    const size_t timeout_len = strlen(METRICS_TIMEOUT_OPTION);
+    const size_t history_len = strlen(METRICS_HISTORY_OPTION);
+    for (int i = first_i; sc_tokens[i] != NULL; i++)
+    {
+        if (strncmp(sc_tokens[i], METRICS_TIMEOUT_OPTION, timeout_len) == 0)
+        {
+            const char* value = &sc_tokens[i][timeout_len];
+            char* end;
+            errno = 0;
+            *timeout_ms = strtol(value, &end, METRICS_TIMEOUT_OPTION_BASE);
+            if (errno != 0 || end == value || *end != STR_NULL_TERMINATOR || *timeout_ms < 1 ||
+                *timeout_ms > METRICS_RESPONSE_TIMEOUT_MAX_MS)
+            {
+                return false;
+            }
+        }
+        else if (strncmp(sc_tokens[i], METRICS_HISTORY_OPTION, history_len) == 0 &&
+                 (sc_tokens[i][history_len] == '=' || sc_tokens[i][history_len] == STR_NULL_TERMINATOR))
+        {
+            // The value comes right after "=", or as the next arg
+            *history_text = sc_tokens[i][history_len] == '=' ? &sc_tokens[i][history_len + 1] : sc_tokens[++i];
+            if (*history_text == NULL || !parse_duration(*history_text, history_ns))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Shows the summary of every metric of the history of a "metrics" app over a window of time.
+ * @param out Where to show it (i.e.: stdout).
+ * @param m The instance.
+ * @param window_ns Window, in nanoseconds.
+ * @param window_text Window, as typed.
+ */
+static void print_metrics_history(FILE* out, monitor* m, uint64_t window_ns, const char* window_text)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const uint64_t now_ns = (uint64_t)now.tv_sec * NSECS_PER_SEC + (uint64_t)now.tv_nsec;
+    // Summarized before anything is shown, so the lock isn't held while a pipe is full
+    metrics_summary summaries[N_METRICS_SERIES] = {0};
+    monitor_lock_samples();
+    monitor_record_samples(m);
+    for (int s = 0; s < N_METRICS_SERIES && m->history != NULL; s++)
+    {
+        metrics_history_summary(m->history, s, window_ns, now_ns, &summaries[s]);
+    }
+    monitor_unlock_samples();
+    if (strcmp(m->name, MONITOR_DEFAULT_NAME) == 0)
+    {
+        fprintf(out, "metrics app history (last %s)\n", window_text);
+    }
+    else
+    {
+        fprintf(out, "metrics app \"%s\" history (last %s)\n", m->name, window_text);
+    }
+    fprintf(out, "-----------------------------\n"
+           "%-26s %8s %12s %12s %12s %12s %12s %12s\n",
+           "Metric", "samples", "min", "avg", "p50", "p95", "p99", "max");
+    for (int s = 0; s < N_METRICS_SERIES; s++)
+    {
+        const metrics_summary summary = summaries[s];
+        if (summary.count == 0)
+        {
+            fprintf(out, "%-26s %8d %12s %12s %12s %12s %12s %12s\n", metrics_history_name(s), 0, "n/a", "n/a", "n/a",
+                    "n/a", "n/a", "n/a");
+            continue;
+        }
+        fprintf(out, "%-26s %8" PRIu64 " %12.2f %12.2f %12.2f %12.2f %12.2f %12.2f\n", metrics_history_name(s),
+                summary.count, summary.min, summary.avg, summary.p50, summary.p95, summary.p99, summary.max);
+    }
+}
+
+/**
+ * @brief Gives the status data of the "metrics" app as the text shown for each metric (labeled by
+ * metrics_status_labels); the metrics it doesn't have are "n/a".
+ * @param sample Status data.
+ * @param values Where to leave the text of each metric.
+ */
+static void format_metrics_status(const metrics_sample* sample, char values[][DASHBOARD_VALUE_SIZE])
+{
+    for (int i = 0; i < METRICS_STATUS_ROWS; i++)
+    {
+        snprintf(values[i], DASHBOARD_VALUE_SIZE, "n/a");
+    }
+    if (sample->fields & METRICS_FIELD_CPU)
+    {
+        snprintf(values[0], DASHBOARD_VALUE_SIZE, "%.2f %%", sample->cpu_usage);
+    }
+    if (sample->fields & METRICS_FIELD_MEM)
+    {
+        snprintf(values[1], DASHBOARD_VALUE_SIZE, "%.2f %%", sample->mem_usage);
+    }
+    if (sample->fields & METRICS_FIELD_HDD)
+    {
+        snprintf(values[2], DASHBOARD_VALUE_SIZE, "%" PRIu64, sample->sectors_read_rate);
+        snprintf(values[3], DASHBOARD_VALUE_SIZE, "%" PRIu64, sample->sectors_written_rate);
+    }
+    if (sample->fields & METRICS_FIELD_NET)
+    {
+        snprintf(values[4], DASHBOARD_VALUE_SIZE, "%" PRIu64, sample->net_rx_rate);
+        snprintf(values[5], DASHBOARD_VALUE_SIZE, "%" PRIu64, sample->net_tx_rate);
+    }
+    if (sample->fields & METRICS_FIELD_PROCS)
+    {
+        snprintf(values[6], DASHBOARD_VALUE_SIZE, "%" PRIu64 "/%" PRIu64, sample->procs_running, sample->procs_total);
+    }
+}
+
+/**
+ * @brief Does what fetch_monitor_samples() does, holding monitor_lock_samples().
+ * @param monitors The instances, running; MONITORS_MAX at most.
+ * @param n Amount of instances.
+ * @param timeout_ms Milliseconds to wait for the responses to SIGUSR1, for all of them.
+ * @param statuses Where to leave the status data of each instance (error is ETIMEDOUT if no response arrived in time).
+ */
+static void fetch_monitor_samples_locked(monitor* const* monitors, size_t n, long timeout_ms, monitor_status* statuses)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const uint64_t now_ns = (uint64_t)now.tv_sec * NSECS_PER_SEC + (uint64_t)now.tv_nsec;
+    bool waiting[MONITORS_MAX] = {false};
+    size_t n_waiting = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        monitor_status* status = &statuses[i];
+        monitor_record_samples(monitors[i]);
+        status->from_ring = monitors[i]->samples != NULL && metrics_ring_latest(monitors[i]->samples, &status->sample);
+        status->error = status->from_ring ? 0 : ETIMEDOUT;
+        status->latency_ms = status->from_ring && now_ns > status->sample.timestamp_ns
+                                 ? (double)(now_ns - status->sample.timestamp_ns) / NSECS_PER_MSEC
+                                 : 0.0;
+        waiting[i] = !status->from_ring;
+        n_waiting += waiting[i];
+    }
+    if (n_waiting == 0)
+    {
+        return;
+    }
+    // The responses are never delivered to a handler: SIGUSR1 stays blocked, and gets taken when the shell is ready to
+    sigset_t response_set;
+    sigemptyset(&response_set);
+    sigaddset(&response_set, SIGUSR1);
+    if (sigprocmask(SIG_BLOCK, &response_set, NULL) == -1)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            statuses[i].error = waiting[i] ? errno : statuses[i].error;
+        }
+        return;
+    }
+    // A response that arrived after a previous timeout isn't the one for this req
+    const struct timespec no_wait = {0, 0};
+    while (sigtimedwait(&response_set, NULL, &no_wait) == SIGUSR1)
+    {
+    }
+    struct timespec sent_at;
+    clock_gettime(CLOCK_MONOTONIC, &sent_at);
+    const long long sent_at_ns = (long long)sent_at.tv_sec * NSECS_PER_SEC + sent_at.tv_nsec;
+    const long long deadline_ns = sent_at_ns + (long long)timeout_ms * NSECS_PER_MSEC;
+    long long resend_ns = sent_at_ns;
+    while (n_waiting > 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        const long long at_ns = (long long)now.tv_sec * NSECS_PER_SEC + now.tv_nsec;
+        if (at_ns >= deadline_ns)
+        {
+            return;
+        }
+        // SIGUSR1 isn't a realtime signal: responses that arrive together merge into a single one, so the instances
+        // still missing get asked again, every so often, until the deadline
+        if (at_ns >= resend_ns)
+        {
+            union sigval directive;
+            directive.sival_int = METRICS_GET_STATUS_CODE;
+            for (size_t i = 0; i < n; i++)
+            {
+                if (waiting[i] && sigqueue(monitors[i]->pid, SIGUSR1, directive) == -1)
+                {
+                    statuses[i].error = errno;
+                    waiting[i] = false;
+                    n_waiting--;
+                }
+            }
+            resend_ns = at_ns + (long long)METRICS_RESEND_MS * NSECS_PER_MSEC;
+            continue;
+        }
+        // Sleep until a response arrives, or it's time to ask again; no CPU is used meanwhile
+        const long long left_ns = (resend_ns < deadline_ns ? resend_ns : deadline_ns) - at_ns;
+        const struct timespec left = {(time_t)(left_ns / NSECS_PER_SEC), (long)(left_ns % NSECS_PER_SEC)};
+        siginfo_t info;
+        if (sigtimedwait(&response_set, &info, &left) != SIGUSR1)
+        {
+            // Interrupted, or time to ask again
+            continue;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            // A SIGUSR1 sent by someone else is ignored
+            if (waiting[i] && info.si_pid == monitors[i]->pid)
+            {
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                statuses[i].latency_ms = (double)(now.tv_sec - sent_at.tv_sec) * MSECS_PER_SEC +
+                                         (double)(now.tv_nsec - sent_at.tv_nsec) / NSECS_PER_MSEC;
+                decode_metrics_status(info.si_value.sival_int, &statuses[i].sample);
+                // Without the ring, the history only gets the samples asked for
+                if (monitors[i]->history != NULL)
+                {
+                    metrics_history_add(monitors[i]->history, &statuses[i].sample);
+                }
+                statuses[i].error = 0;
+                waiting[i] = false;
+                n_waiting--;
+                // The responses of the rest may have merged into this one: ask them again right away
+                resend_ns = at_ns;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Gets the latest status data of several "metrics" apps at once: straight from the shared memory ring of the
+ * ones that publish there (no syscall involved), otherwise asking every other one for it with SIGUSR1 up front, and
+ * sleeping until their responses arrive or a single deadline passes. Either way, the samples end up on their histories
+ * too. One thread at a time gets to ask (see monitor_lock_samples()), so several "status_monitor" stages of a
+ * pipeline don't take each other's responses.
+ * @param monitors The instances, running; MONITORS_MAX at most.
+ * @param n Amount of instances.
+ * @param timeout_ms Milliseconds to wait for the responses to SIGUSR1, for all of them.
+ * @param statuses Where to leave the status data of each instance (error is ETIMEDOUT if no response arrived in time).
+ */
+static void fetch_monitor_samples(monitor* const* monitors, size_t n, long timeout_ms, monitor_status* statuses)
+{
+    monitor_lock_samples();
+    fetch_monitor_samples_locked(monitors, n, timeout_ms, statuses);
+    monitor_unlock_samples();
+}
+
+/**
+ * @brief Gets the latest status data of a "metrics" app, as fetch_monitor_samples() does.
+ * @param m The instance, running.
+ * @param timeout_ms Milliseconds to wait for a response to SIGUSR1.
+ * @param status Where to leave the status data.
+ * @return true on success, false otherwise (errno is set; ETIMEDOUT if no response arrived in time).
+ */
+static bool fetch_monitor_sample(monitor* m, long timeout_ms, monitor_status* status)
+{
+    fetch_monitor_samples(&m, 1, timeout_ms, status);
+    errno = status->error;
+    return status->error == 0;
+}
+
+/**
+ * @brief Shows the latest status data of every running "metrics" app, one per row; they're all asked at once, so it
+ * takes as long as the slowest one (or the timeout) at most, not their sum.
+ * @param out Where to show it (i.e.: stdout).
+ * @param timeout_ms Milliseconds to wait for the responses to SIGUSR1.
+ */
+static void print_monitors_status(FILE* out, long timeout_ms)
+{
+    size_t n_slots;
+    monitor* registry = monitor_registry(&n_slots);
+    monitor* running[MONITORS_MAX];
+    size_t n = 0;
+    for (size_t i = 0; i < n_slots; i++)
+    {
+        if (registry[i].name[0] != STR_NULL_TERMINATOR && monitor_running(&registry[i]))
+        {
+            running[n++] = &registry[i];
+        }
+    }
+    if (n == 0)
+    {
+        fputs("WARNING: No metrics app initialized, or tracked by this Shell.\n", out);
+        return;
+    }
+    monitor_status statuses[MONITORS_MAX];
+    fetch_monitor_samples(running, n, timeout_ms, statuses);
+    fprintf(out, "%-16s %10s %10s %12s %12s %14s %14s %12s %12s\n", "Name", "CPU", "RAM", "HDD read/s", "HDD write/s",
+           "Net rx/s", "Net tx/s", "Procs", "Latency");
+    for (size_t i = 0; i < n; i++)
+    {
+        if (statuses[i].error != 0)
+        {
+            fprintf(out, "%-16s %s\n", running[i]->name,
+                    statuses[i].error == ETIMEDOUT ? "Timeout reached. No response." : strerror(statuses[i].error));
+            continue;
+        }
+        char values[METRICS_STATUS_ROWS][DASHBOARD_VALUE_SIZE];
+        format_metrics_status(&statuses[i].sample, values);
+        fprintf(out, "%-16s %10s %10s %12s %12s %14s %14s %12s %9.3f ms (%s)\n", running[i]->name, values[0],
+                values[1], values[2], values[3], values[4], values[5], values[6], statuses[i].latency_ms,
+                statuses[i].from_ring ? "sample age" : "response");
+    }
+}
+
+/**
+ * @brief Parses the args of "watch_monitor": the name of the "metrics" app, then the seconds between refreshes
+ * (i.e.: "0.5"), both optional. A first arg that is a number is the interval.
+ * @param sc_tokens Single command tokens.
+ * @param name Where to leave the name; MONITOR_DEFAULT_NAME if it isn't given.
+ * @param interval_ms Where to leave the milliseconds between refreshes; WATCH_INTERVAL_MS if the arg isn't given.
+ * @return true if the args are missing or valid, false otherwise.
+ */
+static bool parse_watch_args(char** sc_tokens, const char** name, long* interval_ms)
+{
+    *name = MONITOR_DEFAULT_NAME;
+    *interval_ms = WATCH_INTERVAL_MS;
+    const char* value = sc_tokens[SC_FIRST_ARG_I];
+    if (value == NULL)
+    {
+        return true;
+    }
+    char* end;
+    errno = 0;
+    double seconds = strtod(value, &end);
+    int value_i = SC_FIRST_ARG_I;
+    if (end == value || *end != STR_NULL_TERMINATOR)
+    {
+        *name = value;
+        value = sc_tokens[++value_i];
+        if (value == NULL)
+        {
+            return true;
+        }
+        errno = 0;
+        seconds = strtod(value, &end);
+    }
+    if (errno != 0 || end == value || *end != STR_NULL_TERMINATOR || sc_tokens[value_i + 1] != NULL ||
+        !(seconds * MSECS_PER_SEC >= WATCH_INTERVAL_MIN_MS && seconds * MSECS_PER_SEC <= WATCH_INTERVAL_MAX_MS))
+    {
+        return false;
+    }
+    *interval_ms = (long)(seconds * MSECS_PER_SEC + 0.5);
+    return true;
+}
+
+/**
+ * @brief Brings the values of the "watch_monitor" dashboard up to date with the latest status data of the "metrics"
+ * app. On failure, the metrics keep their previous values and the last row tells what happened.
+ * @param m The instance watched.
+ * @param values Text of each metric, plus the latency row.
+ * @param timeout_ms Milliseconds to wait for a response to SIGUSR1.
+ */
+static void refresh_watch_values(monitor* m, char values[][DASHBOARD_VALUE_SIZE], long timeout_ms)
+{
+    monitor_status status;
+    if (!fetch_monitor_sample(m, timeout_ms, &status))
+    {
+        snprintf(values[METRICS_STATUS_ROWS], DASHBOARD_VALUE_SIZE, "%s",
+                 errno == ETIMEDOUT ? "no response" : strerror(errno));
+        return;
+    }
+    format_metrics_status(&status.sample, values);
+    snprintf(values[METRICS_STATUS_ROWS], DASHBOARD_VALUE_SIZE, "%s %.3f ms",
+             status.from_ring ? "sample age" : "response in", status.latency_ms);
+}
+
+void start_shell_ml()
+{
+    // The shell itself mustn't answer to certain signals
+    for (int i = LOWEST_ARR_INDEX; i < N_SINGALS_TO_HANDLE; i++)
+    {
+        signal(signals[i], SIG_IGN);
+    }
+    // Nor to the ones sent when it hands the terminal to a job, and takes it back
+    for (int i = LOWEST_ARR_INDEX; i < N_JOB_CONTROL_SIGNALS; i++)
+    {
+        signal(job_control_signals[i], SIG_IGN);
+    }
+    // Job control only makes sense with a terminal
+    if (jobs_init(isatty(STDIN_FILENO)) == -1)
+    {
+        wstderr("ERROR: Children can't be reaped asynchronously", true);
+    }
+
+    // Get the 3 parts that conform the command line prompt
+    prompt.user = getenv(ENV_USER_KEY);
+    gethostname(prompt.host, (HOST_NAME_MAX + 1));
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, PATH_MAX) == NULL)
+    {
+        wstderr("ERROR: cwd can't be retrieved", true);
+        exit(EXIT_FAILURE);
+    }
+
+    // The shell sleeps until there's input, or a child changes its state; a regular file (i.e.: "shell < file") can't
+    // be watched, but it's always ready to be read
+    const bool input_watched = event_watch(STDIN_FILENO, EPOLLIN, read_prompt_input, cwd) == 0;
+    if (jobs_signal_fd() != -1)
+    {
+        event_watch(jobs_signal_fd(), EPOLLIN, notify_finished_jobs, cwd);
+    }
+
+    // Main loop
+    show_prompt(cwd);
+    while (true)
+    {
+        if (!input_watched)
+        {
+            read_prompt_input(STDIN_FILENO, EPOLLIN, cwd);
+        }
+        else if (event_dispatch(-1) == -1)
+        {
+            wstderr("ERROR: Waiting for input", true);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void execute_command(const char* input, size_t len, char* cwd)
+{
+    // A single pass over the input builds the whole command line AST; the input itself doesn't get copied
+    cmd_pipeline pipeline;
+    if (parse_command_line(input, len, &cmd_arena, &pipeline) == -1)
+    {
+        wstderr(pipeline.error, false);
+        arena_reset(&cmd_arena);
+        return;
+    }
+    const int sc_n = (int)pipeline.n_stages;
+    const bool background_execution = pipeline.background;
+    // How many single commands (separated by |) were submitted: none, one or multiple?
+    if (sc_n == 0)
+    {
+        // Only blanks were submitted
+        arena_reset(&cmd_arena);
+        return;
+    }
+    // One single command was submitted
+    if (sc_n == 1)
+    {
+        const char* stdin_file;
+        const char* stdout_file;
+        char** sc_tokens = prepare_single_command(&pipeline, &pipeline.stages[LOWEST_ARR_INDEX], &stdin_file,
+                                                  &stdout_file);
+        const builtin_call call = {sc_tokens, background_execution, cwd, stdout, false};
+        const builtin* internal_cmd = builtin_lookup(sc_tokens[LOWEST_ARR_INDEX]);
+        int exit_code = EXIT_SUCCESS;
+        if (internal_cmd != NULL && (internal_cmd->flags & (BUILTIN_IN_PROCESS | BUILTIN_NEEDS_PARENT)))
+        {
+            // Internal commands run inside the shell process itself, so the shell stdin & stdout are redirected
+            int original_stdin = redirect_stdin(stdin_file);
+            int original_stdout = redirect_stdout(stdout_file);
+            internal_cmd->handler(&call);
+            // Restore stdin and stdout if were modified
+            restore_stdio(original_stdin, STDIN_FILENO);
+            restore_stdio(original_stdout, STDOUT_FILENO);
+        }
+        else
+        {
+            // Potential external command invocation, or a slow internal one run by a copy of the shell (so it can go
+            // to the background); redirections are applied on the new process
+            spawn_io io;
+            spawn_io_init(&io);
+            io.stdin_file = stdin_file;
+            io.stdout_file = stdout_file;
+            // With job control, the process leads its own process group
+            io.pgid = jobs_control_enabled() ? 0 : SPAWN_PGID_INHERIT;
+            const pid_t pid_child = internal_cmd == NULL
+                                        ? execute_external_cmd(sc_tokens, background_execution, &io)
+                                        : execute_internal_cmd_forked(internal_cmd, &call, &io);
+            if (pid_child != -1)
+            {
+                await_job(input, len, jobs_control_enabled() ? pid_child : 0, &pid_child, 1, background_execution,
+                          &exit_code);
+            }
+            else
+            {
+                exit_code = internal_cmd == NULL ? EXIT_CODE_NOT_RUN : EXIT_FAILURE;
+            }
+        }
+        if (!background_execution)
+        {
+            set_pipe_status(&exit_code, 1);
+        }
+    }
+    else
+    {
+        // Multiple single command (sc_n > 1) submitted, pipe implementation called
+        execute_pipeline(&pipeline, input, len, cwd);
+    }
+    // The command line finished; its AST, tokens & argv arrays are released at once
+    arena_reset(&cmd_arena);
+}
+
+bool await_job(const char* command, size_t command_len, pid_t pgid, const pid_t* pids, size_t n_pids,
+               bool background_execution, int* exit_codes)
+{
+    job* j = jobs_add(command, command_len, pgid, pids, n_pids, background_execution);
+    if (j == NULL)
+    {
+        // Can't be tracked; at least don't leave the foreground ones behind
+        wstderr("ERROR: Failed to allocate memory", true);
+        for (size_t i = LOWEST_ARR_INDEX; i < n_pids && !background_execution; i++)
+        {
+            int status = 0;
+            waitpid(pids[i], &status, 0);
+            if (exit_codes != NULL)
+            {
+                exit_codes[i] = jobs_status_exit_code(status);
+            }
+        }
+        return false;
+    }
+    if (background_execution)
+    {
+        // Concurrent execution
+        printf("[%u] %d\n", j->id, (int)pids[n_pids - 1]);
+        // Try that this output goes out first
+        fflush(stdout);
+        return false;
+    }
+    // Non concurrent execution, wait for the job to finish (or to be stopped, i.e.: [Ctrl]+[Z])
+    jobs_wait(j, true);
+    for (size_t i = LOWEST_ARR_INDEX; i < n_pids && exit_codes != NULL; i++)
+    {
+        exit_codes[i] = jobs_status_exit_code(j->members[i].status);
+    }
+    if (jobs_state(j) == JOB_STOPPED)
+    {
+        j->background = true;
+        putchar('\n');
+        jobs_print(stdout, j);
+        fflush(stdout);
+        return true;
+    }
+    jobs_remove(j);
+    return false;
+}
+
+pid_t execute_internal_cmd_forked(const builtin* internal_cmd, const builtin_call* call, const spawn_io* io)
+{
+    // Don't let the copy of the shell inherit pending stdout data
+    fflush(stdout);
+    const pid_t pid_child = fork();
+    if (pid_child == -1)
+    {
+        wstderr("ERROR: Forking of current process failed", true);
+        return -1;
+    }
+    else if (pid_child > 0)
+    {
+        // Set on both sides, so it's already done whichever runs first
+        if (io->pgid != SPAWN_PGID_INHERIT)
+        {
+            setpgid(pid_child, io->pgid == 0 ? pid_child : io->pgid);
+        }
+        return pid_child;
+    }
+    // This is a child process; join the process group of its job, and answer to job control signals again
+    if (io->pgid != SPAWN_PGID_INHERIT)
+    {
+        setpgid(0, io->pgid);
+    }
+    for (int i = LOWEST_ARR_INDEX; i < N_JOB_CONTROL_SIGNALS; i++)
+    {
+        signal(job_control_signals[i], SIG_DFL);
+    }
+    // Set its stdin & stdout to be certain ends of the pipes, if any
+    if ((io->stdin_fd != SPAWN_FD_INHERIT && dup2(io->stdin_fd, STDIN_FILENO) == -1) ||
+        (io->stdout_fd != SPAWN_FD_INHERIT && dup2(io->stdout_fd, STDOUT_FILENO) == -1))
+    {
+        wstderr("ERROR: dup2() failed", true);
+        _exit(EXIT_FAILURE);
+    }
+    // Once pipes file descriptors were copied to its respective stdin & stdout, close them (it doesn't exec, so being
+    // close-on-exec doesn't help)
+    spawn_close_fds(io->fds_to_close, io->n_fds_to_close);
+    // Redirections implementation
+    redirect_stdin(io->stdin_file);
+    redirect_stdout(io->stdout_file);
+    internal_cmd->handler(call);
+    // End this child process successfully; _exit() so the shell stdio streams aren't touched twice
+    fflush(stdout);
+    _exit(EXIT_SUCCESS);
+}
+
+void execute_batch_file(const char* path, unsigned jobs)
+{
+    // Get current working directory
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, PATH_MAX) == NULL)
+    {
+        wstderr("ERROR: cwd can't be retrieved", true);
+        exit(EXIT_FAILURE);
+    }
+    // No job control without a terminal, but finished background jobs still get reaped
+    jobs_init(false);
+    // Open file; the commands executed mustn't inherit it
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        wstderr("ERROR: Opening batch file", true);
+        return;
+    }
+    // Each line is executed straight from the mapped file (or the read buffer); if there's a forced exit, the file
+    // gets closed automatically
+    const int result = jobs > 1 ? parallel_for_each_line(fd, jobs, classify_batch_line, execute_batch_line, cwd)
+                                : batch_for_each_line(fd, execute_batch_line, cwd);
+    if (result == -1)
+    {
+        wstderr("ERROR: Reading batch file", true);
+    }
+    // Close the file cleanly
+    close(fd);
+}
+
+int set_pipe_size(int bytes)
+{
+    if (bytes > 0 && spawn_check_pipe_size(bytes) == -1)
+    {
+        return -1;
+    }
+    pipe_size = bytes;
+    return 0;
+}
+
+int redirect_stdin(const char* file_name)
+{
+    if (file_name != NULL)
+    {
+        // Redirect stdin
+        int input_fd = open(file_name, O_RDONLY);
+        if (input_fd == -1)
+        {
+            wstderr("ERROR: Failed to open input file", true);
+            exit(EXIT_FAILURE);
+        }
+        // duplicate the original file descriptor number to return if everything goes well
+        int original_stdin = dup(STDIN_FILENO);
+        if (dup2(input_fd, STDIN_FILENO) == -1)
+        {
+            wstderr("ERROR: Failed to redirect stdin", true);
+            close(input_fd);
+            exit(EXIT_FAILURE);
+        }
+        close(input_fd);
+        return original_stdin;
+    }
+    return -1;
+}
+
+int redirect_stdout(const char* file_name)
+{
+    if (file_name != NULL)
+    {
+        // Redirect stdout
+        int output_fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (output_fd == -1)
+        {
+            wstderr("ERROR: Failed to open output file", true);
+            exit(EXIT_FAILURE);
+        }
+        // duplicate the original file descriptor number to return if everything goes well
+        int original_stdin = dup(STDOUT_FILENO);
+        if (dup2(output_fd, STDOUT_FILENO) == -1)
+        {
+            wstderr("ERROR: Failed to redirect stdout", true);
+            close(output_fd);
+            exit(EXIT_FAILURE);
+        }
+        close(output_fd);
+        return original_stdin;
+    }
+    return -1;
+}
+
+void restore_stdio(int original_stdio, int target_fd)
+{
+    if (original_stdio != -1)
+    {
+        if (dup2(original_stdio, target_fd) == -1)
+        {
+            wstderr("ERROR: Failed to restore stdio", true);
+            close(original_stdio);
+            exit(EXIT_FAILURE);
+        }
+        close(original_stdio);
+    }
+}
+
+void execute_cd(const builtin_call* call)
+{
+    char** sc_tokens = call->sc_tokens;
+    char* cwd = call->cwd;
+    // Check existence of argument
+    if (sc_tokens[SC_FIRST_ARG_I])
+    {
+        // Argument provided
+        if (strcmp(sc_tokens[SC_FIRST_ARG_I], "-") == 0 && sc_tokens[SC_SECOND_ARG_I] == NULL)
+        {
+            // Return to old current directory (if exist)
+            const char* old_cwd = getenv(ENV_OLDPWD_KEY);
+            if (old_cwd == NULL)
+            {
+                errno = ENOENT;
+                wstderr("ERROR: No such thing as 'OLDPWD' for now", true);
+            }
+            else
+            {
+                // Old current directory exist, head to it if possible and update env
+                if (chdir(old_cwd) == -1)
+                {
+                    wstderr("ERROR: Issue changing cwd to the old one", true);
+                }
+                else
+                {
+                    // Success
+                    setenv(ENV_OLDPWD_KEY, cwd, true);
+                    if (getcwd(cwd, PATH_MAX) == NULL)
+                    {
+                        wstderr("ERROR: cwd can't be retrieved", true);
+                        exit(EXIT_FAILURE);
+                    }
+                }
+            }
+        }
+        else
+        {
+            // Try to move to a new current directory; args are joined back, so unquoted spaces are part of the path
+            char path[PATH_MAX];
+            if (!join_tokens(&sc_tokens[SC_FIRST_ARG_I], path, PATH_MAX))
+            {
+                errno = ENAMETOOLONG;
+                wstderr("ERROR: Can't change current working directory", true);
+            }
+            else if (chdir(path) == -1)
+            {
+                // The argument is wrong or another problem appeared
+                wstderr("ERROR: Can't change current working directory", true);
+            }
+            else
+            {
+                // The arguments is right, proceed with the normal procedure
+                setenv(ENV_OLDPWD_KEY, cwd, true);
+                if (getcwd(cwd, PATH_MAX) == NULL)
+                {
+                    wstderr("ERROR: cwd can't be retrieved", true);
+                    exit(EXIT_FAILURE);
+                }
+            }
+        }
+    }
+    else
+    {
+        // No argument; the current directory shall be provided
+        fprintf(call->out, "%s\n", cwd);
+    }
+}
 
-void start_shell_ml()
+void execute_echo(const builtin_call* call)
 {
-    // The shell itself mustn't answer to certain signals
-    for (int i = LOWEST_ARR_INDEX; i < N_SINGALS_TO_HANDLE; i++)
+    char** sc_tokens = call->sc_tokens;
+    // Check existence of argument
+    if (sc_tokens[SC_FIRST_ARG_I])
     {
-        signal(signals[i], SIG_IGN);
+        // Arg provided; check if starts with '$', in which case it's referencing an env var
+        if (sc_tokens[SC_FIRST_ARG_I][LOWEST_ARR_INDEX] == '$')
+        {
+            const char* env_val = getenv(&sc_tokens[SC_FIRST_ARG_I][1]);
+            if (env_val == NULL)
+            {
+                // No env var with thy name or any other issue; errno doesn't get set
+                wstderr("ERROR: Unexistent env var or empty arg provided.\n", false);
+            }
+            else
+            {
+                fprintf(call->out, "%s\n", env_val);
+            }
+        }
+        else
+        {
+            // Args are printed separated by a single space, as other shells do
+            for (int i = SC_FIRST_ARG_I; sc_tokens[i] != NULL; i++)
+            {
+                fprintf(call->out, i == SC_FIRST_ARG_I ? "%s" : " %s", sc_tokens[i]);
+            }
+            fputc('\n', call->out);
+        }
     }
-
-    // Get the 3 parts that conform the command line prompt
-    const char* user = getenv(ENV_USER_KEY);
-    char host[HOST_NAME_MAX + 1];
-    gethostname(host, (HOST_NAME_MAX + 1));
-    char cwd[PATH_MAX];
-    if (getcwd(cwd, PATH_MAX) == NULL)
+    else
     {
-        wstderr("ERROR: cwd can't be retrieved", true);
-        exit(EXIT_FAILURE);
+        // No argument; a newline gets printed
+        fputc('\n', call->out);
     }
+}
 
-    // Main loop
-    while (true)
+void execute_clr(const builtin_call* call)
+{
+    fputs(CLR_ANSI_EC, call->out);
+    fflush(call->out);
+}
+
+void execute_quit(const builtin_call* call)
+{
+    // Args ignored
+    (void)call;
+    // Try to end zombie processes
+    jobs_reap();
+    // In case the JSON config file for "metrics" was created, try its deletion
+    delete_owned_metrics_json_config_file();
+    // do exit
+    exit(EXIT_SUCCESS);
+}
+
+void execute_start_monitor(const builtin_call* call)
+{
+    // "--name=NAME" tells it apart from the rest; the "metrics" options ignore it
+    const char* name = MONITOR_DEFAULT_NAME;
+    const size_t name_len = strlen(MONITOR_NAME_OPTION);
+    for (int i = SC_FIRST_ARG_I; call->sc_tokens[i] != NULL; i++)
+    {
+        if (strncmp(call->sc_tokens[i], MONITOR_NAME_OPTION, name_len) == 0)
+        {
+            name = &call->sc_tokens[i][name_len];
+        }
+    }
+    if (!monitor_name_valid(name))
+    {
+        wstderr("ERROR: `--name` value must be up to 31 letters, digits, \"_\" or \"-\" (but \"all\").\n", false);
+        return;
+    }
+    // The config gets built in memory by the shell (or reused, if it's the same as last time), and handed over as an
+    // inherited file descriptor the "metrics" app opens by path; nothing gets written to the filesystem. Bad options
+    // leave the registry (and the history kept for the name) untouched
+    char* config_path;
+    int config_fd;
+    if (get_metrics_config(call->sc_tokens, &config_path, &config_fd) == -1)
+    {
+        return;
+    }
+    monitor* m = monitor_claim(name);
+    if (m == NULL)
     {
-        printf("%s@%s:%s$ ", user, host, cwd);
-        // Buffer for the input
-        static char input[ARG_MAX];
-        if (fgets(input, ARG_MAX, stdin) != NULL)
+        if (errno == EEXIST)
+        {
+            printf("WARNING: metrics app \"%s\" is already running; stop it first.\n", name);
+        }
+        else
         {
-            execute_command(input, cwd);
+            fprintf(stderr, "ERROR: Up to %d metrics apps can run at once.\n", MONITORS_MAX);
         }
+        return;
+    }
+    char* argv[METRICS_MAX_ARGC + 1] = {METRICS_APP_PATH, config_fd != -1 ? METRICS_CONFIG_CHILD_PATH : config_path,
+                                        NULL};
+    spawn_io io;
+    spawn_io_init(&io);
+    if (config_fd != -1)
+    {
+        io.shared_fds[CONFIG_SHARED_FD_I] = config_fd;
+        io.shared_fd_targets[CONFIG_SHARED_FD_I] = METRICS_CONFIG_CHILD_FD;
+    }
+    io.pgid = jobs_control_enabled() ? 0 : SPAWN_PGID_INHERIT;
+    // A new ring and control channel per "metrics" app, handed over as file descriptors it learns from the
+    // environment; without them, the status gets asked with a signal, and the config can't change live
+    m->samples = metrics_ring_create(&m->samples_fd);
+    char ring_fd[sizeof(int) * 3 + 1];
+    snprintf(ring_fd, sizeof(ring_fd), "%d", METRICS_RING_CHILD_FD);
+    if (m->samples != NULL)
+    {
+        io.shared_fds[RING_SHARED_FD_I] = m->samples_fd;
+        io.shared_fd_targets[RING_SHARED_FD_I] = METRICS_RING_CHILD_FD;
+        setenv(METRICS_RING_FD_ENV, ring_fd, true);
+    }
+    int control_fds[2] = {-1, -1};
+    char control_fd[sizeof(int) * 3 + 1];
+    snprintf(control_fd, sizeof(control_fd), "%d", METRICS_CONTROL_CHILD_FD);
+    if (metrics_control_open(control_fds) == 0)
+    {
+        m->control_fd = control_fds[0];
+        io.shared_fds[CONTROL_SHARED_FD_I] = control_fds[1];
+        io.shared_fd_targets[CONTROL_SHARED_FD_I] = METRICS_CONTROL_CHILD_FD;
+        setenv(METRICS_CONTROL_FD_ENV, control_fd, true);
+    }
+    const pid_t pid_child = execute_external_cmd(argv, call->background_execution, &io);
+    unsetenv(METRICS_RING_FD_ENV);
+    unsetenv(METRICS_CONTROL_FD_ENV);
+    // Only the "metrics" app keeps its end
+    if (control_fds[1] != -1)
+    {
+        close(control_fds[1]);
+    }
+    if (pid_child == -1)
+    {
+        // It never ran, so it has no history to keep
+        monitor_unclaim(m);
+    }
+    else
+    {
+        // Save the child pid, so the other monitor-related commands can reach it by name; its pidfd tells when it's
+        // gone
+        monitor_track(m, pid_child);
+        await_job(METRICS_APP_PATH, strlen(METRICS_APP_PATH), jobs_control_enabled() ? pid_child : 0, &pid_child, 1,
+                  call->background_execution, NULL);
     }
 }
 
-void execute_command(char* input, char* cwd)
+/**
+ * @brief Stops a running "metrics" app, and forgets it (its history is kept).
+ * @param m The instance.
+ */
+static void stop_monitor(monitor* m)
 {
-    // Initialize job counter
-    static unsigned long long int job_id = 0;
-    // There're custom commands that work with the "metrics" app (lab 1); keep track of some data
-    static int metrics_pid = PID_UNASSIGNED;
-    // Cleanse the newline added at the end, if exist
-    cleanse_newline(input);
-    // Let's dup this value to a helper, for strtok() usage; the original one'll be useful as pristine later
-    static char input_h[ARG_MAX];
-    strcpy(input_h, input);
+    // Through its pidfd, if any, so it can't reach another process that got its process id
+    const int result = m->pidfd != -1 ? event_pidfd_signal(m->pidfd, SIGTERM) : kill(m->pid, SIGTERM);
+    if (result == -1)
+    {
+        wstderr("ERROR: \"metrics\" child process can't be killed", true);
+    }
+    else if (strcmp(m->name, MONITOR_DEFAULT_NAME) == 0)
+    {
+        puts("metrics successfully stopped.");
+    }
+    else
+    {
+        printf("metrics \"%s\" successfully stopped.\n", m->name);
+    }
+    monitor_forget(m);
+}
 
-    // Tokenize single commands, per pipe
-    char* single_commands[MAX_SINGLE_COMMANDS];
-    // Will remain with this value if empty input was submitted; # of SC
-    int sc_n = LOWEST_ARR_INDEX;
-    char* token = strtok(input_h, SC_TOKEN_SEPARATOR);
-    while (token != NULL && sc_n < MAX_SINGLE_COMMANDS)
+void execute_stop_monitor(const builtin_call* call)
+{
+    const char* name = call->sc_tokens[SC_FIRST_ARG_I] != NULL ? call->sc_tokens[SC_FIRST_ARG_I] : MONITOR_DEFAULT_NAME;
+    if (strcmp(name, MONITOR_ALL_NAME) != 0)
+    {
+        monitor* m = monitor_find(name);
+        if (m != NULL && monitor_running(m))
+        {
+            stop_monitor(m);
+        }
+        return;
+    }
+    size_t n_slots;
+    monitor* registry = monitor_registry(&n_slots);
+    for (size_t i = 0; i < n_slots; i++)
     {
-        single_commands[sc_n++] = token;
-        token = strtok(NULL, SC_TOKEN_SEPARATOR);
+        if (registry[i].name[0] != STR_NULL_TERMINATOR && monitor_running(&registry[i]))
+        {
+            stop_monitor(&registry[i]);
+        }
     }
+}
 
-    // How many single commands (separated by |) were submitted: none, one or multiple?
-    if (sc_n == 0)
+void execute_config_monitor(const builtin_call* call)
+{
+    int next_i;
+    monitor* m = running_monitor(call->out, monitor_name_arg(call->sc_tokens, &next_i));
+    if (m == NULL)
+    {
         return;
-    // One single command was submitted
-    if (sc_n == 1)
+    }
+    // Same options (and validation) as "start_monitor"; only the ones given get changed
+    unsigned char data[N_JSON_ENTRIES] = JSON_ENTRIES_DEF_VAL;
+    unsigned options;
+    char* config_path;
+    if (parse_metrics_options(call->sc_tokens, data, &options, &config_path) == -1)
     {
-        // One single command submitted; update job id
-        job_id++;
-        // Explicit freed of memory isn't done, relies on the OS when exit() gets called
-        char** sc_tokens = tokenize_single_command(single_commands[LOWEST_ARR_INDEX]);
-        // Check if "&" appears, to see if it requires background execution
-        bool background_execution = is_background_exec(sc_tokens);
-        // Redirections implementation; check for "<" appearance
-        char* file_name = get_possible_redirection(sc_tokens, true);
-        int original_stdin = redirect_stdin(file_name);
-        // Check for ">" appearance; re-use file_name, as it is a buffer
-        file_name = get_possible_redirection(sc_tokens, false);
-        int original_stdout = redirect_stdout(file_name);
-        // cleanse single command tokens & the string itself from redirection tokens
-        cleanse_redirections_on_argv(sc_tokens);
-        cleanse_redirections_on_sc(input);
-        // Internal commands, when called solo, are always executed in the foreground, as they are quick
-        if (strcmp(sc_tokens[LOWEST_ARR_INDEX], "cd") == 0)
+        return;
+    }
+    if (config_path != NULL || options == 0)
+    {
+        wstderr("ERROR: `config_monitor` takes the `start_monitor` options to change, but `--config` (i.e.: "
+                "--cpu=false --update_interval=2).\n",
+                false);
+        return;
+    }
+    if (m->control_fd == -1)
+    {
+        wstderr("ERROR: There's no control channel to the \"metrics\" app.\n", false);
+        return;
+    }
+    metrics_control_msg msg = {.options = options};
+    memcpy(msg.values, data, sizeof(msg.values));
+    if (metrics_control_request(m->control_fd, &msg, METRICS_RESPONSE_TIMEOUT_MS) == -1)
+    {
+        if (errno == ETIMEDOUT)
         {
-            execute_cd(input, sc_tokens, background_execution, cwd);
+            wstderr("ERROR: Timeout reached. No acknowledgment from \"metrics\" app.\n", false);
         }
-        else if (strcmp(sc_tokens[LOWEST_ARR_INDEX], "clr") == 0)
+        else
         {
-            printf(CLR_ANSI_EC);
-            fflush(stdout);
+            wstderr("ERROR: Config change not applied by \"metrics\" app", true);
         }
-        else if (strcmp(sc_tokens[LOWEST_ARR_INDEX], "echo") == 0)
+        return;
+    }
+    puts("metrics config successfully updated.");
+}
+
+void execute_status_monitor(const builtin_call* call)
+{
+    int next_i;
+    const char* name = monitor_name_arg(call->sc_tokens, &next_i);
+    long timeout_ms;
+    uint64_t history_ns;
+    const char* history_text;
+    if (!parse_status_options(call->sc_tokens, next_i, &timeout_ms, &history_ns, &history_text))
+    {
+        wstderr("ERROR: `--timeout` value must be a recognizable int between 1 and 60000 (milliseconds), and "
+                "`--history` one between 1s and 1h (i.e.: 30s, 5m).\n",
+                false);
+        return;
+    }
+    if (history_ns > 0)
+    {
+        // The history outlives the "metrics" app, until another one gets started with its name
+        monitor* m = monitor_find(name);
+        if (m != NULL)
         {
-            execute_echo(input, sc_tokens, background_execution);
+            print_metrics_history(call->out, m, history_ns, history_text);
+            return;
         }
-        else if (strcmp(sc_tokens[LOWEST_ARR_INDEX], "quit") == 0)
+        size_t n_slots;
+        monitor* registry = monitor_registry(&n_slots);
+        bool any = false;
+        for (size_t i = 0; strcmp(name, MONITOR_ALL_NAME) == 0 && i < n_slots; i++)
         {
-            // Try to end zombie processes
-            while (waitpid(-1, NULL, WNOHANG) > 0)
+            if (registry[i].name[0] != STR_NULL_TERMINATOR)
             {
+                print_metrics_history(call->out, &registry[i], history_ns, history_text);
+                any = true;
             }
-            // In case the JSON config file for "metrics" was created, try its deletion
-            delete_owned_metrics_json_config_file();
-            // do exit
-            exit(EXIT_SUCCESS);
         }
-        else if (strcmp(sc_tokens[LOWEST_ARR_INDEX], "stop_monitor") == 0)
+        if (!any)
         {
-            execute_stop_monitor(&metrics_pid);
+            fprintf(call->out, "WARNING: No history of metrics app \"%s\".\n", name);
         }
-        else if (strcmp(sc_tokens[LOWEST_ARR_INDEX], "status_monitor") == 0)
+        return;
+    }
+    if (strcmp(name, MONITOR_ALL_NAME) == 0)
+    {
+        print_monitors_status(call->out, timeout_ms);
+        return;
+    }
+    monitor* m = running_monitor(call->out, name);
+    if (m == NULL)
+    {
+        return;
+    }
+    monitor_status status;
+    if (!fetch_monitor_sample(m, timeout_ms, &status))
+    {
+        if (errno == ETIMEDOUT)
         {
-            execute_status_monitor(&metrics_pid);
+            wstderr("ERROR: Timeout reached. No response from \"metrics\" app.\n", false);
         }
-        else if (strcmp(sc_tokens[LOWEST_ARR_INDEX], "explore_filesystem") == 0)
+        else
         {
-            execute_explore_filesystem(sc_tokens);
+            wstderr("ERROR: Signaling \"status_monitor\"", true);
         }
-        else
+        return;
+    }
+    print_metrics_status(call->out, m->name, &status.sample, status.from_ring ? "Sample age" : "Response time",
+                         status.latency_ms);
+}
+
+void execute_watch_monitor(const builtin_call* call)
+{
+    const char* name;
+    long interval_ms;
+    if (!parse_watch_args(call->sc_tokens, &name, &interval_ms))
+    {
+        wstderr("ERROR: `watch_monitor` interval must be a number of seconds between 0.1 and 60 (i.e.: 0.5).\n", false);
+        return;
+    }
+    monitor* m = running_monitor(call->out, name);
+    if (m == NULL)
+    {
+        return;
+    }
+    struct termios saved_mode;
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) || tcgetattr(STDIN_FILENO, &saved_mode) == -1)
+    {
+        wstderr("ERROR: `watch_monitor` needs a terminal.\n", false);
+        return;
+    }
+    const int timer = event_timerfd((unsigned)interval_ms);
+    if (timer == -1)
+    {
+        wstderr("ERROR: `watch_monitor` timer creation failed", true);
+        return;
+    }
+    // Each key gets read as soon as it's pressed, unechoed; [Ctrl]+[C] is a key too
+    struct termios key_mode = saved_mode;
+    key_mode.c_lflag &= ~(tcflag_t)(ICANON | ECHO | ISIG);
+    key_mode.c_cc[VMIN] = 1;
+    key_mode.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &key_mode);
+    // Frames are written straight to the terminal; whatever stdio holds goes first
+    fflush(stdout);
+    char title[DASHBOARD_VALUE_SIZE * 2];
+    snprintf(title, sizeof(title), "metrics app %s live data (every %ld ms, press any key to stop)", m->name,
+             interval_ms);
+    const char* labels[METRICS_STATUS_ROWS + 1];
+    memcpy(labels, metrics_status_labels, sizeof(metrics_status_labels));
+    labels[METRICS_STATUS_ROWS] = "Updated";
+    dashboard board;
+    dashboard_init(&board, title, labels, METRICS_STATUS_ROWS + 1);
+    char values[METRICS_STATUS_ROWS + 1][DASHBOARD_VALUE_SIZE] = {{0}};
+    const char* value_ptrs[METRICS_STATUS_ROWS + 1];
+    for (int i = 0; i <= METRICS_STATUS_ROWS; i++)
+    {
+        value_ptrs[i] = values[i];
+    }
+    char frame[DASHBOARD_FRAME_SIZE];
+    // The monitor exit ends the watch too; a -1 pidfd is ignored by poll()
+    struct pollfd sources[] = {{STDIN_FILENO, POLLIN, 0}, {timer, POLLIN, 0}, {m->pidfd, POLLIN, 0}};
+    const long timeout_ms = interval_ms < METRICS_RESPONSE_TIMEOUT_MS ? interval_ms : METRICS_RESPONSE_TIMEOUT_MS;
+    bool watching = true;
+    bool refresh = true;
+    while (watching)
+    {
+        if (refresh)
         {
-            // Potential external or monitor-related command invocation
-            const pid_t pid_child = fork();
-            if (pid_child == -1)
+            refresh_watch_values(m, values, timeout_ms);
+            // A single write per frame, carrying only what changed
+            const size_t frame_len = dashboard_render(&board, value_ptrs, frame);
+            if (frame_len > 0 && write(STDOUT_FILENO, frame, frame_len) == -1)
             {
-                wstderr("ERROR: Forking of current process failed", true);
-                return;
+                break;
             }
-            else if (pid_child == 0)
+            refresh = false;
+        }
+        if (poll(sources, sizeof(sources) / sizeof(sources[0]), -1) == -1)
+        {
+            if (errno == EINTR)
             {
-                if (strcmp(sc_tokens[LOWEST_ARR_INDEX], "start_monitor") == 0)
-                {
-                    char* metrics_json_config_file_path = get_metrics_json_config_file_path(sc_tokens);
-                    char* argv[METRICS_MAX_ARGC] = {METRICS_APP_PATH, metrics_json_config_file_path};
-                    execute_external_cmd(argv, background_execution);
-                }
-                else
-                {
-                    execute_external_cmd(sc_tokens, background_execution);
-                }
+                continue;
+            }
+            break;
+        }
+        if (sources[0].revents != 0)
+        {
+            // The key is consumed, so it doesn't end up on the prompt
+            char keys[PROMPT_READ_CHUNK];
+            watching = read(STDIN_FILENO, keys, sizeof(keys)) == -1 && errno == EINTR;
+        }
+        if (sources[2].revents != 0)
+        {
+            snprintf(values[METRICS_STATUS_ROWS], DASHBOARD_VALUE_SIZE, "metrics app exited");
+            const size_t frame_len = dashboard_render(&board, value_ptrs, frame);
+            if (write(STDOUT_FILENO, frame, frame_len) == -1)
+            {
+                break;
+            }
+            watching = false;
+        }
+        if (sources[1].revents != 0)
+        {
+            uint64_t expirations;
+            refresh = read(timer, &expirations, sizeof(expirations)) > 0;
+        }
+    }
+    const size_t frame_len = dashboard_leave(&board, frame);
+    if (write(STDOUT_FILENO, frame, frame_len) == -1)
+    {
+        wstderr("ERROR: `watch_monitor` can't write to the terminal", true);
+    }
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved_mode);
+    close(timer);
+}
+
+/**
+ * @brief Parses the args of "explore_filesystem": a path to a dir, and optionally "--threads=N", "--io=sync|uring",
+ * "--io-depth=N", "--max-depth=N", "--exclude GLOB" (as many times as needed), "--one-file-system",
+ * "--ignore-file=NAME", "--format=ndjson|null|tsv", "--content", "--changes", "--watch", "--index=FILE",
+ * "--query PATH" and "--where PREDICATE" (as many times as needed).
+ * @param sc_tokens Single command tokens.
+ * @param options Where to leave them; the dir path is NULL if it isn't given.
+ * @return true if every option is known and valid, false otherwise (the error gets shown).
+ */
+static bool parse_explore_args(char** sc_tokens, explore_options* options)
+{
+    *options = (explore_options){.n_threads = explore_default_workers(), .filter.max_depth = EXPLORE_UNLIMITED_DEPTH};
+    const size_t threads_len = strlen(EXPLORE_THREADS_OPTION);
+    const size_t index_len = strlen(EXPLORE_INDEX_OPTION);
+    const size_t io_len = strlen(EXPLORE_IO_OPTION);
+    const size_t io_depth_len = strlen(EXPLORE_IO_DEPTH_OPTION);
+    const size_t max_depth_len = strlen(EXPLORE_MAX_DEPTH_OPTION);
+    const size_t ignore_file_len = strlen(EXPLORE_IGNORE_FILE_OPTION);
+    const size_t format_len = strlen(EXPLORE_FORMAT_OPTION);
+    unsigned io_depth = TRAVERSE_IO_DEPTH;
+    bool uring = false;
+    for (int i = SC_FIRST_ARG_I; sc_tokens[i] != NULL; i++)
+    {
+        if (strncmp(sc_tokens[i], EXPLORE_THREADS_OPTION, threads_len) == 0)
+        {
+            const char* value = &sc_tokens[i][threads_len];
+            char* end;
+            errno = 0;
+            const long threads = strtol(value, &end, METRICS_TIMEOUT_OPTION_BASE);
+            if (errno != 0 || end == value || *end != STR_NULL_TERMINATOR || threads < 1 ||
+                threads > EXPLORE_MAX_WORKERS)
+            {
+                wstderr("ERROR: `--threads` value must be a recognizable int between 1 and 64.\n", false);
+                return false;
             }
-            // Save the child pid if "start_monitor" command was called
-            if (strcmp(sc_tokens[LOWEST_ARR_INDEX], "start_monitor") == 0)
+            options->n_threads = (unsigned)threads;
+        }
+        else if (strncmp(sc_tokens[i], EXPLORE_IO_OPTION, io_len) == 0)
+        {
+            const char* value = &sc_tokens[i][io_len];
+            if (strcmp(value, EXPLORE_IO_SYNC) != 0 && strcmp(value, EXPLORE_IO_URING) != 0)
             {
-                metrics_pid = pid_child;
+                wstderr("ERROR: `--io` value must be `" EXPLORE_IO_SYNC "` or `" EXPLORE_IO_URING "`.\n", false);
+                return false;
             }
-            // Parent process; wait for child to finish only if not a background proc
-            if (background_execution)
+            uring = strcmp(value, EXPLORE_IO_URING) == 0;
+        }
+        else if (strncmp(sc_tokens[i], EXPLORE_IO_DEPTH_OPTION, io_depth_len) == 0)
+        {
+            const char* value = &sc_tokens[i][io_depth_len];
+            char* end;
+            errno = 0;
+            const long depth = strtol(value, &end, METRICS_TIMEOUT_OPTION_BASE);
+            if (errno != 0 || end == value || *end != STR_NULL_TERMINATOR || depth < 1 || depth > TRAVERSE_MAX_IO_DEPTH)
             {
-                // Concurrent execution
-                printf("[%llu] %d\n", job_id, (int)pid_child);
-                // Try that this output goes out first
-                fflush(stdout);
+                fprintf(stderr, "ERROR: `--io-depth` value must be a recognizable int between 1 and %d.\n",
+                        TRAVERSE_MAX_IO_DEPTH);
+                return false;
             }
-            else
+            io_depth = (unsigned)depth;
+        }
+        else if (strncmp(sc_tokens[i], EXPLORE_MAX_DEPTH_OPTION, max_depth_len) == 0)
+        {
+            const char* value = &sc_tokens[i][max_depth_len];
+            char* end;
+            errno = 0;
+            const long depth = strtol(value, &end, METRICS_TIMEOUT_OPTION_BASE);
+            if (errno != 0 || end == value || *end != STR_NULL_TERMINATOR || depth < 0 ||
+                (unsigned long)depth >= EXPLORE_UNLIMITED_DEPTH)
             {
-                // Non concurrent execution, wait for child process to finish
-                if (waitpid(pid_child, NULL, 0) == -1)
-                {
-                    wstderr("ERROR: waitpid() failed", true);
-                }
+                wstderr("ERROR: `--max-depth` value must be a recognizable non-negative int.\n", false);
+                return false;
             }
+            options->filter.max_depth = (unsigned)depth;
         }
-        // Restore stdin and stdout if were modified
-        restore_stdio(original_stdin, STDIN_FILENO);
-        restore_stdio(original_stdout, STDOUT_FILENO);
-    }
-    else
-    {
-        // Multiple single command (sc_n > 1) submitted, pipe implementation called
-        int pipesfd[2 * (sc_n - 1)];
-        // Pipes creation
-        for (int i = LOWEST_ARR_INDEX; i < sc_n; i++)
-        {
-            if (pipe(pipesfd + i * 2) == -1)
-            {
-                wstderr("ERROR: On pipe creation", true);
-                return;
-            }
-        }
-        // Track child processes that need to be waited (running in foreground)
-        pid_t ch_procs_to_wait[MAX_SINGLE_COMMANDS];
-        unsigned ch_proc_to_wait_n = 0;
-        // Fork a process per single command
-        for (int i = LOWEST_ARR_INDEX; i < sc_n; i++)
-        {
-            // Update job id
-            job_id++;
-            // Tokenize the single cmd; use a copy of the command as tokenize_single_command() modifies it
-            static char sc_h[ARG_MAX];
-            strcpy(sc_h, single_commands[i]);
-            // Explicit freed of memory isn't done, relies on the OS when exit() gets called
-            char** sc_tokens = tokenize_single_command(sc_h);
-            // Check if "&" appears, to see if it requires background execution
-            bool background_execution = is_background_exec(sc_tokens);
-            // Fork main process
-            const pid_t pid_child = fork();
-            if (pid_child == -1)
-            {
-                wstderr("ERROR: Forking of current process failed", true);
-                return;
-            }
-            else if (pid_child == 0)
-            {
-                // This is a child process; first one doesn't need read end set
-                if (i > 0)
-                {
-                    // Set the stdin of this process to be certain end of a pipe (read end)
-                    if (dup2(pipesfd[(i - 1) * 2], STDIN_FILENO) == -1)
-                    {
-                        wstderr("ERROR: dup2() failed", true);
-                        exit(EXIT_FAILURE);
-                    }
-                }
-                // Last single command doesn't need its stdout set to be certain end of a pipe
-                if (i < (sc_n - 1))
-                {
-                    // Set the stdout of this process to be certain end of a pipe (write end)
-                    if (dup2(pipesfd[i * 2 + 1], STDOUT_FILENO) == -1)
-                    {
-                        wstderr("ERROR: dup2() failed", true);
-                        exit(EXIT_FAILURE);
-                    }
-                }
-                // Once pipes file descriptors were copied to its respective stdin & stdout, close them
-                for (int j = LOWEST_ARR_INDEX; j < 2 * (sc_n - 1); j++)
-                {
-                    close(pipesfd[j]);
-                }
-                // Redirections implementation
-                if (i == 0)
-                {
-                    // First single command, accepts "<"; check for its appearance
-                    const char* file_name = get_possible_redirection(sc_tokens, true);
-                    redirect_stdin(file_name);
-                }
-                else if (i == (sc_n - 1))
-                {
-                    // Last single command, accepts ">"; check for its appearance
-                    const char* file_name = get_possible_redirection(sc_tokens, false);
-                    redirect_stdout(file_name);
-                }
-                // cleanse single command tokens & the string itself from redirection tokens
-                cleanse_redirections_on_argv(sc_tokens);
-                cleanse_redirections_on_sc(single_commands[i]);
-                // Watch out if the command called is internal or external
-                if (strcmp(sc_tokens[LOWEST_ARR_INDEX], "cd") == 0)
-                {
-                    execute_cd(single_commands[i], sc_tokens, background_execution, cwd);
-                }
-                else if (strcmp(sc_tokens[LOWEST_ARR_INDEX], "clr") == 0)
-                {
-                    printf(CLR_ANSI_EC);
-                    fflush(stdout);
-                }
-                else if (strcmp(sc_tokens[LOWEST_ARR_INDEX], "echo") == 0)
-                {
-                    execute_echo(single_commands[i], sc_tokens, background_execution);
-                }
-                else if (strcmp(sc_tokens[LOWEST_ARR_INDEX], "quit") == 0)
-                {
-                    // As a coupled command, does nothing
-                }
-                else if (strcmp(sc_tokens[LOWEST_ARR_INDEX], "status_monitor") == 0)
-                {
-                    execute_status_monitor(&metrics_pid);
-                }
-                else if (strcmp(sc_tokens[LOWEST_ARR_INDEX], "explore_filesystem") == 0)
-                {
-                    execute_explore_filesystem(sc_tokens);
-                }
-                else
-                {
-                    execute_external_cmd(sc_tokens, background_execution);
-                }
-                // End this child process successfully
-                exit(EXIT_SUCCESS);
+        else if (strcmp(sc_tokens[i], EXPLORE_EXCLUDE_OPTION) == 0)
+        {
+            // Its value is the next arg
+            if (sc_tokens[i + 1] == NULL || options->filter.n_excludes == EXPLORE_MAX_EXCLUDES)
+            {
+                fprintf(stderr, "ERROR: `%s` needs a glob (up to %d).\n", sc_tokens[i], EXPLORE_MAX_EXCLUDES);
+                return false;
+            }
+            options->filter.excludes[options->filter.n_excludes++] = sc_tokens[++i];
+        }
+        else if (strcmp(sc_tokens[i], EXPLORE_ONE_FILE_SYSTEM_OPTION) == 0)
+        {
+            options->filter.one_file_system = true;
+        }
+        else if (strncmp(sc_tokens[i], EXPLORE_IGNORE_FILE_OPTION, ignore_file_len) == 0)
+        {
+            options->filter.ignore_file = &sc_tokens[i][ignore_file_len];
+            if (*options->filter.ignore_file == STR_NULL_TERMINATOR || strchr(options->filter.ignore_file, '/') != NULL)
+            {
+                wstderr("ERROR: `--ignore-file` needs a file base name, i.e.: `.gitignore`.\n", false);
+                return false;
             }
-            // Parent process; save child pid, if we need to wait for it to finish
-            if (background_execution)
+        }
+        else if (strncmp(sc_tokens[i], EXPLORE_FORMAT_OPTION, format_len) == 0)
+        {
+            if (!record_format_parse(&sc_tokens[i][format_len], &options->format))
             {
-                // Concurrent execution
-                printf("[%llu] %d\n", job_id, (int)pid_child);
-                // Try that this output goes out first
-                fflush(stdout);
+                wstderr("ERROR: `--format` value must be `" RECORD_NDJSON_NAME "`, `" RECORD_NULL_NAME
+                        "` or `" RECORD_TSV_NAME "`.\n",
+                        false);
+                return false;
             }
-            else
+            options->records = true;
+        }
+        else if (strcmp(sc_tokens[i], EXPLORE_CONTENT_OPTION) == 0)
+        {
+            options->with_content = true;
+        }
+        else if (strncmp(sc_tokens[i], EXPLORE_INDEX_OPTION, index_len) == 0)
+        {
+            options->index_path = &sc_tokens[i][index_len];
+            if (*options->index_path == STR_NULL_TERMINATOR)
             {
-                // Keep track of the just created child, as it has to be waited to finish
-                ch_procs_to_wait[ch_proc_to_wait_n++] = pid_child;
+                wstderr("ERROR: `--index` needs a path to a file.\n", false);
+                return false;
             }
+            options->changes = true;
         }
-        // Parent process closes all pipe file descriptors as it makes no use of them
-        for (int i = LOWEST_ARR_INDEX; i < 2 * (sc_n - 1); i++)
+        else if (strcmp(sc_tokens[i], EXPLORE_CHANGES_OPTION) == 0 || strcmp(sc_tokens[i], EXPLORE_WATCH_OPTION) == 0)
         {
-            close(pipesfd[i]);
+            options->changes = true;
+            options->watch |= strcmp(sc_tokens[i], EXPLORE_WATCH_OPTION) == 0;
         }
-        // Hold for all child processes that needs to be awaited to finish
-        for (unsigned i = LOWEST_ARR_INDEX; i < ch_proc_to_wait_n; i++)
+        else if (strcmp(sc_tokens[i], EXPLORE_QUERY_OPTION) == 0 || strcmp(sc_tokens[i], EXPLORE_WHERE_OPTION) == 0)
         {
-            if (waitpid(ch_procs_to_wait[i], NULL, 0) == -1)
+            // Their value is the next arg
+            const bool is_query = strcmp(sc_tokens[i], EXPLORE_QUERY_OPTION) == 0;
+            if (sc_tokens[i + 1] == NULL || (!is_query && options->n_where == QUERY_MAX_PREDICATES))
+            {
+                fprintf(stderr, "ERROR: `%s` needs a value (up to %d `%s`).\n", sc_tokens[i], QUERY_MAX_PREDICATES,
+                        EXPLORE_WHERE_OPTION);
+                return false;
+            }
+            if (is_query)
+            {
+                options->select = sc_tokens[++i];
+            }
+            else
             {
-                wstderr("ERROR: waitpid() failed", true);
+                options->where[options->n_where++] = sc_tokens[++i];
             }
         }
-    }
-}
-
-char** tokenize_single_command(char* sc)
-{
-    char** argv = malloc((MAX_TOKENS_PER_COMMAND + 1) * sizeof(char*));
-    if (argv == NULL)
-    {
-        wstderr("ERROR: Failed to allocate memory", true);
-        exit(EXIT_FAILURE);
-    }
-    int argc = LOWEST_ARR_INDEX;
-    char* token = strtok(sc, TOKEN_SEPARATOR);
-    while (token != NULL && argc < MAX_TOKENS_PER_COMMAND)
-    {
-        argv[argc++] = malloc(strlen(token) + 1);
-        if (argv[argc - 1] == NULL)
+        else if (options->dir_path == NULL)
         {
-            wstderr("ERROR: Failed to allocate memory", true);
-            free_recursively((void**)argv, -1);
-            exit(EXIT_FAILURE);
+            // The first arg that isn't an option is only taken into account
+            options->dir_path = sc_tokens[i];
         }
-        strcpy(argv[argc - 1], token);
-        token = strtok(NULL, TOKEN_SEPARATOR);
-    }
-    // Check if max amount of tokens were reached and more of them are available to consume
-    if (argc == MAX_TOKENS_PER_COMMAND && token != NULL)
-    {
-        wstderr("ERROR: You surpassed the arguments limit for a command.\n", false);
-        free_recursively((void**)argv, argc);
-        exit(EXIT_FAILURE);
     }
-    // Reached this line, the limits of argument were respected; "close" the argv list
-    argv[argc] = NULL;
-
-    return argv;
-}
-
-void execute_batch_file(const char* path)
-{
-    // Get current working directory
-    char cwd[PATH_MAX];
-    if (getcwd(cwd, PATH_MAX) == NULL)
+    if (options->changes && (options->select != NULL || options->n_where > 0))
     {
-        wstderr("ERROR: cwd can't be retrieved", true);
-        exit(EXIT_FAILURE);
+        wstderr("ERROR: `--changes` and `--watch` can't be combined with `--query` nor `--where`.\n", false);
+        return false;
     }
-    // Open file
-    FILE* file = fopen(path, "r");
-    if (file == NULL)
+    if (options->records && (options->changes || options->select != NULL || options->n_where > 0 || uring))
     {
-        wstderr("ERROR: Opening batch file", true);
-        return;
+        wstderr("ERROR: `--format` can't be combined with `--changes`, `--watch`, `--query`, `--where` nor "
+                "`--io=uring`.\n",
+                false);
+        return false;
     }
-    char input[ARG_MAX];
-    while (fgets(input, ARG_MAX, file))
+    if (options->with_content && !options->records)
     {
-        // If there's a forced exit, the file gets closed automatically
-        execute_command(input, cwd);
+        wstderr("ERROR: `--content` needs `--format`.\n", false);
+        return false;
     }
-    // Close the file cleanly
-    fclose(file);
+    options->io_depth = uring ? io_depth : 0;
+    return true;
 }
 
-int redirect_stdin(const char* file_name)
+/**
+ * @brief Tells the config files added, changed or removed under a dir for "explore_filesystem --changes", and keeps
+ * telling them as they happen with "--watch", until a key is pressed (if there's a terminal, and it isn't run on a
+ * helper thread: stdin belongs to the shell thread then) or nobody reads them anymore.
+ * @param options Options of "explore_filesystem".
+ * @param call Its invocation.
+ */
+static void explore_changes(const explore_options* options, const builtin_call* call)
 {
-    if (file_name != NULL)
+    struct termios saved_mode;
+    const bool key_stops = options->watch && !call->on_helper_thread && isatty(STDIN_FILENO) &&
+                           tcgetattr(STDIN_FILENO, &saved_mode) == 0;
+    if (key_stops)
     {
-        // Redirect stdin
-        int input_fd = open(file_name, O_RDONLY);
-        if (input_fd == -1)
-        {
-            wstderr("ERROR: Failed to open input file", true);
-            exit(EXIT_FAILURE);
-        }
-        // duplicate the original file descriptor number to return if everything goes well
-        int original_stdin = dup(STDIN_FILENO);
-        if (dup2(input_fd, STDIN_FILENO) == -1)
-        {
-            wstderr("ERROR: Failed to redirect stdin", true);
-            close(input_fd);
-            exit(EXIT_FAILURE);
-        }
-        close(input_fd);
-        return original_stdin;
+        // Each key gets read as soon as it's pressed, unechoed; [Ctrl]+[C] is a key too
+        struct termios key_mode = saved_mode;
+        key_mode.c_lflag &= ~(tcflag_t)(ICANON | ECHO | ISIG);
+        key_mode.c_cc[VMIN] = 1;
+        key_mode.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &key_mode);
     }
-    return -1;
-}
-
-int redirect_stdout(const char* file_name)
-{
-    if (file_name != NULL)
+    audit_directory(options->dir_path, options->n_threads, &options->filter, options->index_path, options->watch,
+                    key_stops ? STDIN_FILENO : -1, call->out);
+    if (key_stops)
     {
-        // Redirect stdout
-        int output_fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-        if (output_fd == -1)
-        {
-            wstderr("ERROR: Failed to open output file", true);
-            exit(EXIT_FAILURE);
-        }
-        // duplicate the original file descriptor number to return if everything goes well
-        int original_stdin = dup(STDOUT_FILENO);
-        if (dup2(output_fd, STDOUT_FILENO) == -1)
-        {
-            wstderr("ERROR: Failed to redirect stdout", true);
-            close(output_fd);
-            exit(EXIT_FAILURE);
-        }
-        close(output_fd);
-        return original_stdin;
+        // The key is consumed, so it doesn't end up on the prompt
+        tcflush(STDIN_FILENO, TCIFLUSH);
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved_mode);
     }
-    return -1;
 }
 
-void restore_stdio(int original_stdio, int target_fd)
+/**
+ * @brief Shows the config files under a dir that match the query of "explore_filesystem --query/--where".
+ * @param options Options of "explore_filesystem".
+ * @param out Where to show them.
+ */
+static void explore_query(const explore_options* options, FILE* out)
 {
-    if (original_stdio != -1)
+    json_query query = {0};
+    if (json_query_compile(&query, options->select, options->where, options->n_where) == 0)
     {
-        if (dup2(original_stdio, target_fd) == -1)
-        {
-            wstderr("ERROR: Failed to restore stdio", true);
-            close(original_stdio);
-            exit(EXIT_FAILURE);
-        }
-        close(original_stdio);
+        query_directory(options->dir_path, options->n_threads, &options->filter, &query, out);
     }
+    json_query_free(&query);
 }
 
-void execute_cd(char* input, char** sc_tokens, bool background_execution, char* cwd)
+void execute_explore_filesystem(const builtin_call* call)
 {
-    // Ignore "&" if appears, as this is an internal command
-    if (background_execution)
+    explore_options options;
+    if (!parse_explore_args(call->sc_tokens, &options))
     {
-        // Cleanse "&"
-        cleanse_ampersand(input);
+        return;
     }
-    // Check existence of argument
-    if (sc_tokens[SC_FIRST_ARG_I])
+    // The path must exist
+    if (options.dir_path == NULL)
     {
-        // Argument provided
-        if (strcmp(sc_tokens[SC_FIRST_ARG_I], "-") == 0 && sc_tokens[SC_SECOND_ARG_I] == NULL)
+        wstderr("ERROR: This command needs a path to a dir as a lone arg.\n", false);
+        return;
+    }
+    struct stat stat_buffer;
+    // Check path existence, and if it's in fact a dir, which is what's expected
+    if (stat(options.dir_path, &stat_buffer) == 0)
+    {
+        if (S_ISDIR(stat_buffer.st_mode))
         {
-            // Return to old current directory (if exist)
-            const char* old_cwd = getenv(ENV_OLDPWD_KEY);
-            if (old_cwd == NULL)
+            // Path exist and it's a dir
+            if (options.changes)
             {
-                errno = ENOENT;
-                wstderr("ERROR: No such thing as 'OLDPWD' for now", true);
+                explore_changes(&options, call);
             }
-            else
+            else if (options.select != NULL || options.n_where > 0)
             {
-                // Old current directory exist, head to it if possible and update env
-                if (chdir(old_cwd) == -1)
-                {
-                    wstderr("ERROR: Issue changing cwd to the old one", true);
-                }
-                else
-                {
-                    // Success
-                    setenv(ENV_OLDPWD_KEY, cwd, true);
-                    if (getcwd(cwd, PATH_MAX) == NULL)
-                    {
-                        wstderr("ERROR: cwd can't be retrieved", true);
-                        exit(EXIT_FAILURE);
-                    }
-                }
+                explore_query(&options, call->out);
             }
-        }
-        else
-        {
-            // Try to move to a new current directory
-            if (chdir(&input[CD_ARG_START_I]) == -1)
+            else if (options.records)
             {
-                // The argument is wrong or another problem appeared
-                wstderr("ERROR: Can't change current working directory", true);
+                export_directory(options.dir_path, options.n_threads, &options.filter, options.format,
+                                 options.with_content, call->out);
             }
             else
             {
-                // The arguments is right, proceed with the normal procedure
-                setenv(ENV_OLDPWD_KEY, cwd, true);
-                if (getcwd(cwd, PATH_MAX) == NULL)
-                {
-                    wstderr("ERROR: cwd can't be retrieved", true);
-                    exit(EXIT_FAILURE);
-                }
+                traverse_directory(options.dir_path, options.n_threads, &options.filter, options.io_depth, call->out);
             }
         }
+        else
+        {
+            wstderr("ERROR: The path provided isn't a dir.\n", false);
+        }
     }
     else
     {
-        // No argument; the current directory shall be provided
-        printf("%s\n", cwd);
+        wstderr("ERROR: Provided path to a potential dir doesn't exist.\n", false);
     }
 }
 
-void execute_echo(char* input, char** sc_tokens, bool background_execution)
+bool explore_filesystem_forks(char** sc_tokens)
 {
-    // Ignore "&" if appears, as this is an internal command
-    if (background_execution)
-    {
-        // Cleanse "&"
-        cleanse_ampersand(input);
-    }
-    // Check existence of argument
-    if (sc_tokens[SC_FIRST_ARG_I])
+    // Even as the value of another option; forking is never wrong, only slower
+    for (int i = SC_FIRST_ARG_I; sc_tokens[i] != NULL; i++)
     {
-        // Arg provided; check if starts with '$', in which case it's referencing an env var
-        if (sc_tokens[SC_FIRST_ARG_I][LOWEST_ARR_INDEX] == '$')
-        {
-            const char* env_val = getenv(&input[6]);
-            if (env_val == NULL)
-            {
-                // No env var with thy name or any other issue; errno doesn't get set
-                wstderr("ERROR: Unexistent env var or empty arg provided.\n", false);
-            }
-            else
-            {
-                puts(env_val);
-            }
-        }
-        else
+        if (strcmp(sc_tokens[i], EXPLORE_WATCH_OPTION) == 0)
         {
-            puts(&input[ECHO_ARG_START_I]);
+            return true;
         }
     }
-    else
-    {
-        // No argument; a newline gets printed
-        puts("");
-    }
+    return false;
 }
 
-void execute_stop_monitor(int* metrics_pid)
+void execute_hash(const builtin_call* call)
 {
-    if (*metrics_pid != -1)
+    char** sc_tokens = call->sc_tokens;
+    // No argument; show what is remembered
+    if (!sc_tokens[SC_FIRST_ARG_I])
     {
-        if (kill(*metrics_pid, SIGTERM) == -1)
-        {
-            wstderr("ERROR: \"metrics\" child process can't be killed", true);
-        }
-        else
+        path_cache_print(call->out);
+        return;
+    }
+    if (strcmp(sc_tokens[SC_FIRST_ARG_I], "-r") == 0)
+    {
+        path_cache_flush();
+        return;
+    }
+    // Names provided; look them up now, so the next invocation is already resolved
+    for (int i = SC_FIRST_ARG_I; sc_tokens[i] != NULL; i++)
+    {
+        if (path_cache_lookup(sc_tokens[i]) == NULL)
         {
-            puts("metrics successfully stopped.");
+            fprintf(stderr, "ERROR: hash: %s: not found\n", sc_tokens[i]);
+            fflush(stderr);
         }
-        *metrics_pid = -1;
     }
 }
 
-void execute_status_monitor(const int* metrics_pid)
+void execute_jobs(const builtin_call* call)
+{
+    jobs_print_all(call->out);
+}
+
+void execute_fg(const builtin_call* call)
 {
-    if (*metrics_pid != -1)
+    job* j = jobs_find_spec(call->sc_tokens[SC_FIRST_ARG_I]);
+    if (j == NULL)
     {
-        // Only if the monitor was started, get its status; subscribe to listening to a response
-        struct sigaction sa;
-        sa.sa_flags = SA_SIGINFO;
-        sa.sa_sigaction = handle_sigusr1;
-        sigemptyset(&sa.sa_mask);
-        sa.sa_restorer = NULL;
-        if (sigaction(SIGUSR1, &sa, NULL) == -1)
-        {
-            wstderr("ERROR: Signal subscription failed", true);
-        }
-        else
-        {
-            // Successfully subscribed to catch response from the child process; send signal
-            union sigval directive;
-            directive.sival_int = METRICS_GET_STATUS_CODE;
-            if (sigqueue(*metrics_pid, SIGUSR1, directive) == -1)
-            {
-                wstderr("ERROR: Signaling \"status_monitor\"", true);
-            }
-            else
-            {
-                // Signal successfully sent, await response
-                time_t l_start_t, l_current_t;
-                time(&l_start_t);
-                while (true)
-                {
-                    time(&l_current_t);
-                    if (sfmh)
-                    {
-                        // Signal from metrics with its status successfully handled, reset it
-                        sfmh = false;
-                        break;
-                    }
-                    else if (difftime(l_current_t, l_start_t) >= WAIT_T_FOR_METRICS_RESPONSE)
-                    {
-                        wstderr("ERROR: Timeout reached. No response from \"metrics\" app.\n", false);
-                        break;
-                    }
-                }
-            }
-            // Unsubscribe to SIGUSR1
-            sa.sa_flags = 0;
-            sa.sa_handler = SIG_DFL;
-            if (sigaction(SIGUSR1, &sa, NULL) == -1)
-            {
-                wstderr("ERROR: Signal unsubscription failed", true);
-            }
-        }
+        wstderr("ERROR: fg: No such job.\n", false);
+        return;
+    }
+    puts(j->command);
+    fflush(stdout);
+    if (jobs_continue(j, false) == -1)
+    {
+        wstderr("ERROR: fg: Job can't be resumed", true);
+        return;
+    }
+    jobs_wait(j, true);
+    if (jobs_state(j) == JOB_STOPPED)
+    {
+        // Stopped once again
+        j->background = true;
+        putchar('\n');
+        jobs_print(stdout, j);
     }
     else
     {
-        puts("WARNING: metrics app not initialized, or not tracked by this Shell.");
+        jobs_remove(j);
     }
 }
 
-void execute_explore_filesystem(char** sc_tokens)
+void execute_bg(const builtin_call* call)
 {
-    // The first arg of the cmd is only taken into account and must exist
-    if (!sc_tokens[SC_FIRST_ARG_I])
+    job* j = jobs_find_spec(call->sc_tokens[SC_FIRST_ARG_I]);
+    if (j == NULL)
     {
-        wstderr("ERROR: This command needs a path to a dir as a lone arg.\n", false);
+        wstderr("ERROR: bg: No such job.\n", false);
         return;
     }
-    // Argument provided
-    const char* path = sc_tokens[SC_FIRST_ARG_I];
-    struct stat stat_buffer;
-    // Check path existence, and if it's in fact a dir, which is what's expected
-    if (stat(path, &stat_buffer) == 0)
+    if (jobs_continue(j, true) == -1)
     {
-        if (S_ISDIR(stat_buffer.st_mode))
-        {
-            // Path exist and it's a dir
-            traverse_directory(path);
-        }
-        else
+        wstderr("ERROR: bg: Job can't be resumed", true);
+        return;
+    }
+    printf("[%u] %s &\n", j->id, j->command);
+}
+
+void execute_wait(const builtin_call* call)
+{
+    char** sc_tokens = call->sc_tokens;
+    if (sc_tokens[SC_FIRST_ARG_I] == NULL)
+    {
+        // No argument; every job that isn't stopped (the current job has the greatest id)
+        jobs_reap();
+        const job* current = jobs_find_spec(NULL);
+        const unsigned highest_id = current == NULL ? 0 : current->id;
+        for (unsigned id = 1; id <= highest_id; id++)
         {
-            wstderr("ERROR: The path provided isn't a dir.\n", false);
+            job* j = jobs_find(id);
+            if (j != NULL && jobs_state(j) != JOB_STOPPED)
+            {
+                jobs_wait(j, false);
+                jobs_remove(j);
+            }
         }
+        return;
     }
-    else
+    for (int i = SC_FIRST_ARG_I; sc_tokens[i] != NULL; i++)
     {
-        wstderr("ERROR: Provided path to a potential dir doesn't exist.\n", false);
+        job* j = jobs_find_spec(sc_tokens[i]);
+        if (j == NULL)
+        {
+            fprintf(stderr, "ERROR: wait: %s: No such job\n", sc_tokens[i]);
+            fflush(stderr);
+            continue;
+        }
+        jobs_wait(j, false);
+        if (jobs_state(j) == JOB_DONE)
+        {
+            jobs_remove(j);
+        }
     }
 }
 
-void execute_external_cmd(char** sc_tokens, bool background_execution)
+pid_t execute_external_cmd(char** sc_tokens, bool background_execution, spawn_io* io)
 {
     // If this child proc is being executed in the foreground, certain signals must respond
-    if (!background_execution)
+    sigset_t sig_default;
+    sigemptyset(&sig_default);
+    // Job control signals are only ignored by the shell itself
+    for (int i = LOWEST_ARR_INDEX; i < N_JOB_CONTROL_SIGNALS; i++)
+    {
+        sigaddset(&sig_default, job_control_signals[i]);
+    }
+    io->sig_default = &sig_default;
+    // With job control, background jobs are on their own process group, out of the reach of the terminal signals
+    if (!background_execution || jobs_control_enabled())
     {
         for (int i = LOWEST_ARR_INDEX; i < N_SINGALS_TO_HANDLE; i++)
         {
             // Revert these signals managment to their default behavior
-            signal(signals[i], SIG_DFL);
+            sigaddset(&sig_default, signals[i]);
         }
     }
-    // Execute this child, pass the torch of the proc to another program
-    if (execvp(sc_tokens[LOWEST_ARR_INDEX], sc_tokens) == -1)
+    // Anything the shell printed so far must appear before the program output
+    fflush(stdout);
+    // Spawn the child, passing the torch of the proc to another program without duplicating the shell first
+    const char* path = path_cache_lookup(sc_tokens[LOWEST_ARR_INDEX]);
+    pid_t pid_child = path == NULL ? -1 : spawn_process(path, sc_tokens, io);
+    if (pid_child == -1 && path != NULL && path != sc_tokens[LOWEST_ARR_INDEX] && (errno == ENOENT || errno == EACCES))
+    {
+        // The remembered executable is gone (or changed its permissions); look it up once again
+        path_cache_forget(sc_tokens[LOWEST_ARR_INDEX]);
+        path = path_cache_lookup(sc_tokens[LOWEST_ARR_INDEX]);
+        pid_child = path == NULL ? -1 : spawn_process(path, sc_tokens, io);
+    }
+    io->sig_default = NULL;
+    if (pid_child == -1)
     {
         // Something went wrong
         wstderr("ERROR: Command couldn't be executed", true);
-        exit(EXIT_FAILURE);
     }
+    return pid_child;
 }
 
-void handle_sigusr1(int sig, siginfo_t* info, void* context)
+void decode_metrics_status(int e_status, metrics_sample* sample)
 {
-    // Args ignored
-    (void)context;
-    (void)sig;
-
-    // "monitor" app status encoded
-    int e_status = info->si_value.sival_int;
-    // Decode
-    unsigned char d_status[G_STATUS_N_METRICS_TRACKED] = {0};
-    /** Index meaning (LSB to MSB):
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    memset(sample, 0, sizeof(metrics_sample));
+    sample->timestamp_ns = (uint64_t)now.tv_sec * NSECS_PER_SEC + (uint64_t)now.tv_nsec;
+    sample->fields = METRICS_FIELD_CPU | METRICS_FIELD_MEM | METRICS_FIELD_HDD;
+    /** Byte meaning (LSB to MSB):
      * 0 - cpu_usage_percentage
      * 1 - memory_used_percentage
      * 2 - sectors_read_rate
      * 3 - sectors_written_rate
      */
-    d_status[D_STATUS_CPU_I] = (unsigned char)((e_status >> LSBIT_CPU_EMSD) & LSBYTE_MASK);
-    d_status[D_STATUS_RAM_I] = (unsigned char)((e_status >> LSBIT_RAM_EMSD) & LSBYTE_MASK);
-    d_status[D_STATUS_HDDR_I] = (unsigned char)((e_status >> LSBIT_HDDR_EMSD) & LSBYTE_MASK);
-    d_status[D_STATUS_HDDW_I] = (unsigned char)((e_status >> LSBIT_HDDW_EMSD) & LSBYTE_MASK);
-    // print data to stdout
-    printf("metrics app (working: OK) data\n"
-           "------------------------------\n"
-           "CPU usage: %u %%\n"
-           "RAM usage: %u %%\n"
-           "HDD Sectors (512 KB each) read/s: %u\n"
-           "HDD Sectors (512 KB each) written/s: %u\n",
-           d_status[D_STATUS_CPU_I], d_status[D_STATUS_RAM_I], d_status[D_STATUS_HDDR_I], d_status[D_STATUS_HDDW_I]);
-
-    // set the flag as "monitor" status was received
-    sfmh = true;
+    sample->cpu_usage = (e_status >> LSBIT_CPU_EMSD) & LSBYTE_MASK;
+    sample->mem_usage = (e_status >> LSBIT_RAM_EMSD) & LSBYTE_MASK;
+    sample->sectors_read_rate = (e_status >> LSBIT_HDDR_EMSD) & LSBYTE_MASK;
+    sample->sectors_written_rate = (e_status >> LSBIT_HDDW_EMSD) & LSBYTE_MASK;
+}
+
+void print_metrics_status(FILE* out, const char* name, const metrics_sample* sample, const char* latency_label,
+                          double latency_ms)
+{
+    char values[METRICS_STATUS_ROWS][DASHBOARD_VALUE_SIZE];
+    format_metrics_status(sample, values);
+    // print data to the stream
+    if (strcmp(name, MONITOR_DEFAULT_NAME) == 0)
+    {
+        fprintf(out, "metrics app (working: OK) data\n");
+    }
+    else
+    {
+        fprintf(out, "metrics app \"%s\" (working: OK) data\n", name);
+    }
+    fprintf(out, "------------------------------\n");
+    for (int i = 0; i < METRICS_STATUS_ROWS; i++)
+    {
+        fprintf(out, "%s: %s\n", metrics_status_labels[i], values[i]);
+    }
+    fprintf(out, "%s: %.3f ms\n", latency_label, latency_ms);
 }
 
 void wstderr(const char* s, bool use_perror)
@@ -712,13 +2292,3 @@ void wstderr(const char* s, bool use_perror)
     fflush(stderr);
     usleep(TERMINAL_FLUSH_DELAY);
 }
-
-void free_recursively(void** arr, int limit)
-{
-    // free memory prev allocated and get out
-    for (int i = LOWEST_ARR_INDEX; limit == -1 ? arr[i] != NULL : i < limit; i++)
-    {
-        free(arr[i]);
-    }
-    free(arr);
-}
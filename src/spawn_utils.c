@@ -0,0 +1,195 @@
+/**
+ * @file spawn_utils.c
+ * @brief Process spawning utilities definition.
+ */
+
+// pipe2() & F_SETPIPE_SZ
+#define _GNU_SOURCE
+#include "spawn_utils.h"
+
+//! \brief Environment of the shell, inherited by every spawned process.
+extern char** environ;
+
+void spawn_io_init(spawn_io* io)
+{
+    io->stdin_fd = SPAWN_FD_INHERIT;
+    io->stdout_fd = SPAWN_FD_INHERIT;
+    io->stdin_file = NULL;
+    io->stdout_file = NULL;
+    io->fds_to_close = NULL;
+    io->n_fds_to_close = 0;
+    io->sig_default = NULL;
+    io->pgid = SPAWN_PGID_INHERIT;
+    for (int i = 0; i < SPAWN_MAX_SHARED_FDS; i++)
+    {
+        io->shared_fds[i] = SPAWN_FD_INHERIT;
+        io->shared_fd_targets[i] = SPAWN_FD_INHERIT;
+    }
+}
+
+pid_t spawn_process(const char* path, char* const* argv, const spawn_io* io)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    int error = posix_spawn_file_actions_init(&actions);
+    if (error != 0)
+    {
+        errno = error;
+        return -1;
+    }
+    error = posix_spawnattr_init(&attr);
+    if (error != 0)
+    {
+        posix_spawn_file_actions_destroy(&actions);
+        errno = error;
+        return -1;
+    }
+    // The child always starts with an empty signal mask, whatever the shell is blocking at this moment
+    sigset_t empty_mask;
+    sigemptyset(&empty_mask);
+    short flags = POSIX_SPAWN_SETSIGMASK;
+    error = posix_spawnattr_setsigmask(&attr, &empty_mask);
+    if (io != NULL)
+    {
+        // Same order a forked child used to follow: wire pipe ends first, drop every other end, then redirections
+        if (error == 0 && io->stdin_fd != SPAWN_FD_INHERIT)
+        {
+            error = posix_spawn_file_actions_adddup2(&actions, io->stdin_fd, STDIN_FILENO);
+        }
+        if (error == 0 && io->stdout_fd != SPAWN_FD_INHERIT)
+        {
+            error = posix_spawn_file_actions_adddup2(&actions, io->stdout_fd, STDOUT_FILENO);
+        }
+        for (size_t i = 0; error == 0 && i < io->n_fds_to_close; i++)
+        {
+            error = posix_spawn_file_actions_addclose(&actions, io->fds_to_close[i]);
+        }
+        // Through numbers above every one involved first, so a target can't clobber a shared file descriptor still to
+        // be handed over (dup2() also clears close-on-exec)
+        int scratch_fd = 0;
+        for (int i = 0; i < SPAWN_MAX_SHARED_FDS; i++)
+        {
+            if (io->shared_fds[i] != SPAWN_FD_INHERIT)
+            {
+                scratch_fd = io->shared_fds[i] >= scratch_fd ? io->shared_fds[i] + 1 : scratch_fd;
+                scratch_fd = io->shared_fd_targets[i] >= scratch_fd ? io->shared_fd_targets[i] + 1 : scratch_fd;
+            }
+        }
+        for (int i = 0; error == 0 && i < SPAWN_MAX_SHARED_FDS; i++)
+        {
+            if (io->shared_fds[i] != SPAWN_FD_INHERIT)
+            {
+                error = posix_spawn_file_actions_adddup2(&actions, io->shared_fds[i], scratch_fd + i);
+            }
+        }
+        for (int i = 0; error == 0 && i < SPAWN_MAX_SHARED_FDS; i++)
+        {
+            if (io->shared_fds[i] != SPAWN_FD_INHERIT)
+            {
+                error = posix_spawn_file_actions_adddup2(&actions, scratch_fd + i, io->shared_fd_targets[i]);
+                if (error == 0)
+                {
+                    error = posix_spawn_file_actions_addclose(&actions, scratch_fd + i);
+                }
+            }
+        }
+        if (error == 0 && io->stdin_file != NULL)
+        {
+            error = posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, io->stdin_file, O_RDONLY, 0);
+        }
+        if (error == 0 && io->stdout_file != NULL)
+        {
+            error = posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, io->stdout_file,
+                                                     O_WRONLY | O_CREAT | O_TRUNC, SPAWN_REDIRECTION_FILE_MODE);
+        }
+        // Job control: the process group is set before the program image is loaded, so there's no window in which a
+        // terminal signal could reach the process on the wrong group
+        if (error == 0 && io->pgid != SPAWN_PGID_INHERIT)
+        {
+            flags |= POSIX_SPAWN_SETPGROUP;
+            error = posix_spawnattr_setpgroup(&attr, io->pgid);
+        }
+        // Signals ignored by the shell are inherited as ignored by exec(); revert the requested ones
+        if (error == 0 && io->sig_default != NULL)
+        {
+            flags |= POSIX_SPAWN_SETSIGDEF;
+            error = posix_spawnattr_setsigdefault(&attr, io->sig_default);
+        }
+    }
+    if (error == 0)
+    {
+        error = posix_spawnattr_setflags(&attr, flags);
+    }
+    pid_t pid = -1;
+    if (error == 0)
+    {
+        error = posix_spawn(&pid, path, &actions, &attr, argv, environ);
+    }
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    if (error != 0)
+    {
+        errno = error;
+        return -1;
+    }
+    return pid;
+}
+
+int spawn_pipes(int* fds, size_t n_pipes, int size)
+{
+    for (size_t i = 0; i < n_pipes; i++)
+    {
+        if (pipe2(&fds[i * 2], O_CLOEXEC) == -1)
+        {
+            const int error = errno;
+            spawn_close_fds(fds, i * 2);
+            errno = error;
+            return -1;
+        }
+        if (size > 0)
+        {
+            // Growing the write end grows the pipe
+            fcntl(fds[i * 2 + 1], F_SETPIPE_SZ, size);
+        }
+    }
+    return 0;
+}
+
+int spawn_check_pipe_size(int size)
+{
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1)
+    {
+        return -1;
+    }
+    const int set = fcntl(fds[1], F_SETPIPE_SZ, size);
+    const int error = errno;
+    spawn_close_fds(fds, 2);
+    errno = error;
+    return set == -1 ? -1 : 0;
+}
+
+void spawn_close_fds(const int* fds, size_t n_fds)
+{
+    if (n_fds == 0)
+    {
+        return;
+    }
+    int lowest = fds[0];
+    int highest = fds[0];
+    for (size_t i = 1; i < n_fds; i++)
+    {
+        lowest = fds[i] < lowest ? fds[i] : lowest;
+        highest = fds[i] > highest ? fds[i] : highest;
+    }
+    // Freshly created pipes usually take consecutive numbers; otherwise (or if the kernel lacks close_range(), before
+    // Linux 5.9) they're closed one by one
+    if ((size_t)(highest - lowest) + 1 == n_fds && syscall(SYS_close_range, lowest, highest, 0) == 0)
+    {
+        return;
+    }
+    for (size_t i = 0; i < n_fds; i++)
+    {
+        close(fds[i]);
+    }
+}
@@ -0,0 +1,217 @@
+/**
+ * @file uring_utils.c
+ * @brief Minimal io_uring definition.
+ */
+
+#include "uring_utils.h"
+
+int uring_init(uring* ring, unsigned entries)
+{
+    *ring = (uring){.fd = -1};
+    struct io_uring_params params = {0};
+    const long fd = syscall(SYS_io_uring_setup, entries, &params);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    ring->fd = (int)fd;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    // Both rings come in a single mapping, if the kernel can
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring->sq_ring_size = ring->cq_ring_size > ring->sq_ring_size ? ring->cq_ring_size : ring->sq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                         IORING_OFF_SQ_RING);
+    ring->cq_ring = ring->sq_ring;
+    if (ring->sq_ring != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                             IORING_OFF_CQ_RING);
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = ring->cq_ring == MAP_FAILED ? MAP_FAILED
+                                             : mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        const int error = errno;
+        uring_exit(ring);
+        errno = error;
+        return -1;
+    }
+    char* sq = ring->sq_ring;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->sq_pending_tail = *ring->sq_tail;
+    char* cq = ring->cq_ring;
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    // Each entry of the submission queue always points to the same sqe
+    for (unsigned i = 0; i <= ring->sq_mask; i++)
+    {
+        ring->sq_array[i] = i;
+    }
+    return 0;
+}
+
+void uring_exit(uring* ring)
+{
+    if (ring->sqes != NULL && ring->sqes != MAP_FAILED)
+    {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring != NULL && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring)
+    {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring != NULL && ring->sq_ring != MAP_FAILED)
+    {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    if (ring->fd != -1)
+    {
+        close(ring->fd);
+    }
+    *ring = (uring){.fd = -1};
+}
+
+bool uring_supports(const uring* ring, const uint8_t* ops, size_t n_ops)
+{
+    const size_t size = sizeof(struct io_uring_probe) + URING_PROBE_OPS * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = calloc(1, size);
+    if (probe == NULL ||
+        syscall(SYS_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, URING_PROBE_OPS) == -1)
+    {
+        free(probe);
+        return false;
+    }
+    bool supported = true;
+    for (size_t i = 0; i < n_ops && supported; i++)
+    {
+        supported = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return supported;
+}
+
+int uring_register_files(const uring* ring, unsigned n_files)
+{
+    int* fds = malloc(n_files * sizeof(int));
+    if (fds == NULL)
+    {
+        return -1;
+    }
+    // Every slot starts empty
+    memset(fds, -1, n_files * sizeof(int));
+    const long registered = syscall(SYS_io_uring_register, ring->fd, IORING_REGISTER_FILES, fds, n_files);
+    const int error = errno;
+    free(fds);
+    errno = error;
+    return registered == -1 ? -1 : 0;
+}
+
+/**
+ * @brief Submits the only entry queued on a ring, and waits for its result.
+ * @param ring The ring.
+ * @param res Where to leave the result of the entry.
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+static int run_alone(uring* ring, int* res)
+{
+    if (uring_submit(ring, 1) == -1)
+    {
+        return -1;
+    }
+    const struct io_uring_cqe* cqe = uring_peek_cqe(ring);
+    if (cqe == NULL)
+    {
+        errno = EIO;
+        return -1;
+    }
+    *res = cqe->res;
+    uring_cqe_seen(ring);
+    return 0;
+}
+
+bool uring_opens_direct(uring* ring)
+{
+    struct io_uring_sqe* sqe = uring_get_sqe(ring);
+    if (sqe == NULL)
+    {
+        return false;
+    }
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uintptr_t)"/";
+    sqe->open_flags = O_RDONLY | O_DIRECTORY;
+    sqe->file_index = 1;
+    int opened;
+    if (run_alone(ring, &opened) == -1 || opened < 0)
+    {
+        return false;
+    }
+    if (opened > 0)
+    {
+        // The slot was ignored: it's a descriptor of the process, and a direct close would close descriptor 0
+        close(opened);
+        return false;
+    }
+    sqe = uring_get_sqe(ring);
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = 1;
+    int closed;
+    return run_alone(ring, &closed) == 0 && closed == 0;
+}
+
+struct io_uring_sqe* uring_get_sqe(uring* ring)
+{
+    const unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_pending_tail - head > ring->sq_mask)
+    {
+        return NULL;
+    }
+    struct io_uring_sqe* sqe = &ring->sqes[ring->sq_pending_tail++ & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int uring_submit(uring* ring, unsigned wait_nr)
+{
+    const unsigned to_submit = ring->sq_pending_tail - *ring->sq_tail;
+    // The kernel sees the entries filled in, once it sees the tail moved
+    __atomic_store_n(ring->sq_tail, ring->sq_pending_tail, __ATOMIC_RELEASE);
+    if (to_submit == 0 && wait_nr == 0)
+    {
+        return 0;
+    }
+    long submitted;
+    do
+    {
+        submitted = syscall(SYS_io_uring_enter, ring->fd, to_submit, wait_nr, wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0,
+                            NULL, 0);
+    } while (submitted == -1 && (errno == EINTR || errno == EAGAIN));
+    return (int)submitted;
+}
+
+struct io_uring_cqe* uring_peek_cqe(uring* ring)
+{
+    const unsigned head = *ring->cq_head;
+    // The kernel fills in the entry before moving the tail
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+    {
+        return NULL;
+    }
+    return &ring->cqes[head & ring->cq_mask];
+}
+
+void uring_cqe_seen(uring* ring)
+{
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
@@ -3,14 +3,62 @@
  * @brief Main testing file.
  */
 
+#include "arena_utils.h"
+#include "batch_utils.h"
+#include "builtin_utils.h"
+#include "cmd_utils.h"
+#include "config_index_utils.h"
+#include "dashboard_utils.h"
+#include "event_utils.h"
+#include "explore_utils.h"
+#include "jobs_utils.h"
+#include "metrics_control_utils.h"
+#include "metrics_history_utils.h"
+#include "metrics_ring_utils.h"
 #include "metrics_utils.h"
+#include "monitor_utils.h"
+#include "parallel_utils.h"
+#include "parser_utils.h"
+#include "path_utils.h"
+#include "query_utils.h"
+#include "record_utils.h"
+#include "shell.h"
+#include "spawn_utils.h"
 #include "unity.h"
+#include "uring_utils.h"
 
 /* PROTOTYPES */
 void test_get_metrics_json_config_file_path_valid(void);
 void test_get_metrics_json_config_file_path_invalid_update_interval(void);
 void test_get_metrics_json_config_file_path_invalid_cpu(void);
 void test_delete_owned_metrics_json_config_file(void);
+void test_path_cache_lookup_found(void);
+void test_path_cache_lookup_not_found(void);
+void test_builtin_registry_perfect_hash(void);
+void test_arena_reset_reuses_memory(void);
+void test_parse_command_line_pipeline(void);
+void test_parse_command_line_malformed(void);
+void test_batch_for_each_line(void);
+void test_jobs_table_lookup(void);
+void test_event_dispatch(void);
+void test_metrics_ring_latest(void);
+void test_metrics_history_summary(void);
+void test_monitor_claim(void);
+void test_dashboard_render(void);
+void test_metrics_control_request(void);
+void test_get_metrics_config_memfd(void);
+void test_explore_tree_order(void);
+void test_explore_tree_filter(void);
+void test_copy_file_to_fd(void);
+void test_config_index_changes(void);
+void test_json_query_match(void);
+void test_uring_linked_read(void);
+void test_record_writer_formats(void);
+void test_spawn_pipes_capacity(void);
+void test_pipeline_builtin_stage(void);
+void test_spawn_process_wiring(void);
+void test_parallel_output_order(void);
+void test_status_monitor_timeout(void);
 
 // Mock data for testing
 char* argv_valid[] = {"start_monitor",
@@ -85,6 +133,1223 @@ void test_delete_owned_metrics_json_config_file(void)
     TEST_ASSERT_NULL(file); // File should not exist anymore
 }
 
+//! \brief Test for path_cache_lookup() resolving (and remembering) a command available on PATH.
+void test_path_cache_lookup_found(void)
+{
+    path_cache_flush();
+    const char* path = path_cache_lookup("sh");
+    TEST_ASSERT_NOT_NULL(path);
+    TEST_ASSERT_EQUAL_INT('/', path[0]);
+    TEST_ASSERT_EQUAL_STRING("/sh", strrchr(path, '/'));
+    // Second lookup is answered by the cache, with the same answer
+    TEST_ASSERT_EQUAL_STRING(path, path_cache_lookup("sh"));
+    // Paths are not looked up
+    TEST_ASSERT_EQUAL_STRING("./sh", path_cache_lookup("./sh"));
+}
+
+//! \brief Test for path_cache_lookup() with a command that doesn't exist on PATH.
+void test_path_cache_lookup_not_found(void)
+{
+    path_cache_flush();
+    TEST_ASSERT_NULL(path_cache_lookup("surely_not_an_existent_command"));
+    TEST_ASSERT_EQUAL_INT(ENOENT, errno);
+    // Negative answers are remembered too
+    errno = 0;
+    TEST_ASSERT_NULL(path_cache_lookup("surely_not_an_existent_command"));
+    TEST_ASSERT_EQUAL_INT(ENOENT, errno);
+}
+
+//! \brief Test that every builtin sits on the slot its name hashes to, so builtin_lookup() finds them all.
+void test_builtin_registry_perfect_hash(void)
+{
+    size_t n_slots;
+    const builtin* registry = builtin_registry(&n_slots);
+    unsigned n_builtins = 0;
+    for (size_t i = 0; i < n_slots; i++)
+    {
+        if (registry[i].name != NULL)
+        {
+            n_builtins++;
+            TEST_ASSERT_EQUAL_size_t(i, builtin_hash(registry[i].name));
+            TEST_ASSERT_EQUAL_PTR(&registry[i], builtin_lookup(registry[i].name));
+            TEST_ASSERT_NOT_NULL(registry[i].handler);
+            // Only pipeline stages run on helper threads, and never the ones changing the shell state
+            if (registry[i].flags & BUILTIN_ON_THREAD)
+            {
+                TEST_ASSERT_TRUE(registry[i].flags & BUILTIN_IN_PIPELINE);
+                TEST_ASSERT_FALSE(registry[i].flags & BUILTIN_NEEDS_PARENT);
+            }
+        }
+    }
+    TEST_ASSERT_GREATER_THAN(0, n_builtins);
+    TEST_ASSERT_NOT_NULL(builtin_lookup("cd"));
+    TEST_ASSERT_NULL(builtin_lookup("ls"));
+    TEST_ASSERT_NULL(builtin_lookup("c"));
+}
+
+//! \brief Test that an arena hands out aligned memory, and hands out the same memory again after a reset.
+void test_arena_reset_reuses_memory(void)
+{
+    arena a = {0};
+    char* first = arena_strdup(&a, "start_monitor");
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_EQUAL_STRING("start_monitor", first);
+    void* second = arena_alloc(&a, 3);
+    TEST_ASSERT_EQUAL_size_t(0, (size_t)second % ARENA_ALIGNMENT);
+    // Bigger than a block; gets its own one
+    void* big = arena_alloc(&a, ARENA_BLOCK_SIZE * 2);
+    TEST_ASSERT_NOT_NULL(big);
+    memset(big, 0, ARENA_BLOCK_SIZE * 2);
+    arena_reset(&a);
+    TEST_ASSERT_EQUAL_PTR(first, arena_alloc(&a, 1));
+    arena_release(&a);
+    TEST_ASSERT_NULL(a.head);
+}
+
+//! \brief Test that a command line gets parsed into its stages, redirections and background flag, quotes resolved.
+void test_parse_command_line_pipeline(void)
+{
+    arena a = {0};
+    const char* input = "cat<in.txt|grep \"a b\" 'c|d' x\\ y > out.txt &\n";
+    cmd_pipeline pipeline;
+    TEST_ASSERT_EQUAL_INT(0, parse_command_line(input, strlen(input), &a, &pipeline));
+    TEST_ASSERT_EQUAL_UINT(2, pipeline.n_stages);
+    TEST_ASSERT_TRUE(pipeline.background);
+    char** first = cmd_stage_argv(&pipeline, &pipeline.stages[0], &a);
+    TEST_ASSERT_EQUAL_STRING("cat", first[0]);
+    TEST_ASSERT_NULL(first[1]);
+    TEST_ASSERT_EQUAL_STRING("in.txt", cmd_span_str(&pipeline, pipeline.stages[0].stdin_file, &a));
+    TEST_ASSERT_NULL(cmd_span_str(&pipeline, pipeline.stages[0].stdout_file, &a));
+    char** second = cmd_stage_argv(&pipeline, &pipeline.stages[1], &a);
+    TEST_ASSERT_EQUAL_STRING("grep", second[0]);
+    TEST_ASSERT_EQUAL_STRING("a b", second[1]);
+    TEST_ASSERT_EQUAL_STRING("c|d", second[2]);
+    TEST_ASSERT_EQUAL_STRING("x y", second[3]);
+    TEST_ASSERT_NULL(second[4]);
+    TEST_ASSERT_EQUAL_STRING("out.txt", cmd_span_str(&pipeline, pipeline.stages[1].stdout_file, &a));
+    // Only blanks
+    TEST_ASSERT_EQUAL_INT(0, parse_command_line(" \t\n", 3, &a, &pipeline));
+    TEST_ASSERT_EQUAL_UINT(0, pipeline.n_stages);
+    arena_release(&a);
+}
+
+//! \brief Test that malformed command lines are rejected, with a reason.
+void test_parse_command_line_malformed(void)
+{
+    arena a = {0};
+    const char* inputs[] = {"echo \"unterminated", "ls |", "| ls", "ls > ", "ls & ls", "&", "< in.txt"};
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+    {
+        cmd_pipeline pipeline;
+        TEST_ASSERT_EQUAL_INT(-1, parse_command_line(inputs[i], strlen(inputs[i]), &a, &pipeline));
+        TEST_ASSERT_NOT_NULL(pipeline.error);
+    }
+    arena_release(&a);
+}
+
+//! \brief Helper that collects every line handed by batch_for_each_line(), each one followed by a ';'.
+static void collect_batch_line(const char* line, size_t len, void* ctx)
+{
+    strncat(ctx, line, len);
+    strcat(ctx, ";");
+}
+
+//! \brief Test that a batch file gets split in lines both when mapped (regular file) and when streamed (pipe).
+void test_batch_for_each_line(void)
+{
+    const char content[] = "echo a\n\nls -l | wc\nquit";
+    char lines[64] = "";
+    char file_path[] = "/tmp/shell_project_batch_XXXXXX";
+    int fd = mkstemp(file_path);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    TEST_ASSERT_EQUAL_INT((int)strlen(content), (int)write(fd, content, strlen(content)));
+    TEST_ASSERT_EQUAL_INT(0, batch_for_each_line(fd, collect_batch_line, lines));
+    close(fd);
+    unlink(file_path);
+    TEST_ASSERT_EQUAL_STRING("echo a;;ls -l | wc;quit;", lines);
+    int pipefd[2];
+    TEST_ASSERT_EQUAL_INT(0, pipe(pipefd));
+    TEST_ASSERT_EQUAL_INT((int)strlen(content), (int)write(pipefd[1], content, strlen(content)));
+    close(pipefd[1]);
+    lines[0] = '\0';
+    TEST_ASSERT_EQUAL_INT(0, batch_for_each_line(pipefd[0], collect_batch_line, lines));
+    close(pipefd[0]);
+    TEST_ASSERT_EQUAL_STRING("echo a;;ls -l | wc;quit;", lines);
+}
+
+//! \brief Test that jobs get consecutive ids, can be found as the user refers to them, and free their ids.
+void test_jobs_table_lookup(void)
+{
+    // Process ids that don't belong to this process; nothing gets reaped for them
+    const pid_t first_pids[] = {999991};
+    const pid_t second_pids[] = {999992, 999993};
+    job* first = jobs_add("sleep 10 &\n", 11, 0, first_pids, 1, true);
+    job* second = jobs_add("ls | wc", 7, 0, second_pids, 2, false);
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_NOT_NULL(second);
+    TEST_ASSERT_EQUAL_UINT(first->id + 1, second->id);
+    TEST_ASSERT_EQUAL_STRING("sleep 10 &", first->command);
+    TEST_ASSERT_EQUAL_PTR(second, jobs_find_spec(NULL));
+    char spec[16];
+    snprintf(spec, sizeof(spec), "%%%u", first->id);
+    TEST_ASSERT_EQUAL_PTR(first, jobs_find_spec(spec));
+    TEST_ASSERT_NULL(jobs_find_spec("%x"));
+    TEST_ASSERT_EQUAL_INT(JOB_RUNNING, jobs_state(second));
+    const unsigned second_id = second->id;
+    jobs_remove(second);
+    TEST_ASSERT_NULL(jobs_find(second_id));
+    TEST_ASSERT_EQUAL_PTR(first, jobs_find_spec(NULL));
+    jobs_remove(first);
+    TEST_ASSERT_NULL(jobs_find_spec(NULL));
+}
+
+//! \brief Helper that counts (on the int given as ctx) the times a file descriptor was ready, draining it.
+static void count_ready(int fd, uint32_t events, void* ctx)
+{
+    (void)events;
+    char drained[16];
+    TEST_ASSERT_TRUE(read(fd, drained, sizeof(drained)) > 0);
+    (*(int*)ctx)++;
+}
+
+//! \brief Test for event_dispatch(): handlers are called for ready file descriptors only, until they're unwatched.
+void test_event_dispatch(void)
+{
+    int pipefd[2];
+    TEST_ASSERT_EQUAL_INT(0, pipe(pipefd));
+    int n_ready = 0;
+    TEST_ASSERT_EQUAL_INT(0, event_watch(pipefd[0], EPOLLIN, count_ready, &n_ready));
+    // Nothing written yet
+    TEST_ASSERT_EQUAL_INT(0, event_dispatch(0));
+    TEST_ASSERT_EQUAL_INT(1, (int)write(pipefd[1], "x", 1));
+    TEST_ASSERT_EQUAL_INT(1, event_dispatch(-1));
+    TEST_ASSERT_EQUAL_INT(1, n_ready);
+    // Once unwatched, its handler isn't called anymore
+    event_unwatch(pipefd[0]);
+    TEST_ASSERT_EQUAL_INT(1, (int)write(pipefd[1], "x", 1));
+    TEST_ASSERT_EQUAL_INT(0, event_dispatch(0));
+    TEST_ASSERT_EQUAL_INT(1, n_ready);
+    event_close(pipefd[0]);
+    close(pipefd[1]);
+}
+
+//! \brief Test that the latest sample published on a ring is read back, also from another mapping of its memfd.
+void test_metrics_ring_latest(void)
+{
+    int fd;
+    metrics_ring* ring = metrics_ring_create(&fd);
+    TEST_ASSERT_NOT_NULL(ring);
+    metrics_sample sample;
+    TEST_ASSERT_FALSE(metrics_ring_latest(ring, &sample));
+    // More samples than slots, so the ring wraps around
+    for (uint64_t i = 1; i <= METRICS_RING_SLOTS + 5; i++)
+    {
+        const metrics_sample published = {.timestamp_ns = i, .fields = METRICS_FIELD_HDD, .sectors_read_rate = i * 10};
+        metrics_ring_publish(ring, &published);
+    }
+    metrics_ring* attached = metrics_ring_attach(fd);
+    TEST_ASSERT_NOT_NULL(attached);
+    TEST_ASSERT_TRUE(metrics_ring_latest(attached, &sample));
+    TEST_ASSERT_EQUAL_UINT64(METRICS_RING_SLOTS + 5, sample.timestamp_ns);
+    TEST_ASSERT_EQUAL_UINT64((METRICS_RING_SLOTS + 5) * 10, sample.sectors_read_rate);
+    metrics_ring_release(attached);
+    metrics_ring_release(ring);
+    close(fd);
+}
+
+//! \brief Test for metrics_history_summary(): exact count/min/max/avg, percentiles within the sketch accuracy, and
+//! samples out of the window left out; each history on its own.
+void test_metrics_history_summary(void)
+{
+    metrics_history* history = metrics_history_create();
+    metrics_history* other = metrics_history_create();
+    TEST_ASSERT_NOT_NULL(history);
+    TEST_ASSERT_NOT_NULL(other);
+    const uint64_t start_ns = 100 * HISTORY_BUCKET_NS;
+    // A sample way before the window, then 1..100 on the last minute
+    const metrics_sample old = {.timestamp_ns = start_ns - 10 * HISTORY_BUCKET_NS,
+                                .fields = METRICS_FIELD_CPU | METRICS_FIELD_HDD,
+                                .cpu_usage = 1000.0,
+                                .sectors_read_rate = 100000};
+    TEST_ASSERT_TRUE(metrics_history_add(history, &old));
+    for (uint64_t i = 1; i <= 100; i++)
+    {
+        const metrics_sample sample = {.timestamp_ns = start_ns + i * (HISTORY_BUCKET_NS / 20),
+                                       .fields = METRICS_FIELD_CPU | METRICS_FIELD_HDD,
+                                       .cpu_usage = (double)i / 4,
+                                       .sectors_read_rate = i};
+        TEST_ASSERT_TRUE(metrics_history_add(history, &sample));
+    }
+    const uint64_t now_ns = start_ns + 5 * HISTORY_BUCKET_NS + 1;
+    metrics_summary summary;
+    metrics_history_summary(history, SERIES_SECTORS_READ, 6 * HISTORY_BUCKET_NS, now_ns, &summary);
+    TEST_ASSERT_EQUAL_UINT64(100, summary.count);
+    TEST_ASSERT_EQUAL_FLOAT(1.0, summary.min);
+    TEST_ASSERT_EQUAL_FLOAT(100.0, summary.max);
+    TEST_ASSERT_EQUAL_FLOAT(50.5, summary.avg);
+    TEST_ASSERT_FLOAT_WITHIN(50 * HISTORY_RATE_ACCURACY, 50.0, summary.p50);
+    TEST_ASSERT_FLOAT_WITHIN(95 * HISTORY_RATE_ACCURACY, 95.0, summary.p95);
+    metrics_history_summary(history, SERIES_CPU, 6 * HISTORY_BUCKET_NS, now_ns, &summary);
+    TEST_ASSERT_EQUAL_UINT64(100, summary.count);
+    TEST_ASSERT_EQUAL_FLOAT(25.0, summary.max);
+    TEST_ASSERT_FLOAT_WITHIN(12.5 * HISTORY_PCT_ACCURACY, 12.5, summary.p50);
+    TEST_ASSERT_FLOAT_WITHIN(24.75 * HISTORY_PCT_ACCURACY, 24.75, summary.p99);
+    // A wider window takes the old sample in
+    metrics_history_summary(history, SERIES_SECTORS_READ, 20 * HISTORY_BUCKET_NS, now_ns, &summary);
+    TEST_ASSERT_EQUAL_UINT64(101, summary.count);
+    TEST_ASSERT_EQUAL_FLOAT(100000.0, summary.max);
+    metrics_history_summary(history, SERIES_NET_RX, 20 * HISTORY_BUCKET_NS, now_ns, &summary);
+    TEST_ASSERT_EQUAL_UINT64(0, summary.count);
+    metrics_history_summary(other, SERIES_SECTORS_READ, 20 * HISTORY_BUCKET_NS, now_ns, &summary);
+    TEST_ASSERT_EQUAL_UINT64(0, summary.count);
+    metrics_history_destroy(other);
+    metrics_history_destroy(history);
+}
+
+//! \brief Helper that sends what gets written to a standard stream to /dev/null, until restore_stream().
+static int silence_stream(int fd)
+{
+    fflush(fd == STDOUT_FILENO ? stdout : stderr);
+    const int original = dup(fd);
+    const int null_fd = open("/dev/null", O_WRONLY);
+    TEST_ASSERT_NOT_EQUAL(-1, original);
+    TEST_ASSERT_NOT_EQUAL(-1, null_fd);
+    dup2(null_fd, fd);
+    close(null_fd);
+    return original;
+}
+
+//! \brief Helper that gives a standard stream silenced by silence_stream() back.
+static void restore_stream(int fd, int original)
+{
+    fflush(fd == STDOUT_FILENO ? stdout : stderr);
+    dup2(original, fd);
+    close(original);
+}
+
+//! \brief Test for monitor_claim(): names are validated, and a stopped instance's slot is taken back by its name. A
+//! start that fails (a bad option, or no process) leaves neither the name registered nor its kept history wiped.
+void test_monitor_claim(void)
+{
+    TEST_ASSERT_FALSE(monitor_name_valid(MONITOR_ALL_NAME));
+    TEST_ASSERT_FALSE(monitor_name_valid("two words"));
+    TEST_ASSERT_FALSE(monitor_name_valid(""));
+    TEST_ASSERT_FALSE(monitor_name_valid("0123456789012345678901234567890123"));
+    TEST_ASSERT_TRUE(monitor_name_valid("fast_1-b"));
+    TEST_ASSERT_NULL(monitor_find("fast"));
+    monitor* fast = monitor_claim("fast");
+    TEST_ASSERT_NOT_NULL(fast);
+    TEST_ASSERT_EQUAL_STRING("fast", fast->name);
+    TEST_ASSERT_EQUAL_INT(MONITOR_NO_PID, fast->pid);
+    TEST_ASSERT_EQUAL_INT(-1, fast->control_fd);
+    TEST_ASSERT_NOT_NULL(fast->history);
+    monitor* slow = monitor_claim("slow");
+    TEST_ASSERT_NOT_NULL(slow);
+    TEST_ASSERT_TRUE(fast != slow);
+    TEST_ASSERT_EQUAL_PTR(fast, monitor_find("fast"));
+    // Not running: its name takes the same slot again
+    TEST_ASSERT_EQUAL_PTR(fast, monitor_claim("fast"));
+    TEST_ASSERT_FALSE(monitor_running(fast));
+    const metrics_sample sample = {.timestamp_ns = HISTORY_BUCKET_NS, .fields = METRICS_FIELD_CPU, .cpu_usage = 5.0};
+    TEST_ASSERT_TRUE(metrics_history_add(fast->history, &sample));
+    char* mistyped[] = {"start_monitor", "--name=fast", "--cpu=maybe", NULL};
+    char* unknown[] = {"start_monitor", "--name=typo", "--cpu=maybe", NULL};
+    char* unspawned[] = {"start_monitor", "--name=unspawned", NULL};
+    char cwd[] = "/";
+    const int original_stderr = silence_stream(STDERR_FILENO);
+    execute_start_monitor(&(builtin_call){mistyped, false, cwd, stdout, false});
+    execute_start_monitor(&(builtin_call){unknown, false, cwd, stdout, false});
+    // Only where the "metrics" app can't be run, so the spawn fails
+    const bool can_spawn = access(METRICS_APP_PATH, X_OK) == 0;
+    if (!can_spawn)
+    {
+        execute_start_monitor(&(builtin_call){unspawned, false, cwd, stdout, false});
+    }
+    restore_stream(STDERR_FILENO, original_stderr);
+    TEST_ASSERT_NULL(monitor_find("typo"));
+    metrics_summary summary;
+    metrics_history_summary(fast->history, SERIES_CPU, 2 * HISTORY_BUCKET_NS, 2 * HISTORY_BUCKET_NS, &summary);
+    TEST_ASSERT_EQUAL_UINT64(1, summary.count);
+    if (!can_spawn)
+    {
+        TEST_ASSERT_NULL(monitor_find("unspawned"));
+    }
+    // A slot given back has no name nor channels
+    monitor* unstarted = monitor_claim("unstarted");
+    TEST_ASSERT_NOT_NULL(unstarted);
+    monitor_unclaim(unstarted);
+    TEST_ASSERT_NULL(monitor_find("unstarted"));
+    TEST_ASSERT_EQUAL_INT(-1, unstarted->control_fd);
+    TEST_ASSERT_NULL(unstarted->samples);
+}
+
+//! \brief Test for dashboard_render(): the whole dashboard first, then only the values that changed, at their place.
+void test_dashboard_render(void)
+{
+    const char* labels[] = {"CPU", "Network"};
+    const char* values[] = {"1.00 %", "42"};
+    dashboard board;
+    dashboard_init(&board, "title", labels, 2);
+    char frame[DASHBOARD_FRAME_SIZE];
+    size_t len = dashboard_render(&board, values, frame);
+    TEST_ASSERT_TRUE(len > 0);
+    TEST_ASSERT_NOT_NULL(strstr(frame, "title\n-----\nCPU:\nNetwork:"));
+    TEST_ASSERT_NOT_NULL(strstr(frame, "\033[3;10H1.00 %\033[K"));
+    TEST_ASSERT_NOT_NULL(strstr(frame, "\033[4;10H42\033[K"));
+    // Nothing changed, nothing to write
+    TEST_ASSERT_EQUAL_UINT64(0, dashboard_render(&board, values, frame));
+    values[1] = "43";
+    len = dashboard_render(&board, values, frame);
+    frame[len] = '\0';
+    TEST_ASSERT_EQUAL_STRING("\033[4;10H43\033[K", frame);
+    len = dashboard_leave(&board, frame);
+    frame[len] = '\0';
+    TEST_ASSERT_EQUAL_STRING("\033[5;1H\033[?25h", frame);
+}
+
+//! \brief Test for metrics_control_request(): the change arrives whole, stale acknowledgments are skipped, and the
+//! reason of a rejection is given back.
+void test_metrics_control_request(void)
+{
+    int fds[2];
+    TEST_ASSERT_EQUAL_INT(0, metrics_control_open(fds));
+    metrics_control_msg msg = {.options = 1u << CPU_I | 1u << UPDATE_I_I, .values = {[UPDATE_I_I] = 2, [CPU_I] = 0}};
+    // Nobody answers yet
+    TEST_ASSERT_EQUAL_INT(-1, metrics_control_request(fds[0], &msg, 0));
+    TEST_ASSERT_EQUAL_INT(ETIMEDOUT, errno);
+    metrics_control_msg received;
+    TEST_ASSERT_EQUAL_INT(0, metrics_control_receive(fds[1], &received));
+    TEST_ASSERT_EQUAL_UINT32(msg.sequence, received.sequence);
+    unsigned char data[N_JSON_ENTRIES] = JSON_ENTRIES_DEF_VAL;
+    metrics_control_apply(&received, data);
+    TEST_ASSERT_EQUAL_UINT8(2, data[UPDATE_I_I]);
+    TEST_ASSERT_EQUAL_UINT8(0, data[CPU_I]);
+    TEST_ASSERT_EQUAL_UINT8(1, data[MEM_I]);
+    // Late acknowledgment of the first change, then (ahead of time) a rejection of the next one
+    TEST_ASSERT_EQUAL_INT(0, metrics_control_acknowledge(fds[1], received.sequence, 0));
+    TEST_ASSERT_EQUAL_INT(0, metrics_control_acknowledge(fds[1], received.sequence + 1, EINVAL));
+    TEST_ASSERT_EQUAL_INT(-1, metrics_control_request(fds[0], &msg, 100));
+    TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+    close(fds[1]);
+    TEST_ASSERT_EQUAL_INT(-1, metrics_control_request(fds[0], &msg, 100));
+    TEST_ASSERT_EQUAL_INT(EPIPE, errno);
+    close(fds[0]);
+}
+
+//! \brief Helper that reads the "update_interval" of the JSON config held by a file descriptor.
+static int read_update_interval(int fd)
+{
+    char json[512];
+    const ssize_t len = pread(fd, json, sizeof(json) - 1, 0);
+    TEST_ASSERT_TRUE(len > 0);
+    json[len] = '\0';
+    cJSON* root = cJSON_Parse(json);
+    TEST_ASSERT_NOT_NULL(root);
+    TEST_ASSERT_TRUE(cJSON_IsFalse(cJSON_GetObjectItem(cJSON_GetObjectItem(root, "metrics"), "cpu")));
+    const int update_interval = cJSON_GetObjectItem(root, "update_interval")->valueint;
+    cJSON_Delete(root);
+    return update_interval;
+}
+
+//! \brief Test for get_metrics_config(): the config is built on a sealed memfd, reused while it doesn't change.
+void test_get_metrics_config_memfd(void)
+{
+    char* argv_first[] = {"start_monitor", "--update_interval=7", "--cpu=false", NULL};
+    char* argv_second[] = {"start_monitor", "--cpu=false", "--update_interval=8", NULL};
+    char* argv_bad[] = {"start_monitor", "--update_interval=5abc", NULL};
+    char* path;
+    int fd;
+    TEST_ASSERT_EQUAL_INT(0, get_metrics_config(argv_first, &path, &fd));
+    TEST_ASSERT_NULL(path);
+    TEST_ASSERT_TRUE(fd >= 0);
+    TEST_ASSERT_EQUAL_INT(7, read_update_interval(fd));
+    TEST_ASSERT_EQUAL_INT(-1, pwrite(fd, "{", 1, 0));
+    int cached_fd;
+    TEST_ASSERT_EQUAL_INT(0, get_metrics_config(argv_first, &path, &cached_fd));
+    TEST_ASSERT_EQUAL_INT(fd, cached_fd);
+    TEST_ASSERT_EQUAL_INT(0, get_metrics_config(argv_second, &path, &fd));
+    TEST_ASSERT_EQUAL_INT(8, read_update_interval(fd));
+    TEST_ASSERT_EQUAL_INT(-1, get_metrics_config(argv_bad, &path, &fd));
+}
+
+//! \brief Helper that tells if a file found by explore_tree() is a config file.
+static bool wanted_config(const char* name, void* ctx)
+{
+    (void)ctx;
+    return is_config_file(name);
+}
+
+//! \brief Helper that collects every dir reported by explore_tree(), as "D:path;".
+static void collect_explored_dir(const char* path, int error, void* ctx)
+{
+    TEST_ASSERT_EQUAL_INT(0, error);
+    strcat(ctx, "D:");
+    strcat(ctx, path);
+    strcat(ctx, ";");
+}
+
+//! \brief Helper that collects every file reported by explore_tree(), as "F:path;".
+static void collect_explored_file(const char* path, void* found, void* ctx)
+{
+    TEST_ASSERT_NULL(found);
+    strcat(ctx, "F:");
+    strcat(ctx, path);
+    strcat(ctx, ";");
+}
+
+//! \brief Helper that stops explore_tree() once a file was reported.
+static bool stop_after_file(void* ctx)
+{
+    return strstr(ctx, "F:") != NULL;
+}
+
+//! \brief Test for explore_tree(): only the wanted files get reported, each dir before its content, and in the same
+//! order whatever the amount of threads; once stopped, what got reported until then is the same too.
+void test_explore_tree_order(void)
+{
+    char root[] = "/tmp/shell_project_explore_XXXXXX";
+    TEST_ASSERT_NOT_NULL(mkdtemp(root));
+    const char* dirs[] = {"a", "a/b", "c"};
+    const char* files[] = {"w.json", "a/x.json", "a/b/y.config", "c/z.txt"};
+    char path[PATH_MAX];
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", root, dirs[i]);
+        TEST_ASSERT_EQUAL_INT(0, mkdir(path, 0700));
+    }
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", root, files[i]);
+        FILE* file = fopen(path, "w");
+        TEST_ASSERT_NOT_NULL(file);
+        fclose(file);
+    }
+    char sequential[1024] = "";
+    char parallel[1024] = "";
+    const explore_visitor sequential_visitor = {wanted_config, NULL, collect_explored_dir, collect_explored_file, NULL,
+                                                sequential};
+    const explore_visitor parallel_visitor = {wanted_config, NULL, collect_explored_dir, collect_explored_file, NULL,
+                                              parallel};
+    TEST_ASSERT_EQUAL_INT(0, explore_tree(root, 1, NULL, &sequential_visitor));
+    TEST_ASSERT_EQUAL_INT(0, explore_tree(root, 8, NULL, &parallel_visitor));
+    TEST_ASSERT_EQUAL_STRING(sequential, parallel);
+    snprintf(path, sizeof(path), "D:%s/a/b;", root);
+    const char* dir_b = strstr(sequential, path);
+    snprintf(path, sizeof(path), "F:%s/a/b/y.config;", root);
+    const char* file_y = strstr(sequential, path);
+    TEST_ASSERT_NOT_NULL(dir_b);
+    TEST_ASSERT_NOT_NULL(file_y);
+    TEST_ASSERT_TRUE(dir_b < file_y);
+    TEST_ASSERT_NULL(strstr(sequential, "z.txt"));
+    char stopped[1024] = "";
+    const explore_visitor stopping_visitor = {wanted_config, NULL, collect_explored_dir, collect_explored_file,
+                                              stop_after_file, stopped};
+    TEST_ASSERT_EQUAL_INT(-1, explore_tree(root, 8, NULL, &stopping_visitor));
+    TEST_ASSERT_EQUAL_INT(ECANCELED, errno);
+    const char* first_file = strstr(stopped, "F:");
+    TEST_ASSERT_NOT_NULL(first_file);
+    TEST_ASSERT_EQUAL_INT(0, strncmp(sequential, stopped, (size_t)(strchr(first_file, ';') + 1 - stopped)));
+    for (size_t i = sizeof(files) / sizeof(files[0]); i > 0; i--)
+    {
+        snprintf(path, sizeof(path), "%s/%s", root, files[i - 1]);
+        unlink(path);
+    }
+    for (size_t i = sizeof(dirs) / sizeof(dirs[0]); i > 0; i--)
+    {
+        snprintf(path, sizeof(path), "%s/%s", root, dirs[i - 1]);
+        rmdir(path);
+    }
+    rmdir(root);
+}
+
+//! \brief Helper that collects every dir reported by explore_tree(), as "D:path;" (or "L:path;" if it's a loop).
+static void collect_filtered_dir(const char* path, int error, void* ctx)
+{
+    TEST_ASSERT_TRUE(error == 0 || error == ELOOP);
+    strcat(ctx, error == 0 ? "D:" : "L:");
+    strcat(ctx, path);
+    strcat(ctx, ";");
+}
+
+//! \brief Test for the filter of explore_tree(): depth, excludes and ignore files (a deeper one, or a later glob, take
+//! precedence) leave entries out, and a symbolic link to a dir it's inside of isn't followed.
+void test_explore_tree_filter(void)
+{
+    char root[] = "/tmp/shell_project_filter_XXXXXX";
+    TEST_ASSERT_NOT_NULL(mkdtemp(root));
+    const char* dirs[] = {"build", "keep", "node_modules", "d1", "d1/d2", "d1/d2/d3"};
+    const char* files[] = {".ignore",     "a.json",       "skip.json",           "keep/skip.json", "keep/.ignore",
+                           "keep/b.json", "build/x.json", "node_modules/m.json", "d1/d2/d3/deep.json"};
+    const char* ignores[] = {"# Comment\nskip.json\n!keep/skip.json\nbuild/\n", "b.json\n"};
+    char path[PATH_MAX];
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", root, dirs[i]);
+        TEST_ASSERT_EQUAL_INT(0, mkdir(path, 0700));
+    }
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", root, files[i]);
+        FILE* file = fopen(path, "w");
+        TEST_ASSERT_NOT_NULL(file);
+        fputs(strstr(files[i], ".ignore") == NULL ? "{}" : ignores[i != 0], file);
+        fclose(file);
+    }
+    snprintf(path, sizeof(path), "%s/d1/loop", root);
+    TEST_ASSERT_EQUAL_INT(0, symlink("..", path));
+    explore_filter filter = {.max_depth = 2, .excludes = {"node_modules"}, .n_excludes = 1, .ignore_file = ".ignore"};
+    char found[2048] = "";
+    const explore_visitor visitor = {wanted_config, NULL, collect_filtered_dir, collect_explored_file, NULL, found};
+    TEST_ASSERT_EQUAL_INT(0, explore_tree(root, 4, &filter, &visitor));
+    const char* expected[] = {"D:%s;", "F:%s/a.json;", "D:%s/keep;", "F:%s/keep/skip.json;", "D:%s/d1/d2;",
+                              "L:%s/d1/loop;"};
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+    {
+        snprintf(path, sizeof(path), expected[i], root);
+        TEST_ASSERT_NOT_NULL(strstr(found, path));
+    }
+    const char* left_out[] = {"F:%s/skip.json;", "%s/keep/b.json", "%s/build", "%s/node_modules", "%s/d1/d2/d3"};
+    for (size_t i = 0; i < sizeof(left_out) / sizeof(left_out[0]); i++)
+    {
+        snprintf(path, sizeof(path), left_out[i], root);
+        TEST_ASSERT_NULL(strstr(found, path));
+    }
+    filter.base = root;
+    snprintf(path, sizeof(path), "%s/keep/skip.json", root);
+    TEST_ASSERT_TRUE(explore_filter_admits(&filter, path, false));
+    snprintf(path, sizeof(path), "%s/keep/b.json", root);
+    TEST_ASSERT_FALSE(explore_filter_admits(&filter, path, false));
+    snprintf(path, sizeof(path), "%s/d1/d2/d3", root);
+    TEST_ASSERT_FALSE(explore_filter_admits(&filter, path, true));
+    snprintf(path, sizeof(path), "%s/d1/loop", root);
+    unlink(path);
+    for (size_t i = sizeof(files) / sizeof(files[0]); i > 0; i--)
+    {
+        snprintf(path, sizeof(path), "%s/%s", root, files[i - 1]);
+        unlink(path);
+    }
+    for (size_t i = sizeof(dirs) / sizeof(dirs[0]); i > 0; i--)
+    {
+        snprintf(path, sizeof(path), "%s/%s", root, dirs[i - 1]);
+        rmdir(path);
+    }
+    rmdir(root);
+}
+
+//! \brief Test for copy_file_to_fd(): the whole file gets copied to a pipe and to a regular file, whatever the way
+//! tried first; the ones the kernel can't do get skipped.
+void test_copy_file_to_fd(void)
+{
+    const char content[] = "{\"update_interval\": 1}\n";
+    char in_path[] = "/tmp/shell_project_copy_in_XXXXXX";
+    char out_path[] = "/tmp/shell_project_copy_out_XXXXXX";
+    const int in_fd = mkstemp(in_path);
+    const int out_fd = mkstemp(out_path);
+    TEST_ASSERT_NOT_EQUAL(-1, in_fd);
+    TEST_ASSERT_NOT_EQUAL(-1, out_fd);
+    TEST_ASSERT_EQUAL_INT((int)strlen(content), (int)write(in_fd, content, strlen(content)));
+    char copied[64];
+    for (enum copy_method first = COPY_FILE_RANGE; first <= COPY_BUFFERED; first++)
+    {
+        int pipefd[2];
+        TEST_ASSERT_EQUAL_INT(0, pipe(pipefd));
+        enum copy_method method = first;
+        TEST_ASSERT_EQUAL_INT(0, (int)lseek(in_fd, 0, SEEK_SET));
+        TEST_ASSERT_EQUAL_INT(0, copy_file_to_fd(in_fd, pipefd[1], &method));
+        TEST_ASSERT_TRUE(method >= first);
+        close(pipefd[1]);
+        memset(copied, 0, sizeof(copied));
+        TEST_ASSERT_EQUAL_INT((int)strlen(content), (int)read(pipefd[0], copied, sizeof(copied)));
+        close(pipefd[0]);
+        TEST_ASSERT_EQUAL_STRING(content, copied);
+        method = first;
+        TEST_ASSERT_EQUAL_INT(0, (int)lseek(in_fd, 0, SEEK_SET));
+        TEST_ASSERT_EQUAL_INT(0, ftruncate(out_fd, 0));
+        TEST_ASSERT_EQUAL_INT(0, (int)lseek(out_fd, 0, SEEK_SET));
+        TEST_ASSERT_EQUAL_INT(0, copy_file_to_fd(in_fd, out_fd, &method));
+        memset(copied, 0, sizeof(copied));
+        TEST_ASSERT_EQUAL_INT((int)strlen(content), (int)pread(out_fd, copied, sizeof(copied), 0));
+        TEST_ASSERT_EQUAL_STRING(content, copied);
+    }
+    close(in_fd);
+    close(out_fd);
+    unlink(in_path);
+    unlink(out_path);
+}
+
+//! \brief Test for the config files index: changes are told, it survives a save and load, and removals are swept.
+void test_config_index_changes(void)
+{
+    char dir[] = "/tmp/shell_project_index_XXXXXX";
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+    char kept[PATH_MAX];
+    char gone[PATH_MAX];
+    char file[PATH_MAX];
+    snprintf(kept, sizeof(kept), "%s/kept.json", dir);
+    snprintf(gone, sizeof(gone), "%s/gone.config", dir);
+    snprintf(file, sizeof(file), "%s/index", dir);
+    FILE* f = fopen(kept, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fputs("{\"cpu\": true}\n", f);
+    fclose(f);
+    f = fopen(gone, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fclose(f);
+    config_index* index = config_index_create(dir);
+    TEST_ASSERT_NOT_NULL(index);
+    enum config_change change;
+    config_index_begin_scan(index);
+    TEST_ASSERT_EQUAL_INT(0, config_index_refresh(index, kept, &change));
+    TEST_ASSERT_EQUAL_INT(CONFIG_ADDED, change);
+    TEST_ASSERT_EQUAL_INT(0, config_index_refresh(index, gone, &change));
+    TEST_ASSERT_EQUAL_INT(CONFIG_ADDED, change);
+    TEST_ASSERT_EQUAL_INT(0, config_index_save(index, file));
+    config_index_destroy(index);
+    // An index of another dir isn't loaded, nor one that anybody else could write to
+    index = config_index_create("/elsewhere");
+    TEST_ASSERT_EQUAL_INT(-1, config_index_load(index, file));
+    TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+    config_index_destroy(index);
+    index = config_index_create(dir);
+    TEST_ASSERT_EQUAL_INT(0, chmod(file, 0666));
+    TEST_ASSERT_EQUAL_INT(-1, config_index_load(index, file));
+    TEST_ASSERT_EQUAL_INT(EPERM, errno);
+    TEST_ASSERT_EQUAL_INT(0, chmod(file, 0600));
+    config_index_destroy(index);
+    // The default one is on a dir of the cache dir only the user gets in
+    char cache[PATH_MAX];
+    char default_path[PATH_MAX];
+    char* saved_cache = getenv(CONFIG_INDEX_CACHE_ENV_KEY) != NULL ? strdup(getenv(CONFIG_INDEX_CACHE_ENV_KEY)) : NULL;
+    setenv(CONFIG_INDEX_CACHE_ENV_KEY, dir, 1);
+    TEST_ASSERT_TRUE(config_index_default_path(dir, default_path, sizeof(default_path)));
+    snprintf(cache, sizeof(cache), "%s/" CONFIG_INDEX_CACHE_DIR, dir);
+    TEST_ASSERT_EQUAL_MEMORY(cache, default_path, strlen(cache));
+    struct stat st;
+    TEST_ASSERT_EQUAL_INT(0, stat(cache, &st));
+    TEST_ASSERT_EQUAL_INT(CONFIG_INDEX_DIR_MODE, st.st_mode & 0777);
+    TEST_ASSERT_FALSE(config_index_default_path(dir, default_path, strlen(cache)));
+    TEST_ASSERT_EQUAL_INT(ENAMETOOLONG, errno);
+    if (saved_cache != NULL)
+    {
+        setenv(CONFIG_INDEX_CACHE_ENV_KEY, saved_cache, 1);
+    }
+    else
+    {
+        unsetenv(CONFIG_INDEX_CACHE_ENV_KEY);
+    }
+    free(saved_cache);
+    rmdir(cache);
+    index = config_index_create(dir);
+    TEST_ASSERT_EQUAL_INT(0, config_index_load(index, file));
+    TEST_ASSERT_EQUAL_UINT(2, config_index_size(index));
+    config_index_begin_scan(index);
+    TEST_ASSERT_EQUAL_INT(0, config_index_refresh(index, kept, &change));
+    TEST_ASSERT_EQUAL_INT(CONFIG_UNCHANGED, change);
+    // Same size, written right after being hashed: only the content tells it apart
+    f = fopen(kept, "w");
+    TEST_ASSERT_NOT_NULL(f);
+    fputs("{\"cpu\": fals}\n", f);
+    fclose(f);
+    TEST_ASSERT_EQUAL_INT(0, config_index_refresh(index, kept, &change));
+    TEST_ASSERT_EQUAL_INT(CONFIG_CHANGED, change);
+    TEST_ASSERT_EQUAL_UINT(1, config_index_sweep(index, dir, NULL, NULL));
+    TEST_ASSERT_EQUAL_UINT(1, config_index_size(index));
+    TEST_ASSERT_FALSE(config_index_remove(index, gone));
+    TEST_ASSERT_TRUE(config_index_remove(index, kept));
+    config_index_destroy(index);
+    unlink(kept);
+    unlink(gone);
+    unlink(file);
+    rmdir(dir);
+}
+
+//! \brief Test for json_query_match(): predicates, the value selected, and the files left out before parsing.
+void test_json_query_match(void)
+{
+    const char matching[] = "{\"update_interval\": 7, \"metrics\": {\"cpu\": true}, \"tags\": [\"a\", \"b\"]}";
+    const char lower[] = "{\"update_interval\": 3, \"metrics\": {\"cpu\": false}}";
+    const char keyless[] = "{\"update_interval\": 9}";
+    char* where[] = {"update_interval>5", "tags.1=b"};
+    json_query query = {0};
+    TEST_ASSERT_EQUAL_INT(0, json_query_compile(&query, "metrics.cpu", where, 2));
+    char* value;
+    TEST_ASSERT_TRUE(json_query_may_match(&query, matching, strlen(matching)));
+    TEST_ASSERT_TRUE(json_query_match(&query, matching, strlen(matching), &value));
+    TEST_ASSERT_EQUAL_STRING("true", value);
+    free(value);
+    TEST_ASSERT_FALSE(json_query_match(&query, lower, strlen(lower), &value));
+    TEST_ASSERT_NULL(value);
+    TEST_ASSERT_FALSE(json_query_may_match(&query, keyless, strlen(keyless)));
+    TEST_ASSERT_FALSE(json_query_match(&query, "not json", strlen("not json"), &value));
+    json_query_free(&query);
+    char* invalid[] = {"update_interval"};
+    TEST_ASSERT_EQUAL_INT(-1, json_query_compile(&query, NULL, invalid, 1));
+    json_query_free(&query);
+    // A key spelled with escapes ("\/" for '/') isn't left out before parsing
+    const char escaped[] = "{\"paths\": {\"etc\\/metrics\": 1}}";
+    TEST_ASSERT_EQUAL_INT(0, json_query_compile(&query, "paths.etc/metrics", NULL, 0));
+    TEST_ASSERT_TRUE(json_query_may_match(&query, escaped, strlen(escaped)));
+    TEST_ASSERT_TRUE(json_query_match(&query, escaped, strlen(escaped), &value));
+    TEST_ASSERT_EQUAL_STRING("1", value);
+    free(value);
+    json_query_free(&query);
+}
+
+//! \brief Helper that counts the file descriptors open on the process, among the first 1024.
+static int count_open_fds(void)
+{
+    int open_fds = 0;
+    for (int fd = 0; fd < 1024; fd++)
+    {
+        open_fds += fcntl(fd, F_GETFD) != -1;
+    }
+    return open_fds;
+}
+
+//! \brief Test for the io_uring wrapper: a file gets opened into a registered slot, read and closed by a single chain
+//! of linked operations, submitted at once. Passes as is if the kernel lacks io_uring, or opening into a slot; if it
+//! has it, the check leaves the slot empty and nothing to reap, and no descriptor behind.
+void test_uring_linked_read(void)
+{
+    const char content[] = "{\"update_interval\": 1}\n";
+    char path[] = "/tmp/shell_project_uring_XXXXXX";
+    const int fd = mkstemp(path);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    TEST_ASSERT_EQUAL_INT((int)strlen(content), (int)write(fd, content, strlen(content)));
+    close(fd);
+    uring ring;
+    const uint8_t ops[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE};
+    const int open_fds = count_open_fds();
+    if (uring_init(&ring, 4) == -1 || !uring_supports(&ring, ops, sizeof(ops)) ||
+        uring_register_files(&ring, 1) == -1 || !uring_opens_direct(&ring))
+    {
+        uring_exit(&ring);
+        unlink(path);
+        return;
+    }
+    TEST_ASSERT_NULL(uring_peek_cqe(&ring));
+    // Only the ring itself
+    TEST_ASSERT_EQUAL_INT(open_fds + 1, count_open_fds());
+    char copied[64] = {0};
+    struct io_uring_sqe* sqe = uring_get_sqe(&ring);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uintptr_t)path;
+    sqe->file_index = 1;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = IORING_OP_OPENAT;
+    sqe = uring_get_sqe(&ring);
+    sqe->opcode = IORING_OP_READ;
+    sqe->addr = (uintptr_t)copied;
+    sqe->len = sizeof(copied);
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+    sqe->user_data = IORING_OP_READ;
+    sqe = uring_get_sqe(&ring);
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = 1;
+    sqe->user_data = IORING_OP_CLOSE;
+    TEST_ASSERT_EQUAL_INT(3, uring_submit(&ring, 3));
+    for (int i = 0; i < 3; i++)
+    {
+        const struct io_uring_cqe* cqe = uring_peek_cqe(&ring);
+        TEST_ASSERT_NOT_NULL(cqe);
+        TEST_ASSERT_EQUAL_INT(cqe->user_data == IORING_OP_READ ? (int)strlen(content) : 0, cqe->res);
+        uring_cqe_seen(&ring);
+    }
+    TEST_ASSERT_NULL(uring_peek_cqe(&ring));
+    TEST_ASSERT_EQUAL_STRING(content, copied);
+    uring_exit(&ring);
+    unlink(path);
+}
+
+//! \brief Helper that writes the same two records (one of them with a content chunk that needs escaping) on a format,
+//! and reads them back.
+static size_t write_records(enum record_format format, bool with_content, char* out, size_t size)
+{
+    FILE* file = tmpfile();
+    TEST_ASSERT_NOT_NULL(file);
+    record_writer writer;
+    TEST_ASSERT_EQUAL_INT(0, record_writer_init(&writer, fileno(file), format, with_content));
+    record_begin(&writer, "/etc/a\tb.json", 12, (struct timespec){1700000000, 5});
+    if (with_content)
+    {
+        record_content(&writer, "{\"k\":\n", 6);
+        record_content(&writer, "\"\\\x01\"}", 5);
+    }
+    record_end(&writer);
+    record_begin(&writer, "/etc/c.config", 0, (struct timespec){-2, 250000000});
+    record_end(&writer);
+    TEST_ASSERT_EQUAL_INT(0, record_writer_destroy(&writer));
+    rewind(file);
+    const size_t len = fread(out, 1, size, file);
+    fclose(file);
+    return len;
+}
+
+//! \brief Test for record_begin(), record_content() and record_end() on every format, and UTF-8 on NDJSON.
+void test_record_writer_formats(void)
+{
+    enum record_format format;
+    TEST_ASSERT_TRUE(record_format_parse("tsv", &format));
+    TEST_ASSERT_EQUAL_INT(RECORD_TSV, format);
+    TEST_ASSERT_FALSE(record_format_parse("csv", &format));
+    char out[512];
+    size_t len = write_records(RECORD_NDJSON, true, out, sizeof(out));
+    const char ndjson[] = "{\"path\":\"/etc/a\\tb.json\",\"size\":12,\"mtime\":1700000000.000000005,"
+                          "\"content\":\"{\\\"k\\\":\\n\\\"\\\\\\u0001\\\"}\"}\n"
+                          "{\"path\":\"/etc/c.config\",\"size\":0,\"mtime\":-1.750000000,\"content\":\"\"}\n";
+    TEST_ASSERT_EQUAL_size_t(strlen(ndjson), len);
+    TEST_ASSERT_EQUAL_MEMORY(ndjson, out, len);
+    len = write_records(RECORD_TSV, false, out, sizeof(out));
+    const char tsv[] = "/etc/a\\tb.json\t12\t1700000000.000000005\n/etc/c.config\t0\t-1.750000000\n";
+    TEST_ASSERT_EQUAL_size_t(strlen(tsv), len);
+    TEST_ASSERT_EQUAL_MEMORY(tsv, out, len);
+    len = write_records(RECORD_NULL, true, out, sizeof(out));
+    const char null[] = "/etc/a\tb.json\00012\0001700000000.000000005\000{\"k\":\n\"\\\x01\"}\000"
+                        "/etc/c.config\0000\000-1.750000000\000\000";
+    TEST_ASSERT_EQUAL_size_t(sizeof(null) - 1, len);
+    TEST_ASSERT_EQUAL_MEMORY(null, out, len);
+    // On NDJSON, valid UTF-8 is kept as is (even split between chunks of content), and any other byte escaped
+    FILE* file = tmpfile();
+    TEST_ASSERT_NOT_NULL(file);
+    record_writer writer;
+    TEST_ASSERT_EQUAL_INT(0, record_writer_init(&writer, fileno(file), RECORD_NDJSON, true));
+    record_begin(&writer, "/etc/\xc3\xb1\xff.json", 1, (struct timespec){0, 0});
+    const char* chunks[] = {"\xe2\x82", "\xac\xf0\x9f", "\x98\x80 \xed\xa0\x80 \xc3", "A\xe2"};
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++)
+    {
+        record_content(&writer, chunks[i], strlen(chunks[i]));
+    }
+    record_end(&writer);
+    TEST_ASSERT_EQUAL_INT(0, record_writer_destroy(&writer));
+    rewind(file);
+    len = fread(out, 1, sizeof(out), file);
+    fclose(file);
+    const char utf8[] = "{\"path\":\"/etc/\xc3\xb1\\u00ff.json\",\"size\":1,\"mtime\":0.000000000,"
+                        "\"content\":\"\xe2\x82\xac\xf0\x9f\x98\x80 \\u00ed\\u00a0\\u0080 \\u00c3A\\u00e2\"}\n";
+    TEST_ASSERT_EQUAL_size_t(strlen(utf8), len);
+    TEST_ASSERT_EQUAL_MEMORY(utf8, out, len);
+}
+
+//! \brief Test for spawn_pipes() and spawn_close_fds(): close-on-exec pipes of the capacity asked for, closed at once.
+void test_spawn_pipes_capacity(void)
+{
+    // Twice the default capacity, below the default /proc/sys/fs/pipe-max-size
+    const int size = 131072;
+    TEST_ASSERT_EQUAL_INT(0, spawn_check_pipe_size(size));
+    int fds[6];
+    TEST_ASSERT_EQUAL_INT(0, spawn_pipes(fds, 3, size));
+    for (size_t i = 0; i < 6; i++)
+    {
+        TEST_ASSERT_TRUE(fcntl(fds[i], F_GETFD) & FD_CLOEXEC);
+    }
+    // The whole capacity gets written without a reader
+    char chunk[4096] = {0};
+    TEST_ASSERT_EQUAL_INT(0, fcntl(fds[1], F_SETFL, O_NONBLOCK));
+    int written = 0;
+    while (write(fds[1], chunk, sizeof(chunk)) == (ssize_t)sizeof(chunk))
+    {
+        written += (int)sizeof(chunk);
+    }
+    TEST_ASSERT_EQUAL_INT(EAGAIN, errno);
+    TEST_ASSERT_GREATER_OR_EQUAL(size, written);
+    spawn_close_fds(fds, 6);
+    for (size_t i = 0; i < 6; i++)
+    {
+        TEST_ASSERT_EQUAL_INT(-1, fcntl(fds[i], F_GETFD));
+    }
+}
+
+//! \brief Test for the internal commands run on a helper thread as pipeline stages: one writing more than a pipe holds
+//! to a reader that's gone gets 141 (as a process killed by SIGPIPE) without taking the shell down; one whose job got
+//! stopped is left behind, and still ends once the job reads everything.
+void test_pipeline_builtin_stage(void)
+{
+    char dir[] = "/tmp/shell_project_stage_XXXXXX";
+    TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+    char config[PATH_MAX];
+    char script[PATH_MAX];
+    snprintf(config, sizeof(config), "%s/big.json", dir);
+    snprintf(script, sizeof(script), "%s/stop.sh", dir);
+    // Way more than a pipe holds
+    FILE* file = fopen(config, "w");
+    TEST_ASSERT_NOT_NULL(file);
+    for (int i = 0; i < 65536; i++)
+    {
+        fputs("{\"update_interval\": 1}\n", file);
+    }
+    fclose(file);
+    file = fopen(script, "w");
+    TEST_ASSERT_NOT_NULL(file);
+    fputs("kill -STOP $$\ncat > /dev/null\n", file);
+    fclose(file);
+    char cwd[PATH_MAX];
+    TEST_ASSERT_NOT_NULL(getcwd(cwd, sizeof(cwd)));
+    char line[3 * PATH_MAX];
+    snprintf(line, sizeof(line), "explore_filesystem %s | true", dir);
+    execute_command(line, strlen(line), cwd);
+    TEST_ASSERT_EQUAL_STRING("141 0", getenv(ENV_PIPESTATUS_KEY));
+    // The reader stops itself, so the stage gets detached while blocked on its full pipe; the notice of the stopped
+    // job isn't part of the test output
+    snprintf(line, sizeof(line), "explore_filesystem %s | /bin/sh %s", dir, script);
+    const int original_stdout = silence_stream(STDOUT_FILENO);
+    execute_command(line, strlen(line), cwd);
+    restore_stream(STDOUT_FILENO, original_stdout);
+    job* stopped = jobs_find_spec(NULL);
+    TEST_ASSERT_NOT_NULL(stopped);
+    TEST_ASSERT_EQUAL_INT(JOB_STOPPED, jobs_state(stopped));
+    // Its reader only finishes once the stage wrote everything and closed its end
+    TEST_ASSERT_EQUAL_INT(0, jobs_continue(stopped, true));
+    jobs_wait(stopped, false);
+    TEST_ASSERT_EQUAL_INT(JOB_DONE, jobs_state(stopped));
+    TEST_ASSERT_EQUAL_INT(EXIT_SUCCESS, jobs_exit_code(stopped));
+    jobs_remove(stopped);
+    unlink(script);
+    unlink(config);
+    rmdir(dir);
+}
+
+//! \brief Helper that spawns a program with its stdout on a pipe, and reads all it writes there, NULL-terminated.
+static void read_spawned(char* const* argv, spawn_io* io, char* out, size_t size)
+{
+    int fds[2];
+    TEST_ASSERT_EQUAL_INT(0, spawn_pipes(fds, 1, 0));
+    io->stdout_fd = fds[1];
+    const pid_t pid = spawn_process(argv[0], argv, io);
+    close(fds[1]);
+    TEST_ASSERT_NOT_EQUAL(-1, pid);
+    size_t len = 0;
+    ssize_t n_read;
+    while (len < size - 1 && (n_read = read(fds[0], out + len, size - 1 - len)) > 0)
+    {
+        len += (size_t)n_read;
+    }
+    out[len] = '\0';
+    close(fds[0]);
+    int status;
+    TEST_ASSERT_EQUAL_INT(pid, waitpid(pid, &status, 0));
+    TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+}
+
+//! \brief Helper that gives the signal mask of a "/proc/PID/status" line (i.e.: "SigIgn"), from a copy of the file.
+static unsigned long long status_mask(const char* status, const char* key)
+{
+    const char* line = strstr(status, key);
+    TEST_ASSERT_NOT_NULL(line);
+    return strtoull(line + strlen(key) + 1, NULL, 16);
+}
+
+//! \brief Test for spawn_process(): the spawned program gets its redirections opened and the descriptors to close
+//! closed, the signals requested back to their default disposition (the rest of the ignored ones still ignored), and
+//! nothing blocked, whatever the shell blocks.
+void test_spawn_process_wiring(void)
+{
+    char input[] = "/tmp/shell_project_spawn_XXXXXX";
+    const int fd = mkstemp(input);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    TEST_ASSERT_EQUAL_INT(6, (int)write(fd, "spawn\n", 6));
+    close(fd);
+    char output[sizeof(input) + 4];
+    snprintf(output, sizeof(output), "%s.out", input);
+    char* cat_argv[] = {"/bin/cat", NULL};
+    spawn_io io;
+    spawn_io_init(&io);
+    io.stdin_file = input;
+    io.stdout_file = output;
+    const pid_t pid = spawn_process(cat_argv[0], cat_argv, &io);
+    TEST_ASSERT_NOT_EQUAL(-1, pid);
+    int status;
+    TEST_ASSERT_EQUAL_INT(pid, waitpid(pid, &status, 0));
+    char copied[16] = {0};
+    const int copy_fd = open(output, O_RDONLY);
+    TEST_ASSERT_EQUAL_INT(6, (int)read(copy_fd, copied, sizeof(copied)));
+    close(copy_fd);
+    TEST_ASSERT_EQUAL_STRING("spawn\n", copied);
+    // A descriptor that isn't close-on-exec only leaks if it isn't asked to be closed
+    const int leaked = dup2(STDERR_FILENO, 100);
+    TEST_ASSERT_EQUAL_INT(100, leaked);
+    char* ls_argv[] = {"/bin/ls", "/proc/self/fd", NULL};
+    char fds[4096];
+    spawn_io_init(&io);
+    read_spawned(ls_argv, &io, fds, sizeof(fds));
+    TEST_ASSERT_NOT_NULL(strstr(fds, "100\n"));
+    spawn_io_init(&io);
+    io.fds_to_close = &leaked;
+    io.n_fds_to_close = 1;
+    read_spawned(ls_argv, &io, fds, sizeof(fds));
+    TEST_ASSERT_NULL(strstr(fds, "100\n"));
+    close(leaked);
+    // Ignored & blocked by the shell; only SIGINT gets reset
+    struct sigaction ignore = {.sa_handler = SIG_IGN};
+    struct sigaction original_int;
+    struct sigaction original_quit;
+    sigaction(SIGINT, &ignore, &original_int);
+    sigaction(SIGQUIT, &ignore, &original_quit);
+    sigset_t blocked;
+    sigset_t original_mask;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGUSR2);
+    sigprocmask(SIG_BLOCK, &blocked, &original_mask);
+    sigset_t sig_default;
+    sigemptyset(&sig_default);
+    sigaddset(&sig_default, SIGINT);
+    char* status_argv[] = {"/bin/cat", "/proc/self/status", NULL};
+    char proc_status[8192];
+    spawn_io_init(&io);
+    io.sig_default = &sig_default;
+    read_spawned(status_argv, &io, proc_status, sizeof(proc_status));
+    sigprocmask(SIG_SETMASK, &original_mask, NULL);
+    sigaction(SIGINT, &original_int, NULL);
+    sigaction(SIGQUIT, &original_quit, NULL);
+    const unsigned long long ignored = status_mask(proc_status, "SigIgn:");
+    TEST_ASSERT_FALSE(ignored & (1ULL << (SIGINT - 1)));
+    TEST_ASSERT_TRUE(ignored & (1ULL << (SIGQUIT - 1)));
+    TEST_ASSERT_EQUAL_UINT64(0, status_mask(proc_status, "SigBlk:"));
+    unlink(output);
+    unlink(input);
+}
+
+//! \brief Helper that tells a "=" line of a parallel run is a barrier, and the rest of them jobs.
+static enum parallel_line_kind classify_test_line(const char* line, size_t len, void* ctx)
+{
+    (void)ctx;
+    return len == 1 && line[0] == '=' ? PARALLEL_LINE_BARRIER : PARALLEL_LINE_JOB;
+}
+
+//! \brief Helper that runs a line of a parallel run: "N x" sleeps N tenths of a second, then shows the line (or, for
+//! "N big", more than a pipe holds).
+static void run_test_line(const char* line, size_t len, void* ctx)
+{
+    (void)ctx;
+    usleep((useconds_t)(line[0] - '0') * 100000);
+    if (len > 2 && strncmp(line + 2, "big", len - 2) == 0)
+    {
+        for (int i = 0; i < 100000; i++)
+        {
+            putchar('b');
+        }
+        putchar('\n');
+        return;
+    }
+    printf("%.*s\n", (int)len, line);
+}
+
+//! \brief Test that the lines of a batch file run on several workers show their output in the order of the lines,
+//! whichever finishes first: a slow first line holds the rest (even more than a pipe holds) back, and a barrier runs
+//! on the calling process once the lines before it showed theirs.
+void test_parallel_output_order(void)
+{
+    const char content[] = "3 a\n0 big\n=\n1 c\n0 d\n";
+    FILE* batch = tmpfile();
+    FILE* captured = tmpfile();
+    TEST_ASSERT_NOT_NULL(batch);
+    TEST_ASSERT_NOT_NULL(captured);
+    fputs(content, batch);
+    fflush(batch);
+    rewind(batch);
+    fflush(stdout);
+    const int original_stdout = dup(STDOUT_FILENO);
+    dup2(fileno(captured), STDOUT_FILENO);
+    const int result = parallel_for_each_line(fileno(batch), 4, classify_test_line, run_test_line, NULL);
+    fflush(stdout);
+    dup2(original_stdout, STDOUT_FILENO);
+    close(original_stdout);
+    TEST_ASSERT_EQUAL_INT(0, result);
+    static char expected[100016];
+    static char output[sizeof(expected) + 16];
+    strcpy(expected, "3 a\n");
+    memset(expected + 4, 'b', 100000);
+    strcpy(expected + 100004, "\n=\n1 c\n0 d\n");
+    rewind(captured);
+    output[fread(output, 1, sizeof(output) - 1, captured)] = '\0';
+    TEST_ASSERT_EQUAL_STRING(expected, output);
+    fclose(captured);
+    fclose(batch);
+}
+
+//! \brief Helper that answers a "get status" req (SIGUSR1) as a "metrics" app does, with a fixed status.
+static void answer_status(int sig, siginfo_t* info, void* context)
+{
+    (void)context;
+    union sigval status;
+    status.sival_int = 0x01020304;
+    sigqueue(info->si_pid, sig, status);
+}
+
+//! \brief Helper that forks a stand-in for a "metrics" app that answers (or ignores, if not) every "get status" req.
+static pid_t fork_metrics_app(bool answers)
+{
+    int ready[2];
+    TEST_ASSERT_EQUAL_INT(0, pipe(ready));
+    const pid_t pid = fork();
+    TEST_ASSERT_NOT_EQUAL(-1, pid);
+    if (pid == 0)
+    {
+        struct sigaction action = {.sa_handler = SIG_IGN};
+        if (answers)
+        {
+            action = (struct sigaction){.sa_sigaction = answer_status, .sa_flags = SA_SIGINFO};
+        }
+        sigaction(SIGUSR1, &action, NULL);
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+        // Only asked once ready, so a req doesn't kill it first
+        close(ready[0]);
+        close(ready[1]);
+        for (;;)
+        {
+            pause();
+        }
+    }
+    close(ready[1]);
+    char nothing;
+    TEST_ASSERT_EQUAL_INT(0, (int)read(ready[0], &nothing, 1));
+    close(ready[0]);
+    return pid;
+}
+
+//! \brief Test for "status_monitor all": every "metrics" app is asked at once, the one answering shows its status, and
+//! the one that never does times out once, so the whole command takes the timeout, not more.
+void test_status_monitor_timeout(void)
+{
+    monitor* answering = monitor_claim("answering");
+    monitor* silent = monitor_claim("silent");
+    TEST_ASSERT_NOT_NULL(answering);
+    TEST_ASSERT_NOT_NULL(silent);
+    monitor_track(answering, fork_metrics_app(true));
+    monitor_track(silent, fork_metrics_app(false));
+    FILE* out = tmpfile();
+    TEST_ASSERT_NOT_NULL(out);
+    char* tokens[] = {"status_monitor", MONITOR_ALL_NAME, "--timeout=300", NULL};
+    char cwd[] = "/";
+    const builtin_call call = {tokens, false, cwd, out, false};
+    struct timespec started;
+    struct timespec finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    execute_status_monitor(&call);
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    const long elapsed_ms =
+        (long)(finished.tv_sec - started.tv_sec) * 1000 + (finished.tv_nsec - started.tv_nsec) / 1000000;
+    TEST_ASSERT_GREATER_OR_EQUAL(300, elapsed_ms);
+    TEST_ASSERT_LESS_OR_EQUAL(3000, elapsed_ms);
+    char shown[4096];
+    rewind(out);
+    shown[fread(shown, 1, sizeof(shown) - 1, out)] = '\0';
+    fclose(out);
+    TEST_ASSERT_NOT_NULL(strstr(shown, "silent           Timeout reached. No response."));
+    const char* row = strstr(shown, "answering");
+    TEST_ASSERT_NOT_NULL(row);
+    TEST_ASSERT_NOT_NULL(strstr(row, "(response)"));
+    monitor* apps[] = {answering, silent};
+    for (size_t i = 0; i < 2; i++)
+    {
+        kill(apps[i]->pid, SIGKILL);
+        waitpid(apps[i]->pid, NULL, 0);
+        TEST_ASSERT_FALSE(monitor_running(apps[i]));
+    }
+}
+
 //! \brief Main function for testing.
 int main(void)
 {
@@ -93,5 +1358,32 @@ int main(void)
     RUN_TEST(test_get_metrics_json_config_file_path_invalid_update_interval);
     RUN_TEST(test_get_metrics_json_config_file_path_invalid_cpu);
     RUN_TEST(test_delete_owned_metrics_json_config_file);
+    RUN_TEST(test_path_cache_lookup_found);
+    RUN_TEST(test_path_cache_lookup_not_found);
+    RUN_TEST(test_builtin_registry_perfect_hash);
+    RUN_TEST(test_arena_reset_reuses_memory);
+    RUN_TEST(test_parse_command_line_pipeline);
+    RUN_TEST(test_parse_command_line_malformed);
+    RUN_TEST(test_batch_for_each_line);
+    RUN_TEST(test_jobs_table_lookup);
+    RUN_TEST(test_event_dispatch);
+    RUN_TEST(test_metrics_ring_latest);
+    RUN_TEST(test_metrics_history_summary);
+    RUN_TEST(test_monitor_claim);
+    RUN_TEST(test_dashboard_render);
+    RUN_TEST(test_metrics_control_request);
+    RUN_TEST(test_get_metrics_config_memfd);
+    RUN_TEST(test_explore_tree_order);
+    RUN_TEST(test_explore_tree_filter);
+    RUN_TEST(test_copy_file_to_fd);
+    RUN_TEST(test_config_index_changes);
+    RUN_TEST(test_json_query_match);
+    RUN_TEST(test_uring_linked_read);
+    RUN_TEST(test_record_writer_formats);
+    RUN_TEST(test_spawn_pipes_capacity);
+    RUN_TEST(test_pipeline_builtin_stage);
+    RUN_TEST(test_spawn_process_wiring);
+    RUN_TEST(test_parallel_output_order);
+    RUN_TEST(test_status_monitor_timeout);
     return UNITY_END();
 }